@@ -4,12 +4,25 @@
 #define LONGx2 "16384"
 void main(void) {
    const char *n = "abcdefghijklmnopqrstuvwxyz0123456789";
+#if defined(__aarch64__)
+   uint32_t c = 0;
+   uint64_t v = 1;
+   __asm__(".arch_extension crc\n\t"
+           "crc32cx\t%w0, %w0, %x1"
+           : "+r"(c)
+           : "r"(v));
+   __asm__(".arch_extension crc\n\t"
+           "crc32cb\t%w0, %w0, %w1"
+           : "+r"(c)
+           : "r"((uint32_t)n[0]));
+   printf("avoiding unused code removal by printing %d\n", (int)c);
+#else
    uint64_t c0 = 0, c1 = 1, c2 = 2;
    uint64_t s;
    uint32_t eax = 1, ecx;
    __asm__("cpuid"
-           : "=c"(ecx)
-           : "a"(eax)
+           : "=c"(ecx), "+a"(eax)
+           :
            : "%ebx", "%edx");
    __asm__("crc32b\t" "(%1), %0"
            : "=r"(c0)
@@ -19,6 +32,14 @@ void main(void) {
            "crc32q\t" LONGx2 "(%3), %2"
            : "=r"(c0), "=r"(c1), "=r"(c2)
            : "r"(n), "0"(c0), "1"(c1), "2"(c2));
+   __asm__("movq\t%1, %%xmm0\n\t"
+           "movq\t%2, %%xmm1\n\t"
+           "pclmulqdq\t$0x00, %%xmm1, %%xmm0\n\t"
+           "movq\t%%xmm0, %0"
+           : "=r"(c0)
+           : "r"(c1), "r"(c2)
+           : "xmm0", "xmm1");
   s = c0 + c1 + c2;
   printf("avoiding unused code removal by printing %d, %d, %d\n", (int)s, (int)eax, (int)ecx);
+#endif
 }
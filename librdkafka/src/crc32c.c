@@ -4,10 +4,11 @@
  *   * global hw/sw initialization to be called once per process
  *   * HW support is determined by configure's WITH_CRC32C_HW
  *   * Windows porting (no hardware support on Windows yet)
+ *   * PCLMULQDQ, if available, to combine the three parallel crcs
+ *   * Hardware support on ARMv8 (crc32c instructions)
  *
  * FIXME:
  *   * Hardware support on Windows (MSVC assembler)
- *   * Hardware support on ARM
  */
 
 /* crc32c.c -- compute CRC-32C using the Intel crc32 instruction
@@ -53,6 +54,12 @@
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
+#if WITH_CRC32C_HW && defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
 
 #include "rdunittest.h"
 #include "rdendian.h"
@@ -135,7 +142,16 @@ static uint32_t crc32c_sw(uint32_t crci, const void *buf, size_t len)
 
 
 #if WITH_CRC32C_HW
-static int sse42;  /* Cached SSE42 support */
+#if defined(__aarch64__)
+#define CRC32C_HW_ARMV8 1
+#else
+#define CRC32C_HW_SSE42 1
+#endif
+
+static int hw_crc;  /* Cached crc instruction support (SSE 4.2 or ARMv8) */
+#if CRC32C_HW_SSE42
+static int pclmul;  /* Cached PCLMULQDQ support */
+#endif
 
 /* Multiply a matrix times a vector over the Galois field of two elements,
    GF(2).  Each element is a bit in an unsigned integer.  mat must have at
@@ -239,20 +255,88 @@ static RD_INLINE uint32_t crc32c_shift(uint32_t zeros[][256], uint32_t crc)
 #define SHORT 256
 #define SHORTx1 "256"
 #define SHORTx2 "512"
+#define TINY 64
+#define TINYx1 "64"
+#define TINYx2 "128"
 
 /* Tables for hardware crc that shift a crc by LONG and SHORT zeros. */
 static uint32_t crc32c_long[4][256];
 static uint32_t crc32c_short[4][256];
 
+#if CRC32C_HW_SSE42
+/* Constants for combining the three crcs of LONG and SHORT blocks with
+   PCLMULQDQ: [0] shifts a crc by two blocks, [1] by one block. */
+static uint32_t crc32c_long_k[2];
+static uint32_t crc32c_short_k[2];
+/* The combination is cheap enough for a third, TINY, block size. */
+static uint32_t crc32c_tiny_k[2];
+
+/* Return x^n modulo the CRC-32C polynomial, in reversed bit order. */
+static uint32_t crc32c_x_pow(size_t n)
+{
+    uint32_t p = 0x80000000;    /* x^0 */
+
+    while (n--)
+        p = p & 1 ? (p >> 1) ^ POLY : p >> 1;
+    return p;
+}
+#endif
+
 /* Initialize tables for shifting crcs. */
 static void crc32c_init_hw(void)
 {
     crc32c_zeros(crc32c_long, LONG);
     crc32c_zeros(crc32c_short, SHORT);
+#if CRC32C_HW_SSE42
+    /* See crc32c_combine_clmul() for the -33 */
+    crc32c_long_k[0] = crc32c_x_pow(LONG*2*8 - 33);
+    crc32c_long_k[1] = crc32c_x_pow(LONG*8 - 33);
+    crc32c_short_k[0] = crc32c_x_pow(SHORT*2*8 - 33);
+    crc32c_short_k[1] = crc32c_x_pow(SHORT*8 - 33);
+    crc32c_tiny_k[0] = crc32c_x_pow(TINY*2*8 - 33);
+    crc32c_tiny_k[1] = crc32c_x_pow(TINY*8 - 33);
+#endif
 }
 
-/* Compute CRC-32C using the Intel hardware instruction. */
-static uint32_t crc32c_hw(uint32_t crc, const void *buf, size_t len)
+#if CRC32C_HW_SSE42
+/* Carry-less multiply of a and b.  For crcs in reversed bit order the 63-bit
+   product is a * b * x, in reversed bit order in the 64-bit result. */
+static RD_INLINE uint64_t crc32c_clmul(uint32_t a, uint32_t b)
+{
+    uint64_t r;
+
+    __asm__("movq\t%1, %%xmm0\n\t"
+            "movq\t%2, %%xmm1\n\t"
+            "pclmulqdq\t$0x00, %%xmm1, %%xmm0\n\t"
+            "movq\t%%xmm0, %0"
+            : "=r"(r)
+            : "r"((uint64_t)a), "r"((uint64_t)b)
+            : "xmm0", "xmm1");
+    return r;
+}
+
+/* Combine the crcs of three consecutive blocks of n bytes, i.e. compute
+   crc0 * x^16n + crc1 * x^8n + crc2, where k holds x^(16n-33) and x^(8n-33).
+   crc32q of a 64-bit word multiplies it by x^32 modulo the polynomial, which
+   together with the x from the carry-less multiply makes up for the 33.  The
+   two multiplies are independent, unlike the two table shifts. */
+static RD_INLINE uint64_t crc32c_combine_clmul(const uint32_t *k,
+                                               uint64_t crc0, uint64_t crc1,
+                                               uint64_t crc2)
+{
+    uint64_t t, crc = 0;
+
+    t = crc32c_clmul((uint32_t)crc0, k[0]) ^ crc32c_clmul((uint32_t)crc1, k[1]);
+    __asm__("crc32q\t%1, %0"
+            : "=r"(crc)
+            : "r"(t), "0"(crc));
+    return crc ^ crc2;
+}
+
+/* Compute CRC-32C using the Intel hardware instruction, combining the
+   parallel crcs with PCLMULQDQ if use_pclmul is set, else with tables. */
+static RD_INLINE uint32_t crc32c_hw0(uint32_t crc, const void *buf, size_t len,
+                                     int use_pclmul)
 {
     const unsigned char *next = buf;
     const unsigned char *end;
@@ -287,8 +371,12 @@ static uint32_t crc32c_hw(uint32_t crc, const void *buf, size_t len)
                     : "r"(next), "0"(crc0), "1"(crc1), "2"(crc2));
             next += 8;
         } while (next < end);
-        crc0 = crc32c_shift(crc32c_long, crc0) ^ crc1;
-        crc0 = crc32c_shift(crc32c_long, crc0) ^ crc2;
+        if (use_pclmul)
+            crc0 = crc32c_combine_clmul(crc32c_long_k, crc0, crc1, crc2);
+        else {
+            crc0 = crc32c_shift(crc32c_long, crc0) ^ crc1;
+            crc0 = crc32c_shift(crc32c_long, crc0) ^ crc2;
+        }
         next += LONG*2;
         len -= LONG*3;
     }
@@ -307,14 +395,36 @@ static uint32_t crc32c_hw(uint32_t crc, const void *buf, size_t len)
                     : "r"(next), "0"(crc0), "1"(crc1), "2"(crc2));
             next += 8;
         } while (next < end);
-        crc0 = crc32c_shift(crc32c_short, crc0) ^ crc1;
-        crc0 = crc32c_shift(crc32c_short, crc0) ^ crc2;
+        if (use_pclmul)
+            crc0 = crc32c_combine_clmul(crc32c_short_k, crc0, crc1, crc2);
+        else {
+            crc0 = crc32c_shift(crc32c_short, crc0) ^ crc1;
+            crc0 = crc32c_shift(crc32c_short, crc0) ^ crc2;
+        }
         next += SHORT*2;
         len -= SHORT*3;
     }
 
+    /* and on TINY*3 blocks if the crcs can be combined with PCLMULQDQ */
+    while (use_pclmul && len >= TINY*3) {
+        crc1 = 0;
+        crc2 = 0;
+        end = next + TINY;
+        do {
+            __asm__("crc32q\t" "(%3), %0\n\t"
+                    "crc32q\t" TINYx1 "(%3), %1\n\t"
+                    "crc32q\t" TINYx2 "(%3), %2"
+                    : "=r"(crc0), "=r"(crc1), "=r"(crc2)
+                    : "r"(next), "0"(crc0), "1"(crc1), "2"(crc2));
+            next += 8;
+        } while (next < end);
+        crc0 = crc32c_combine_clmul(crc32c_tiny_k, crc0, crc1, crc2);
+        next += TINY*2;
+        len -= TINY*3;
+    }
+
     /* compute the crc on the remaining eight-byte units less than a SHORT*3
-       block */
+       (or TINY*3) block */
     end = next + (len - (len & 7));
     while (next < end) {
         __asm__("crc32q\t" "(%1), %0"
@@ -337,21 +447,127 @@ static uint32_t crc32c_hw(uint32_t crc, const void *buf, size_t len)
     return (uint32_t)crc0 ^ 0xffffffff;
 }
 
-/* Check for SSE 4.2.  SSE 4.2 was first supported in Nehalem processors
-   introduced in November, 2008.  This does not check for the existence of the
-   cpuid instruction itself, which was introduced on the 486SL in 1992, so this
-   will fail on earlier x86 processors.  cpuid works on all Pentium and later
-   processors. */
-#define SSE42(have) \
-    do { \
-        uint32_t eax, ecx; \
-        eax = 1; \
-        __asm__("cpuid" \
-                : "=c"(ecx) \
-                : "a"(eax) \
-                : "%ebx", "%edx"); \
-        (have) = (ecx >> 20) & 1; \
-    } while (0)
+static uint32_t crc32c_hw(uint32_t crc, const void *buf, size_t len)
+{
+    return crc32c_hw0(crc, buf, len, pclmul);
+}
+
+/* Check for SSE 4.2 and PCLMULQDQ.  SSE 4.2 was first supported in Nehalem
+   processors introduced in November, 2008, PCLMULQDQ in Westmere.  This does
+   not check for the existence of the cpuid instruction itself, which was
+   introduced on the 486SL in 1992, so this will fail on earlier x86
+   processors.  cpuid works on all Pentium and later processors. */
+static void crc32c_hw_detect(void)
+{
+    uint32_t eax = 1, ecx;
+
+    __asm__("cpuid"
+            : "=c"(ecx), "+a"(eax)
+            :
+            : "%ebx", "%edx");
+    hw_crc = (ecx >> 20) & 1;
+    pclmul = (ecx >> 1) & 1;
+}
+
+#elif CRC32C_HW_ARMV8
+
+/* The crc32c instructions are optional in ARMv8.0 (and mandatory from
+   ARMv8.1), so enable them for the assembler and check for them at
+   runtime. */
+#define CRC32CX(crc, value) \
+    __asm__(".arch_extension crc\n\t" \
+            "crc32cx\t%w0, %w0, %x1" \
+            : "+r"(crc) \
+            : "r"((uint64_t)(value)))
+#define CRC32CB(crc, value) \
+    __asm__(".arch_extension crc\n\t" \
+            "crc32cb\t%w0, %w0, %w1" \
+            : "+r"(crc) \
+            : "r"((uint32_t)(value)))
+
+/* Unaligned little-endian load, unaligned loads are fine on AArch64. */
+static RD_INLINE uint64_t crc32c_load64(const unsigned char *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return le64toh(v);
+}
+
+/* Compute CRC-32C using the ARMv8 hardware instructions, with the same three
+   independent crcs on LONG*3 and SHORT*3 blocks as the Intel version above
+   (the crc32c instructions have a latency of two to three cycles but a
+   throughput of one per cycle on most cores). */
+static uint32_t crc32c_hw(uint32_t crc, const void *buf, size_t len)
+{
+    const unsigned char *next = buf;
+    const unsigned char *end;
+    uint32_t crc0, crc1, crc2;
+
+    /* pre-process the crc */
+    crc0 = crc ^ 0xffffffff;
+
+    while (len >= LONG*3) {
+        crc1 = 0;
+        crc2 = 0;
+        end = next + LONG;
+        do {
+            CRC32CX(crc0, crc32c_load64(next));
+            CRC32CX(crc1, crc32c_load64(next + LONG));
+            CRC32CX(crc2, crc32c_load64(next + LONG*2));
+            next += 8;
+        } while (next < end);
+        crc0 = crc32c_shift(crc32c_long, crc0) ^ crc1;
+        crc0 = crc32c_shift(crc32c_long, crc0) ^ crc2;
+        next += LONG*2;
+        len -= LONG*3;
+    }
+
+    while (len >= SHORT*3) {
+        crc1 = 0;
+        crc2 = 0;
+        end = next + SHORT;
+        do {
+            CRC32CX(crc0, crc32c_load64(next));
+            CRC32CX(crc1, crc32c_load64(next + SHORT));
+            CRC32CX(crc2, crc32c_load64(next + SHORT*2));
+            next += 8;
+        } while (next < end);
+        crc0 = crc32c_shift(crc32c_short, crc0) ^ crc1;
+        crc0 = crc32c_shift(crc32c_short, crc0) ^ crc2;
+        next += SHORT*2;
+        len -= SHORT*3;
+    }
+
+    while (len >= 8) {
+        CRC32CX(crc0, crc32c_load64(next));
+        next += 8;
+        len -= 8;
+    }
+
+    while (len) {
+        CRC32CB(crc0, *next);
+        next++;
+        len--;
+    }
+
+    /* return a post-processed crc */
+    return crc0 ^ 0xffffffff;
+}
+
+/* Check for the ARMv8 crc32 instructions. */
+static void crc32c_hw_detect(void)
+{
+#if defined(__APPLE__)
+    hw_crc = 1;  /* All 64-bit Apple ARM processors have them */
+#elif defined(__linux__)
+    hw_crc = !!(getauxval(AT_HWCAP) & HWCAP_CRC32);
+#else
+    hw_crc = 0;
+#endif
+}
+
+#endif /* CRC32C_HW_ARMV8 */
 
 #endif /* WITH_CRC32C_HW */
 
@@ -360,7 +576,7 @@ static uint32_t crc32c_hw(uint32_t crc, const void *buf, size_t len)
 uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
 {
 #if WITH_CRC32C_HW
-        if (sse42)
+        if (hw_crc)
                 return crc32c_hw(crc, buf, len);
         else
 #endif
@@ -377,14 +593,29 @@ uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
  */
 void crc32c_global_init (void) {
 #if WITH_CRC32C_HW
-        SSE42(sse42);
-        if (sse42)
+        crc32c_hw_detect();
+        if (hw_crc)
                 crc32c_init_hw();
         else
 #endif
                 crc32c_init_sw();
 }
 
+#if WITH_CRC32C_HW
+/**
+ * @brief Hardware CRC for the unit test, combining the parallel crcs
+ *        with PCLMULQDQ or (\p use_pclmul = 0) with tables.
+ */
+static uint32_t crc32c_hw_ut (uint32_t crc, const void *buf, size_t len,
+                              int use_pclmul) {
+#if CRC32C_HW_SSE42
+        return crc32c_hw0(crc, buf, len, use_pclmul);
+#else
+        return crc32c_hw(crc, buf, len);
+#endif
+}
+#endif
+
 int unittest_crc32c (void) {
         const char *buf =
 "  This software is provided 'as-is', without any express or implied\n"
@@ -408,11 +639,18 @@ int unittest_crc32c (void) {
 
         crc32c_global_init();
 
-#if WITH_CRC32C_HW
-        if (sse42)
-                how = "hardware (SSE42)";
+#if CRC32C_HW_SSE42
+        if (hw_crc)
+                how = pclmul ? "hardware (SSE42, PCLMULQDQ)" :
+                        "hardware (SSE42)";
         else
                 how = "software (SSE42 supported in build but not at runtime)";
+#elif CRC32C_HW_ARMV8
+        if (hw_crc)
+                how = "hardware (ARMv8)";
+        else
+                how = "software (ARMv8 crc supported in build but not at "
+                        "runtime)";
 #else
         how = "software";
 #endif
@@ -434,5 +672,79 @@ int unittest_crc32c (void) {
                      " not matching expected CRC 0x%"PRIx32,
                      crc, expected_crc);
 
+#if WITH_CRC32C_HW
+        if (hw_crc) {
+                /* Verify the hardware version against the software version
+                 * at all alignments and at lengths around the three-way
+                 * LONG, SHORT and TINY block sizes, in one or two calls. */
+                static const size_t lens[] = {
+                        0, 1, 7, 8, 9, 63, TINY*3-1, TINY*3, TINY*3*2+5,
+                        SHORT*3-1, SHORT*3, SHORT*3+1,
+                        SHORT*3*2+17, LONG*3-1, LONG*3, LONG*3+SHORT*3+9,
+                        LONG*3*2+SHORT
+                };
+                const size_t bufsize = LONG*3*2+SHORT+8;
+                unsigned char *big = rd_malloc(bufsize);
+                uint32_t x = 0x12345678;
+                size_t i, j, of;
+                int use_pclmul;
+
+                for (i = 0 ; i < bufsize ; i++) {
+                        x = x * 1103515245 + 12345;
+                        big[i] = (unsigned char)(x >> 16);
+                }
+
+                for (use_pclmul = 0 ; use_pclmul <= 1 ; use_pclmul++) {
+#if CRC32C_HW_SSE42
+                        if (use_pclmul && !pclmul)
+                                break;
+#else
+                        if (use_pclmul) /* x86 only */
+                                break;
+#endif
+                        RD_UT_SAY("Verify %s CRC32C against software",
+                                  use_pclmul ? "PCLMULQDQ-combined" :
+                                  "table-combined");
+
+                        for (i = 0 ; i < RD_ARRAYSIZE(lens) ; i++) {
+                                for (of = 0 ; of < 8 ; of++) {
+                                        const unsigned char *p = big + of;
+                                        uint32_t exp, crc2;
+
+                                        exp = crc32c_sw(0, p, lens[i]);
+                                        crc = crc32c_hw_ut(0, p, lens[i],
+                                                           use_pclmul);
+                                        RD_UT_ASSERT(crc == exp,
+                                                     "len %"PRIusz" at "
+                                                     "offset %"PRIusz": "
+                                                     "hardware CRC 0x%"PRIx32
+                                                     " != software CRC "
+                                                     "0x%"PRIx32,
+                                                     lens[i], of, crc, exp);
+
+                                        /* Split in two calls */
+                                        j = lens[i] / 3;
+                                        crc2 = crc32c_hw_ut(
+                                                crc32c_hw_ut(0, p, j,
+                                                             use_pclmul),
+                                                p + j, lens[i] - j,
+                                                use_pclmul);
+                                        RD_UT_ASSERT(crc2 == exp,
+                                                     "len %"PRIusz" at "
+                                                     "offset %"PRIusz
+                                                     " split at %"PRIusz": "
+                                                     "hardware CRC 0x%"PRIx32
+                                                     " != software CRC "
+                                                     "0x%"PRIx32,
+                                                     lens[i], of, j,
+                                                     crc2, exp);
+                                }
+                        }
+                }
+
+                rd_free(big);
+        }
+#endif
+
         RD_UT_PASS();
 }
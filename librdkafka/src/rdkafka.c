@@ -37,6 +37,7 @@
 
 #include "rdkafka_int.h"
 #include "rdkafka_msg.h"
+#include "rdkafka_msgset.h"
 #include "rdkafka_broker.h"
 #include "rdkafka_topic.h"
 #include "rdkafka_partition.h"
@@ -50,6 +51,10 @@
 #include "rdkafka_interceptor.h"
 #include "rdkafka_idempotence.h"
 #include "rdkafka_sasl_oauthbearer.h"
+#include "rdkafka_mock.h"
+#if WITH_ZSTD
+#include "rdkafka_zstd.h"
+#endif
 #if WITH_SSL
 #include "rdkafka_ssl.h"
 #endif
@@ -844,6 +849,15 @@ void rd_kafka_destroy_final (rd_kafka_t *rk) {
 
         rd_kafka_metadata_cache_destroy(rk);
 
+#if WITH_ZSTD
+        if (rk->rk_zstd_dict)
+                rd_kafka_zstd_dict_destroy(rk->rk_zstd_dict);
+#endif
+
+        /* Destroy mock cluster */
+        if (rk->rk_mock.cluster)
+                rd_kafka_mock_cluster_destroy(rk->rk_mock.cluster);
+
         /* Terminate SASL provider */
         if (rk->rk_conf.sasl.provider)
                 rd_kafka_sasl_term(rk);
@@ -884,6 +898,7 @@ void rd_kafka_destroy_final (rd_kafka_t *rk) {
         if (rk->rk_type == RD_KAFKA_PRODUCER) {
 		cnd_destroy(&rk->rk_curr_msgs.cnd);
 		mtx_destroy(&rk->rk_curr_msgs.lock);
+                rd_kafka_msgpool_destroy(&rk->rk_msgpool);
 	}
 
         if (rk->rk_fatal.errstr) {
@@ -1148,6 +1163,12 @@ static void rd_kafka_destroy_internal (rd_kafka_t *rk) {
         }
 
         rd_list_destroy(&wait_thrds);
+
+        /* The broker threads wait for their outstanding MessageSets to be
+         * compressed before exiting, so the compression thread pool
+         * must be terminated after the broker threads. */
+        if (rk->rk_compress.q)
+                rd_kafka_compress_pool_term(rk);
 }
 
 /**
@@ -2036,6 +2057,7 @@ rd_kafka_t *rd_kafka_new (rd_kafka_type_t type, rd_kafka_conf_t *app_conf,
                 else
                         rk->rk_curr_msgs.max_size =
                         (size_t)rk->rk_conf.queue_buffering_max_kbytes * 1024;
+                rd_kafka_msgpool_init(&rk->rk_msgpool);
 	}
 
         if (rd_kafka_assignors_init(rk, errstr, errstr_size) == -1) {
@@ -2044,6 +2066,34 @@ rd_kafka_t *rd_kafka_new (rd_kafka_type_t type, rd_kafka_conf_t *app_conf,
                 goto fail;
         }
 
+        /* Load the default topic configuration's ZSTD dictionary up front
+         * so that topics created implicitly, with the handle lock held,
+         * need not read it. */
+        if (rk->rk_conf.topic_conf &&
+            rd_kafka_topic_conf_zstd_dict_load(rk, rk->rk_conf.topic_conf,
+                                               &rk->rk_zstd_dict,
+                                               errstr, errstr_size) == -1) {
+                ret_err = RD_KAFKA_RESP_ERR__INVALID_ARG;
+                ret_errno = EINVAL;
+                goto fail;
+        }
+
+        /* Create Mock cluster */
+        if (rk->rk_conf.mock.broker_cnt > 0) {
+                rk->rk_mock.cluster = rd_kafka_mock_cluster_new(
+                        rk, rk->rk_conf.mock.broker_cnt);
+
+                if (!rk->rk_mock.cluster) {
+                        if (errstr)
+                                rd_snprintf(errstr, errstr_size,
+                                            "Failed to create mock cluster, "
+                                            "see logs");
+                        ret_err = RD_KAFKA_RESP_ERR__FAIL;
+                        ret_errno = EINVAL;
+                        goto fail;
+                }
+        }
+
         if (rk->rk_conf.security_protocol == RD_KAFKA_PROTO_SASL_SSL ||
             rk->rk_conf.security_protocol == RD_KAFKA_PROTO_SASL_PLAINTEXT) {
                 /* Select SASL provider */
@@ -2101,6 +2151,19 @@ rd_kafka_t *rd_kafka_new (rd_kafka_type_t type, rd_kafka_conf_t *app_conf,
         pthread_sigmask(SIG_SETMASK, &newset, &oldset);
 #endif
 
+        /* Create the compression thread pool, if configured. */
+        if (type == RD_KAFKA_PRODUCER &&
+            rk->rk_conf.compression_threads > 0 &&
+            rd_kafka_compress_pool_init(rk, errstr, errstr_size) == -1) {
+                ret_err = RD_KAFKA_RESP_ERR__CRIT_SYS_RESOURCE;
+                ret_errno = errno;
+#ifndef _MSC_VER
+                /* Restore sigmask of caller */
+                pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+                goto fail;
+        }
+
         mtx_lock(&rk->rk_init_lock);
 
         /* Create background thread and queue if background_event_cb()
@@ -2179,6 +2242,22 @@ rd_kafka_t *rd_kafka_new (rd_kafka_type_t type, rd_kafka_conf_t *app_conf,
 						  "", 0, RD_KAFKA_NODEID_UA);
         mtx_unlock(&rk->rk_internal_rkb_lock);
 
+        /* Replace the configured brokers with the mock cluster.
+         * This is done past the point of failure since the original
+         * brokerlist belongs to the application's conf until then. */
+        if (rk->rk_mock.cluster) {
+                const char *bootstraps =
+                        rd_kafka_mock_cluster_bootstraps(rk->rk_mock.cluster);
+
+                rd_kafka_log(rk, LOG_NOTICE, "MOCK", "Mock cluster enabled: "
+                             "original bootstrap.servers ignored and replaced "
+                             "with %s", bootstraps);
+
+                if (rk->rk_conf.brokerlist)
+                        rd_free(rk->rk_conf.brokerlist);
+                rk->rk_conf.brokerlist = rd_strdup(bootstraps);
+        }
+
 	/* Add initial list of brokers from configuration */
 	if (rk->rk_conf.brokerlist) {
 		if (rd_kafka_brokers_add0(rk, rk->rk_conf.brokerlist) == 0)
@@ -3385,6 +3464,12 @@ rd_kafka_poll_cb (rd_kafka_t *rk, rd_kafka_q_t *rkq, rd_kafka_op_t *rko,
                 break;
 
 	case RD_KAFKA_OP_DR:
+        {
+                /* Destroyed messages are released in one go
+                 * when done with the op (or yielding). */
+                rd_kafka_msg_destroy_batch_t batch =
+                        RD_KAFKA_MSG_DESTROY_BATCH_INITIALIZER;
+
 		/* Delivery report:
 		 * call application DR callback for each message. */
 		while ((rkm = TAILQ_FIRST(&rko->rko_u.dr.msgq.rkmq_msgs))) {
@@ -3409,9 +3494,11 @@ rd_kafka_poll_cb (rd_kafka_t *rk, rd_kafka_q_t *rkq, rd_kafka_op_t *rko,
                                                   rkmessage->_private);
                         }
 
-                        rd_kafka_msg_destroy(rk, rkm);
+                        rd_kafka_msg_destroy0(rk, rkm, &batch);
 
                         if (unlikely(rd_kafka_yield_thread)) {
+                                rd_kafka_msg_destroy_batch_commit(&batch);
+
                                 /* Callback called yield(),
                                  * re-enqueue the op (if there are any
                                  * remaining messages). */
@@ -3424,8 +3511,10 @@ rd_kafka_poll_cb (rd_kafka_t *rk, rd_kafka_q_t *rkq, rd_kafka_op_t *rko,
                         }
 		}
 
-		rd_kafka_msgq_init(&rko->rko_u.dr.msgq);
+                rd_kafka_msg_destroy_batch_commit(&batch);
 
+		rd_kafka_msgq_init(&rko->rko_u.dr.msgq);
+        }
 		break;
 
 	case RD_KAFKA_OP_THROTTLE:
@@ -223,7 +223,7 @@ const char *rd_kafka_get_debug_contexts(void);
  *             Use rd_kafka_get_debug_contexts() instead.
  */
 #define RD_KAFKA_DEBUG_CONTEXTS \
-        "all,generic,broker,topic,metadata,feature,queue,msg,protocol,cgrp,security,fetch,interceptor,plugin,consumer,admin,eos"
+        "all,generic,broker,topic,metadata,feature,queue,msg,protocol,cgrp,security,fetch,interceptor,plugin,consumer,admin,eos,mock"
 
 
 /* @cond NO_DOC */
@@ -4058,7 +4058,9 @@ int rd_kafka_thread_cnt(void);
 typedef enum rd_kafka_thread_type_t {
         RD_KAFKA_THREAD_MAIN,       /**< librdkafka's internal main thread */
         RD_KAFKA_THREAD_BACKGROUND, /**< Background thread (if enabled) */
-        RD_KAFKA_THREAD_BROKER      /**< Per-broker thread */
+        RD_KAFKA_THREAD_BROKER,     /**< Per-broker thread */
+        RD_KAFKA_THREAD_COMPRESS    /**< Producer compression thread
+                                     *   (if compression.threads > 0) */
 } rd_kafka_thread_type_t;
 
 
@@ -65,6 +65,9 @@
 #include "rdcrc32.h"
 #include "rdrand.h"
 #include "rdkafka_lz4.h"
+#if WITH_ZSTD
+#include "rdkafka_zstd.h"
+#endif
 #if WITH_SSL
 #include <openssl/err.h>
 #endif
@@ -74,6 +77,10 @@
 
 static const int rd_kafka_max_block_ms = 1000;
 
+static int rd_kafka_broker_compressq_purge (rd_kafka_broker_t *rkb,
+                                            rd_kafka_toppar_t *rktp,
+                                            rd_kafka_resp_err_t err);
+
 const char *rd_kafka_broker_state_names[] = {
 	"INIT",
 	"DOWN",
@@ -489,6 +496,13 @@ void rd_kafka_broker_fail (rd_kafka_broker_t *rkb,
                             err == RD_KAFKA_RESP_ERR__TIMED_OUT ?
                             RD_KAFKA_RESP_ERR__TIMED_OUT_QUEUE : err);
 
+        /* Purge the ProduceRequests held back on the compressq,
+         * after the output queue to retain their order. */
+        rd_kafka_broker_compressq_purge(
+                rkb, NULL,
+                err == RD_KAFKA_RESP_ERR__TIMED_OUT ?
+                RD_KAFKA_RESP_ERR__TIMED_OUT_QUEUE : err);
+
 	/* Update bufq for connection reset:
 	 *  - Purge connection-setup requests from outbufs since they will be
 	 *    reissued on the next connect.
@@ -1028,6 +1042,124 @@ void rd_kafka_broker_buf_enq_replyq (rd_kafka_broker_t *rkb,
 }
 
 
+/**
+ * @brief Enqueue ProduceRequests from the compressq for transmission,
+ *        once they and any preceding ProduceRequests for the same
+ *        partition have been compressed.
+ *        Purged requests are failed instead, in the same order.
+ *
+ * @locality broker thread
+ */
+static void rd_kafka_broker_compressq_serve (rd_kafka_broker_t *rkb) {
+        rd_kafka_buf_t *rkbuf, *tmp;
+
+        TAILQ_FOREACH_SAFE(rkbuf, &rkb->rkb_compressq.rkbq_bufs,
+                           rkbuf_link, tmp) {
+                const rd_kafka_toppar_t *rktp;
+                const rd_kafka_buf_t *first;
+
+                if (rkbuf->rkbuf_flags & RD_KAFKA_OP_F_COMPRESSING)
+                        continue;
+
+                /* Any preceding request for the same partition still on
+                 * the queue is either being compressed or waiting for
+                 * one that is. */
+                rktp = rd_kafka_toppar_s2i(rkbuf->rkbuf_batch.s_rktp);
+                TAILQ_FOREACH(first, &rkb->rkb_compressq.rkbq_bufs,
+                              rkbuf_link)
+                        if (rd_kafka_toppar_s2i(first->rkbuf_batch.s_rktp) ==
+                            rktp)
+                                break;
+
+                if (first != rkbuf)
+                        continue;
+
+                rd_kafka_bufq_deq(&rkb->rkb_compressq, rkbuf);
+
+                if (unlikely(rkbuf->rkbuf_u.Produce.purge_err)) {
+                        rd_kafka_buf_callback(rkb->rkb_rk, rkb,
+                                              rkbuf->rkbuf_u.Produce.
+                                              purge_err, NULL, rkbuf);
+                        continue;
+                }
+
+                rd_kafka_broker_buf_enq_replyq(rkb, rkbuf, RD_KAFKA_NO_REPLYQ,
+                                               rkbuf->rkbuf_cb,
+                                               rkbuf->rkbuf_opaque);
+        }
+}
+
+
+/**
+ * @brief Purge ProduceRequests for partition \p rktp, or for all
+ *        partitions if \p rktp is NULL, from the compressq.
+ *
+ *        A request that is being compressed belongs to the compression
+ *        thread until its RD_KAFKA_OP_COMPRESS op is returned, so the
+ *        requests are only marked as purged here and are failed with
+ *        \p err by rd_kafka_broker_compressq_serve(), in order, once they
+ *        and the preceding requests for the same partition are compressed.
+ *
+ * @returns the number of purged requests.
+ *
+ * @locality broker thread
+ */
+static int rd_kafka_broker_compressq_purge (rd_kafka_broker_t *rkb,
+                                            rd_kafka_toppar_t *rktp,
+                                            rd_kafka_resp_err_t err) {
+        rd_kafka_buf_t *rkbuf;
+        int cnt = 0;
+
+        TAILQ_FOREACH(rkbuf, &rkb->rkb_compressq.rkbq_bufs, rkbuf_link) {
+                if (rktp &&
+                    rd_kafka_toppar_s2i(rkbuf->rkbuf_batch.s_rktp) != rktp)
+                        continue;
+
+                if (!rkbuf->rkbuf_u.Produce.purge_err)
+                        rkbuf->rkbuf_u.Produce.purge_err = err;
+                cnt++;
+        }
+
+        if (cnt > 0)
+                rd_kafka_broker_compressq_serve(rkb);
+
+        return cnt;
+}
+
+
+/**
+ * @brief Enqueue ProduceRequest for transmission.
+ *
+ *        A ProduceRequest that is being compressed by the compression
+ *        thread pool, or that was created while the compressq is not empty,
+ *        is held back on the compressq until it can be transmitted in
+ *        order with the other ProduceRequests for the same partition.
+ *
+ * @locality broker thread
+ */
+void rd_kafka_broker_buf_enq_produce (rd_kafka_broker_t *rkb,
+                                      rd_kafka_buf_t *rkbuf,
+                                      rd_kafka_resp_cb_t *resp_cb,
+                                      void *opaque) {
+
+        rd_kafka_assert(rkb->rkb_rk, thrd_is_current(rkb->rkb_thread));
+
+        if (likely(!(rkbuf->rkbuf_flags & RD_KAFKA_OP_F_COMPRESSING) &&
+                   rd_kafka_bufq_cnt(&rkb->rkb_compressq) == 0)) {
+                rd_kafka_broker_buf_enq_replyq(rkb, rkbuf, RD_KAFKA_NO_REPLYQ,
+                                               resp_cb, opaque);
+                return;
+        }
+
+        rkbuf->rkbuf_cb     = resp_cb;
+        rkbuf->rkbuf_opaque = opaque;
+
+        rd_kafka_bufq_enq(&rkb->rkb_compressq, rkbuf);
+
+        rd_kafka_broker_compressq_serve(rkb);
+}
+
+
 
 
 /**
@@ -2830,6 +2962,8 @@ static int rd_kafka_broker_op_serve (rd_kafka_broker_t *rkb,
                                 &rkb->rkb_outbufs,
                                 RD_KAFKAP_Produce, rktp,
                                 RD_KAFKA_RESP_ERR__RETRY);
+                        rd_kafka_broker_compressq_purge(
+                                rkb, rktp, RD_KAFKA_RESP_ERR__RETRY);
                 }
 
 
@@ -2926,6 +3060,22 @@ static int rd_kafka_broker_op_serve (rd_kafka_broker_t *rkb,
                 rko = NULL; /* the rko is reused for the reply */
                 break;
 
+        case RD_KAFKA_OP_COMPRESS:
+        {
+                /* MessageSet compressed by the compression thread pool */
+                rd_kafka_buf_t *rkbuf = rko->rko_u.compress.rkbuf;
+                rd_kafka_toppar_t *rktp =
+                        rd_kafka_toppar_s2i(rkbuf->rkbuf_batch.s_rktp);
+
+                rd_avg_add(&rktp->rktp_rkt->rkt_avg_batchsize,
+                           (int64_t)rko->rko_u.compress.MessageSetSize);
+                rd_atomic32_sub(&rktp->rktp_compress_cnt, 1);
+
+                rkbuf->rkbuf_flags &= ~RD_KAFKA_OP_F_COMPRESSING;
+                rd_kafka_broker_compressq_serve(rkb);
+                break;
+        }
+
         case RD_KAFKA_OP_CONNECT:
                 /* Sparse connections: connection requested, transition
                  * to TRY_CONNECT state to trigger new connection. */
@@ -3185,6 +3335,10 @@ static int rd_kafka_toppar_producer_serve (rd_kafka_broker_t *rkb,
          * buffers enqueued waiting for transmission. */
         max_requests = rd_kafka_broker_outbufs_space(rkb);
 
+        /* MessageSets for this partition that are still being compressed
+         * by the compression thread pool count towards the threshold. */
+        max_requests -= rd_atomic32_get(&rktp->rktp_compress_cnt);
+
         rd_kafka_toppar_lock(rktp);
 
         if (unlikely(rktp->rktp_leader != rkb)) {
@@ -3261,6 +3415,8 @@ static int rd_kafka_toppar_producer_serve (rd_kafka_broker_t *rkb,
                                 &rkb->rkb_outbufs,
                                 RD_KAFKAP_Produce, rktp,
                                 RD_KAFKA_RESP_ERR__RETRY);
+                        rd_kafka_broker_compressq_purge(
+                                rkb, rktp, RD_KAFKA_RESP_ERR__RETRY);
                         did_purge = rd_true;
 
                         if (rd_kafka_pid_valid(rktp->rktp_eos.pid))
@@ -3298,12 +3454,16 @@ static int rd_kafka_toppar_producer_serve (rd_kafka_broker_t *rkb,
                                 /* Flush any ProduceRequests for this
                                  * partition in the output buffer queue to
                                  * speed up draining. */
-                                if (!did_purge)
+                                if (!did_purge) {
                                         rd_kafka_broker_bufq_purge_by_toppar(
                                                 rkb,
                                                 &rkb->rkb_outbufs,
                                                 RD_KAFKAP_Produce, rktp,
                                                 RD_KAFKA_RESP_ERR__RETRY);
+                                        rd_kafka_broker_compressq_purge(
+                                                rkb, rktp,
+                                                RD_KAFKA_RESP_ERR__RETRY);
+                                }
 
                                 return 0;
                         }
@@ -4473,6 +4633,11 @@ static int rd_kafka_broker_thread_main (void *arg) {
 #endif
 #endif
 
+#if WITH_ZSTD
+        /* Free this thread's ZSTD (de)compression contexts */
+        rd_kafka_zstd_thread_cleanup();
+#endif
+
         rd_kafka_interceptors_on_thread_exit(rk, RD_KAFKA_THREAD_BROKER);
 
 	rd_atomic32_sub(&rd_kafka_thread_cnt_curr, 1);
@@ -4490,6 +4655,7 @@ void rd_kafka_broker_destroy_final (rd_kafka_broker_t *rkb) {
         rd_kafka_assert(rkb->rkb_rk, TAILQ_EMPTY(&rkb->rkb_outbufs.rkbq_bufs));
         rd_kafka_assert(rkb->rkb_rk, TAILQ_EMPTY(&rkb->rkb_waitresps.rkbq_bufs));
         rd_kafka_assert(rkb->rkb_rk, TAILQ_EMPTY(&rkb->rkb_retrybufs.rkbq_bufs));
+        rd_kafka_assert(rkb->rkb_rk, TAILQ_EMPTY(&rkb->rkb_compressq.rkbq_bufs));
         rd_kafka_assert(rkb->rkb_rk, TAILQ_EMPTY(&rkb->rkb_toppars));
 
         if (rkb->rkb_source != RD_KAFKA_INTERNAL &&
@@ -4601,6 +4767,7 @@ rd_kafka_broker_t *rd_kafka_broker_add (rd_kafka_t *rk,
 	rd_kafka_bufq_init(&rkb->rkb_outbufs);
 	rd_kafka_bufq_init(&rkb->rkb_waitresps);
 	rd_kafka_bufq_init(&rkb->rkb_retrybufs);
+	rd_kafka_bufq_init(&rkb->rkb_compressq);
 	rkb->rkb_ops = rd_kafka_q_new(rk);
         rd_avg_init(&rkb->rkb_avg_int_latency, RD_AVG_GAUGE, 0, 100*1000, 2,
                     rk->rk_conf.stats_interval_ms ? 1 : 0);
@@ -5367,6 +5534,11 @@ static void rd_kafka_broker_handle_purge_queues (rd_kafka_broker_t *rkb,
                         RD_KAFKAP_Produce, RD_KAFKA_RESP_ERR__PURGE_QUEUE, 0,
                         NULL, 0);
 
+                /* Requests held back on the compressq, these are
+                 * included in outq_cnt. */
+                outq_cnt += rd_kafka_broker_compressq_purge(
+                        rkb, NULL, RD_KAFKA_RESP_ERR__PURGE_QUEUE);
+
                 /* Purging a partially transmitted request will mess up
                  * the protocol stream, so we need to disconnect from the broker
                  * to get a clean protocol socket. */
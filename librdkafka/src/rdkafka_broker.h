@@ -179,6 +179,10 @@ struct rd_kafka_broker_s { /* rd_kafka_broker_t */
 	rd_kafka_bufq_t     rkb_outbufs;
 	rd_kafka_bufq_t     rkb_waitresps;
 	rd_kafka_bufq_t     rkb_retrybufs;
+        rd_kafka_bufq_t     rkb_compressq;  /**< ProduceRequests held back
+                                             *   while being compressed by
+                                             *   the compression thread
+                                             *   pool, in creation order. */
 
 	rd_avg_t            rkb_avg_int_latency;/* Current internal latency period*/
         rd_avg_t            rkb_avg_outbuf_latency; /**< Current latency
@@ -429,6 +433,10 @@ void rd_kafka_broker_buf_enq_replyq (rd_kafka_broker_t *rkb,
                                      rd_kafka_replyq_t replyq,
                                      rd_kafka_resp_cb_t *resp_cb,
                                      void *opaque);
+void rd_kafka_broker_buf_enq_produce (rd_kafka_broker_t *rkb,
+                                      rd_kafka_buf_t *rkbuf,
+                                      rd_kafka_resp_cb_t *resp_cb,
+                                      void *opaque);
 
 void rd_kafka_broker_buf_retry (rd_kafka_broker_t *rkb, rd_kafka_buf_t *rkbuf);
 
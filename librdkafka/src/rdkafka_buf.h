@@ -594,6 +594,11 @@ struct rd_kafka_buf_s { /* rd_kafka_buf_t */
                 } Metadata;
                 struct {
                         rd_kafka_msgbatch_t batch; /**< MessageSet/batch */
+                        rd_kafka_resp_err_t purge_err; /**< Set when the
+                                                        *   request is purged
+                                                        *   while held on the
+                                                        *   broker's
+                                                        *   compressq. */
                 } Produce;
         } rkbuf_u;
 
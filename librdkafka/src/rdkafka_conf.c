@@ -357,6 +357,7 @@ static const struct rd_kafka_property rd_kafka_properties[] = {
                         { RD_KAFKA_DBG_CONSUMER, "consumer" },
                         { RD_KAFKA_DBG_ADMIN,    "admin" },
                         { RD_KAFKA_DBG_EOS,      "eos" },
+                        { RD_KAFKA_DBG_MOCK,     "mock" },
 			{ RD_KAFKA_DBG_ALL,      "all" }
 		} },
 	{ _RK_GLOBAL, "socket.timeout.ms", _RK_C_INT, _RK(socket_timeout_ms),
@@ -832,6 +833,12 @@ static const struct rd_kafka_property rd_kafka_properties[] = {
           "ProduceResponse handler: "
           "rd_kafka_resp_err_t (*cb) (rd_kafka_t *rk, "
           "int32_t brokerid, uint64_t msgid, rd_kafka_resp_err_t err)" },
+        { _RK_GLOBAL|_RK_HIDDEN, "test.mock.num.brokers", _RK_C_INT,
+          _RK(mock.broker_cnt),
+          "Number of mock brokers to create. "
+          "This will automatically overwrite `bootstrap.servers` with the "
+          "mock broker list.",
+          0, 10000, 0 },
 
         /* Global consumer group properties */
         { _RK_GLOBAL|_RK_CGRP|_RK_HIGH, "group.id", _RK_C_STR,
@@ -1042,7 +1049,10 @@ static const struct rd_kafka_property rd_kafka_properties[] = {
 	  _RK(queue_buffering_max_kbytes),
 	  "Maximum total message size sum allowed on the producer queue. "
 	  "This queue is shared by all topics and partitions. "
-	  "This property has higher priority than queue.buffering.max.messages.",
+	  "This property has higher priority than queue.buffering.max.messages. "
+	  "Messages whose key and copied payload fit in the internal message "
+	  "pool are accounted for by the size of their pool slot "
+	  "(up to ~1.3 kilobytes) rather than their payload size.",
 	  1, INT_MAX/1024, 0x100000/*1GB*/ },
         { _RK_GLOBAL|_RK_PRODUCER|_RK_HIGH, "queue.buffering.max.ms",
           _RK_C_DBL,
@@ -1104,11 +1114,32 @@ static const struct rd_kafka_property rd_kafka_properties[] = {
 		} },
         { _RK_GLOBAL|_RK_PRODUCER|_RK_MED, "compression.type", _RK_C_ALIAS,
           .sdef = "compression.codec" },
+        { _RK_GLOBAL|_RK_PRODUCER, "compression.threads", _RK_C_INT,
+          _RK(compression_threads),
+          "Number of threads in the compression thread pool. "
+          "When set to a value larger than 0, compressed MessageSets are "
+          "compressed by the thread pool instead of by the broker thread, "
+          "allowing MessageSets for different partitions to be compressed "
+          "in parallel while the broker thread keeps serving its other "
+          "partitions. The per-partition order of ProduceRequests is "
+          "retained. "
+          "0 = compress on the broker thread.",
+          0, 128, 0 },
         { _RK_GLOBAL|_RK_PRODUCER|_RK_MED, "batch.num.messages", _RK_C_INT,
 	  _RK(batch_num_messages),
 	  "Maximum number of messages batched in one MessageSet. "
 	  "The total MessageSet size is also limited by message.max.bytes.",
 	  1, 1000000, 10000 },
+        { _RK_GLOBAL|_RK_PRODUCER|_RK_EXPERIMENTAL, "enable.produce.zerocopy",
+          _RK_C_BOOL,
+          _RK(produce_zerocopy),
+          "When set to `true`, the payloads of messages in uncompressed "
+          "MessageSets are always passed by reference (zero-copy) to the "
+          "socket, each in its own buffer segment, regardless of "
+          "`message.copy.max.bytes`. "
+          "This avoids copying larger payloads to the ProduceRequest buffer "
+          "at the expense of more iovecs per request.",
+          0, 1, 0 },
 	{ _RK_GLOBAL|_RK_PRODUCER, "delivery.report.only.error", _RK_C_BOOL,
 	  _RK(dr_err_only),
 	  "Only provide delivery reports for failed messages.",
@@ -1233,6 +1264,17 @@ static const struct rd_kafka_property rd_kafka_properties[] = {
 	  RD_KAFKA_COMPLEVEL_MIN,
 	  RD_KAFKA_COMPLEVEL_MAX,
 	  RD_KAFKA_COMPLEVEL_DEFAULT },
+        { _RK_TOPIC, "compression.zstd.dictionary.location",
+          _RK_C_STR,
+          _RKT(zstd_dictionary_location),
+          "Path to a ZSTD dictionary file (as trained by `zstd --train`) "
+          "used by the producer to compress MessageSets when "
+          "`compression.codec` is `zstd`, and by the consumer to "
+          "decompress MessageSets compressed with this dictionary. "
+          "Dictionaries improve the compression ratio of small, similar "
+          "messages. All producers and consumers of the topic must "
+          "use the same dictionary. Requires libzstd >= 1.4.0."
+        },
 
 
         /* Topic consumer properties */
@@ -3358,6 +3400,12 @@ const char *rd_kafka_topic_conf_finalize (rd_kafka_type_t cltype,
                                 "`linger.ms`";
         }
 
+#if !WITH_ZSTD
+        if (tconf->zstd_dictionary_location)
+                return "`compression.zstd.dictionary.location` requires "
+                        "librdkafka to be built with zstd support";
+#endif
+
 
         return NULL;
 }
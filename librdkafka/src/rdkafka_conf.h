@@ -366,6 +366,8 @@ struct rd_kafka_conf_s {
 	int    max_retries;
 	int    retry_backoff_ms;
 	int    batch_num_messages;
+        int    produce_zerocopy;
+        int    compression_threads;
 	rd_kafka_compression_t compression_codec;
 	int    dr_err_only;
 
@@ -466,6 +468,13 @@ struct rd_kafka_conf_s {
                         uint64_t msgid,
                         rd_kafka_resp_err_t err);
         } ut;
+
+        /*
+         * Mock cluster
+         */
+        struct {
+                int broker_cnt;   /**< Number of mock brokers to create */
+        } mock;
 };
 
 int rd_kafka_socket_cb_linux (int domain, int type, int protocol, void *opaque);
@@ -499,6 +508,7 @@ struct rd_kafka_topic_conf_s {
 
 	rd_kafka_compression_t compression_codec;
 	rd_kafka_complevel_t compression_level;
+        char   *zstd_dictionary_location;
         int     produce_offset_report;
 
         int     consume_callback_max_msgs;
@@ -193,6 +193,12 @@ struct rd_kafka_s {
         struct rd_kafka_cgrp_s *rk_cgrp;
 
         rd_kafka_conf_t  rk_conf;
+
+        /** ZSTD dictionary of the default topic configuration, loaded
+         *  by rd_kafka_new() and shared by the topics using it, or NULL.
+         *  Immutable. */
+        struct rd_kafka_zstd_dict_s *rk_zstd_dict;
+
         rd_kafka_q_t    *rk_logq;          /* Log queue if `log.queue` set */
         char             rk_name[128];
 	rd_kafkap_str_t *rk_client_id;
@@ -311,6 +317,8 @@ struct rd_kafka_s {
 		size_t max_size; /* Max limit */
 	} rk_curr_msgs;
 
+        rd_kafka_msgpool_t rk_msgpool; /**< Producer message pool */
+
         rd_kafka_timers_t rk_timers;
 	thrd_t rk_thread;
 
@@ -338,6 +346,27 @@ struct rd_kafka_s {
                                    *   purposes. */
         } rk_background;
 
+        /**
+         * Compression thread pool,
+         * enabled by setting `compression.threads`.
+         */
+        struct {
+                rd_kafka_q_t *q;  /**< Queue of MessageSets to compress
+                                   *   (RD_KAFKA_OP_COMPRESS), served by
+                                   *   all compression threads. */
+                thrd_t *thrds;    /**< Compression threads. */
+                int cnt;          /**< Number of compression threads. */
+        } rk_compress;
+
+
+        /*
+         * Mock cluster, enabled by `test.mock.num.brokers`.
+         */
+        struct {
+                struct rd_kafka_mock_cluster_s *cluster; /**< Mock cluster,
+                                                          *   owned by rk. */
+        } rk_mock;
+
 
         /*
          * Logs, events or actions to rate limit / suppress
@@ -558,7 +587,8 @@ const char *rd_kafka_purge_flags2str (int flags);
 #define RD_KAFKA_DBG_CONSUMER       0x2000
 #define RD_KAFKA_DBG_ADMIN          0x4000
 #define RD_KAFKA_DBG_EOS            0x8000
-#define RD_KAFKA_DBG_ALL            0xffff
+#define RD_KAFKA_DBG_MOCK           0x10000
+#define RD_KAFKA_DBG_ALL            0xfffff
 #define RD_KAFKA_DBG_NONE           0x0
 
 void rd_kafka_log0(const rd_kafka_conf_t *conf,
@@ -0,0 +1,1323 @@
+/*
+ * librdkafka - Apache Kafka C library
+ *
+ * Copyright (c) 2019 Magnus Edenhill
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Mock cluster
+ *
+ * Provides a mock Kafka cluster, served by a single thread, to be used
+ * for testing and benchmarking without a real Kafka cluster.
+ * See rdkafka_mock.h for the interface.
+ */
+
+#include "rd.h"
+#include "rdkafka_int.h"
+#include "rdkafka_mock.h"
+#include "rdkafka_mock_int.h"
+#include "rdkafka_transport_int.h"
+#include "crc32c.h"
+
+#include <errno.h>
+
+#ifndef _MSC_VER
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <signal.h>
+#define rd_kafka_mock_socket_poll(fds,cnt,tmout) poll(fds,cnt,tmout)
+#define rd_kafka_mock_socket_close(s) close(s)
+#else
+#define rd_kafka_mock_socket_poll(fds,cnt,tmout) WSAPoll(fds,cnt,tmout)
+#define rd_kafka_mock_socket_close(s) closesocket(s)
+#endif
+
+/* AIX doesn't have MSG_DONTWAIT */
+#ifndef MSG_DONTWAIT
+#  define MSG_DONTWAIT MSG_NONBLOCK
+#endif
+
+#ifndef MSG_NOSIGNAL
+#  define MSG_NOSIGNAL 0
+#endif
+
+
+/**
+ * @name Topics and partitions
+ * @{
+ */
+
+static void
+rd_kafka_mock_partition_init (rd_kafka_mock_topic_t *mtopic,
+                              rd_kafka_mock_partition_t *mpart,
+                              int id, int replication_factor) {
+        rd_kafka_mock_cluster_t *mcluster = mtopic->cluster;
+        rd_kafka_mock_broker_t *mrkb;
+        int i, first;
+
+        mpart->topic = mtopic;
+        mpart->id = id;
+
+        TAILQ_INIT(&mpart->msgsets);
+        TAILQ_INIT(&mpart->committed_offsets);
+
+        /* Assign replicas in a round-robin fashion starting at a
+         * per-partition broker, the first replica is the leader. */
+        mpart->replicas = rd_calloc(replication_factor,
+                                    sizeof(*mpart->replicas));
+        mpart->replica_cnt = replication_factor;
+
+        first = (id + mcluster->topic_cnt) % mcluster->broker_cnt;
+        i = 0;
+        TAILQ_FOREACH(mrkb, &mcluster->brokers, link) {
+                if (i++ == first)
+                        break;
+        }
+
+        for (i = 0 ; i < replication_factor ; i++) {
+                mpart->replicas[i] = mrkb;
+                if (!(mrkb = TAILQ_NEXT(mrkb, link)))
+                        mrkb = TAILQ_FIRST(&mcluster->brokers);
+        }
+
+        mpart->leader = mpart->replicas[0];
+}
+
+
+static void rd_kafka_mock_partition_destroy (rd_kafka_mock_partition_t *mpart) {
+        rd_kafka_mock_msgset_t *mset;
+        rd_kafka_mock_committed_offset_t *coff;
+
+        while ((mset = TAILQ_FIRST(&mpart->msgsets))) {
+                TAILQ_REMOVE(&mpart->msgsets, mset, link);
+                rd_free(mset);
+        }
+
+        while ((coff = TAILQ_FIRST(&mpart->committed_offsets))) {
+                TAILQ_REMOVE(&mpart->committed_offsets, coff, link);
+                if (coff->metadata)
+                        rd_kafkap_str_destroy(coff->metadata);
+                rd_free(coff->group);
+                rd_free(coff);
+        }
+
+        rd_free(mpart->replicas);
+}
+
+
+static rd_kafka_mock_topic_t *
+rd_kafka_mock_topic_new (rd_kafka_mock_cluster_t *mcluster, const char *name,
+                         int partition_cnt, int replication_factor) {
+        rd_kafka_mock_topic_t *mtopic;
+        int i;
+
+        mtopic = rd_calloc(1, sizeof(*mtopic));
+        mtopic->name = rd_strdup(name);
+        mtopic->cluster = mcluster;
+
+        mtopic->partition_cnt = partition_cnt;
+        mtopic->partitions = rd_calloc(partition_cnt,
+                                       sizeof(*mtopic->partitions));
+
+        for (i = 0 ; i < partition_cnt ; i++)
+                rd_kafka_mock_partition_init(mtopic, &mtopic->partitions[i],
+                                             i, replication_factor);
+
+        TAILQ_INSERT_TAIL(&mcluster->topics, mtopic, link);
+        mcluster->topic_cnt++;
+
+        rd_kafka_dbg(mcluster->rk, MOCK, "MOCK",
+                     "Created topic \"%s\" with %d partition(s) and "
+                     "replication-factor %d",
+                     mtopic->name, mtopic->partition_cnt, replication_factor);
+
+        return mtopic;
+}
+
+
+static void rd_kafka_mock_topic_destroy (rd_kafka_mock_topic_t *mtopic) {
+        int i;
+
+        for (i = 0 ; i < mtopic->partition_cnt ; i++)
+                rd_kafka_mock_partition_destroy(&mtopic->partitions[i]);
+
+        TAILQ_REMOVE(&mtopic->cluster->topics, mtopic, link);
+        mtopic->cluster->topic_cnt--;
+
+        rd_free(mtopic->partitions);
+        rd_free(mtopic->name);
+        rd_free(mtopic);
+}
+
+
+rd_kafka_mock_topic_t *
+rd_kafka_mock_topic_find (const rd_kafka_mock_cluster_t *mcluster,
+                          const char *name) {
+        const rd_kafka_mock_topic_t *mtopic;
+
+        TAILQ_FOREACH(mtopic, &mcluster->topics, link) {
+                if (!strcmp(mtopic->name, name))
+                        return (rd_kafka_mock_topic_t *)mtopic;
+        }
+
+        return NULL;
+}
+
+
+rd_kafka_mock_topic_t *
+rd_kafka_mock_topic_find_by_kstr (const rd_kafka_mock_cluster_t *mcluster,
+                                  const rd_kafkap_str_t *kname) {
+        const rd_kafka_mock_topic_t *mtopic;
+
+        if (RD_KAFKAP_STR_IS_NULL(kname))
+                return NULL;
+
+        TAILQ_FOREACH(mtopic, &mcluster->topics, link) {
+                if (!rd_kafkap_str_cmp_str2(mtopic->name, kname))
+                        return (rd_kafka_mock_topic_t *)mtopic;
+        }
+
+        return NULL;
+}
+
+
+/**
+ * @brief Create a topic using the default settings, as if
+ *        auto.create.topics.enable=true on the broker.
+ *
+ * @returns the existing or new topic, or NULL if \p kname is invalid.
+ */
+rd_kafka_mock_topic_t *
+rd_kafka_mock_topic_auto_create (rd_kafka_mock_cluster_t *mcluster,
+                                 const rd_kafkap_str_t *kname) {
+        rd_kafka_mock_topic_t *mtopic;
+        char *name;
+
+        if (RD_KAFKAP_STR_LEN(kname) == 0)
+                return NULL;
+
+        if ((mtopic = rd_kafka_mock_topic_find_by_kstr(mcluster, kname)))
+                return mtopic;
+
+        RD_KAFKAP_STR_DUPA(&name, kname);
+
+        return rd_kafka_mock_topic_new(mcluster, name,
+                                       mcluster->defaults.partition_cnt,
+                                       mcluster->defaults.replication_factor);
+}
+
+
+rd_kafka_mock_partition_t *
+rd_kafka_mock_partition_find (const rd_kafka_mock_topic_t *mtopic,
+                              int32_t partition) {
+        if (!mtopic || partition < 0 || partition >= mtopic->partition_cnt)
+                return NULL;
+
+        return (rd_kafka_mock_partition_t *)&mtopic->partitions[partition];
+}
+
+
+/**
+ * @brief Validate the MessageSet (RecordBatch) at \p p with \p remains
+ *        bytes remaining, returning its size in \p *sizep.
+ */
+static rd_kafka_resp_err_t
+rd_kafka_mock_msgset_validate (const char *p, size_t remains, size_t *sizep) {
+        int32_t Length;
+        uint32_t Crc;
+        size_t size;
+
+        if (remains < RD_KAFKAP_MSGSET_V2_SIZE)
+                return RD_KAFKA_RESP_ERR_INVALID_MSG;
+
+        memcpy(&Length, p + RD_KAFKAP_MSGSET_V2_OF_Length, sizeof(Length));
+        Length = be32toh(Length);
+
+        size = 8 + 4 + (size_t)Length;
+        if (Length < RD_KAFKAP_MSGSET_V2_SIZE - 8 - 4 || size > remains)
+                return RD_KAFKA_RESP_ERR_INVALID_MSG;
+
+        /* MagicByte */
+        if (p[8+4+4] != 2)
+                return RD_KAFKA_RESP_ERR_UNSUPPORTED_FOR_MESSAGE_FORMAT;
+
+        /* The CRC covers the batch from the Attributes to the end */
+        memcpy(&Crc, p + RD_KAFKAP_MSGSET_V2_OF_CRC, sizeof(Crc));
+        if (be32toh(Crc) !=
+            crc32c(0, p + RD_KAFKAP_MSGSET_V2_OF_Attributes,
+                   size - RD_KAFKAP_MSGSET_V2_OF_Attributes))
+                return RD_KAFKA_RESP_ERR_INVALID_MSG;
+
+        *sizep = size;
+        return RD_KAFKA_RESP_ERR_NO_ERROR;
+}
+
+
+/**
+ * @brief Append the MessageSet(s) in \p bytes to the partition log,
+ *        assigning offsets.
+ *
+ * The MessageSets are validated before anything is appended so that
+ * a failed request does not leave a partial append behind.
+ *
+ * @param BaseOffset will be set to the offset of the first message.
+ */
+rd_kafka_resp_err_t
+rd_kafka_mock_partition_log_append (rd_kafka_mock_partition_t *mpart,
+                                    const rd_kafkap_bytes_t *bytes,
+                                    int64_t *BaseOffset) {
+        rd_kafka_mock_cluster_t *mcluster = mpart->topic->cluster;
+        const char *p = (const char *)bytes->data;
+        size_t remains = (size_t)RD_KAFKAP_BYTES_LEN(bytes);
+        size_t size;
+        rd_kafka_resp_err_t err;
+
+        if (remains == 0)
+                return RD_KAFKA_RESP_ERR_INVALID_MSG;
+
+        while (remains > 0) {
+                if ((err = rd_kafka_mock_msgset_validate(p, remains, &size)))
+                        return err;
+                p += size;
+                remains -= size;
+        }
+
+        *BaseOffset = mpart->end_offset;
+
+        p = (const char *)bytes->data;
+        remains = (size_t)RD_KAFKAP_BYTES_LEN(bytes);
+
+        while (remains > 0) {
+                rd_kafka_mock_msgset_t *mset;
+                int64_t v64;
+                int32_t LastOffsetDelta;
+
+                rd_kafka_mock_msgset_validate(p, remains, &size);
+
+                mset = rd_malloc(sizeof(*mset) + size);
+                mset->bytes.len = (int32_t)size;
+                mset->bytes.data = (void *)(mset+1);
+                memcpy((void *)mset->bytes.data, p, size);
+
+                memcpy(&LastOffsetDelta,
+                       p + RD_KAFKAP_MSGSET_V2_OF_LastOffsetDelta,
+                       sizeof(LastOffsetDelta));
+                memcpy(&v64, p + RD_KAFKAP_MSGSET_V2_OF_MaxTimestamp,
+                       sizeof(v64));
+                mset->max_timestamp = be64toh(v64);
+
+                mset->first_offset = mpart->end_offset;
+                mset->last_offset = mset->first_offset +
+                        be32toh(LastOffsetDelta);
+                mpart->end_offset = mset->last_offset + 1;
+
+                /* Rewrite BaseOffset, which is not covered by the CRC. */
+                v64 = htobe64(mset->first_offset);
+                memcpy((void *)mset->bytes.data, &v64, sizeof(v64));
+
+                TAILQ_INSERT_TAIL(&mpart->msgsets, mset, link);
+                mpart->msgset_cnt++;
+                mpart->size += size;
+
+                p += size;
+                remains -= size;
+        }
+
+        /* Enforce retention: drop the oldest MessageSets, but always
+         * keep the last one. */
+        while (mpart->size > mcluster->defaults.max_partition_bytes &&
+               mpart->msgset_cnt > 1) {
+                rd_kafka_mock_msgset_t *mset = TAILQ_FIRST(&mpart->msgsets);
+
+                TAILQ_REMOVE(&mpart->msgsets, mset, link);
+                mpart->msgset_cnt--;
+                mpart->size -= (size_t)mset->bytes.len;
+                mpart->start_offset = TAILQ_FIRST(&mpart->msgsets)->
+                        first_offset;
+                rd_free(mset);
+        }
+
+        /* Let parked FetchRequests know there is new data. */
+        mcluster->fetch_retry = 1;
+
+        return RD_KAFKA_RESP_ERR_NO_ERROR;
+}
+
+
+/**
+ * @returns the MessageSet containing \p offset, or the first MessageSet
+ *          past \p offset, or NULL if \p offset is beyond the end of the log.
+ */
+const rd_kafka_mock_msgset_t *
+rd_kafka_mock_msgset_find (const rd_kafka_mock_partition_t *mpart,
+                           int64_t offset) {
+        const rd_kafka_mock_msgset_t *mset;
+
+        if (offset < mpart->start_offset || offset >= mpart->end_offset)
+                return NULL;
+
+        /* Consumers typically read from the tail, search backwards. */
+        TAILQ_FOREACH_REVERSE(mset, &mpart->msgsets,
+                              rd_kafka_mock_msgset_s_head, link) {
+                if (offset >= mset->first_offset) {
+                        if (offset > mset->last_offset)
+                                mset = TAILQ_NEXT(mset, link);
+                        return mset;
+                }
+        }
+
+        return TAILQ_FIRST(&mpart->msgsets);
+}
+
+
+/**
+ * @returns the offset of the first MessageSet with a MaxTimestamp
+ *          at or after \p timestamp, or the log end offset if there
+ *          is none.
+ *
+ * @remark This works on MessageSet granularity, the returned offset may
+ *         be that of an earlier message in the same MessageSet.
+ */
+int64_t
+rd_kafka_mock_partition_offset_for_time (const rd_kafka_mock_partition_t *mpart,
+                                         int64_t timestamp) {
+        const rd_kafka_mock_msgset_t *mset;
+
+        TAILQ_FOREACH(mset, &mpart->msgsets, link) {
+                if (mset->max_timestamp >= timestamp)
+                        return mset->first_offset;
+        }
+
+        return mpart->end_offset;
+}
+
+
+const rd_kafka_mock_committed_offset_t *
+rd_kafka_mock_committed_offset_find (const rd_kafka_mock_partition_t *mpart,
+                                     const rd_kafkap_str_t *group) {
+        const rd_kafka_mock_committed_offset_t *coff;
+
+        TAILQ_FOREACH(coff, &mpart->committed_offsets, link) {
+                if (!rd_kafkap_str_cmp_str2(coff->group, group))
+                        return coff;
+        }
+
+        return NULL;
+}
+
+
+void
+rd_kafka_mock_commit_offset (rd_kafka_mock_partition_t *mpart,
+                             const rd_kafkap_str_t *group, int64_t offset,
+                             const rd_kafkap_str_t *metadata) {
+        rd_kafka_mock_committed_offset_t *coff;
+
+        coff = (rd_kafka_mock_committed_offset_t *)
+                rd_kafka_mock_committed_offset_find(mpart, group);
+        if (!coff) {
+                coff = rd_calloc(1, sizeof(*coff));
+                coff->group = RD_KAFKAP_STR_DUP(group);
+                TAILQ_INSERT_TAIL(&mpart->committed_offsets, coff, link);
+        }
+
+        if (coff->metadata)
+                rd_kafkap_str_destroy(coff->metadata);
+        coff->metadata = rd_kafkap_str_copy(metadata);
+        coff->offset = offset;
+
+        rd_kafka_dbg(mpart->topic->cluster->rk, MOCK, "MOCK",
+                     "Topic %s [%"PRId32"] committed offset %"PRId64
+                     " for group %s",
+                     mpart->topic->name, mpart->id, offset, coff->group);
+}
+
+/**@}*/
+
+
+
+/**
+ * @name Connections
+ * @{
+ */
+
+/**
+ * @brief Create a new response buffer for \p request, with the
+ *        response header written.
+ */
+rd_kafka_buf_t *rd_kafka_mock_buf_new_response (const rd_kafka_buf_t *request) {
+        rd_kafka_buf_t *rkbuf = rd_kafka_buf_new(1, 100);
+
+        /* Size, updated later */
+        rd_kafka_buf_write_i32(rkbuf, 0);
+
+        /* CorrId */
+        rd_kafka_buf_write_i32(rkbuf, request->rkbuf_reqhdr.CorrId);
+
+        /* Handlers and delayed responses need the request header */
+        rkbuf->rkbuf_reqhdr = request->rkbuf_reqhdr;
+
+        return rkbuf;
+}
+
+
+/**
+ * @brief Finalize and enqueue \p resp for transmission, it will be sent
+ *        by the cluster thread when the socket is writable.
+ */
+void rd_kafka_mock_connection_send_response (rd_kafka_mock_connection_t *mconn,
+                                             rd_kafka_buf_t *resp) {
+        /* Update Size field */
+        rd_kafka_buf_update_i32(resp, 0,
+                                (int32_t)rd_buf_len(&resp->rkbuf_buf) - 4);
+
+        rd_slice_init_full(&resp->rkbuf_reader, &resp->rkbuf_buf);
+
+        TAILQ_INSERT_TAIL(&mconn->outbufs, resp, rkbuf_link);
+}
+
+
+static void rd_kafka_mock_connection_close (rd_kafka_mock_connection_t *mconn,
+                                            const char *reason) {
+        rd_kafka_mock_broker_t *mrkb = mconn->broker;
+        rd_kafka_buf_t *rkbuf;
+
+        rd_kafka_dbg(mrkb->cluster->rk, MOCK, "MOCK",
+                     "Broker %"PRId32": Connection from %s closed: %s",
+                     mrkb->id, mconn->peer, reason);
+
+        rd_kafka_mock_cgrps_connection_closed(mrkb->cluster, mconn);
+
+        while ((rkbuf = TAILQ_FIRST(&mconn->outbufs))) {
+                TAILQ_REMOVE(&mconn->outbufs, rkbuf, rkbuf_link);
+                rd_kafka_buf_destroy(rkbuf);
+        }
+
+        if (mconn->rxbuf)
+                rd_kafka_buf_destroy(mconn->rxbuf);
+
+        if (mconn->fetch_req)
+                rd_kafka_buf_destroy(mconn->fetch_req);
+
+        rd_kafka_mock_socket_close(mconn->s);
+
+        TAILQ_REMOVE(&mrkb->connections, mconn, link);
+        rd_free(mconn);
+}
+
+
+static void rd_kafka_mock_broker_accept (rd_kafka_mock_broker_t *mrkb) {
+        rd_kafka_mock_connection_t *mconn;
+        struct sockaddr_in sin;
+        socklen_t sinlen = sizeof(sin);
+        int s;
+        int on = 1;
+
+        s = (int)accept(mrkb->listen_s, (struct sockaddr *)&sin, &sinlen);
+        if (s == -1) {
+                rd_kafka_log(mrkb->cluster->rk, LOG_WARNING, "MOCK",
+                             "Broker %"PRId32": Failed to accept "
+                             "connection: %s",
+                             mrkb->id, rd_strerror(socket_errno));
+                return;
+        }
+
+        if (rd_fd_set_nonblocking(s) != 0) {
+                rd_kafka_log(mrkb->cluster->rk, LOG_WARNING, "MOCK",
+                             "Broker %"PRId32": Failed to set connection "
+                             "non-blocking: %s",
+                             mrkb->id, rd_strerror(socket_errno));
+                rd_kafka_mock_socket_close(s);
+                return;
+        }
+
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (void *)&on, sizeof(on));
+
+        mconn = rd_calloc(1, sizeof(*mconn));
+        mconn->s = s;
+        mconn->broker = mrkb;
+        TAILQ_INIT(&mconn->outbufs);
+        rd_snprintf(mconn->peer, sizeof(mconn->peer), "%s",
+                    rd_sockaddr2str(&sin, RD_SOCKADDR2STR_F_PORT));
+
+        TAILQ_INSERT_TAIL(&mrkb->connections, mconn, link);
+
+        rd_kafka_dbg(mrkb->cluster->rk, MOCK, "MOCK",
+                     "Broker %"PRId32": New connection from %s",
+                     mrkb->id, mconn->peer);
+}
+
+
+/**
+ * @brief Receive as much as fits in the current segment of \p rbuf.
+ *
+ * @returns the number of bytes read, or -1 on error or disconnect.
+ */
+static ssize_t rd_kafka_mock_connection_recv (rd_kafka_mock_connection_t *mconn,
+                                              rd_buf_t *rbuf) {
+        ssize_t sum = 0;
+        void *p;
+        size_t len;
+
+        while ((len = rd_buf_get_writable(rbuf, &p))) {
+                ssize_t r;
+
+                r = recv(mconn->s, p,
+#ifdef _MSC_VER
+                         (int)
+#endif
+                         len, MSG_DONTWAIT);
+
+                if (r == -1) {
+                        if (socket_errno == EAGAIN
+#ifdef _MSC_VER
+                            || socket_errno == WSAEWOULDBLOCK
+#endif
+                                )
+                                break;
+                        return -1;
+                } else if (r == 0) {
+                        return -1; /* Disconnected */
+                }
+
+                rd_buf_write(rbuf, NULL, (size_t)r);
+                sum += r;
+
+                if ((size_t)r < len)
+                        break;
+        }
+
+        return sum;
+}
+
+
+/**
+ * @brief Read a request frame from the connection.
+ *
+ * @returns 1 if a request was read and returned in \p *rkbufp,
+ *          0 if more data is needed, or -1 on error.
+ */
+static int
+rd_kafka_mock_connection_read_request (rd_kafka_mock_connection_t *mconn,
+                                       rd_kafka_buf_t **rkbufp) {
+        rd_kafka_t *rk = mconn->broker->cluster->rk;
+        rd_kafka_buf_t *rkbuf;
+        const int log_decode_errors = 0;
+        ssize_t r;
+
+        if (!(rkbuf = mconn->rxbuf)) {
+                /* Initial state: set up buf to receive the length field */
+                rkbuf = rd_kafka_buf_new(1, 4);
+                rd_buf_write_ensure(&rkbuf->rkbuf_buf, 4, 4);
+                mconn->rxbuf = rkbuf;
+        }
+
+        r = rd_kafka_mock_connection_recv(mconn, &rkbuf->rkbuf_buf);
+        if (r == -1)
+                return -1;
+
+        if (rkbuf->rkbuf_totlen == 0) {
+                int32_t frame_len;
+
+                if (rd_buf_write_pos(&rkbuf->rkbuf_buf) < sizeof(frame_len))
+                        return 0; /* Wait for the entire length field */
+
+                rd_slice_init(&rkbuf->rkbuf_reader, &rkbuf->rkbuf_buf, 0, 4);
+                rd_kafka_buf_read_i32(rkbuf, &frame_len);
+
+                if (frame_len < RD_KAFKAP_REQHDR_SIZE - 4 + 2 ||
+                    frame_len > rk->rk_conf.recv_max_msg_size) {
+                        rd_kafka_log(rk, LOG_WARNING, "MOCK",
+                                     "Broker %"PRId32": Invalid request "
+                                     "frame size %"PRId32" from %s",
+                                     mconn->broker->id, frame_len,
+                                     mconn->peer);
+                        return -1;
+                }
+
+                rkbuf->rkbuf_totlen = 4 + frame_len;
+
+                /* Receive the entire request into contiguous memory. */
+                rd_buf_write_ensure_contig(&rkbuf->rkbuf_buf, frame_len);
+
+                /* There is probably more data available already. */
+                return rd_kafka_mock_connection_read_request(mconn, rkbufp);
+        }
+
+        if (rd_buf_write_pos(&rkbuf->rkbuf_buf) < rkbuf->rkbuf_totlen)
+                return 0; /* Wait for more data */
+
+        /* Request is complete: parse the request header */
+        mconn->rxbuf = NULL;
+
+        rd_slice_init(&rkbuf->rkbuf_reader, &rkbuf->rkbuf_buf, 4,
+                      rkbuf->rkbuf_totlen - 4);
+
+        rd_kafka_buf_read_i16(rkbuf, &rkbuf->rkbuf_reqhdr.ApiKey);
+        rd_kafka_buf_read_i16(rkbuf, &rkbuf->rkbuf_reqhdr.ApiVersion);
+        rd_kafka_buf_read_i32(rkbuf, &rkbuf->rkbuf_reqhdr.CorrId);
+        rd_kafka_buf_skip_str(rkbuf); /* ClientId */
+
+        *rkbufp = rkbuf;
+        return 1;
+
+ err_parse:
+        rd_kafka_log(rk, LOG_WARNING, "MOCK",
+                     "Broker %"PRId32": Failed to parse request header "
+                     "from %s: %s",
+                     mconn->broker->id, mconn->peer,
+                     rd_kafka_err2str(rkbuf->rkbuf_err));
+        if (mconn->rxbuf == rkbuf)
+                mconn->rxbuf = NULL;
+        rd_kafka_buf_destroy(rkbuf);
+        return -1;
+}
+
+
+/**
+ * @brief Dispatch request \p rkbuf to its handler.
+ *
+ * @returns 0 on success, or -1 if the connection should be closed.
+ */
+static int
+rd_kafka_mock_connection_handle_request (rd_kafka_mock_connection_t *mconn,
+                                         rd_kafka_buf_t *rkbuf) {
+        rd_kafka_t *rk = mconn->broker->cluster->rk;
+        int16_t ApiKey = rkbuf->rkbuf_reqhdr.ApiKey;
+        int16_t ApiVersion = rkbuf->rkbuf_reqhdr.ApiVersion;
+
+        if (ApiKey < 0 || ApiKey >= RD_KAFKAP__NUM ||
+            !rd_kafka_mock_api_handlers[ApiKey].cb) {
+                rd_kafka_log(rk, LOG_WARNING, "MOCK",
+                             "Broker %"PRId32": unsupported %sRequest "
+                             "from %s",
+                             mconn->broker->id,
+                             rd_kafka_ApiKey2str(ApiKey), mconn->peer);
+                return -1;
+        }
+
+        if (ApiVersion < rd_kafka_mock_api_handlers[ApiKey].MinVersion ||
+            ApiVersion > rd_kafka_mock_api_handlers[ApiKey].MaxVersion) {
+                rd_kafka_log(rk, LOG_WARNING, "MOCK",
+                             "Broker %"PRId32": unsupported %sRequest "
+                             "version %hd from %s",
+                             mconn->broker->id,
+                             rd_kafka_ApiKey2str(ApiKey), ApiVersion,
+                             mconn->peer);
+                return -1;
+        }
+
+        rd_kafka_dbg(rk, MOCK, "MOCK",
+                     "Broker %"PRId32": Received %sRequest (v%hd) from %s",
+                     mconn->broker->id, rd_kafka_ApiKey2str(ApiKey),
+                     ApiVersion, mconn->peer);
+
+        return rd_kafka_mock_api_handlers[ApiKey].cb(mconn, rkbuf);
+}
+
+
+/**
+ * @brief Send queued responses.
+ *
+ * @returns 0 on success (even if not all data could be sent),
+ *          or -1 on error.
+ */
+static int rd_kafka_mock_connection_write_out (rd_kafka_mock_connection_t *mconn) {
+        rd_kafka_buf_t *rkbuf;
+
+        while ((rkbuf = TAILQ_FIRST(&mconn->outbufs))) {
+                const void *p;
+                size_t rlen;
+
+                while ((rlen = rd_slice_peeker(&rkbuf->rkbuf_reader, &p))) {
+                        ssize_t r;
+
+                        r = send(mconn->s, p,
+#ifdef _MSC_VER
+                                 (int)rlen, 0
+#else
+                                 rlen, MSG_DONTWAIT|MSG_NOSIGNAL
+#endif
+                                );
+
+                        if (r == -1) {
+                                if (socket_errno == EAGAIN
+#ifdef _MSC_VER
+                                    || socket_errno == WSAEWOULDBLOCK
+#endif
+                                        )
+                                        return 0;
+                                return -1;
+                        }
+
+                        rd_slice_read(&rkbuf->rkbuf_reader, NULL, (size_t)r);
+
+                        if ((size_t)r < rlen)
+                                return 0; /* Socket buffer is full */
+                }
+
+                TAILQ_REMOVE(&mconn->outbufs, rkbuf, rkbuf_link);
+                rd_kafka_buf_destroy(rkbuf);
+        }
+
+        return 0;
+}
+
+
+/**
+ * @brief Serve socket events for a connection.
+ */
+static void rd_kafka_mock_connection_io (rd_kafka_mock_connection_t *mconn,
+                                         int events) {
+        if (events & POLLIN) {
+                rd_kafka_buf_t *rkbuf;
+                int r;
+
+                while ((r = rd_kafka_mock_connection_read_request(
+                                mconn, &rkbuf)) == 1) {
+                        r = rd_kafka_mock_connection_handle_request(mconn,
+                                                                    rkbuf);
+                        rd_kafka_buf_destroy(rkbuf);
+                        if (r == -1)
+                                break;
+                }
+
+                if (r == -1) {
+                        rd_kafka_mock_connection_close(mconn,
+                                                       "Read error or "
+                                                       "invalid request");
+                        return;
+                }
+        }
+
+        if (events & (POLLERR|POLLHUP)) {
+                rd_kafka_mock_connection_close(mconn, "Disconnected");
+                return;
+        }
+
+        if (!TAILQ_EMPTY(&mconn->outbufs) &&
+            rd_kafka_mock_connection_write_out(mconn) == -1)
+                rd_kafka_mock_connection_close(mconn, "Write error");
+}
+
+
+/**
+ * @brief Retry parked FetchRequests that may now be satisfied or
+ *        have reached their deadline.
+ *
+ * @returns the earliest deadline of the remaining parked requests,
+ *          or 0 if there are none.
+ */
+static rd_ts_t rd_kafka_mock_cluster_fetches_serve (
+        rd_kafka_mock_cluster_t *mcluster, rd_ts_t now) {
+        rd_kafka_mock_broker_t *mrkb;
+        rd_ts_t next = 0;
+        int retry_all = mcluster->fetch_retry;
+
+        mcluster->fetch_retry = 0;
+
+        TAILQ_FOREACH(mrkb, &mcluster->brokers, link) {
+                rd_kafka_mock_connection_t *mconn;
+
+                TAILQ_FOREACH(mconn, &mrkb->connections, link) {
+                        rd_kafka_buf_t *rkbuf = mconn->fetch_req;
+
+                        if (!rkbuf)
+                                continue;
+
+                        if (!retry_all && now < mconn->fetch_deadline) {
+                                if (!next || mconn->fetch_deadline < next)
+                                        next = mconn->fetch_deadline;
+                                continue;
+                        }
+
+                        /* The handler will park the request again
+                         * if it still can't be satisfied. */
+                        mconn->fetch_req = NULL;
+                        rd_slice_seek(&rkbuf->rkbuf_reader,
+                                      mconn->fetch_req_of);
+                        rd_kafka_mock_connection_handle_request(mconn, rkbuf);
+                        rd_kafka_buf_destroy(rkbuf);
+
+                        if (mconn->fetch_req &&
+                            (!next || mconn->fetch_deadline < next))
+                                next = mconn->fetch_deadline;
+                }
+        }
+
+        return next;
+}
+
+/**@}*/
+
+
+
+/**
+ * @name Cluster thread
+ * @{
+ */
+
+/**
+ * @brief Rebuild the poll set: the wakeup fd, followed by each broker's
+ *        listen socket, followed by all client connections.
+ */
+static void rd_kafka_mock_cluster_build_pollset (
+        rd_kafka_mock_cluster_t *mcluster) {
+        rd_kafka_mock_broker_t *mrkb;
+        int cnt = 1 + mcluster->broker_cnt;
+
+        TAILQ_FOREACH(mrkb, &mcluster->brokers, link) {
+                const rd_kafka_mock_connection_t *mconn;
+                TAILQ_FOREACH(mconn, &mrkb->connections, link)
+                        cnt++;
+        }
+
+        if (cnt > mcluster->fd_size) {
+                mcluster->fd_size = cnt + 16;
+                mcluster->fds = rd_realloc(mcluster->fds,
+                                           sizeof(*mcluster->fds) *
+                                           mcluster->fd_size);
+                mcluster->fd_opaques = rd_realloc(mcluster->fd_opaques,
+                                                  sizeof(*mcluster->
+                                                         fd_opaques) *
+                                                  mcluster->fd_size);
+        }
+
+        mcluster->fd_cnt = 0;
+
+        mcluster->fds[0].fd = mcluster->wakeup_fds[0];
+        mcluster->fds[0].events = POLLIN;
+        mcluster->fd_opaques[0] = NULL;
+        mcluster->fd_cnt++;
+
+        TAILQ_FOREACH(mrkb, &mcluster->brokers, link) {
+                mcluster->fds[mcluster->fd_cnt].fd = mrkb->listen_s;
+                mcluster->fds[mcluster->fd_cnt].events = POLLIN;
+                mcluster->fd_opaques[mcluster->fd_cnt] = mrkb;
+                mcluster->fd_cnt++;
+        }
+
+        TAILQ_FOREACH(mrkb, &mcluster->brokers, link) {
+                rd_kafka_mock_connection_t *mconn;
+                TAILQ_FOREACH(mconn, &mrkb->connections, link) {
+                        struct pollfd *pfd = &mcluster->fds[mcluster->fd_cnt];
+                        pfd->fd = mconn->s;
+                        pfd->events = POLLIN;
+                        if (!TAILQ_EMPTY(&mconn->outbufs))
+                                pfd->events |= POLLOUT;
+                        mcluster->fd_opaques[mcluster->fd_cnt] = mconn;
+                        mcluster->fd_cnt++;
+                }
+        }
+}
+
+
+static int rd_kafka_mock_cluster_thread_main (void *arg) {
+        rd_kafka_mock_cluster_t *mcluster = arg;
+
+        rd_kafka_set_thread_name("mock");
+        rd_kafka_set_thread_sysname("rdk:mock");
+
+        (void)rd_atomic32_add(&rd_kafka_thread_cnt_curr, 1);
+
+        mtx_lock(&mcluster->lock);
+
+        while (mcluster->run) {
+                rd_ts_t now = rd_clock();
+                rd_ts_t next = now + 1000*1000;
+                rd_ts_t t;
+                int timeout_ms;
+                int r, i;
+
+                /* Serve parked fetches and consumer group timers. */
+                if ((t = rd_kafka_mock_cluster_fetches_serve(mcluster,
+                                                             now)) &&
+                    t < next)
+                        next = t;
+                if ((t = rd_kafka_mock_cgrps_serve(mcluster, now)) &&
+                    t < next)
+                        next = t;
+
+                rd_kafka_mock_cluster_build_pollset(mcluster);
+
+                timeout_ms = next > now ? (int)((next - now + 999) / 1000) : 0;
+
+                mtx_unlock(&mcluster->lock);
+                r = rd_kafka_mock_socket_poll(mcluster->fds, mcluster->fd_cnt,
+                                              timeout_ms);
+                mtx_lock(&mcluster->lock);
+
+                if (r <= 0)
+                        continue;
+
+                for (i = 0 ; i < mcluster->fd_cnt && mcluster->run ; i++) {
+                        int events = mcluster->fds[i].revents;
+
+                        if (!events)
+                                continue;
+
+                        if (i == 0) {
+                                /* Wakeup, drain the pipe. */
+                                char buf[64];
+                                while (rd_read(mcluster->wakeup_fds[0],
+                                               buf, sizeof(buf)) > 0)
+                                        ;
+                        } else if (i <= mcluster->broker_cnt) {
+                                rd_kafka_mock_broker_accept(
+                                        mcluster->fd_opaques[i]);
+                        } else {
+                                rd_kafka_mock_connection_io(
+                                        mcluster->fd_opaques[i], events);
+                        }
+                }
+        }
+
+        mtx_unlock(&mcluster->lock);
+
+        rd_kafka_dbg(mcluster->rk, MOCK, "MOCK",
+                     "Mock cluster thread exiting");
+
+        rd_atomic32_sub(&rd_kafka_thread_cnt_curr, 1);
+
+        return 0;
+}
+
+/**@}*/
+
+
+
+/**
+ * @name Cluster and brokers
+ * @{
+ */
+
+static void rd_kafka_mock_broker_destroy (rd_kafka_mock_broker_t *mrkb) {
+        rd_kafka_mock_connection_t *mconn;
+
+        while ((mconn = TAILQ_FIRST(&mrkb->connections)))
+                rd_kafka_mock_connection_close(mconn, "Destroying broker");
+
+        if (mrkb->listen_s != -1)
+                rd_kafka_mock_socket_close(mrkb->listen_s);
+
+        TAILQ_REMOVE(&mrkb->cluster->brokers, mrkb, link);
+        mrkb->cluster->broker_cnt--;
+
+        rd_free(mrkb);
+}
+
+
+static rd_kafka_mock_broker_t *
+rd_kafka_mock_broker_new (rd_kafka_mock_cluster_t *mcluster,
+                          int32_t broker_id) {
+        rd_kafka_mock_broker_t *mrkb;
+        struct sockaddr_in sin = {
+                .sin_family = AF_INET,
+                .sin_addr = {
+                        .s_addr = htonl(INADDR_LOOPBACK)
+                }
+        };
+        socklen_t sin_len = sizeof(sin);
+        int listen_s;
+
+        /* Bind to a random port on localhost */
+        if ((listen_s = (int)socket(AF_INET, SOCK_STREAM,
+                                    IPPROTO_TCP)) == -1) {
+                rd_kafka_log(mcluster->rk, LOG_CRIT, "MOCK",
+                             "Unable to create mock broker listen socket: %s",
+                             rd_strerror(socket_errno));
+                return NULL;
+        }
+
+        if (bind(listen_s, (struct sockaddr *)&sin, sizeof(sin)) == -1 ||
+            getsockname(listen_s, (struct sockaddr *)&sin, &sin_len) == -1 ||
+            listen(listen_s, 5) == -1 ||
+            rd_fd_set_nonblocking(listen_s) != 0) {
+                rd_kafka_log(mcluster->rk, LOG_CRIT, "MOCK",
+                             "Failed to set up mock broker listen socket "
+                             "on %s: %s",
+                             rd_sockaddr2str(&sin, RD_SOCKADDR2STR_F_PORT),
+                             rd_strerror(socket_errno));
+                rd_kafka_mock_socket_close(listen_s);
+                return NULL;
+        }
+
+        mrkb = rd_calloc(1, sizeof(*mrkb));
+        mrkb->id = broker_id;
+        mrkb->cluster = mcluster;
+        mrkb->listen_s = listen_s;
+        mrkb->port = ntohs(sin.sin_port);
+        rd_snprintf(mrkb->advertised_listener,
+                    sizeof(mrkb->advertised_listener),
+                    "%s", rd_sockaddr2str(&sin, 0));
+        TAILQ_INIT(&mrkb->connections);
+
+        TAILQ_INSERT_TAIL(&mcluster->brokers, mrkb, link);
+        mcluster->broker_cnt++;
+
+        return mrkb;
+}
+
+
+/**
+ * @returns the coordinator broker for \p key, e.g., a group id.
+ */
+rd_kafka_mock_broker_t *
+rd_kafka_mock_cluster_get_coord (rd_kafka_mock_cluster_t *mcluster,
+                                 const rd_kafkap_str_t *key) {
+        rd_kafka_mock_broker_t *mrkb;
+        unsigned int hash = 5381;
+        int i, idx;
+
+        /* djb2 */
+        for (i = 0 ; i < RD_KAFKAP_STR_LEN(key) ; i++)
+                hash = ((hash << 5) + hash) + (unsigned char)key->str[i];
+
+        idx = (int)(hash % (unsigned int)mcluster->broker_cnt);
+
+        TAILQ_FOREACH(mrkb, &mcluster->brokers, link)
+                if (idx-- == 0)
+                        return mrkb;
+
+        RD_NOTREACHED();
+        return NULL;
+}
+
+
+/**
+ * @brief Wake up the cluster thread.
+ */
+static void rd_kafka_mock_cluster_wakeup (rd_kafka_mock_cluster_t *mcluster) {
+        char c = 1;
+        if (rd_write(mcluster->wakeup_fds[1], &c, 1) == -1 &&
+            errno != EAGAIN)
+                rd_kafka_log(mcluster->rk, LOG_WARNING, "MOCK",
+                             "Failed to wake up mock cluster thread: %s",
+                             rd_strerror(errno));
+}
+
+
+void rd_kafka_mock_cluster_destroy (rd_kafka_mock_cluster_t *mcluster) {
+        rd_kafka_mock_topic_t *mtopic;
+        rd_kafka_mock_broker_t *mrkb;
+        rd_kafka_mock_cgrp_t *mcgrp;
+        int res;
+
+        rd_kafka_dbg(mcluster->rk, MOCK, "MOCK",
+                     "Destroying mock cluster %s", mcluster->id);
+
+        mtx_lock(&mcluster->lock);
+        mcluster->run = 0;
+        mtx_unlock(&mcluster->lock);
+
+        rd_kafka_mock_cluster_wakeup(mcluster);
+
+        if (thrd_join(mcluster->thread, &res) != thrd_success)
+                rd_assert(!*"failed to join mock thread");
+
+        while ((mcgrp = TAILQ_FIRST(&mcluster->cgrps)))
+                rd_kafka_mock_cgrp_destroy(mcgrp);
+
+        while ((mrkb = TAILQ_FIRST(&mcluster->brokers)))
+                rd_kafka_mock_broker_destroy(mrkb);
+
+        while ((mtopic = TAILQ_FIRST(&mcluster->topics)))
+                rd_kafka_mock_topic_destroy(mtopic);
+
+        mtx_destroy(&mcluster->lock);
+
+        rd_close(mcluster->wakeup_fds[0]);
+        rd_close(mcluster->wakeup_fds[1]);
+
+        if (mcluster->fds)
+                rd_free(mcluster->fds);
+        if (mcluster->fd_opaques)
+                rd_free(mcluster->fd_opaques);
+
+        rd_free(mcluster->bootstraps);
+        rd_free(mcluster);
+}
+
+
+rd_kafka_mock_cluster_t *rd_kafka_mock_cluster_new (rd_kafka_t *rk,
+                                                    int broker_cnt) {
+        rd_kafka_mock_cluster_t *mcluster;
+        rd_kafka_mock_broker_t *mrkb;
+        int i, r;
+        size_t bootstraps_len = 0;
+        size_t of;
+#ifndef _MSC_VER
+        sigset_t newset, oldset;
+#endif
+
+        if (broker_cnt < 1) {
+                rd_kafka_log(rk, LOG_ERR, "MOCK",
+                             "Mock cluster requires at least one broker");
+                return NULL;
+        }
+
+        mcluster = rd_calloc(1, sizeof(*mcluster));
+        mcluster->rk = rk;
+
+        TAILQ_INIT(&mcluster->brokers);
+        TAILQ_INIT(&mcluster->topics);
+        TAILQ_INIT(&mcluster->cgrps);
+
+        mcluster->defaults.partition_cnt = 4;
+        mcluster->defaults.replication_factor = RD_MIN(3, broker_cnt);
+        mcluster->defaults.max_partition_bytes = 64 * 1024 * 1024;
+
+        mcluster->next_pid = 1000;
+
+        if ((r = rd_pipe_nonblocking(mcluster->wakeup_fds)) != 0) {
+                rd_kafka_log(rk, LOG_CRIT, "MOCK",
+                             "Failed to create mock cluster wake-up "
+                             "pipe: %s", rd_strerror(r));
+                rd_free(mcluster);
+                return NULL;
+        }
+
+        mtx_init(&mcluster->lock, mtx_plain);
+
+        for (i = 1 ; i <= broker_cnt ; i++) {
+                if (!(mrkb = rd_kafka_mock_broker_new(mcluster, i))) {
+                        mcluster->run = 0;
+                        while ((mrkb = TAILQ_FIRST(&mcluster->brokers)))
+                                rd_kafka_mock_broker_destroy(mrkb);
+                        mtx_destroy(&mcluster->lock);
+                        rd_close(mcluster->wakeup_fds[0]);
+                        rd_close(mcluster->wakeup_fds[1]);
+                        rd_free(mcluster);
+                        return NULL;
+                }
+
+                /* advertised_listener + ":port" + "," */
+                bootstraps_len += strlen(mrkb->advertised_listener) + 6 + 2;
+        }
+
+        mcluster->controller_id = TAILQ_FIRST(&mcluster->brokers)->id;
+
+        rd_snprintf(mcluster->id, sizeof(mcluster->id),
+                    "mockCluster%lx", (unsigned long)rd_clock());
+
+        /* Construct bootstrap.servers list */
+        mcluster->bootstraps = rd_malloc(bootstraps_len + 1);
+        of = 0;
+        TAILQ_FOREACH(mrkb, &mcluster->brokers, link) {
+                r = rd_snprintf(&mcluster->bootstraps[of],
+                                bootstraps_len - of,
+                                "%s%s:%d",
+                                of > 0 ? "," : "",
+                                mrkb->advertised_listener, mrkb->port);
+                of += r;
+                rd_assert(of < bootstraps_len);
+        }
+        mcluster->bootstraps[of] = '\0';
+
+        mcluster->run = 1;
+
+#ifndef _MSC_VER
+        /* Block all signals in the cluster thread, see rd_kafka_new(). */
+        sigemptyset(&oldset);
+        sigfillset(&newset);
+        pthread_sigmask(SIG_SETMASK, &newset, &oldset);
+#endif
+
+        r = thrd_create(&mcluster->thread, rd_kafka_mock_cluster_thread_main,
+                        mcluster);
+
+#ifndef _MSC_VER
+        pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+
+        if (r != thrd_success) {
+                rd_kafka_log(rk, LOG_CRIT, "MOCK",
+                             "Failed to create mock cluster thread: %s",
+                             rd_strerror(errno));
+                mcluster->run = 0;
+                while ((mrkb = TAILQ_FIRST(&mcluster->brokers)))
+                        rd_kafka_mock_broker_destroy(mrkb);
+                mtx_destroy(&mcluster->lock);
+                rd_close(mcluster->wakeup_fds[0]);
+                rd_close(mcluster->wakeup_fds[1]);
+                rd_free(mcluster->bootstraps);
+                rd_free(mcluster);
+                return NULL;
+        }
+
+        rd_kafka_dbg(rk, MOCK, "MOCK",
+                     "Mock cluster %s with %d broker(s) started: "
+                     "bootstrap.servers=%s",
+                     mcluster->id, broker_cnt, mcluster->bootstraps);
+
+        return mcluster;
+}
+
+
+rd_kafka_mock_cluster_t *rd_kafka_handle_mock_cluster (const rd_kafka_t *rk) {
+        return (rd_kafka_mock_cluster_t *)rk->rk_mock.cluster;
+}
+
+
+const char *
+rd_kafka_mock_cluster_bootstraps (const rd_kafka_mock_cluster_t *mcluster) {
+        return mcluster->bootstraps;
+}
+
+
+rd_kafka_resp_err_t
+rd_kafka_mock_topic_create (rd_kafka_mock_cluster_t *mcluster,
+                            const char *topic, int partition_cnt,
+                            int replication_factor) {
+        rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
+
+        if (partition_cnt < 1)
+                return RD_KAFKA_RESP_ERR_INVALID_PARTITIONS;
+
+        mtx_lock(&mcluster->lock);
+
+        if (replication_factor < 1 ||
+            replication_factor > mcluster->broker_cnt)
+                err = RD_KAFKA_RESP_ERR_INVALID_REPLICATION_FACTOR;
+        else if (rd_kafka_mock_topic_find(mcluster, topic))
+                err = RD_KAFKA_RESP_ERR_TOPIC_ALREADY_EXISTS;
+        else
+                rd_kafka_mock_topic_new(mcluster, topic, partition_cnt,
+                                        replication_factor);
+
+        mtx_unlock(&mcluster->lock);
+
+        return err;
+}
+
+
+void
+rd_kafka_mock_set_default_partition_cnt (rd_kafka_mock_cluster_t *mcluster,
+                                         int partition_cnt) {
+        mtx_lock(&mcluster->lock);
+        mcluster->defaults.partition_cnt = RD_MAX(1, partition_cnt);
+        mtx_unlock(&mcluster->lock);
+}
+
+/**@}*/
@@ -0,0 +1,151 @@
+/*
+ * librdkafka - Apache Kafka C library
+ *
+ * Copyright (c) 2019 Magnus Edenhill
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _RDKAFKA_MOCK_H_
+#define _RDKAFKA_MOCK_H_
+
+#ifndef _RDKAFKA_H_
+#error "rdkafka_mock.h must be included after rdkafka.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#if 0
+} /* Restore indent */
+#endif
+#endif
+
+
+/**
+ * @name Mock cluster
+ * @{
+ *
+ * Provides a mock Kafka cluster with a configurable number of brokers
+ * that support a reasonable subset of Kafka protocol operations:
+ * Metadata, Produce, Fetch, ListOffsets, OffsetCommit, OffsetFetch,
+ * FindCoordinator, JoinGroup, SyncGroup, Heartbeat, LeaveGroup and
+ * InitProducerId.
+ *
+ * The mock cluster runs in its own thread and serves all its brokers
+ * over local (127.0.0.1) TCP sockets, the data is kept in memory only.
+ *
+ * There are two ways to use the mock cluster, the most simple approach
+ * is to configure `test.mock.num.brokers` (to e.g. 3) on the rd_kafka_t
+ * in an existing application, which will replace the configured
+ * `bootstrap.servers` with the mock cluster brokers.
+ * This approach is convenient to easily test existing applications.
+ * Other rd_kafka_t instances may connect to the same mock cluster by setting
+ * their `bootstrap.servers` to rd_kafka_mock_cluster_bootstraps().
+ *
+ * The second approach is to explicitly create a mock cluster on an
+ * rd_kafka_t instance by using rd_kafka_mock_cluster_new().
+ *
+ * Topics are automatically created on first use with the default
+ * partition count, or explicitly with rd_kafka_mock_topic_create().
+ *
+ * @remark This is an experimental interface for testing and benchmarking
+ *         purposes only and is subject to change.
+ *
+ * @remark The mock cluster does not validate produced message sequences,
+ *         does not support transactions, SASL or SSL, and only supports
+ *         MsgVersion 2 (Kafka >= 0.11.0) MessageSets.
+ */
+
+typedef struct rd_kafka_mock_cluster_s rd_kafka_mock_cluster_t;
+
+
+/**
+ * @brief Create new mock cluster with \p broker_cnt brokers.
+ *
+ * The broker ids will start at 1 up to and including \p broker_cnt.
+ *
+ * The \p rk instance is required for logging and internal resources,
+ * it must outlive the mock cluster.
+ *
+ * @returns the new mock cluster, or NULL on failure (see logs).
+ */
+RD_EXPORT
+rd_kafka_mock_cluster_t *rd_kafka_mock_cluster_new (rd_kafka_t *rk,
+                                                    int broker_cnt);
+
+
+/**
+ * @brief Destroy mock cluster, closing all client connections.
+ */
+RD_EXPORT
+void rd_kafka_mock_cluster_destroy (rd_kafka_mock_cluster_t *mcluster);
+
+
+/**
+ * @returns the rd_kafka_t's internal mock cluster, if the instance
+ *          was configured with `test.mock.num.brokers`, else NULL.
+ */
+RD_EXPORT rd_kafka_mock_cluster_t *
+rd_kafka_handle_mock_cluster (const rd_kafka_t *rk);
+
+
+/**
+ * @returns the mock cluster's bootstrap.servers list
+ */
+RD_EXPORT const char *
+rd_kafka_mock_cluster_bootstraps (const rd_kafka_mock_cluster_t *mcluster);
+
+
+/**
+ * @brief Create a topic with \p partition_cnt partitions and
+ *        \p replication_factor replicas (at most the number of brokers).
+ *
+ * Partition leaders are assigned to the brokers in a round-robin fashion.
+ *
+ * @returns RD_KAFKA_RESP_ERR_TOPIC_ALREADY_EXISTS if the topic exists,
+ *          RD_KAFKA_RESP_ERR_INVALID_PARTITIONS or
+ *          RD_KAFKA_RESP_ERR_INVALID_REPLICATION_FACTOR on invalid counts,
+ *          else RD_KAFKA_RESP_ERR_NO_ERROR.
+ */
+RD_EXPORT rd_kafka_resp_err_t
+rd_kafka_mock_topic_create (rd_kafka_mock_cluster_t *mcluster,
+                            const char *topic, int partition_cnt,
+                            int replication_factor);
+
+
+/**
+ * @brief Set the partition count used for automatically created topics.
+ *
+ * Defaults to 4 partitions.
+ */
+RD_EXPORT void
+rd_kafka_mock_set_default_partition_cnt (rd_kafka_mock_cluster_t *mcluster,
+                                         int partition_cnt);
+
+
+/**@}*/
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _RDKAFKA_MOCK_H_ */
@@ -0,0 +1,711 @@
+/*
+ * librdkafka - Apache Kafka C library
+ *
+ * Copyright (c) 2019 Magnus Edenhill
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Mock cluster consumer group coordinator
+ *
+ * Implements a simplified version of the broker-side group membership
+ * protocol: JoinGroup responses are held until all known members have
+ * (re)joined or the join deadline is reached, SyncGroup responses are held
+ * until the leader has provided the assignments.
+ */
+
+#include "rd.h"
+#include "rdkafka_int.h"
+#include "rdkafka_mock.h"
+#include "rdkafka_mock_int.h"
+
+
+static const char *rd_kafka_mock_cgrp_state_names[] = {
+        "Empty",
+        "Joining",
+        "Syncing",
+        "Up"
+};
+
+
+static void rd_kafka_mock_cgrp_set_state (rd_kafka_mock_cgrp_t *mcgrp,
+                                          rd_kafka_mock_cgrp_state_t state,
+                                          const char *reason) {
+        if (mcgrp->state == state)
+                return;
+
+        rd_kafka_dbg(mcgrp->cluster->rk, MOCK, "MOCK",
+                     "Mock consumer group %s with %d member(s) "
+                     "changing state %s -> %s: %s",
+                     mcgrp->id, mcgrp->member_cnt,
+                     rd_kafka_mock_cgrp_state_names[mcgrp->state],
+                     rd_kafka_mock_cgrp_state_names[state], reason);
+
+        mcgrp->state = state;
+}
+
+
+void rd_kafka_mock_cgrp_protos_destroy (rd_kafka_mock_cgrp_proto_t *protos,
+                                        int proto_cnt) {
+        int i;
+
+        for (i = 0 ; i < proto_cnt ; i++) {
+                if (protos[i].name)
+                        rd_kafkap_str_destroy(protos[i].name);
+                if (protos[i].metadata)
+                        rd_kafkap_bytes_destroy(protos[i].metadata);
+        }
+
+        rd_free(protos);
+}
+
+
+/**
+ * @brief Drop the member's pending Join- or SyncGroup response, if any.
+ */
+static void
+rd_kafka_mock_cgrp_member_resp_drop (rd_kafka_mock_cgrp_member_t *member) {
+        if (!member->resp)
+                return;
+
+        rd_kafka_buf_destroy(member->resp);
+        member->resp = NULL;
+        member->conn = NULL;
+}
+
+
+/**
+ * @brief Send the member's pending response, if any.
+ */
+static void
+rd_kafka_mock_cgrp_member_resp_send (rd_kafka_mock_cgrp_member_t *member) {
+        if (!member->resp)
+                return;
+
+        rd_kafka_mock_connection_send_response(member->conn, member->resp);
+        member->resp = NULL;
+        member->conn = NULL;
+}
+
+
+/**
+ * @returns true if the member's pending response is for \p ApiKey.
+ */
+static RD_INLINE rd_bool_t
+rd_kafka_mock_cgrp_member_pending (const rd_kafka_mock_cgrp_member_t *member,
+                                   int16_t ApiKey) {
+        return member->resp &&
+                member->resp->rkbuf_reqhdr.ApiKey == ApiKey;
+}
+
+
+/**
+ * @brief Send a SyncGroup error response to all members with a pending
+ *        SyncGroup request.
+ */
+static void rd_kafka_mock_cgrp_sync_fail (rd_kafka_mock_cgrp_t *mcgrp,
+                                          rd_kafka_resp_err_t err) {
+        rd_kafka_mock_cgrp_member_t *member;
+
+        TAILQ_FOREACH(member, &mcgrp->members, link) {
+                if (!rd_kafka_mock_cgrp_member_pending(member,
+                                                       RD_KAFKAP_SyncGroup))
+                        continue;
+
+                /* Response: ErrorCode */
+                rd_kafka_buf_write_i16(member->resp, err);
+                /* Response: MemberState */
+                rd_kafka_buf_write_bytes(member->resp, NULL, 0);
+
+                rd_kafka_mock_cgrp_member_resp_send(member);
+        }
+}
+
+
+/**
+ * @brief Start a rebalance: members will be told to rejoin through
+ *        their Heartbeats.
+ */
+static void rd_kafka_mock_cgrp_rebalance (rd_kafka_mock_cgrp_t *mcgrp,
+                                          const char *reason) {
+        const rd_kafka_mock_cgrp_member_t *member;
+        int timeout_ms = 0;
+
+        if (mcgrp->state == RD_KAFKA_MOCK_CGRP_STATE_SYNCING)
+                rd_kafka_mock_cgrp_sync_fail(
+                        mcgrp, RD_KAFKA_RESP_ERR_REBALANCE_IN_PROGRESS);
+
+        if (mcgrp->state != RD_KAFKA_MOCK_CGRP_STATE_JOINING) {
+                /* Give the members one session timeout to rejoin. */
+                TAILQ_FOREACH(member, &mcgrp->members, link)
+                        timeout_ms = RD_MAX(timeout_ms,
+                                            member->session_timeout_ms);
+
+                mcgrp->ts_join_deadline = rd_clock() +
+                        ((rd_ts_t)timeout_ms * 1000);
+        }
+
+        rd_kafka_mock_cgrp_set_state(mcgrp,
+                                     RD_KAFKA_MOCK_CGRP_STATE_JOINING,
+                                     reason);
+}
+
+
+static void rd_kafka_mock_cgrp_member_destroy (
+        rd_kafka_mock_cgrp_t *mcgrp,
+        rd_kafka_mock_cgrp_member_t *member) {
+
+        TAILQ_REMOVE(&mcgrp->members, member, link);
+        mcgrp->member_cnt--;
+
+        if (mcgrp->leader == member)
+                mcgrp->leader = NULL;
+
+        rd_kafka_mock_cgrp_member_resp_drop(member);
+
+        if (member->protocols)
+                rd_kafka_mock_cgrp_protos_destroy(member->protocols,
+                                                  member->protocol_cnt);
+        if (member->assignment)
+                rd_kafkap_bytes_destroy(member->assignment);
+
+        rd_free(member->id);
+        rd_free(member);
+}
+
+
+/**
+ * @returns the first protocol of the leader that is supported by all
+ *          members, or NULL if there is none.
+ */
+static const rd_kafkap_str_t *
+rd_kafka_mock_cgrp_select_protocol (const rd_kafka_mock_cgrp_t *mcgrp) {
+        int i;
+
+        for (i = 0 ; i < mcgrp->leader->protocol_cnt ; i++) {
+                const rd_kafkap_str_t *name = mcgrp->leader->protocols[i].name;
+                const rd_kafka_mock_cgrp_member_t *member;
+                rd_bool_t all = rd_true;
+
+                TAILQ_FOREACH(member, &mcgrp->members, link) {
+                        int j;
+                        rd_bool_t found = rd_false;
+
+                        for (j = 0 ; !found && j < member->protocol_cnt ; j++)
+                                found = !rd_kafkap_str_cmp(
+                                        name, member->protocols[j].name);
+
+                        if (!found) {
+                                all = rd_false;
+                                break;
+                        }
+                }
+
+                if (all)
+                        return name;
+        }
+
+        return NULL;
+}
+
+
+/**
+ * @returns the member's metadata for protocol \p name.
+ */
+static const rd_kafkap_bytes_t *
+rd_kafka_mock_cgrp_member_metadata (const rd_kafka_mock_cgrp_member_t *member,
+                                    const char *name) {
+        int i;
+
+        for (i = 0 ; i < member->protocol_cnt ; i++)
+                if (!rd_kafkap_str_cmp_str(member->protocols[i].name, name))
+                        return member->protocols[i].metadata;
+
+        return NULL;
+}
+
+
+/**
+ * @brief Complete the join: members that have not rejoined are removed,
+ *        a new generation is started and the JoinGroup responses are sent.
+ */
+static void rd_kafka_mock_cgrp_join_complete (rd_kafka_mock_cgrp_t *mcgrp) {
+        rd_kafka_mock_cgrp_member_t *member, *tmp;
+        const rd_kafkap_str_t *protocol;
+        rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
+
+        TAILQ_FOREACH_SAFE(member, &mcgrp->members, link, tmp) {
+                if (!rd_kafka_mock_cgrp_member_pending(member,
+                                                       RD_KAFKAP_JoinGroup)) {
+                        rd_kafka_dbg(mcgrp->cluster->rk, MOCK, "MOCK",
+                                     "Member %s did not rejoin group %s: "
+                                     "removing",
+                                     member->id, mcgrp->id);
+                        rd_kafka_mock_cgrp_member_destroy(mcgrp, member);
+                }
+        }
+
+        if (mcgrp->member_cnt == 0) {
+                rd_kafka_mock_cgrp_set_state(mcgrp,
+                                             RD_KAFKA_MOCK_CGRP_STATE_EMPTY,
+                                             "no members joined");
+                return;
+        }
+
+        mcgrp->generation_id++;
+
+        if (!mcgrp->leader)
+                mcgrp->leader = TAILQ_FIRST(&mcgrp->members);
+
+        if (mcgrp->protocol_name) {
+                rd_free(mcgrp->protocol_name);
+                mcgrp->protocol_name = NULL;
+        }
+
+        if ((protocol = rd_kafka_mock_cgrp_select_protocol(mcgrp)))
+                mcgrp->protocol_name = RD_KAFKAP_STR_DUP(protocol);
+        else
+                err = RD_KAFKA_RESP_ERR_INCONSISTENT_GROUP_PROTOCOL;
+
+        TAILQ_FOREACH(member, &mcgrp->members, link) {
+                rd_kafka_buf_t *resp = member->resp;
+                rd_bool_t is_leader = member == mcgrp->leader;
+
+                if (member->assignment) {
+                        rd_kafkap_bytes_destroy(member->assignment);
+                        member->assignment = NULL;
+                }
+
+                /* Response: ErrorCode */
+                rd_kafka_buf_write_i16(resp, err);
+                /* Response: GenerationId */
+                rd_kafka_buf_write_i32(resp, mcgrp->generation_id);
+                /* Response: ProtocolName */
+                rd_kafka_buf_write_str(resp, mcgrp->protocol_name, -1);
+                /* Response: LeaderId */
+                rd_kafka_buf_write_str(resp, mcgrp->leader->id, -1);
+                /* Response: MemberId */
+                rd_kafka_buf_write_str(resp, member->id, -1);
+
+                if (is_leader && !err) {
+                        const rd_kafka_mock_cgrp_member_t *member2;
+
+                        /* Response: #Members */
+                        rd_kafka_buf_write_i32(resp, mcgrp->member_cnt);
+
+                        TAILQ_FOREACH(member2, &mcgrp->members, link) {
+                                /* Response: Members.MemberId */
+                                rd_kafka_buf_write_str(resp, member2->id, -1);
+                                /* Response: Members.MemberMetadata */
+                                rd_kafka_buf_write_kbytes(
+                                        resp,
+                                        rd_kafka_mock_cgrp_member_metadata(
+                                                member2,
+                                                mcgrp->protocol_name));
+                        }
+                } else {
+                        /* Response: #Members */
+                        rd_kafka_buf_write_i32(resp, 0);
+                }
+
+                rd_kafka_mock_cgrp_member_resp_send(member);
+        }
+
+        if (err) {
+                /* Members will rejoin with other protocols, or not. */
+                while ((member = TAILQ_FIRST(&mcgrp->members)))
+                        rd_kafka_mock_cgrp_member_destroy(mcgrp, member);
+                rd_kafka_mock_cgrp_set_state(mcgrp,
+                                             RD_KAFKA_MOCK_CGRP_STATE_EMPTY,
+                                             "inconsistent group protocol");
+                return;
+        }
+
+        rd_kafka_mock_cgrp_set_state(mcgrp, RD_KAFKA_MOCK_CGRP_STATE_SYNCING,
+                                     "all members joined");
+}
+
+
+/**
+ * @brief Complete the join if all members have joined.
+ */
+static void
+rd_kafka_mock_cgrp_check_join_complete (rd_kafka_mock_cgrp_t *mcgrp) {
+        const rd_kafka_mock_cgrp_member_t *member;
+
+        if (mcgrp->state != RD_KAFKA_MOCK_CGRP_STATE_JOINING)
+                return;
+
+        TAILQ_FOREACH(member, &mcgrp->members, link) {
+                if (!rd_kafka_mock_cgrp_member_pending(member,
+                                                       RD_KAFKAP_JoinGroup))
+                        return;
+        }
+
+        rd_kafka_mock_cgrp_join_complete(mcgrp);
+}
+
+
+/**
+ * @brief Complete the sync: send the assignments to all members with
+ *        a pending SyncGroup request.
+ */
+static void rd_kafka_mock_cgrp_sync_complete (rd_kafka_mock_cgrp_t *mcgrp) {
+        rd_kafka_mock_cgrp_member_t *member;
+
+        rd_kafka_mock_cgrp_set_state(mcgrp, RD_KAFKA_MOCK_CGRP_STATE_UP,
+                                     "leader synced");
+
+        TAILQ_FOREACH(member, &mcgrp->members, link) {
+                if (!rd_kafka_mock_cgrp_member_pending(member,
+                                                       RD_KAFKAP_SyncGroup))
+                        continue;
+
+                /* Response: ErrorCode */
+                rd_kafka_buf_write_i16(member->resp,
+                                       RD_KAFKA_RESP_ERR_NO_ERROR);
+                /* Response: MemberState */
+                if (member->assignment)
+                        rd_kafka_buf_write_kbytes(member->resp,
+                                                  member->assignment);
+                else
+                        rd_kafka_buf_write_bytes(member->resp, "", 0);
+
+                rd_kafka_mock_cgrp_member_resp_send(member);
+        }
+}
+
+
+rd_kafka_mock_cgrp_member_t *
+rd_kafka_mock_cgrp_member_find (const rd_kafka_mock_cgrp_t *mcgrp,
+                                const rd_kafkap_str_t *MemberId) {
+        const rd_kafka_mock_cgrp_member_t *member;
+
+        if (RD_KAFKAP_STR_IS_NULL(MemberId))
+                return NULL;
+
+        TAILQ_FOREACH(member, &mcgrp->members, link) {
+                if (!rd_kafkap_str_cmp_str2(member->id, MemberId))
+                        return (rd_kafka_mock_cgrp_member_t *)member;
+        }
+
+        return NULL;
+}
+
+
+/**
+ * @brief Check that \p member may perform \p request in the group's
+ *        current state and generation.
+ */
+rd_kafka_resp_err_t
+rd_kafka_mock_cgrp_check_state (rd_kafka_mock_cgrp_t *mcgrp,
+                                rd_kafka_mock_cgrp_member_t *member,
+                                const rd_kafka_buf_t *request,
+                                int32_t generation_id) {
+        if (!member)
+                return RD_KAFKA_RESP_ERR_UNKNOWN_MEMBER_ID;
+
+        if (request->rkbuf_reqhdr.ApiKey == RD_KAFKAP_JoinGroup)
+                return RD_KAFKA_RESP_ERR_NO_ERROR;
+
+        if (mcgrp->state == RD_KAFKA_MOCK_CGRP_STATE_JOINING)
+                return RD_KAFKA_RESP_ERR_REBALANCE_IN_PROGRESS;
+
+        if (generation_id != mcgrp->generation_id)
+                return RD_KAFKA_RESP_ERR_ILLEGAL_GENERATION;
+
+        return RD_KAFKA_RESP_ERR_NO_ERROR;
+}
+
+
+/**
+ * @brief Add or update a member from a JoinGroupRequest.
+ *
+ * Takes ownership of \p protos and, on success, of \p resp which is sent
+ * when the join completes.
+ */
+rd_kafka_resp_err_t
+rd_kafka_mock_cgrp_member_add (rd_kafka_mock_cgrp_t *mcgrp,
+                               rd_kafka_mock_connection_t *mconn,
+                               rd_kafka_buf_t *resp,
+                               const rd_kafkap_str_t *MemberId,
+                               rd_kafka_mock_cgrp_proto_t *protos,
+                               int proto_cnt,
+                               int session_timeout_ms) {
+        rd_kafka_mock_cgrp_member_t *member;
+
+        if (RD_KAFKAP_STR_LEN(MemberId) > 0) {
+                if (!(member = rd_kafka_mock_cgrp_member_find(mcgrp,
+                                                              MemberId))) {
+                        rd_kafka_mock_cgrp_protos_destroy(protos, proto_cnt);
+                        return RD_KAFKA_RESP_ERR_UNKNOWN_MEMBER_ID;
+                }
+
+        } else {
+                char id[64];
+
+                rd_snprintf(id, sizeof(id), "%s-member-%d",
+                            mcgrp->id, ++mcgrp->last_member_id);
+
+                member = rd_calloc(1, sizeof(*member));
+                member->id = rd_strdup(id);
+                TAILQ_INSERT_TAIL(&mcgrp->members, member, link);
+                mcgrp->member_cnt++;
+
+                rd_kafka_dbg(mcgrp->cluster->rk, MOCK, "MOCK",
+                             "Added member %s to group %s",
+                             member->id, mcgrp->id);
+        }
+
+        if (member->protocols)
+                rd_kafka_mock_cgrp_protos_destroy(member->protocols,
+                                                  member->protocol_cnt);
+        member->protocols = protos;
+        member->protocol_cnt = proto_cnt;
+        member->session_timeout_ms = session_timeout_ms;
+
+        rd_kafka_mock_cgrp_member_resp_drop(member);
+        member->resp = resp;
+        member->conn = mconn;
+
+        rd_kafka_mock_cgrp_member_active(member);
+
+        rd_kafka_mock_cgrp_rebalance(mcgrp, "member joined");
+
+        rd_kafka_mock_cgrp_check_join_complete(mcgrp);
+
+        return RD_KAFKA_RESP_ERR_NO_ERROR;
+}
+
+
+/**
+ * @brief Hold \p resp until the leader has synced, or respond
+ *        immediately if the group is already up.
+ *
+ * Takes ownership of \p resp on success.
+ */
+rd_kafka_resp_err_t
+rd_kafka_mock_cgrp_member_sync_set (rd_kafka_mock_cgrp_t *mcgrp,
+                                    rd_kafka_mock_cgrp_member_t *member,
+                                    rd_kafka_mock_connection_t *mconn,
+                                    rd_kafka_buf_t *resp) {
+        rd_kafka_mock_cgrp_member_resp_drop(member);
+        member->resp = resp;
+        member->conn = mconn;
+
+        if (member == mcgrp->leader ||
+            mcgrp->state == RD_KAFKA_MOCK_CGRP_STATE_UP)
+                rd_kafka_mock_cgrp_sync_complete(mcgrp);
+
+        return RD_KAFKA_RESP_ERR_NO_ERROR;
+}
+
+
+/**
+ * @brief Set a member's assignment, as provided by the leader.
+ */
+void
+rd_kafka_mock_cgrp_member_assignment_set (rd_kafka_mock_cgrp_t *mcgrp,
+                                          const rd_kafkap_str_t *MemberId,
+                                          const rd_kafkap_bytes_t *assignment) {
+        rd_kafka_mock_cgrp_member_t *member;
+
+        if (!(member = rd_kafka_mock_cgrp_member_find(mcgrp, MemberId)))
+                return;
+
+        if (member->assignment)
+                rd_kafkap_bytes_destroy(member->assignment);
+        member->assignment = rd_kafkap_bytes_copy(assignment);
+}
+
+
+void rd_kafka_mock_cgrp_member_leave (rd_kafka_mock_cgrp_t *mcgrp,
+                                      rd_kafka_mock_cgrp_member_t *member) {
+        rd_kafka_dbg(mcgrp->cluster->rk, MOCK, "MOCK",
+                     "Member %s is leaving group %s", member->id, mcgrp->id);
+
+        rd_kafka_mock_cgrp_member_destroy(mcgrp, member);
+
+        if (mcgrp->member_cnt == 0) {
+                rd_kafka_mock_cgrp_set_state(mcgrp,
+                                             RD_KAFKA_MOCK_CGRP_STATE_EMPTY,
+                                             "last member left");
+                return;
+        }
+
+        rd_kafka_mock_cgrp_rebalance(mcgrp, "member left");
+        rd_kafka_mock_cgrp_check_join_complete(mcgrp);
+}
+
+
+void rd_kafka_mock_cgrp_member_active (rd_kafka_mock_cgrp_member_t *member) {
+        member->ts_last_activity = rd_clock();
+}
+
+
+/**
+ * @brief Drop all pending responses for connection \p mconn.
+ */
+void rd_kafka_mock_cgrps_connection_closed (rd_kafka_mock_cluster_t *mcluster,
+                                            rd_kafka_mock_connection_t *mconn) {
+        rd_kafka_mock_cgrp_t *mcgrp;
+
+        TAILQ_FOREACH(mcgrp, &mcluster->cgrps, link) {
+                rd_kafka_mock_cgrp_member_t *member;
+
+                TAILQ_FOREACH(member, &mcgrp->members, link) {
+                        if (member->conn == mconn)
+                                rd_kafka_mock_cgrp_member_resp_drop(member);
+                }
+        }
+}
+
+
+/**
+ * @brief Serve group timers: join deadlines and session timeouts.
+ *
+ * @returns the time of the next timer, or 0 if there is none.
+ */
+rd_ts_t rd_kafka_mock_cgrps_serve (rd_kafka_mock_cluster_t *mcluster,
+                                   rd_ts_t now) {
+        rd_kafka_mock_cgrp_t *mcgrp;
+        rd_ts_t next = 0;
+
+#define _NEXT(ts) do {                          \
+                if (!next || (ts) < next)       \
+                        next = (ts);            \
+        } while (0)
+
+        TAILQ_FOREACH(mcgrp, &mcluster->cgrps, link) {
+                rd_kafka_mock_cgrp_member_t *member, *tmp;
+                int expired_cnt = 0;
+
+                if (mcgrp->state == RD_KAFKA_MOCK_CGRP_STATE_JOINING) {
+                        if (now >= mcgrp->ts_join_deadline)
+                                rd_kafka_mock_cgrp_join_complete(mcgrp);
+                        else
+                                _NEXT(mcgrp->ts_join_deadline);
+                }
+
+                /* Members with a pending response are waiting for
+                 * the coordinator and can't time out. */
+                TAILQ_FOREACH_SAFE(member, &mcgrp->members, link, tmp) {
+                        rd_ts_t expiry = member->ts_last_activity +
+                                ((rd_ts_t)member->session_timeout_ms * 1000);
+
+                        if (member->resp)
+                                continue;
+
+                        if (now < expiry) {
+                                _NEXT(expiry);
+                                continue;
+                        }
+
+                        rd_kafka_dbg(mcluster->rk, MOCK, "MOCK",
+                                     "Member %s session timed out for "
+                                     "group %s",
+                                     member->id, mcgrp->id);
+                        rd_kafka_mock_cgrp_member_destroy(mcgrp, member);
+                        expired_cnt++;
+                }
+
+                if (!expired_cnt)
+                        continue;
+
+                if (mcgrp->member_cnt == 0)
+                        rd_kafka_mock_cgrp_set_state(
+                                mcgrp, RD_KAFKA_MOCK_CGRP_STATE_EMPTY,
+                                "all members timed out");
+                else {
+                        rd_kafka_mock_cgrp_rebalance(mcgrp,
+                                                     "member timed out");
+                        rd_kafka_mock_cgrp_check_join_complete(mcgrp);
+                        if (mcgrp->state ==
+                            RD_KAFKA_MOCK_CGRP_STATE_JOINING)
+                                _NEXT(mcgrp->ts_join_deadline);
+                }
+        }
+
+#undef _NEXT
+
+        return next;
+}
+
+
+void rd_kafka_mock_cgrp_destroy (rd_kafka_mock_cgrp_t *mcgrp) {
+        rd_kafka_mock_cgrp_member_t *member;
+
+        TAILQ_REMOVE(&mcgrp->cluster->cgrps, mcgrp, link);
+
+        while ((member = TAILQ_FIRST(&mcgrp->members)))
+                rd_kafka_mock_cgrp_member_destroy(mcgrp, member);
+
+        rd_free(mcgrp->id);
+        rd_free(mcgrp->protocol_type);
+        if (mcgrp->protocol_name)
+                rd_free(mcgrp->protocol_name);
+        rd_free(mcgrp);
+}
+
+
+rd_kafka_mock_cgrp_t *
+rd_kafka_mock_cgrp_find (rd_kafka_mock_cluster_t *mcluster,
+                         const rd_kafkap_str_t *GroupId) {
+        rd_kafka_mock_cgrp_t *mcgrp;
+
+        if (RD_KAFKAP_STR_IS_NULL(GroupId))
+                return NULL;
+
+        TAILQ_FOREACH(mcgrp, &mcluster->cgrps, link) {
+                if (!rd_kafkap_str_cmp_str2(mcgrp->id, GroupId))
+                        return mcgrp;
+        }
+
+        return NULL;
+}
+
+
+/**
+ * @brief Find or create a consumer group.
+ */
+rd_kafka_mock_cgrp_t *
+rd_kafka_mock_cgrp_get (rd_kafka_mock_cluster_t *mcluster,
+                        const rd_kafkap_str_t *GroupId,
+                        const rd_kafkap_str_t *ProtocolType) {
+        rd_kafka_mock_cgrp_t *mcgrp;
+
+        if ((mcgrp = rd_kafka_mock_cgrp_find(mcluster, GroupId)))
+                return mcgrp;
+
+        mcgrp = rd_calloc(1, sizeof(*mcgrp));
+        mcgrp->cluster = mcluster;
+        mcgrp->id = RD_KAFKAP_STR_DUP(GroupId);
+        mcgrp->protocol_type = RD_KAFKAP_STR_DUP(ProtocolType);
+        mcgrp->state = RD_KAFKA_MOCK_CGRP_STATE_EMPTY;
+        TAILQ_INIT(&mcgrp->members);
+
+        TAILQ_INSERT_TAIL(&mcluster->cgrps, mcgrp, link);
+
+        return mcgrp;
+}
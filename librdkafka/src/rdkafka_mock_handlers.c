@@ -0,0 +1,1197 @@
+/*
+ * librdkafka - Apache Kafka C library
+ *
+ * Copyright (c) 2019 Magnus Edenhill
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Mock cluster protocol request handlers
+ *
+ * Each handler parses the request and enqueues a response on the
+ * connection. Handlers return 0 on success or -1 if the request could not
+ * be parsed, in which case the connection is closed.
+ */
+
+#include "rd.h"
+#include "rdkafka_int.h"
+#include "rdkafka_mock.h"
+#include "rdkafka_mock_int.h"
+
+
+/* Request parse failures are not logged (there is no rkb to log to),
+ * the connection is closed instead. */
+#define RD_KAFKA_MOCK_LOG_DECODE_ERRORS 0
+
+
+/**
+ * @brief Write a parsed (non-serialized) Kafka string to \p rkbuf.
+ */
+static RD_INLINE void
+rd_kafka_mock_buf_write_kstr (rd_kafka_buf_t *rkbuf,
+                              const rd_kafkap_str_t *kstr) {
+        rd_kafka_buf_write_str(rkbuf, kstr->str, RD_KAFKAP_STR_LEN(kstr));
+}
+
+
+/**
+ * @brief Handle ProduceRequest
+ */
+static int rd_kafka_mock_handle_Produce (rd_kafka_mock_connection_t *mconn,
+                                         rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        int16_t ApiVersion = rkbuf->rkbuf_reqhdr.ApiVersion;
+        int32_t TopicsCnt;
+        rd_kafkap_str_t TransactionalId = RD_KAFKAP_STR_INITIALIZER;
+        int16_t Acks;
+        int32_t TimeoutMs;
+
+        if (ApiVersion >= 3)
+                rd_kafka_buf_read_str(rkbuf, &TransactionalId);
+        rd_kafka_buf_read_i16(rkbuf, &Acks);
+        rd_kafka_buf_read_i32(rkbuf, &TimeoutMs);
+        rd_kafka_buf_read_i32(rkbuf, &TopicsCnt);
+
+        /* Response: #Topics */
+        rd_kafka_buf_write_i32(resp, TopicsCnt);
+
+        while (TopicsCnt-- > 0) {
+                rd_kafkap_str_t Topic;
+                int32_t PartitionCnt;
+                rd_kafka_mock_topic_t *mtopic;
+
+                rd_kafka_buf_read_str(rkbuf, &Topic);
+                rd_kafka_buf_read_i32(rkbuf, &PartitionCnt);
+
+                mtopic = rd_kafka_mock_topic_find_by_kstr(mcluster, &Topic);
+
+                /* Response: Topic */
+                rd_kafka_mock_buf_write_kstr(resp, &Topic);
+                /* Response: #Partitions */
+                rd_kafka_buf_write_i32(resp, PartitionCnt);
+
+                while (PartitionCnt-- > 0) {
+                        int32_t Partition;
+                        rd_kafka_mock_partition_t *mpart;
+                        rd_kafkap_bytes_t records;
+                        rd_kafka_resp_err_t err;
+                        int64_t BaseOffset = -1;
+
+                        rd_kafka_buf_read_i32(rkbuf, &Partition);
+                        rd_kafka_buf_read_bytes(rkbuf, &records);
+
+                        mpart = rd_kafka_mock_partition_find(mtopic,
+                                                             Partition);
+
+                        if (!mpart)
+                                err = RD_KAFKA_RESP_ERR_UNKNOWN_TOPIC_OR_PART;
+                        else if (mpart->leader != mconn->broker)
+                                err = RD_KAFKA_RESP_ERR_NOT_LEADER_FOR_PARTITION;
+                        else
+                                err = rd_kafka_mock_partition_log_append(
+                                        mpart, &records, &BaseOffset);
+
+                        /* Response: Partition */
+                        rd_kafka_buf_write_i32(resp, Partition);
+                        /* Response: ErrorCode */
+                        rd_kafka_buf_write_i16(resp, err);
+                        /* Response: BaseOffset */
+                        rd_kafka_buf_write_i64(resp, BaseOffset);
+
+                        if (ApiVersion >= 2) {
+                                /* Response: LogAppendTime: not used */
+                                rd_kafka_buf_write_i64(resp, -1);
+                        }
+
+                        if (ApiVersion >= 5) {
+                                /* Response: LogStartOffset */
+                                rd_kafka_buf_write_i64(
+                                        resp, mpart ? mpart->start_offset : -1);
+                        }
+                }
+        }
+
+        if (ApiVersion >= 1) {
+                /* Response: ThrottleTime */
+                rd_kafka_buf_write_i32(resp, 0);
+        }
+
+        /* No response is sent for acks=0 */
+        if (Acks == 0)
+                rd_kafka_buf_destroy(resp);
+        else
+                rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+
+/**
+ * @brief Handle FetchRequest
+ *
+ * If less than MinBytes are available the request is parked on the
+ * connection and retried when new messages are produced or MaxWait
+ * expires.
+ */
+static int rd_kafka_mock_handle_Fetch (rd_kafka_mock_connection_t *mconn,
+                                       rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        int16_t ApiVersion = rkbuf->rkbuf_reqhdr.ApiVersion;
+        size_t body_of = rd_slice_offset(&rkbuf->rkbuf_reader);
+        rd_ts_t now = rd_clock();
+        int32_t ReplicaId, MaxWait, MinBytes, MaxBytes = -1;
+        int32_t SessionId = 0, Epoch, TopicsCnt;
+        int8_t IsolationLevel;
+        size_t totsize = 0;
+        rd_bool_t has_err = rd_false;
+
+        rd_kafka_buf_read_i32(rkbuf, &ReplicaId);
+        rd_kafka_buf_read_i32(rkbuf, &MaxWait);
+        rd_kafka_buf_read_i32(rkbuf, &MinBytes);
+        if (ApiVersion >= 3)
+                rd_kafka_buf_read_i32(rkbuf, &MaxBytes);
+        if (ApiVersion >= 4)
+                rd_kafka_buf_read_i8(rkbuf, &IsolationLevel);
+        if (ApiVersion >= 7) {
+                rd_kafka_buf_read_i32(rkbuf, &SessionId);
+                rd_kafka_buf_read_i32(rkbuf, &Epoch);
+        }
+
+        if (!mconn->fetch_deadline)
+                mconn->fetch_deadline = now + ((rd_ts_t)MaxWait * 1000);
+
+        if (ApiVersion >= 1) {
+                /* Response: ThrottleTime */
+                rd_kafka_buf_write_i32(resp, 0);
+        }
+
+        if (ApiVersion >= 7) {
+                /* Response: ErrorCode */
+                rd_kafka_buf_write_i16(resp, RD_KAFKA_RESP_ERR_NO_ERROR);
+                /* Response: SessionId: fetch sessions are not supported */
+                rd_kafka_buf_write_i32(resp, 0);
+        }
+
+        rd_kafka_buf_read_i32(rkbuf, &TopicsCnt);
+
+        /* Response: #Topics */
+        rd_kafka_buf_write_i32(resp, TopicsCnt);
+
+        while (TopicsCnt-- > 0) {
+                rd_kafkap_str_t Topic;
+                int32_t PartitionCnt;
+                rd_kafka_mock_topic_t *mtopic;
+
+                rd_kafka_buf_read_str(rkbuf, &Topic);
+                rd_kafka_buf_read_i32(rkbuf, &PartitionCnt);
+
+                mtopic = rd_kafka_mock_topic_find_by_kstr(mcluster, &Topic);
+
+                /* Response: Topic */
+                rd_kafka_mock_buf_write_kstr(resp, &Topic);
+                /* Response: #Partitions */
+                rd_kafka_buf_write_i32(resp, PartitionCnt);
+
+                while (PartitionCnt-- > 0) {
+                        int32_t Partition, CurrentLeaderEpoch, PartMaxBytes;
+                        int64_t FetchOffset, LogStartOffset;
+                        rd_kafka_mock_partition_t *mpart;
+                        const rd_kafka_mock_msgset_t *mset = NULL;
+                        rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
+                        size_t partsize = 0;
+
+                        rd_kafka_buf_read_i32(rkbuf, &Partition);
+                        if (ApiVersion >= 9)
+                                rd_kafka_buf_read_i32(rkbuf,
+                                                      &CurrentLeaderEpoch);
+                        rd_kafka_buf_read_i64(rkbuf, &FetchOffset);
+                        if (ApiVersion >= 5)
+                                rd_kafka_buf_read_i64(rkbuf, &LogStartOffset);
+                        rd_kafka_buf_read_i32(rkbuf, &PartMaxBytes);
+
+                        mpart = rd_kafka_mock_partition_find(mtopic,
+                                                             Partition);
+
+                        if (!mpart)
+                                err = RD_KAFKA_RESP_ERR_UNKNOWN_TOPIC_OR_PART;
+                        else if (mpart->leader != mconn->broker)
+                                err = RD_KAFKA_RESP_ERR_NOT_LEADER_FOR_PARTITION;
+                        else if (FetchOffset < mpart->start_offset ||
+                                 FetchOffset > mpart->end_offset)
+                                err = RD_KAFKA_RESP_ERR_OFFSET_OUT_OF_RANGE;
+                        else
+                                mset = rd_kafka_mock_msgset_find(mpart,
+                                                                 FetchOffset);
+
+                        if (err)
+                                has_err = rd_true;
+
+                        /* Response: Partition */
+                        rd_kafka_buf_write_i32(resp, Partition);
+                        /* Response: ErrorCode */
+                        rd_kafka_buf_write_i16(resp, err);
+                        /* Response: HighwaterMark */
+                        rd_kafka_buf_write_i64(resp,
+                                               mpart ? mpart->end_offset : -1);
+
+                        if (ApiVersion >= 4) {
+                                /* Response: LastStableOffset */
+                                rd_kafka_buf_write_i64(
+                                        resp, mpart ? mpart->end_offset : -1);
+                        }
+
+                        if (ApiVersion >= 5) {
+                                /* Response: LogStartOffset */
+                                rd_kafka_buf_write_i64(
+                                        resp,
+                                        mpart ? mpart->start_offset : -1);
+                        }
+
+                        if (ApiVersion >= 4) {
+                                /* Response: #AbortedTransactions */
+                                rd_kafka_buf_write_i32(resp, 0);
+                        }
+
+                        /* Response: Records: the size is updated below.
+                         * At least one MessageSet is returned, even if it
+                         * exceeds the partition or request max bytes,
+                         * to guarantee progress. */
+                        rd_kafka_buf_write_i32(resp, 0);
+
+                        for ( ; mset ; mset = TAILQ_NEXT(mset, link)) {
+                                size_t len = (size_t)mset->bytes.len;
+
+                                if (partsize > 0 &&
+                                    (partsize + len >
+                                     (size_t)RD_MAX(PartMaxBytes, 0) ||
+                                     (MaxBytes != -1 &&
+                                      totsize + len > (size_t)MaxBytes)))
+                                        break;
+
+                                rd_kafka_buf_write(resp, mset->bytes.data,
+                                                   len);
+                                partsize += len;
+                                totsize += len;
+                        }
+
+                        rd_kafka_buf_update_i32(
+                                resp,
+                                rd_buf_write_pos(&resp->rkbuf_buf) -
+                                partsize - 4,
+                                (int32_t)partsize);
+                }
+        }
+
+        if (ApiVersion >= 7) {
+                /* ForgottenTopics are ignored: no fetch sessions */
+                int32_t ForgottenTopicCnt;
+                rd_kafka_buf_read_i32(rkbuf, &ForgottenTopicCnt);
+                while (ForgottenTopicCnt-- > 0) {
+                        int32_t ForgottenPartitionCnt;
+                        rd_kafka_buf_skip_str(rkbuf);
+                        rd_kafka_buf_read_i32(rkbuf, &ForgottenPartitionCnt);
+                        rd_kafka_buf_skip(rkbuf,
+                                          (size_t)RD_MAX(0,
+                                                         ForgottenPartitionCnt)
+                                          * 4);
+                }
+        }
+
+        if (!has_err && totsize < (size_t)RD_MAX(MinBytes, 0) &&
+            now < mconn->fetch_deadline) {
+                /* Not enough data yet: park the request until more
+                 * data is produced or MaxWait expires. */
+                rd_kafka_buf_destroy(resp);
+                rd_kafka_buf_keep(rkbuf);
+                if (mconn->fetch_req)
+                        rd_kafka_buf_destroy(mconn->fetch_req);
+                mconn->fetch_req = rkbuf;
+                mconn->fetch_req_of = body_of;
+                return 0;
+        }
+
+        mconn->fetch_deadline = 0;
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        mconn->fetch_deadline = 0;
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+
+/**
+ * @brief Handle ListOffsets (OffsetRequest)
+ */
+static int rd_kafka_mock_handle_ListOffset (rd_kafka_mock_connection_t *mconn,
+                                            rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        int16_t ApiVersion = rkbuf->rkbuf_reqhdr.ApiVersion;
+        int32_t ReplicaId, TopicsCnt;
+
+        rd_kafka_buf_read_i32(rkbuf, &ReplicaId);
+        rd_kafka_buf_read_i32(rkbuf, &TopicsCnt);
+
+        /* Response: #Topics */
+        rd_kafka_buf_write_i32(resp, TopicsCnt);
+
+        while (TopicsCnt-- > 0) {
+                rd_kafkap_str_t Topic;
+                int32_t PartitionCnt;
+                rd_kafka_mock_topic_t *mtopic;
+
+                rd_kafka_buf_read_str(rkbuf, &Topic);
+                rd_kafka_buf_read_i32(rkbuf, &PartitionCnt);
+
+                mtopic = rd_kafka_mock_topic_find_by_kstr(mcluster, &Topic);
+
+                /* Response: Topic */
+                rd_kafka_mock_buf_write_kstr(resp, &Topic);
+                /* Response: #Partitions */
+                rd_kafka_buf_write_i32(resp, PartitionCnt);
+
+                while (PartitionCnt-- > 0) {
+                        int32_t Partition, MaxNumOffsets;
+                        int64_t Timestamp, Offset = -1;
+                        rd_kafka_mock_partition_t *mpart;
+                        rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
+
+                        rd_kafka_buf_read_i32(rkbuf, &Partition);
+                        rd_kafka_buf_read_i64(rkbuf, &Timestamp);
+                        if (ApiVersion == 0)
+                                rd_kafka_buf_read_i32(rkbuf, &MaxNumOffsets);
+
+                        mpart = rd_kafka_mock_partition_find(mtopic,
+                                                             Partition);
+
+                        if (!mpart)
+                                err = RD_KAFKA_RESP_ERR_UNKNOWN_TOPIC_OR_PART;
+                        else if (mpart->leader != mconn->broker)
+                                err = RD_KAFKA_RESP_ERR_NOT_LEADER_FOR_PARTITION;
+                        else if (Timestamp == RD_KAFKA_OFFSET_END)
+                                Offset = mpart->end_offset;
+                        else if (Timestamp == RD_KAFKA_OFFSET_BEGINNING)
+                                Offset = mpart->start_offset;
+                        else if (Timestamp < 0)
+                                err = RD_KAFKA_RESP_ERR_OFFSET_OUT_OF_RANGE;
+                        else
+                                Offset = rd_kafka_mock_partition_offset_for_time(
+                                        mpart, Timestamp);
+
+                        /* Response: Partition */
+                        rd_kafka_buf_write_i32(resp, Partition);
+                        /* Response: ErrorCode */
+                        rd_kafka_buf_write_i16(resp, err);
+
+                        if (ApiVersion == 0) {
+                                /* Response: #OldStyleOffsets */
+                                rd_kafka_buf_write_i32(resp,
+                                                       Offset != -1 ? 1 : 0);
+                                /* Response: OldStyleOffsets[0] */
+                                if (Offset != -1)
+                                        rd_kafka_buf_write_i64(resp, Offset);
+                        } else {
+                                /* Response: Timestamp (FIXME) */
+                                rd_kafka_buf_write_i64(resp, -1);
+                                /* Response: Offset */
+                                rd_kafka_buf_write_i64(resp, Offset);
+                        }
+                }
+        }
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+/**
+ * @returns the error to return if this broker is not the coordinator
+ *          for \p GroupId, else NO_ERROR.
+ */
+static rd_kafka_resp_err_t
+rd_kafka_mock_check_coord (rd_kafka_mock_connection_t *mconn,
+                           const rd_kafkap_str_t *GroupId) {
+        if (RD_KAFKAP_STR_LEN(GroupId) == 0)
+                return RD_KAFKA_RESP_ERR_INVALID_GROUP_ID;
+        if (rd_kafka_mock_cluster_get_coord(mconn->broker->cluster,
+                                            GroupId) != mconn->broker)
+                return RD_KAFKA_RESP_ERR_NOT_COORDINATOR_FOR_GROUP;
+        return RD_KAFKA_RESP_ERR_NO_ERROR;
+}
+
+
+/**
+ * @brief Handle OffsetFetch (fetch committed offsets)
+ */
+static int rd_kafka_mock_handle_OffsetFetch (rd_kafka_mock_connection_t *mconn,
+                                             rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        rd_kafkap_str_t GroupId;
+        rd_kafka_resp_err_t coord_err;
+        int32_t TopicsCnt;
+
+        rd_kafka_buf_read_str(rkbuf, &GroupId);
+        rd_kafka_buf_read_i32(rkbuf, &TopicsCnt);
+
+        coord_err = rd_kafka_mock_check_coord(mconn, &GroupId);
+
+        /* Response: #Topics */
+        rd_kafka_buf_write_i32(resp, TopicsCnt);
+
+        while (TopicsCnt-- > 0) {
+                rd_kafkap_str_t Topic;
+                int32_t PartitionCnt;
+                rd_kafka_mock_topic_t *mtopic;
+
+                rd_kafka_buf_read_str(rkbuf, &Topic);
+                rd_kafka_buf_read_i32(rkbuf, &PartitionCnt);
+
+                mtopic = rd_kafka_mock_topic_find_by_kstr(mcluster, &Topic);
+
+                /* Response: Topic */
+                rd_kafka_mock_buf_write_kstr(resp, &Topic);
+                /* Response: #Partitions */
+                rd_kafka_buf_write_i32(resp, PartitionCnt);
+
+                while (PartitionCnt-- > 0) {
+                        int32_t Partition;
+                        rd_kafka_mock_partition_t *mpart;
+                        const rd_kafka_mock_committed_offset_t *coff = NULL;
+                        rd_kafka_resp_err_t err = coord_err;
+
+                        rd_kafka_buf_read_i32(rkbuf, &Partition);
+
+                        mpart = rd_kafka_mock_partition_find(mtopic,
+                                                             Partition);
+                        if (!err && !mpart)
+                                err = RD_KAFKA_RESP_ERR_UNKNOWN_TOPIC_OR_PART;
+
+                        if (!err)
+                                coff = rd_kafka_mock_committed_offset_find(
+                                        mpart, &GroupId);
+
+                        /* Response: Partition */
+                        rd_kafka_buf_write_i32(resp, Partition);
+                        /* Response: CommittedOffset */
+                        rd_kafka_buf_write_i64(resp, coff ? coff->offset : -1);
+                        /* Response: Metadata */
+                        if (coff && coff->metadata)
+                                rd_kafka_buf_write_kstr(resp, coff->metadata);
+                        else
+                                rd_kafka_buf_write_str(resp, "", 0);
+                        /* Response: ErrorCode */
+                        rd_kafka_buf_write_i16(resp, err);
+                }
+        }
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+
+/**
+ * @brief Handle OffsetCommit
+ */
+static int rd_kafka_mock_handle_OffsetCommit (rd_kafka_mock_connection_t *mconn,
+                                              rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        int16_t ApiVersion = rkbuf->rkbuf_reqhdr.ApiVersion;
+        rd_kafkap_str_t GroupId, MemberId = RD_KAFKAP_STR_INITIALIZER;
+        int32_t GenerationId = -1, TopicsCnt;
+        rd_kafka_resp_err_t all_err;
+
+        rd_kafka_buf_read_str(rkbuf, &GroupId);
+
+        if (ApiVersion >= 1) {
+                rd_kafka_buf_read_i32(rkbuf, &GenerationId);
+                rd_kafka_buf_read_str(rkbuf, &MemberId);
+        }
+
+        if (ApiVersion >= 2 && ApiVersion <= 4) {
+                int64_t RetentionTimeMs;
+                rd_kafka_buf_read_i64(rkbuf, &RetentionTimeMs);
+        }
+
+        rd_kafka_buf_read_i32(rkbuf, &TopicsCnt);
+
+        all_err = rd_kafka_mock_check_coord(mconn, &GroupId);
+
+        /* Commits outside of a group membership (GenerationId -1)
+         * are always accepted. */
+        if (!all_err && GenerationId != -1) {
+                rd_kafka_mock_cgrp_t *mcgrp;
+
+                mcgrp = rd_kafka_mock_cgrp_find(mcluster, &GroupId);
+                if (!mcgrp)
+                        all_err = RD_KAFKA_RESP_ERR_UNKNOWN_MEMBER_ID;
+                else
+                        all_err = rd_kafka_mock_cgrp_check_state(
+                                mcgrp,
+                                rd_kafka_mock_cgrp_member_find(mcgrp,
+                                                               &MemberId),
+                                rkbuf, GenerationId);
+        }
+
+        /* Response: #Topics */
+        rd_kafka_buf_write_i32(resp, TopicsCnt);
+
+        while (TopicsCnt-- > 0) {
+                rd_kafkap_str_t Topic;
+                int32_t PartitionCnt;
+                rd_kafka_mock_topic_t *mtopic;
+
+                rd_kafka_buf_read_str(rkbuf, &Topic);
+                rd_kafka_buf_read_i32(rkbuf, &PartitionCnt);
+
+                mtopic = rd_kafka_mock_topic_find_by_kstr(mcluster, &Topic);
+
+                /* Response: Topic */
+                rd_kafka_mock_buf_write_kstr(resp, &Topic);
+                /* Response: #Partitions */
+                rd_kafka_buf_write_i32(resp, PartitionCnt);
+
+                while (PartitionCnt-- > 0) {
+                        int32_t Partition;
+                        rd_kafka_mock_partition_t *mpart;
+                        rd_kafka_resp_err_t err = all_err;
+                        int64_t CommittedOffset;
+                        rd_kafkap_str_t Metadata;
+
+                        rd_kafka_buf_read_i32(rkbuf, &Partition);
+                        rd_kafka_buf_read_i64(rkbuf, &CommittedOffset);
+
+                        if (ApiVersion == 1) {
+                                int64_t CommitTimestamp;
+                                rd_kafka_buf_read_i64(rkbuf, &CommitTimestamp);
+                        }
+
+                        rd_kafka_buf_read_str(rkbuf, &Metadata);
+
+                        mpart = rd_kafka_mock_partition_find(mtopic,
+                                                             Partition);
+                        if (!err && !mpart)
+                                err = RD_KAFKA_RESP_ERR_UNKNOWN_TOPIC_OR_PART;
+
+                        if (!err)
+                                rd_kafka_mock_commit_offset(mpart, &GroupId,
+                                                            CommittedOffset,
+                                                            &Metadata);
+
+                        /* Response: Partition */
+                        rd_kafka_buf_write_i32(resp, Partition);
+                        /* Response: ErrorCode */
+                        rd_kafka_buf_write_i16(resp, err);
+                }
+        }
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+
+/**
+ * @brief Write a Metadata topic (and its partitions) to \p resp.
+ */
+static void
+rd_kafka_mock_buf_write_Metadata_Topic (rd_kafka_buf_t *resp,
+                                        int16_t ApiVersion,
+                                        const rd_kafkap_str_t *Topic,
+                                        const rd_kafka_mock_topic_t *mtopic,
+                                        rd_kafka_resp_err_t err) {
+        int i;
+
+        /* Response: Topics.ErrorCode */
+        rd_kafka_buf_write_i16(resp, err);
+        /* Response: Topics.Name */
+        rd_kafka_mock_buf_write_kstr(resp, Topic);
+        if (ApiVersion >= 1) {
+                /* Response: Topics.IsInternal */
+                rd_kafka_buf_write_i8(resp, 0);
+        }
+        /* Response: Topics.#Partitions */
+        rd_kafka_buf_write_i32(resp, mtopic ? mtopic->partition_cnt : 0);
+
+        for (i = 0 ; mtopic && i < mtopic->partition_cnt ; i++) {
+                const rd_kafka_mock_partition_t *mpart =
+                        &mtopic->partitions[i];
+                int r;
+
+                /* Response: ..Partitions.ErrorCode */
+                rd_kafka_buf_write_i16(resp, 0);
+                /* Response: ..Partitions.PartitionIndex */
+                rd_kafka_buf_write_i32(resp, mpart->id);
+                /* Response: ..Partitions.Leader */
+                rd_kafka_buf_write_i32(resp, mpart->leader->id);
+
+                /* Response: ..Partitions.#ReplicaNodes */
+                rd_kafka_buf_write_i32(resp, mpart->replica_cnt);
+                for (r = 0 ; r < mpart->replica_cnt ; r++)
+                        rd_kafka_buf_write_i32(resp, mpart->replicas[r]->id);
+
+                /* Response: ..Partitions.#IsrNodes: all replicas in-sync */
+                rd_kafka_buf_write_i32(resp, mpart->replica_cnt);
+                for (r = 0 ; r < mpart->replica_cnt ; r++)
+                        rd_kafka_buf_write_i32(resp, mpart->replicas[r]->id);
+        }
+}
+
+
+/**
+ * @brief Handle MetadataRequest
+ */
+static int rd_kafka_mock_handle_Metadata (rd_kafka_mock_connection_t *mconn,
+                                          rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        int16_t ApiVersion = rkbuf->rkbuf_reqhdr.ApiVersion;
+        const rd_kafka_mock_broker_t *mrkb;
+        rd_bool_t list_all_topics = rd_false;
+        int32_t TopicsCnt;
+        int i;
+
+        /* Response: #Brokers */
+        rd_kafka_buf_write_i32(resp, mcluster->broker_cnt);
+
+        TAILQ_FOREACH(mrkb, &mcluster->brokers, link) {
+                /* Response: Brokers.Nodeid */
+                rd_kafka_buf_write_i32(resp, mrkb->id);
+                /* Response: Brokers.Host */
+                rd_kafka_buf_write_str(resp, mrkb->advertised_listener, -1);
+                /* Response: Brokers.Port */
+                rd_kafka_buf_write_i32(resp, mrkb->port);
+                if (ApiVersion >= 1) {
+                        /* Response: Brokers.Rack */
+                        rd_kafka_buf_write_str(resp, NULL, -1);
+                }
+        }
+
+        if (ApiVersion >= 2) {
+                /* Response: ClusterId */
+                rd_kafka_buf_write_str(resp, mcluster->id, -1);
+        }
+
+        if (ApiVersion >= 1) {
+                /* Response: ControllerId */
+                rd_kafka_buf_write_i32(resp, mcluster->controller_id);
+        }
+
+        /* #Topics */
+        rd_kafka_buf_read_i32(rkbuf, &TopicsCnt);
+
+        if (TopicsCnt > 0) {
+                /* Response: #Topics */
+                rd_kafka_buf_write_i32(resp, TopicsCnt);
+        } else if ((ApiVersion >= 1 && TopicsCnt == -1) ||
+                   (ApiVersion == 0 && TopicsCnt == 0)) {
+                /* All topics */
+                list_all_topics = rd_true;
+                /* Response: #Topics */
+                rd_kafka_buf_write_i32(resp, mcluster->topic_cnt);
+        } else {
+                /* No topics */
+                rd_kafka_buf_write_i32(resp, 0);
+        }
+
+        for (i = 0 ; i < TopicsCnt ; i++) {
+                rd_kafkap_str_t Topic;
+                rd_kafka_mock_topic_t *mtopic;
+                rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
+
+                rd_kafka_buf_read_str(rkbuf, &Topic);
+
+                /* Topics are auto-created, as with the broker default
+                 * auto.create.topics.enable=true */
+                mtopic = rd_kafka_mock_topic_auto_create(mcluster, &Topic);
+                if (!mtopic)
+                        err = RD_KAFKA_RESP_ERR_UNKNOWN_TOPIC_OR_PART;
+
+                rd_kafka_mock_buf_write_Metadata_Topic(resp, ApiVersion,
+                                                       &Topic, mtopic, err);
+        }
+
+        if (list_all_topics) {
+                const rd_kafka_mock_topic_t *mtopic;
+
+                TAILQ_FOREACH(mtopic, &mcluster->topics, link) {
+                        rd_kafkap_str_t Topic = {
+                                .str = mtopic->name,
+                                .len = (int)strlen(mtopic->name)
+                        };
+
+                        rd_kafka_mock_buf_write_Metadata_Topic(
+                                resp, ApiVersion, &Topic, mtopic,
+                                RD_KAFKA_RESP_ERR_NO_ERROR);
+                }
+        }
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+/**
+ * @brief Handle FindCoordinator (GroupCoordinator) request
+ */
+static int
+rd_kafka_mock_handle_FindCoordinator (rd_kafka_mock_connection_t *mconn,
+                                      rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        rd_kafkap_str_t Key;
+        const rd_kafka_mock_broker_t *mrkb;
+
+        rd_kafka_buf_read_str(rkbuf, &Key);
+
+        mrkb = rd_kafka_mock_cluster_get_coord(mcluster, &Key);
+
+        /* Response: ErrorCode */
+        rd_kafka_buf_write_i16(resp, RD_KAFKA_RESP_ERR_NO_ERROR);
+        /* Response: NodeId, Host, Port */
+        rd_kafka_buf_write_i32(resp, mrkb->id);
+        rd_kafka_buf_write_str(resp, mrkb->advertised_listener, -1);
+        rd_kafka_buf_write_i32(resp, mrkb->port);
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+/**
+ * @brief Handle JoinGroupRequest
+ *
+ * The response is sent by the group coordinator once the join completes.
+ */
+static int rd_kafka_mock_handle_JoinGroup (rd_kafka_mock_connection_t *mconn,
+                                           rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        int16_t ApiVersion = rkbuf->rkbuf_reqhdr.ApiVersion;
+        rd_kafkap_str_t GroupId, MemberId, ProtocolType;
+        int32_t SessionTimeoutMs, RebalanceTimeoutMs = -1;
+        int32_t ProtocolCnt = 0, i;
+        rd_kafka_mock_cgrp_proto_t *protos = NULL;
+        rd_kafka_mock_cgrp_t *mcgrp;
+        rd_kafka_resp_err_t err;
+
+        rd_kafka_buf_read_str(rkbuf, &GroupId);
+        rd_kafka_buf_read_i32(rkbuf, &SessionTimeoutMs);
+        if (ApiVersion >= 1)
+                rd_kafka_buf_read_i32(rkbuf, &RebalanceTimeoutMs);
+        rd_kafka_buf_read_str(rkbuf, &MemberId);
+        rd_kafka_buf_read_str(rkbuf, &ProtocolType);
+        rd_kafka_buf_read_i32(rkbuf, &ProtocolCnt);
+
+        if (ProtocolCnt < 0 || ProtocolCnt > 1000)
+                rd_kafka_buf_parse_fail(rkbuf,
+                                        "Invalid protocol count %"PRId32,
+                                        ProtocolCnt);
+
+        protos = rd_calloc(RD_MAX(ProtocolCnt, 1), sizeof(*protos));
+        for (i = 0 ; i < ProtocolCnt ; i++) {
+                rd_kafkap_str_t ProtocolName;
+                rd_kafkap_bytes_t Metadata;
+                rd_kafka_buf_read_str(rkbuf, &ProtocolName);
+                rd_kafka_buf_read_bytes(rkbuf, &Metadata);
+                protos[i].name = rd_kafkap_str_copy(&ProtocolName);
+                protos[i].metadata = rd_kafkap_bytes_copy(&Metadata);
+        }
+
+        if (ApiVersion >= 2) {
+                /* Response: ThrottleTime */
+                rd_kafka_buf_write_i32(resp, 0);
+        }
+
+        err = rd_kafka_mock_check_coord(mconn, &GroupId);
+
+        if (!err && (ProtocolCnt == 0 ||
+                     RD_KAFKAP_STR_IS_NULL(&ProtocolType)))
+                err = RD_KAFKA_RESP_ERR_INCONSISTENT_GROUP_PROTOCOL;
+
+        if (!err && SessionTimeoutMs <= 0)
+                err = RD_KAFKA_RESP_ERR_INVALID_SESSION_TIMEOUT;
+
+        if (!err) {
+                mcgrp = rd_kafka_mock_cgrp_get(mcluster, &GroupId,
+                                               &ProtocolType);
+                if (rd_kafkap_str_cmp_str(&ProtocolType,
+                                          mcgrp->protocol_type))
+                        err = RD_KAFKA_RESP_ERR_INCONSISTENT_GROUP_PROTOCOL;
+        }
+
+        if (!err) {
+                /* The coordinator owns the protocols and the response
+                 * from here on. */
+                err = rd_kafka_mock_cgrp_member_add(mcgrp, mconn, resp,
+                                                    &MemberId, protos,
+                                                    ProtocolCnt,
+                                                    SessionTimeoutMs);
+                if (!err)
+                        return 0;
+        } else {
+                rd_kafka_mock_cgrp_protos_destroy(protos, ProtocolCnt);
+        }
+
+        /* Error response */
+        /* Response: ErrorCode */
+        rd_kafka_buf_write_i16(resp, err);
+        /* Response: GenerationId */
+        rd_kafka_buf_write_i32(resp, -1);
+        /* Response: ProtocolName */
+        rd_kafka_buf_write_str(resp, NULL, -1);
+        /* Response: LeaderId */
+        rd_kafka_buf_write_str(resp, NULL, -1);
+        /* Response: MemberId */
+        rd_kafka_buf_write_str(resp, NULL, -1);
+        /* Response: #Members */
+        rd_kafka_buf_write_i32(resp, 0);
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        if (protos)
+                rd_kafka_mock_cgrp_protos_destroy(protos, ProtocolCnt);
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+/**
+ * @brief Handle SyncGroupRequest
+ *
+ * The response is sent by the group coordinator once the leader has
+ * provided the assignments.
+ */
+static int rd_kafka_mock_handle_SyncGroup (rd_kafka_mock_connection_t *mconn,
+                                           rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        rd_kafkap_str_t GroupId, MemberId;
+        int32_t GenerationId, AssignmentCnt;
+        rd_kafka_mock_cgrp_t *mcgrp = NULL;
+        rd_kafka_mock_cgrp_member_t *member = NULL;
+        rd_kafka_resp_err_t err;
+
+        rd_kafka_buf_read_str(rkbuf, &GroupId);
+        rd_kafka_buf_read_i32(rkbuf, &GenerationId);
+        rd_kafka_buf_read_str(rkbuf, &MemberId);
+        rd_kafka_buf_read_i32(rkbuf, &AssignmentCnt);
+
+        err = rd_kafka_mock_check_coord(mconn, &GroupId);
+
+        if (!err) {
+                mcgrp = rd_kafka_mock_cgrp_find(mcluster, &GroupId);
+                if (!mcgrp)
+                        err = RD_KAFKA_RESP_ERR_UNKNOWN_MEMBER_ID;
+        }
+
+        if (!err) {
+                member = rd_kafka_mock_cgrp_member_find(mcgrp, &MemberId);
+                err = rd_kafka_mock_cgrp_check_state(mcgrp, member, rkbuf,
+                                                     GenerationId);
+        }
+
+        if (!err)
+                rd_kafka_mock_cgrp_member_active(member);
+
+        /* Only the leader's assignments are used */
+        while (AssignmentCnt-- > 0) {
+                rd_kafkap_str_t MemberId2;
+                rd_kafkap_bytes_t Assignment;
+
+                rd_kafka_buf_read_str(rkbuf, &MemberId2);
+                rd_kafka_buf_read_bytes(rkbuf, &Assignment);
+
+                if (!err && member == mcgrp->leader)
+                        rd_kafka_mock_cgrp_member_assignment_set(
+                                mcgrp, &MemberId2, &Assignment);
+        }
+
+        if (!err) {
+                err = rd_kafka_mock_cgrp_member_sync_set(mcgrp, member,
+                                                         mconn, resp);
+                if (!err)
+                        return 0; /* Response will be sent when
+                                   * the leader has synced. */
+        }
+
+        /* Error response */
+        /* Response: ErrorCode */
+        rd_kafka_buf_write_i16(resp, err);
+        /* Response: MemberState */
+        rd_kafka_buf_write_bytes(resp, NULL, 0);
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+/**
+ * @brief Handle HeartbeatRequest
+ */
+static int rd_kafka_mock_handle_Heartbeat (rd_kafka_mock_connection_t *mconn,
+                                           rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        rd_kafkap_str_t GroupId, MemberId;
+        int32_t GenerationId;
+        rd_kafka_mock_cgrp_t *mcgrp;
+        rd_kafka_mock_cgrp_member_t *member = NULL;
+        rd_kafka_resp_err_t err;
+
+        rd_kafka_buf_read_str(rkbuf, &GroupId);
+        rd_kafka_buf_read_i32(rkbuf, &GenerationId);
+        rd_kafka_buf_read_str(rkbuf, &MemberId);
+
+        err = rd_kafka_mock_check_coord(mconn, &GroupId);
+
+        if (!err) {
+                mcgrp = rd_kafka_mock_cgrp_find(mcluster, &GroupId);
+                if (!mcgrp)
+                        err = RD_KAFKA_RESP_ERR_UNKNOWN_MEMBER_ID;
+                else {
+                        member = rd_kafka_mock_cgrp_member_find(mcgrp,
+                                                                &MemberId);
+                        err = rd_kafka_mock_cgrp_check_state(mcgrp, member,
+                                                             rkbuf,
+                                                             GenerationId);
+                }
+        }
+
+        /* A member still in the group is alive, even if it is
+         * told to rejoin. */
+        if (member)
+                rd_kafka_mock_cgrp_member_active(member);
+
+        /* Response: ErrorCode */
+        rd_kafka_buf_write_i16(resp, err);
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+/**
+ * @brief Handle LeaveGroupRequest
+ */
+static int rd_kafka_mock_handle_LeaveGroup (rd_kafka_mock_connection_t *mconn,
+                                            rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        rd_kafkap_str_t GroupId, MemberId;
+        rd_kafka_mock_cgrp_t *mcgrp;
+        rd_kafka_mock_cgrp_member_t *member = NULL;
+        rd_kafka_resp_err_t err;
+
+        rd_kafka_buf_read_str(rkbuf, &GroupId);
+        rd_kafka_buf_read_str(rkbuf, &MemberId);
+
+        err = rd_kafka_mock_check_coord(mconn, &GroupId);
+
+        if (!err) {
+                mcgrp = rd_kafka_mock_cgrp_find(mcluster, &GroupId);
+                if (mcgrp)
+                        member = rd_kafka_mock_cgrp_member_find(mcgrp,
+                                                                &MemberId);
+                if (!member)
+                        err = RD_KAFKA_RESP_ERR_UNKNOWN_MEMBER_ID;
+                else
+                        rd_kafka_mock_cgrp_member_leave(mcgrp, member);
+        }
+
+        /* Response: ErrorCode */
+        rd_kafka_buf_write_i16(resp, err);
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+/**
+ * @brief Handle InitProducerIdRequest
+ *
+ * Only the idempotent producer is supported, every request is assigned
+ * a new PID with epoch 0.
+ */
+static int
+rd_kafka_mock_handle_InitProducerId (rd_kafka_mock_connection_t *mconn,
+                                     rd_kafka_buf_t *rkbuf) {
+        const int log_decode_errors = RD_KAFKA_MOCK_LOG_DECODE_ERRORS;
+        rd_kafka_mock_cluster_t *mcluster = mconn->broker->cluster;
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        rd_kafkap_str_t TransactionalId;
+        int32_t TxnTimeoutMs;
+
+        rd_kafka_buf_read_str(rkbuf, &TransactionalId);
+        rd_kafka_buf_read_i32(rkbuf, &TxnTimeoutMs);
+
+        /* Response: ThrottleTime */
+        rd_kafka_buf_write_i32(resp, 0);
+        /* Response: ErrorCode */
+        rd_kafka_buf_write_i16(resp, RD_KAFKA_RESP_ERR_NO_ERROR);
+        /* Response: ProducerId */
+        rd_kafka_buf_write_i64(resp, mcluster->next_pid++);
+        /* Response: ProducerEpoch */
+        rd_kafka_buf_write_i16(resp, 0);
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+
+ err_parse:
+        rd_kafka_buf_destroy(resp);
+        return -1;
+}
+
+
+/**
+ * @brief Handle ApiVersionRequest
+ */
+static int rd_kafka_mock_handle_ApiVersion (rd_kafka_mock_connection_t *mconn,
+                                            rd_kafka_buf_t *rkbuf) {
+        rd_kafka_buf_t *resp = rd_kafka_mock_buf_new_response(rkbuf);
+        size_t of_ApiKeysCnt;
+        int cnt = 0;
+        int i;
+
+        /* Response: ErrorCode */
+        rd_kafka_buf_write_i16(resp, RD_KAFKA_RESP_ERR_NO_ERROR);
+
+        /* Response: #ApiKeys, updated below */
+        of_ApiKeysCnt = rd_kafka_buf_write_i32(resp, 0);
+
+        for (i = 0 ; i < RD_KAFKAP__NUM ; i++) {
+                if (!rd_kafka_mock_api_handlers[i].cb)
+                        continue;
+
+                /* Response: ApiKeys.ApiKey */
+                rd_kafka_buf_write_i16(resp, (int16_t)i);
+                /* Response: ApiKeys.MinVersion */
+                rd_kafka_buf_write_i16(resp,
+                                       rd_kafka_mock_api_handlers[i].
+                                       MinVersion);
+                /* Response: ApiKeys.MaxVersion */
+                rd_kafka_buf_write_i16(resp,
+                                       rd_kafka_mock_api_handlers[i].
+                                       MaxVersion);
+
+                cnt++;
+        }
+
+        rd_kafka_buf_update_i32(resp, of_ApiKeysCnt, cnt);
+
+        rd_kafka_mock_connection_send_response(mconn, resp);
+
+        return 0;
+}
+
+
+/**
+ * @brief Supported request types and their version ranges.
+ */
+const struct rd_kafka_mock_api_handler
+rd_kafka_mock_api_handlers[RD_KAFKAP__NUM] = {
+        [RD_KAFKAP_Produce] = { 3, 7, rd_kafka_mock_handle_Produce },
+        [RD_KAFKAP_Fetch] = { 4, 10, rd_kafka_mock_handle_Fetch },
+        [RD_KAFKAP_Offset] = { 0, 1, rd_kafka_mock_handle_ListOffset },
+        [RD_KAFKAP_OffsetFetch] = { 0, 1, rd_kafka_mock_handle_OffsetFetch },
+        [RD_KAFKAP_OffsetCommit] = { 0, 2, rd_kafka_mock_handle_OffsetCommit },
+        [RD_KAFKAP_ApiVersion] = { 0, 0, rd_kafka_mock_handle_ApiVersion },
+        [RD_KAFKAP_Metadata] = { 0, 2, rd_kafka_mock_handle_Metadata },
+        [RD_KAFKAP_GroupCoordinator] = { 0, 0,
+                                         rd_kafka_mock_handle_FindCoordinator },
+        [RD_KAFKAP_InitProducerId] = { 0, 1,
+                                       rd_kafka_mock_handle_InitProducerId },
+        [RD_KAFKAP_JoinGroup] = { 0, 2, rd_kafka_mock_handle_JoinGroup },
+        [RD_KAFKAP_Heartbeat] = { 0, 0, rd_kafka_mock_handle_Heartbeat },
+        [RD_KAFKAP_LeaveGroup] = { 0, 0, rd_kafka_mock_handle_LeaveGroup },
+        [RD_KAFKAP_SyncGroup] = { 0, 0, rd_kafka_mock_handle_SyncGroup },
+};
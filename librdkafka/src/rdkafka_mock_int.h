@@ -0,0 +1,337 @@
+/*
+ * librdkafka - Apache Kafka C library
+ *
+ * Copyright (c) 2019 Magnus Edenhill
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _RDKAFKA_MOCK_INT_H_
+#define _RDKAFKA_MOCK_INT_H_
+
+/**
+ * @name Mock cluster internals, all state is owned by the cluster thread
+ *       and protected by the cluster lock.
+ */
+
+
+/**
+ * @struct A stored MessageSet (RecordBatch) with offsets assigned.
+ */
+typedef struct rd_kafka_mock_msgset_s {
+        TAILQ_ENTRY(rd_kafka_mock_msgset_s) link;
+        int64_t first_offset;   /**< First offset in batch */
+        int64_t last_offset;    /**< Last offset in batch */
+        int64_t max_timestamp;  /**< MaxTimestamp from the batch header */
+        rd_kafkap_bytes_t bytes;/**< The raw MessageSet with BaseOffset
+                                 *   rewritten. The data is allocated along
+                                 *   with the struct. */
+} rd_kafka_mock_msgset_t;
+
+
+/**
+ * @struct Committed offset for a group and partition.
+ */
+typedef struct rd_kafka_mock_committed_offset_s {
+        TAILQ_ENTRY(rd_kafka_mock_committed_offset_s) link;
+        char *group;             /**< Consumer group */
+        int64_t offset;          /**< Committed offset */
+        rd_kafkap_str_t *metadata; /**< Metadata, may be NULL */
+} rd_kafka_mock_committed_offset_t;
+
+
+typedef struct rd_kafka_mock_partition_s {
+        TAILQ_HEAD(rd_kafka_mock_msgset_s_head,
+                   rd_kafka_mock_msgset_s) msgsets;
+        int     msgset_cnt;
+        size_t  size;            /**< Total size of msgsets */
+        int64_t start_offset;    /**< Log start offset */
+        int64_t end_offset;      /**< Log end offset (high watermark) */
+
+        int32_t id;
+        struct rd_kafka_mock_topic_s *topic;
+        struct rd_kafka_mock_broker_s *leader;
+        struct rd_kafka_mock_broker_s **replicas;
+        int     replica_cnt;
+
+        TAILQ_HEAD(, rd_kafka_mock_committed_offset_s) committed_offsets;
+} rd_kafka_mock_partition_t;
+
+
+typedef struct rd_kafka_mock_topic_s {
+        TAILQ_ENTRY(rd_kafka_mock_topic_s) link;
+        char *name;
+
+        rd_kafka_mock_partition_t *partitions;
+        int partition_cnt;
+
+        struct rd_kafka_mock_cluster_s *cluster;
+} rd_kafka_mock_topic_t;
+
+
+/**
+ * @struct A client connection to a mock broker.
+ */
+typedef struct rd_kafka_mock_connection_s {
+        TAILQ_ENTRY(rd_kafka_mock_connection_s) link;
+        int s;                           /**< Socket */
+        char peer[64];                   /**< Peer address, for logging */
+        rd_kafka_buf_t *rxbuf;           /**< Request being received */
+        TAILQ_HEAD(, rd_kafka_buf_s) outbufs; /**< Responses to send */
+
+        /**< A FetchRequest that could not yet be satisfied with MinBytes,
+         *   it is retried when new messages are produced or when
+         *   \c fetch_deadline is reached. */
+        rd_kafka_buf_t *fetch_req;
+        size_t fetch_req_of;             /**< Reader offset of the request
+                                          *   body, for re-parsing. */
+        rd_ts_t fetch_deadline;
+
+        struct rd_kafka_mock_broker_s *broker;
+} rd_kafka_mock_connection_t;
+
+
+typedef struct rd_kafka_mock_broker_s {
+        TAILQ_ENTRY(rd_kafka_mock_broker_s) link;
+        int32_t id;
+        char    advertised_listener[128];
+        int     port;
+        int     listen_s;                /**< Listen socket */
+
+        TAILQ_HEAD(, rd_kafka_mock_connection_s) connections;
+
+        struct rd_kafka_mock_cluster_s *cluster;
+} rd_kafka_mock_broker_t;
+
+
+/**
+ * @struct A protocol (assignor) supported by a group member.
+ */
+typedef struct rd_kafka_mock_cgrp_proto_s {
+        rd_kafkap_str_t *name;
+        rd_kafkap_bytes_t *metadata;
+} rd_kafka_mock_cgrp_proto_t;
+
+
+/**
+ * @struct A consumer group member.
+ */
+typedef struct rd_kafka_mock_cgrp_member_s {
+        TAILQ_ENTRY(rd_kafka_mock_cgrp_member_s) link;
+        char *id;                        /**< MemberId */
+        rd_ts_t ts_last_activity;        /**< Last Join/Sync/Heartbeat */
+        int session_timeout_ms;
+
+        /**< The member's supported protocols from JoinGroup */
+        rd_kafka_mock_cgrp_proto_t *protocols;
+        int protocol_cnt;
+
+        rd_kafkap_bytes_t *assignment;   /**< Assignment from the leader's
+                                          *   SyncGroup. */
+
+        /**< Pending Join- or SyncGroup response, awaiting the join or
+         *   sync to finish. Only one of these is set at any time. */
+        rd_kafka_buf_t *resp;
+        rd_kafka_mock_connection_t *conn; /**< Connection of \c resp */
+} rd_kafka_mock_cgrp_member_t;
+
+
+typedef enum {
+        RD_KAFKA_MOCK_CGRP_STATE_EMPTY,     /**< No members */
+        RD_KAFKA_MOCK_CGRP_STATE_JOINING,   /**< Members are joining */
+        RD_KAFKA_MOCK_CGRP_STATE_SYNCING,   /**< Awaiting leader's SyncGroup */
+        RD_KAFKA_MOCK_CGRP_STATE_UP,        /**< Group is stable */
+} rd_kafka_mock_cgrp_state_t;
+
+
+/**
+ * @struct A consumer group, handled by its coordinator broker.
+ */
+typedef struct rd_kafka_mock_cgrp_s {
+        TAILQ_ENTRY(rd_kafka_mock_cgrp_s) link;
+        struct rd_kafka_mock_cluster_s *cluster;
+        char *id;                        /**< Group id */
+        char *protocol_type;             /**< e.g., "consumer" */
+        char *protocol_name;             /**< Selected assignor */
+        int32_t generation_id;
+        rd_kafka_mock_cgrp_state_t state;
+        rd_ts_t ts_join_deadline;        /**< Members that have not re-joined
+                                          *   by this time are removed. */
+        rd_kafka_mock_cgrp_member_t *leader;
+        TAILQ_HEAD(, rd_kafka_mock_cgrp_member_s) members;
+        int member_cnt;
+        int last_member_id;              /**< For generating member ids */
+} rd_kafka_mock_cgrp_t;
+
+
+struct rd_kafka_mock_cluster_s {
+        char id[32];                     /**< ClusterId */
+        rd_kafka_t *rk;                  /**< For logging and config */
+
+        int32_t controller_id;           /**< ControllerId */
+
+        thrd_t thread;
+        mtx_t lock;
+        int run;                         /**< Cluster thread runs while set,
+                                          *   protected by lock. */
+        int wakeup_fds[2];               /**< Wakes up cluster thread */
+
+        TAILQ_HEAD(, rd_kafka_mock_broker_s) brokers;
+        int broker_cnt;
+
+        TAILQ_HEAD(, rd_kafka_mock_topic_s) topics;
+        int topic_cnt;
+
+        TAILQ_HEAD(, rd_kafka_mock_cgrp_s) cgrps;
+
+        char *bootstraps;                /**< bootstrap.servers */
+
+        int64_t next_pid;                /**< Next InitProducerId PID */
+
+        /**< Set when messages were produced, triggers a retry of
+         *   parked FetchRequests. */
+        int fetch_retry;
+
+        struct {
+                int partition_cnt;       /**< Auto topic create part cnt */
+                int replication_factor;  /**< Auto topic create repl factor */
+                size_t max_partition_bytes; /**< Oldest MessageSets are
+                                             *   dropped when a partition
+                                             *   log exceeds this size. */
+        } defaults;
+
+        /**< Poll set, rebuilt on each cluster thread loop */
+        struct pollfd *fds;
+        void **fd_opaques;               /**< Broker or connection of fds */
+        int fd_cnt;
+        int fd_size;
+};
+
+
+/**
+ * @brief Request handler function
+ */
+typedef int (rd_kafka_mock_request_handler_t) (
+        rd_kafka_mock_connection_t *mconn, rd_kafka_buf_t *rkbuf);
+
+struct rd_kafka_mock_api_handler {
+        int16_t MinVersion;
+        int16_t MaxVersion;
+        rd_kafka_mock_request_handler_t *cb;
+};
+
+extern const struct rd_kafka_mock_api_handler
+rd_kafka_mock_api_handlers[RD_KAFKAP__NUM];
+
+
+/**
+ * @name Cluster, topic and connection internals (rdkafka_mock.c)
+ */
+rd_kafka_mock_broker_t *
+rd_kafka_mock_cluster_get_coord (rd_kafka_mock_cluster_t *mcluster,
+                                 const rd_kafkap_str_t *key);
+
+rd_kafka_mock_topic_t *
+rd_kafka_mock_topic_find (const rd_kafka_mock_cluster_t *mcluster,
+                          const char *name);
+rd_kafka_mock_topic_t *
+rd_kafka_mock_topic_find_by_kstr (const rd_kafka_mock_cluster_t *mcluster,
+                                  const rd_kafkap_str_t *kname);
+rd_kafka_mock_topic_t *
+rd_kafka_mock_topic_auto_create (rd_kafka_mock_cluster_t *mcluster,
+                                 const rd_kafkap_str_t *kname);
+rd_kafka_mock_partition_t *
+rd_kafka_mock_partition_find (const rd_kafka_mock_topic_t *mtopic,
+                              int32_t partition);
+
+rd_kafka_resp_err_t
+rd_kafka_mock_partition_log_append (rd_kafka_mock_partition_t *mpart,
+                                    const rd_kafkap_bytes_t *bytes,
+                                    int64_t *BaseOffset);
+const rd_kafka_mock_msgset_t *
+rd_kafka_mock_msgset_find (const rd_kafka_mock_partition_t *mpart,
+                           int64_t offset);
+int64_t
+rd_kafka_mock_partition_offset_for_time (const rd_kafka_mock_partition_t *mpart,
+                                         int64_t timestamp);
+
+const rd_kafka_mock_committed_offset_t *
+rd_kafka_mock_committed_offset_find (const rd_kafka_mock_partition_t *mpart,
+                                     const rd_kafkap_str_t *group);
+void
+rd_kafka_mock_commit_offset (rd_kafka_mock_partition_t *mpart,
+                             const rd_kafkap_str_t *group, int64_t offset,
+                             const rd_kafkap_str_t *metadata);
+
+rd_kafka_buf_t *rd_kafka_mock_buf_new_response (const rd_kafka_buf_t *request);
+void rd_kafka_mock_connection_send_response (rd_kafka_mock_connection_t *mconn,
+                                             rd_kafka_buf_t *resp);
+
+
+/**
+ * @name Consumer group coordinator (rdkafka_mock_cgrp.c)
+ */
+rd_kafka_mock_cgrp_t *
+rd_kafka_mock_cgrp_find (rd_kafka_mock_cluster_t *mcluster,
+                         const rd_kafkap_str_t *GroupId);
+rd_kafka_mock_cgrp_t *
+rd_kafka_mock_cgrp_get (rd_kafka_mock_cluster_t *mcluster,
+                        const rd_kafkap_str_t *GroupId,
+                        const rd_kafkap_str_t *ProtocolType);
+rd_kafka_mock_cgrp_member_t *
+rd_kafka_mock_cgrp_member_find (const rd_kafka_mock_cgrp_t *mcgrp,
+                                const rd_kafkap_str_t *MemberId);
+rd_kafka_resp_err_t
+rd_kafka_mock_cgrp_check_state (rd_kafka_mock_cgrp_t *mcgrp,
+                                rd_kafka_mock_cgrp_member_t *member,
+                                const rd_kafka_buf_t *request,
+                                int32_t generation_id);
+rd_kafka_resp_err_t
+rd_kafka_mock_cgrp_member_add (rd_kafka_mock_cgrp_t *mcgrp,
+                               rd_kafka_mock_connection_t *mconn,
+                               rd_kafka_buf_t *resp,
+                               const rd_kafkap_str_t *MemberId,
+                               rd_kafka_mock_cgrp_proto_t *protos,
+                               int proto_cnt,
+                               int session_timeout_ms);
+rd_kafka_resp_err_t
+rd_kafka_mock_cgrp_member_sync_set (rd_kafka_mock_cgrp_t *mcgrp,
+                                    rd_kafka_mock_cgrp_member_t *member,
+                                    rd_kafka_mock_connection_t *mconn,
+                                    rd_kafka_buf_t *resp);
+void
+rd_kafka_mock_cgrp_member_assignment_set (rd_kafka_mock_cgrp_t *mcgrp,
+                                          const rd_kafkap_str_t *MemberId,
+                                          const rd_kafkap_bytes_t *assignment);
+void rd_kafka_mock_cgrp_member_leave (rd_kafka_mock_cgrp_t *mcgrp,
+                                      rd_kafka_mock_cgrp_member_t *member);
+void rd_kafka_mock_cgrp_member_active (rd_kafka_mock_cgrp_member_t *member);
+void rd_kafka_mock_cgrp_protos_destroy (rd_kafka_mock_cgrp_proto_t *protos,
+                                        int proto_cnt);
+void rd_kafka_mock_cgrps_connection_closed (rd_kafka_mock_cluster_t *mcluster,
+                                            rd_kafka_mock_connection_t *mconn);
+rd_ts_t rd_kafka_mock_cgrps_serve (rd_kafka_mock_cluster_t *mcluster,
+                                   rd_ts_t now);
+void rd_kafka_mock_cgrp_destroy (rd_kafka_mock_cgrp_t *mcgrp);
+
+#endif /* _RDKAFKA_MOCK_INT_H_ */
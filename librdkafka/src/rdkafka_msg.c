@@ -43,14 +43,253 @@
 
 #include <stdarg.h>
 
-void rd_kafka_msg_destroy (rd_kafka_t *rk, rd_kafka_msg_t *rkm) {
+/**
+ * @name Producer message pool
+ * @{
+ */
 
-	if (rkm->rkm_flags & RD_KAFKA_MSG_F_ACCOUNT) {
+/**
+ * @brief Initialize the message pool's size classes.
+ *        Slabs are allocated on demand.
+ */
+void rd_kafka_msgpool_init (rd_kafka_msgpool_t *pool) {
+        static const size_t inline_sizes[RD_KAFKA_MSGPOOL_CLASS_CNT] =
+                RD_KAFKA_MSGPOOL_INLINE_SIZES;
+        int i;
+
+        mtx_init(&pool->lock, mtx_plain);
+
+        for (i = 0 ; i < RD_KAFKA_MSGPOOL_CLASS_CNT ; i++) {
+                rd_kafka_msgpool_class_t *cls = &pool->classes[i];
+
+                cls->inline_size = inline_sizes[i];
+                cls->slot_size   = RD_ROUNDUP(sizeof(rd_kafka_msgpool_slot_t) +
+                                              sizeof(rd_kafka_msg_t) +
+                                              cls->inline_size, 16);
+                cls->slot_cnt    = (int)RD_MAX(RD_KAFKA_MSGPOOL_SLAB_SIZE /
+                                               cls->slot_size, 16);
+                TAILQ_INIT(&cls->slabs);
+                TAILQ_INIT(&cls->all);
+                cls->slab_cnt    = 0;
+                cls->empty_cnt   = 0;
+        }
+}
+
+
+/**
+ * @brief Free all slabs.
+ *
+ * @remark All pooled messages must have been destroyed.
+ */
+void rd_kafka_msgpool_destroy (rd_kafka_msgpool_t *pool) {
+        int i;
+
+        for (i = 0 ; i < RD_KAFKA_MSGPOOL_CLASS_CNT ; i++) {
+                rd_kafka_msgpool_class_t *cls = &pool->classes[i];
+                rd_kafka_msgpool_slab_t *slab;
+
+                while ((slab = TAILQ_FIRST(&cls->all))) {
+                        rd_dassert(slab->free_cnt == cls->slot_cnt);
+                        TAILQ_REMOVE(&cls->all, slab, all_link);
+                        rd_free(slab);
+                }
+        }
+
+        mtx_destroy(&pool->lock);
+}
+
+
+/**
+ * @returns the size class for a message with \p inline_len bytes of
+ *          key and copied payload, or -1 if it is too large to be pooled.
+ */
+static RD_INLINE int
+rd_kafka_msgpool_class_idx (const rd_kafka_msgpool_t *pool,
+                            size_t inline_len) {
+        int i;
+
+        for (i = 0 ; i < RD_KAFKA_MSGPOOL_CLASS_CNT ; i++)
+                if (inline_len <= pool->classes[i].inline_size)
+                        return i;
+
+        return -1;
+}
+
+
+/** @returns the slot header of a pooled message */
+#define rd_kafka_msgpool_rkm2slot(rkm) \
+        (((rd_kafka_msgpool_slot_t *)(rkm)) - 1)
+
+/**
+ * @returns the size a message with flags \p msgflags and payload size \p len
+ *          is accounted for in rk_curr_msgs: the slot size of pool class
+ *          \p cls, plus the payload if it was not copied into the slot,
+ *          or just the payload size for non-pooled messages (\p cls NULL).
+ */
+static RD_INLINE size_t
+rd_kafka_msgpool_acct_size (const rd_kafka_msgpool_class_t *cls,
+                            int msgflags, size_t len) {
+        if (!cls)
+                return len;
+        return cls->slot_size + ((msgflags & RD_KAFKA_MSG_F_COPY) ? 0 : len);
+}
+
+/** @returns the size \p rkm is accounted for in rk_curr_msgs */
+#define rd_kafka_msg_acct_size(rkm)                                     \
+        rd_kafka_msgpool_acct_size(                                     \
+                ((rkm)->rkm_flags & RD_KAFKA_MSG_F_POOLED) ?            \
+                rd_kafka_msgpool_rkm2slot(rkm)->slab->cls : NULL,       \
+                (rkm)->rkm_flags, (rkm)->rkm_len)
+
+/** @returns the first slot in a slab */
+#define rd_kafka_msgpool_slab_slots(slab)                               \
+        ((char *)(slab) + RD_ROUNDUP(sizeof(rd_kafka_msgpool_slab_t), 16))
+
+
+/**
+ * @brief Allocate a new slab for \p cls and put its slots on the
+ *        slab's free list.
+ *
+ * @locks pool->lock MUST be held
+ */
+static rd_kafka_msgpool_slab_t *
+rd_kafka_msgpool_slab_new (rd_kafka_msgpool_class_t *cls) {
+        rd_kafka_msgpool_slab_t *slab;
+        char *slots;
+        int i;
+
+        slab = rd_malloc(RD_ROUNDUP(sizeof(*slab), 16) +
+                         (size_t)cls->slot_cnt * cls->slot_size);
+        slab->cls      = cls;
+        slab->free     = NULL;
+        slab->free_cnt = cls->slot_cnt;
+
+        slots = rd_kafka_msgpool_slab_slots(slab);
+        for (i = cls->slot_cnt - 1 ; i >= 0 ; i--) {
+                rd_kafka_msgpool_slot_t *slot =
+                        (rd_kafka_msgpool_slot_t *)
+                        (slots + (size_t)i * cls->slot_size);
+                slot->slab = slab;
+                slot->next = slab->free;
+                slab->free = slot;
+        }
+
+        TAILQ_INSERT_HEAD(&cls->slabs, slab, link);
+        TAILQ_INSERT_TAIL(&cls->all, slab, all_link);
+        cls->slab_cnt++;
+        cls->empty_cnt++;
+
+        return slab;
+}
+
+
+/**
+ * @returns a message slot from size class \p class_idx.
+ *
+ * @remark The returned message is uninitialized.
+ * @locks pool->lock MUST NOT be held
+ */
+static rd_kafka_msg_t *rd_kafka_msgpool_get (rd_kafka_msgpool_t *pool,
+                                             int class_idx) {
+        rd_kafka_msgpool_class_t *cls = &pool->classes[class_idx];
+        rd_kafka_msgpool_slab_t *slab;
+        rd_kafka_msgpool_slot_t *slot;
+
+        mtx_lock(&pool->lock);
+
+        if (!(slab = TAILQ_FIRST(&cls->slabs)))
+                slab = rd_kafka_msgpool_slab_new(cls);
+
+        slot = slab->free;
+        slab->free = slot->next;
+
+        if (slab->free_cnt-- == cls->slot_cnt)
+                cls->empty_cnt--;
+
+        if (!slab->free) /* Slab is now full */
+                TAILQ_REMOVE(&cls->slabs, slab, link);
+
+        mtx_unlock(&pool->lock);
+
+        return (rd_kafka_msg_t *)(slot + 1);
+}
+
+
+/**
+ * @brief Return the list of \p slots to their slabs.
+ *
+ * Unused slabs are freed, apart from one spare slab per size class.
+ *
+ * @locks pool->lock MUST NOT be held
+ */
+static void rd_kafka_msgpool_put (rd_kafka_msgpool_t *pool,
+                                  rd_kafka_msgpool_slot_t *slots) {
+        rd_kafka_msgpool_slot_t *slot;
+
+        mtx_lock(&pool->lock);
+
+        while ((slot = slots)) {
+                rd_kafka_msgpool_slab_t *slab = slot->slab;
+                rd_kafka_msgpool_class_t *cls = slab->cls;
+
+                slots = slot->next;
+
+                if (!slab->free) /* Slab was full */
+                        TAILQ_INSERT_HEAD(&cls->slabs, slab, link);
+
+                slot->next = slab->free;
+                slab->free = slot;
+
+                if (++slab->free_cnt < cls->slot_cnt)
+                        continue;
+
+                /* Slab is now unused */
+                TAILQ_REMOVE(&cls->slabs, slab, link);
+
+                if (cls->empty_cnt > 0) {
+                        TAILQ_REMOVE(&cls->all, slab, all_link);
+                        cls->slab_cnt--;
+                        rd_free(slab);
+                } else {
+                        /* Keep it as a spare, after the partially
+                         * used slabs. */
+                        TAILQ_INSERT_TAIL(&cls->slabs, slab, link);
+                        cls->empty_cnt++;
+                }
+        }
+
+        mtx_unlock(&pool->lock);
+}
+
+/**@}*/
+
+
+/**
+ * @brief Destroy a message, see rd_kafka_msg_destroy_batch_t.
+ *
+ * @param rk may be NULL for messages with a topic.
+ * @param batch if non-NULL the message's accounting and pool slot is
+ *        deferred to rd_kafka_msg_destroy_batch_commit(), else it is
+ *        released immediately.
+ */
+void rd_kafka_msg_destroy0 (rd_kafka_t *rk, rd_kafka_msg_t *rkm,
+                            rd_kafka_msg_destroy_batch_t *batch) {
+
+        if (rkm->rkm_flags & (RD_KAFKA_MSG_F_ACCOUNT|RD_KAFKA_MSG_F_POOLED)) {
 		rd_dassert(rk || rkm->rkm_rkmessage.rkt);
-		rd_kafka_curr_msgs_sub(
-			rk ? rk :
-			rd_kafka_topic_a2i(rkm->rkm_rkmessage.rkt)->rkt_rk,
-			1, rkm->rkm_len);
+                if (!rk)
+                        rk = rd_kafka_topic_a2i(rkm->rkm_rkmessage.rkt)->rkt_rk;
+        }
+
+	if (rkm->rkm_flags & RD_KAFKA_MSG_F_ACCOUNT) {
+                size_t size = rd_kafka_msg_acct_size(rkm);
+
+                if (batch) {
+                        batch->rk = rk;
+                        batch->cnt++;
+                        batch->size += size;
+                } else
+                        rd_kafka_curr_msgs_sub(rk, 1, size);
 	}
 
         if (rkm->rkm_headers)
@@ -63,11 +302,47 @@ void rd_kafka_msg_destroy (rd_kafka_t *rk, rd_kafka_msg_t *rkm) {
 	if (rkm->rkm_flags & RD_KAFKA_MSG_F_FREE && rkm->rkm_payload)
 		rd_free(rkm->rkm_payload);
 
-	if (rkm->rkm_flags & RD_KAFKA_MSG_F_FREE_RKM)
+        if (rkm->rkm_flags & RD_KAFKA_MSG_F_POOLED) {
+                rd_kafka_msgpool_slot_t *slot = rd_kafka_msgpool_rkm2slot(rkm);
+
+                if (batch) {
+                        batch->rk = rk;
+                        slot->next = batch->slots;
+                        batch->slots = slot;
+                } else {
+                        slot->next = NULL;
+                        rd_kafka_msgpool_put(&rk->rk_msgpool, slot);
+                }
+
+        } else if (rkm->rkm_flags & RD_KAFKA_MSG_F_FREE_RKM)
 		rd_free(rkm);
 }
 
 
+void rd_kafka_msg_destroy (rd_kafka_t *rk, rd_kafka_msg_t *rkm) {
+        rd_kafka_msg_destroy0(rk, rkm, NULL);
+}
+
+
+/**
+ * @brief Release the accounting and return the pool slots of all
+ *        messages destroyed with rd_kafka_msg_destroy0() on \p batch,
+ *        and reset the batch.
+ */
+void rd_kafka_msg_destroy_batch_commit (rd_kafka_msg_destroy_batch_t *batch) {
+
+        if (batch->cnt > 0)
+                rd_kafka_curr_msgs_sub(batch->rk, batch->cnt, batch->size);
+
+        if (batch->slots)
+                rd_kafka_msgpool_put(&batch->rk->rk_msgpool, batch->slots);
+
+        batch->slots = NULL;
+        batch->cnt   = 0;
+        batch->size  = 0;
+}
+
+
 
 /**
  * @brief Create a new Producer message, copying the payload as
@@ -81,7 +356,8 @@ rd_kafka_msg_t *rd_kafka_msg_new00 (rd_kafka_itopic_t *rkt,
 				    int msgflags,
 				    char *payload, size_t len,
 				    const void *key, size_t keylen,
-				    void *msg_opaque) {
+				    void *msg_opaque,
+                                    int pool_class_idx) {
 	rd_kafka_msg_t *rkm;
 	size_t mlen = sizeof(*rkm);
 	char *p;
@@ -96,10 +372,17 @@ rd_kafka_msg_t *rd_kafka_msg_new00 (rd_kafka_itopic_t *rkt,
 
 	/* Note: using rd_malloc here, not rd_calloc, so make sure all fields
 	 *       are properly set up. */
-	rkm                 = rd_malloc(mlen);
+        if (pool_class_idx != -1) {
+                rkm = rd_kafka_msgpool_get(&rkt->rkt_rk->rk_msgpool,
+                                           pool_class_idx);
+                msgflags |= RD_KAFKA_MSG_F_POOLED;
+        } else {
+                rkm = rd_malloc(mlen);
+                msgflags = (msgflags & ~RD_KAFKA_MSG_F_POOLED) |
+                        RD_KAFKA_MSG_F_FREE_RKM;
+        }
 	rkm->rkm_err        = 0;
-	rkm->rkm_flags      = (RD_KAFKA_MSG_F_PRODUCER |
-                               RD_KAFKA_MSG_F_FREE_RKM | msgflags);
+	rkm->rkm_flags      = (RD_KAFKA_MSG_F_PRODUCER | msgflags);
 	rkm->rkm_len        = len;
 	rkm->rkm_opaque     = msg_opaque;
 	rkm->rkm_rkmessage.rkt = rd_kafka_topic_keep_a(rkt);
@@ -161,6 +444,8 @@ static rd_kafka_msg_t *rd_kafka_msg_new0 (rd_kafka_itopic_t *rkt,
                                           rd_ts_t now) {
 	rd_kafka_msg_t *rkm;
         size_t hdrs_size = 0;
+        size_t acct_size;
+        int pool_class_idx;
 
 	if (unlikely(!payload))
 		len = 0;
@@ -178,13 +463,25 @@ static rd_kafka_msg_t *rd_kafka_msg_new0 (rd_kafka_itopic_t *rkt,
 		return NULL;
 	}
 
+        /* Messages whose key and copied payload fit in a message pool
+         * slot are allocated from the pool and accounted for by the slot
+         * size plus any non-copied payload, others by their payload size. */
+        pool_class_idx = rd_kafka_msgpool_class_idx(
+                &rkt->rkt_rk->rk_msgpool,
+                keylen + ((msgflags & RD_KAFKA_MSG_F_COPY) ? len : 0));
+        acct_size = rd_kafka_msgpool_acct_size(
+                pool_class_idx != -1 ?
+                &rkt->rkt_rk->rk_msgpool.classes[pool_class_idx] : NULL,
+                msgflags, len);
+
         if (msgflags & RD_KAFKA_MSG_F_BLOCK)
                 *errp = rd_kafka_curr_msgs_add(
-                        rkt->rkt_rk, 1, len, 1/*block*/,
+                        rkt->rkt_rk, 1, acct_size, 1/*block*/,
                         (msgflags & RD_KAFKA_MSG_F_RKT_RDLOCKED) ?
                         &rkt->rkt_lock : NULL);
         else
-                *errp = rd_kafka_curr_msgs_add(rkt->rkt_rk, 1, len, 0, NULL);
+                *errp = rd_kafka_curr_msgs_add(rkt->rkt_rk, 1, acct_size,
+                                               0, NULL);
 
         if (unlikely(*errp)) {
 		if (errnop)
@@ -195,7 +492,8 @@ static rd_kafka_msg_t *rd_kafka_msg_new0 (rd_kafka_itopic_t *rkt,
 
 	rkm = rd_kafka_msg_new00(rkt, force_partition,
 				 msgflags|RD_KAFKA_MSG_F_ACCOUNT /* curr_msgs_add() */,
-				 payload, len, key, keylen, msg_opaque);
+				 payload, len, key, keylen, msg_opaque,
+                                 pool_class_idx);
 
         memset(&rkm->rkm_u.producer, 0, sizeof(rkm->rkm_u.producer));
 
@@ -323,7 +621,7 @@ rd_kafka_resp_err_t rd_kafka_producev (rd_kafka_t *rk, ...) {
                 case RD_KAFKA_VTYPE_TOPIC:
                         s_rkt = rd_kafka_topic_new0(rk,
                                                     va_arg(ap, const char *),
-                                                    NULL, NULL, 1);
+                                                    NULL, NULL, NULL, 1);
                         break;
 
                 case RD_KAFKA_VTYPE_RKT:
@@ -470,6 +768,74 @@ int rd_kafka_produce (rd_kafka_topic_t *rkt, int32_t partition,
 
 
 
+static shptr_rd_kafka_toppar_t *
+rd_kafka_msg_partitioner0 (rd_kafka_itopic_t *rkt, rd_kafka_msg_t *rkm,
+                           rd_kafka_resp_err_t *errp);
+
+
+/**
+ * @brief Per-partition message queue used by rd_kafka_produce_batch()
+ *        to enqueue all of a partition's messages at once.
+ */
+typedef struct rd_kafka_produce_batch_part_s {
+        shptr_rd_kafka_toppar_t *s_rktp; /**< Destination partition */
+        rd_kafka_msgq_t msgq;            /**< Messages to enqueue */
+} rd_kafka_produce_batch_part_t;
+
+
+/**
+ * @returns the batch partition queue for \p s_rktp, creating it if needed
+ *          in which case the \p s_rktp reference is handed over to it,
+ *          else it is dropped.
+ *
+ * @param partsp array indexed by partition + 1, grown as needed.
+ */
+static rd_kafka_produce_batch_part_t *
+rd_kafka_produce_batch_part_get (rd_kafka_produce_batch_part_t ***partsp,
+                                 int *part_cntp,
+                                 shptr_rd_kafka_toppar_t *s_rktp) {
+        int idx = rd_kafka_toppar_s2i(s_rktp)->rktp_partition + 1;
+        rd_kafka_produce_batch_part_t *part;
+
+        if (unlikely(idx >= *part_cntp)) {
+                /* Partition count increased during the batch */
+                *partsp = rd_realloc(*partsp, sizeof(**partsp) * (idx + 1));
+                memset(*partsp + *part_cntp, 0,
+                       sizeof(**partsp) * (idx + 1 - *part_cntp));
+                *part_cntp = idx + 1;
+        }
+
+        if ((part = (*partsp)[idx])) {
+                rd_kafka_toppar_destroy(s_rktp);
+                return part;
+        }
+
+        part = rd_malloc(sizeof(*part));
+        part->s_rktp = s_rktp;
+        rd_kafka_msgq_init(&part->msgq);
+        (*partsp)[idx] = part;
+
+        return part;
+}
+
+
+/**
+ * @brief Enqueue the collected messages of each partition in \p parts
+ *        on the partition's queue.
+ */
+static void rd_kafka_produce_batch_enq (rd_kafka_produce_batch_part_t **parts,
+                                        int part_cnt) {
+        int i;
+
+        for (i = 0 ; i < part_cnt ; i++) {
+                if (parts[i] && parts[i]->s_rktp)
+                        rd_kafka_toppar_enq_msgq(
+                                rd_kafka_toppar_s2i(parts[i]->s_rktp),
+                                &parts[i]->msgq);
+        }
+}
+
+
 /**
  * Produce a batch of messages.
  * Returns the number of messages succesfully queued for producing.
@@ -478,7 +844,6 @@ int rd_kafka_produce (rd_kafka_topic_t *rkt, int32_t partition,
 int rd_kafka_produce_batch (rd_kafka_topic_t *app_rkt, int32_t partition,
                             int msgflags,
                             rd_kafka_message_t *rkmessages, int message_cnt) {
-        rd_kafka_msgq_t tmpq = RD_KAFKA_MSGQ_INITIALIZER(tmpq);
         int i;
 	int64_t utc_now = rd_uclock() / 1000;
         rd_ts_t now = rd_clock();
@@ -487,25 +852,37 @@ int rd_kafka_produce_batch (rd_kafka_topic_t *app_rkt, int32_t partition,
                                    (msgflags & RD_KAFKA_MSG_F_PARTITION));
         rd_kafka_resp_err_t all_err;
         rd_kafka_itopic_t *rkt = rd_kafka_topic_a2i(app_rkt);
-        shptr_rd_kafka_toppar_t *s_rktp = NULL;
+        rd_kafka_produce_batch_part_t single, *single_part = &single;
+        rd_kafka_produce_batch_part_t **parts = &single_part;
+        int part_cnt = 1;
 
         /* Propagated per-message below */
         all_err = rd_kafka_fatal_error_code(rkt->rkt_rk);
 
+        /* Messages are collected on per-partition queues and
+         * enqueued on each partition at once when done. */
         rd_kafka_topic_rdlock(rkt);
         if (!multiple_partitions) {
                 /* Single partition: look up the rktp once. */
-                s_rktp = rd_kafka_toppar_get_avail(rkt, partition,
-                                                   1/*ua on miss*/, &all_err);
+                single.s_rktp = rd_kafka_toppar_get_avail(rkt, partition,
+                                                          1/*ua on miss*/,
+                                                          &all_err);
+                rd_kafka_msgq_init(&single.msgq);
 
         } else {
                 /* Indicate to lower-level msg_new..() that rkt is locked
                  * so that they may unlock it momentarily if blocking. */
                 msgflags |= RD_KAFKA_MSG_F_RKT_RDLOCKED;
+
+                /* Indexed by partition + 1 (for the UA partition),
+                 * grown as needed. */
+                part_cnt = rkt->rkt_partition_cnt + 1;
+                parts = rd_calloc(part_cnt, sizeof(*parts));
         }
 
         for (i = 0 ; i < message_cnt ; i++) {
                 rd_kafka_msg_t *rkm;
+                rd_kafka_produce_batch_part_t *part = NULL;
 
                 /* Propagate error for all messages. */
                 if (unlikely(all_err)) {
@@ -513,11 +890,13 @@ int rd_kafka_produce_batch (rd_kafka_topic_t *app_rkt, int32_t partition,
                         continue;
                 }
 
-                /* Create message */
+                /* Create message.
+                 * Don't block while holding on to the messages collected
+                 * so far, see below. */
                 rkm = rd_kafka_msg_new0(rkt,
                                         (msgflags & RD_KAFKA_MSG_F_PARTITION) ?
                                         rkmessages[i].partition : partition,
-                                        msgflags,
+                                        msgflags & ~RD_KAFKA_MSG_F_BLOCK,
                                         rkmessages[i].payload,
                                         rkmessages[i].len,
                                         rkmessages[i].key,
@@ -525,6 +904,30 @@ int rd_kafka_produce_batch (rd_kafka_topic_t *app_rkt, int32_t partition,
                                         rkmessages[i]._private,
                                         &rkmessages[i].err, NULL,
 					NULL, utc_now, now);
+
+                if (unlikely(!rkm &&
+                             rkmessages[i].err ==
+                             RD_KAFKA_RESP_ERR__QUEUE_FULL &&
+                             (msgflags & RD_KAFKA_MSG_F_BLOCK))) {
+                        /* Enqueue the messages collected so far so that
+                         * they may be transmitted, making room in the
+                         * queue, and then block. */
+                        rd_kafka_produce_batch_enq(parts, part_cnt);
+
+                        rkm = rd_kafka_msg_new0(
+                                rkt,
+                                (msgflags & RD_KAFKA_MSG_F_PARTITION) ?
+                                rkmessages[i].partition : partition,
+                                msgflags,
+                                rkmessages[i].payload,
+                                rkmessages[i].len,
+                                rkmessages[i].key,
+                                rkmessages[i].key_len,
+                                rkmessages[i]._private,
+                                &rkmessages[i].err, NULL,
+                                NULL, utc_now, now);
+                }
+
                 if (unlikely(!rkm)) {
 			if (rkmessages[i].err == RD_KAFKA_RESP_ERR__QUEUE_FULL)
 				all_err = rkmessages[i].err;
@@ -538,33 +941,31 @@ int rd_kafka_produce_batch (rd_kafka_topic_t *app_rkt, int32_t partition,
                  *  fixed partition:          simply concatenate the queue
                  *                            to partit */
                 if (multiple_partitions) {
-                        if (rkm->rkm_partition == RD_KAFKA_PARTITION_UA) {
-                                /* Partition the message */
-                                rkmessages[i].err =
-                                        rd_kafka_msg_partitioner(
-                                                rkt, rkm, 0/*already locked*/);
+                        int32_t p = rkm->rkm_partition;
+                        shptr_rd_kafka_toppar_t *s_rktp;
+
+                        if (p >= 0 && p + 1 < part_cnt && parts[p + 1] &&
+                            rd_kafka_toppar_s2i(parts[p + 1]->s_rktp)->
+                            rktp_partition == p) {
+                                /* Known partition, no lookup needed. */
+                                part = parts[p + 1];
+
                         } else {
-                                if (s_rktp == NULL ||
-                                    rkm->rkm_partition !=
-                                    rd_kafka_toppar_s2i(s_rktp)->
-                                    rktp_partition) {
-                                        rd_kafka_resp_err_t err;
-                                        if (s_rktp != NULL)
-                                                rd_kafka_toppar_destroy(s_rktp);
+                                if (p == RD_KAFKA_PARTITION_UA)
+                                        /* Partition the message */
+                                        s_rktp = rd_kafka_msg_partitioner0(
+                                                rkt, rkm, &rkmessages[i].err);
+                                else
                                         s_rktp = rd_kafka_toppar_get_avail(
-                                                rkt, rkm->rkm_partition,
-                                                1/*ua on miss*/, &err);
-
-                                        if (unlikely(!s_rktp)) {
-                                                rkmessages[i].err = err;
-                                                continue;
-                                        }
-                                }
-                                rd_kafka_toppar_enq_msg(
-                                        rd_kafka_toppar_s2i(s_rktp), rkm);
+                                                rkt, p, 1/*ua on miss*/,
+                                                &rkmessages[i].err);
+
+                                if (likely(s_rktp != NULL))
+                                        part = rd_kafka_produce_batch_part_get(
+                                                &parts, &part_cnt, s_rktp);
                         }
 
-                        if (unlikely(rkmessages[i].err)) {
+                        if (unlikely(!part)) {
                                 /* Interceptors: Unroll on_send by on_ack.. */
                                 rd_kafka_interceptors_on_acknowledgement(
                                         rkt->rkt_rk, &rkmessages[i]);
@@ -573,20 +974,32 @@ int rd_kafka_produce_batch (rd_kafka_topic_t *app_rkt, int32_t partition,
                                 continue;
                         }
 
-
                 } else {
                         /* Single destination partition. */
-                        rd_kafka_toppar_enq_msg(rd_kafka_toppar_s2i(s_rktp),
-                                                rkm);
+                        part = &single;
                 }
 
+                rd_kafka_msgq_enq(&part->msgq, rkm);
+
                 rkmessages[i].err = RD_KAFKA_RESP_ERR_NO_ERROR;
                 good++;
         }
 
+        rd_kafka_produce_batch_enq(parts, part_cnt);
+
         rd_kafka_topic_rdunlock(rkt);
-        if (s_rktp != NULL)
-                rd_kafka_toppar_destroy(s_rktp);
+
+        for (i = 0 ; i < part_cnt ; i++) {
+                if (!parts[i] || !parts[i]->s_rktp)
+                        continue;
+
+                rd_kafka_toppar_destroy(parts[i]->s_rktp);
+                if (multiple_partitions)
+                        rd_free(parts[i]);
+        }
+
+        if (multiple_partitions)
+                rd_free(parts);
 
         return good;
 }
@@ -786,19 +1199,22 @@ int32_t rd_kafka_msg_partitioner_murmur2_random (const rd_kafka_topic_t *rkt,
 
 
 /**
- * Assigns a message to a topic partition using a partitioner.
- * Returns RD_KAFKA_RESP_ERR__UNKNOWN_PARTITION or .._UNKNOWN_TOPIC if
- * partitioning failed, or 0 on success.
+ * @brief Assigns a message to a topic partition using a partitioner,
+ *        without enqueuing it.
+ *
+ * @returns the partition the message should be enqueued on (a new
+ *          reference), or NULL if partitioning failed in which case
+ *          \p errp is set to RD_KAFKA_RESP_ERR__UNKNOWN_PARTITION or
+ *          .._UNKNOWN_TOPIC.
+ *
+ * @locks rd_kafka_topic_rdlock(rkt) MUST be held.
  */
-int rd_kafka_msg_partitioner (rd_kafka_itopic_t *rkt, rd_kafka_msg_t *rkm,
-			      int do_lock) {
+static shptr_rd_kafka_toppar_t *
+rd_kafka_msg_partitioner0 (rd_kafka_itopic_t *rkt, rd_kafka_msg_t *rkm,
+                           rd_kafka_resp_err_t *errp) {
 	int32_t partition;
 	rd_kafka_toppar_t *rktp_new;
         shptr_rd_kafka_toppar_t *s_rktp_new;
-	rd_kafka_resp_err_t err;
-
-	if (do_lock)
-		rd_kafka_topic_rdlock(rkt);
 
         switch (rkt->rkt_state)
         {
@@ -812,10 +1228,8 @@ int rd_kafka_msg_partitioner (rd_kafka_itopic_t *rkt, rd_kafka_msg_t *rkm,
         case RD_KAFKA_TOPIC_S_NOTEXISTS:
                 /* Topic not found in cluster.
                  * Fail message immediately. */
-                err = RD_KAFKA_RESP_ERR__UNKNOWN_TOPIC;
-		if (do_lock)
-			rd_kafka_topic_rdunlock(rkt);
-                return err;
+                *errp = RD_KAFKA_RESP_ERR__UNKNOWN_TOPIC;
+                return NULL;
 
         case RD_KAFKA_TOPIC_S_EXISTS:
                 /* Topic exists in cluster. */
@@ -850,10 +1264,8 @@ int rd_kafka_msg_partitioner (rd_kafka_itopic_t *rkt, rd_kafka_msg_t *rkm,
 
                 /* Check that partition exists. */
                 if (partition >= rkt->rkt_partition_cnt) {
-                        err = RD_KAFKA_RESP_ERR__UNKNOWN_PARTITION;
-                        if (do_lock)
-                                rd_kafka_topic_rdunlock(rkt);
-                        return err;
+                        *errp = RD_KAFKA_RESP_ERR__UNKNOWN_PARTITION;
+                        return NULL;
                 }
                 break;
 
@@ -868,14 +1280,11 @@ int rd_kafka_msg_partitioner (rd_kafka_itopic_t *rkt, rd_kafka_msg_t *rkm,
 	if (unlikely(!s_rktp_new)) {
 		/* Unknown topic or partition */
 		if (rkt->rkt_state == RD_KAFKA_TOPIC_S_NOTEXISTS)
-			err = RD_KAFKA_RESP_ERR__UNKNOWN_TOPIC;
+			*errp = RD_KAFKA_RESP_ERR__UNKNOWN_TOPIC;
 		else
-			err = RD_KAFKA_RESP_ERR__UNKNOWN_PARTITION;
+			*errp = RD_KAFKA_RESP_ERR__UNKNOWN_PARTITION;
 
-		if (do_lock)
-			rd_kafka_topic_rdunlock(rkt);
-
-		return  err;
+		return NULL;
 	}
 
         rktp_new = rd_kafka_toppar_s2i(s_rktp_new);
@@ -885,8 +1294,32 @@ int rd_kafka_msg_partitioner (rd_kafka_itopic_t *rkt, rd_kafka_msg_t *rkm,
         if (rkm->rkm_partition == RD_KAFKA_PARTITION_UA)
                 rkm->rkm_partition = partition;
 
+        return s_rktp_new;
+}
+
+
+/**
+ * Assigns a message to a topic partition using a partitioner.
+ * Returns RD_KAFKA_RESP_ERR__UNKNOWN_PARTITION or .._UNKNOWN_TOPIC if
+ * partitioning failed, or 0 on success.
+ */
+int rd_kafka_msg_partitioner (rd_kafka_itopic_t *rkt, rd_kafka_msg_t *rkm,
+			      int do_lock) {
+        shptr_rd_kafka_toppar_t *s_rktp_new;
+	rd_kafka_resp_err_t err;
+
+	if (do_lock)
+		rd_kafka_topic_rdlock(rkt);
+
+        s_rktp_new = rd_kafka_msg_partitioner0(rkt, rkm, &err);
+	if (unlikely(!s_rktp_new)) {
+		if (do_lock)
+			rd_kafka_topic_rdunlock(rkt);
+		return err;
+	}
+
 	/* Partition is available: enqueue msg on partition's queue */
-	rd_kafka_toppar_enq_msg(rktp_new, rkm);
+	rd_kafka_toppar_enq_msg(rd_kafka_toppar_s2i(s_rktp_new), rkm);
 	if (do_lock)
 		rd_kafka_topic_rdunlock(rkt);
 	rd_kafka_toppar_destroy(s_rktp_new); /* from _get() */
@@ -1610,9 +2043,115 @@ static int unittest_msg_seq_wrap (void) {
         RD_UT_PASS();
 }
 
+/**
+ * @brief Verify that message pool slabs are allocated on demand and
+ *        freed when unused, keeping one spare slab.
+ */
+static int unittest_msgpool (void) {
+        rd_kafka_msgpool_t pool;
+        rd_kafka_msgpool_class_t *cls;
+        rd_kafka_msgpool_slot_t *slots = NULL;
+        rd_kafka_msg_t **rkms;
+        int msgcnt;
+        int i;
+
+        rd_kafka_msgpool_init(&pool);
+
+        RD_UT_ASSERT(rd_kafka_msgpool_class_idx(&pool, 0) == 0,
+                     "expected class 0");
+        RD_UT_ASSERT(rd_kafka_msgpool_class_idx(&pool, 100) == 1,
+                     "expected class 1");
+        RD_UT_ASSERT(rd_kafka_msgpool_class_idx(&pool, 100000) == -1,
+                     "expected no class");
+
+        /* A small key with a large non-copied payload fits in the
+         * smallest class but must still be accounted for its payload. */
+        RD_UT_ASSERT(rd_kafka_msgpool_class_idx(&pool, 10) == 0,
+                     "expected class 0");
+        cls = &pool.classes[0];
+        rkms = rd_malloc(sizeof(*rkms));
+        rkms[0] = rd_kafka_msgpool_get(&pool, 0);
+        memset(rkms[0], 0, sizeof(*rkms[0]));
+        rkms[0]->rkm_flags = RD_KAFKA_MSG_F_POOLED|RD_KAFKA_MSG_F_ACCOUNT|
+                RD_KAFKA_MSG_F_FREE;
+        rkms[0]->rkm_len = 65536;
+        RD_UT_ASSERT(rd_kafka_msg_acct_size(rkms[0]) ==
+                     rd_kafka_msgpool_acct_size(cls, RD_KAFKA_MSG_F_FREE,
+                                                65536) &&
+                     rd_kafka_msg_acct_size(rkms[0]) ==
+                     cls->slot_size + 65536,
+                     "expected non-copied payload to be accounted, "
+                     "got %"PRIusz, rd_kafka_msg_acct_size(rkms[0]));
+
+        /* A copied payload is accounted for by the slot size only */
+        rkms[0]->rkm_flags = RD_KAFKA_MSG_F_POOLED|RD_KAFKA_MSG_F_ACCOUNT|
+                RD_KAFKA_MSG_F_COPY;
+        rkms[0]->rkm_len = 40;
+        RD_UT_ASSERT(rd_kafka_msg_acct_size(rkms[0]) == cls->slot_size,
+                     "expected slot size %"PRIusz", got %"PRIusz,
+                     cls->slot_size, rd_kafka_msg_acct_size(rkms[0]));
+
+        rd_kafka_msgpool_rkm2slot(rkms[0])->next = NULL;
+        rd_kafka_msgpool_put(&pool, rd_kafka_msgpool_rkm2slot(rkms[0]));
+        rd_free(rkms);
+
+        cls = &pool.classes[1];
+        msgcnt = cls->slot_cnt * 3 + 1;
+        rkms = rd_malloc(sizeof(*rkms) * msgcnt);
+
+        for (i = 0 ; i < msgcnt ; i++) {
+                rkms[i] = rd_kafka_msgpool_get(&pool, 1);
+                /* Fill the inline area to trigger overrun checkers */
+                memset(rkms[i], i & 0xff,
+                       sizeof(*rkms[i]) + cls->inline_size);
+        }
+
+        RD_UT_ASSERT(cls->slab_cnt == 4 && cls->empty_cnt == 0,
+                     "expected 4 slabs and 0 unused, not %d and %d",
+                     cls->slab_cnt, cls->empty_cnt);
+
+        /* Return all but the last message in one batch */
+        for (i = 0 ; i < msgcnt - 1 ; i++) {
+                rd_kafka_msgpool_slot_t *slot =
+                        rd_kafka_msgpool_rkm2slot(rkms[i]);
+                slot->next = slots;
+                slots = slot;
+        }
+        rd_kafka_msgpool_put(&pool, slots);
+
+        RD_UT_ASSERT(cls->slab_cnt == 2 && cls->empty_cnt == 1,
+                     "expected 2 slabs and 1 unused, not %d and %d",
+                     cls->slab_cnt, cls->empty_cnt);
+
+        /* The partially used slab must be used before the spare */
+        rkms[0] = rd_kafka_msgpool_get(&pool, 1);
+        RD_UT_ASSERT(rd_kafka_msgpool_rkm2slot(rkms[0])->slab ==
+                     rd_kafka_msgpool_rkm2slot(rkms[msgcnt-1])->slab,
+                     "expected slot from the partially used slab");
+        RD_UT_ASSERT(cls->empty_cnt == 1, "expected 1 unused slab, not %d",
+                     cls->empty_cnt);
+
+        rd_kafka_msgpool_rkm2slot(rkms[0])->next =
+                rd_kafka_msgpool_rkm2slot(rkms[msgcnt-1]);
+        rd_kafka_msgpool_rkm2slot(rkms[msgcnt-1])->next = NULL;
+        rd_kafka_msgpool_put(&pool, rd_kafka_msgpool_rkm2slot(rkms[0]));
+
+        RD_UT_ASSERT(cls->slab_cnt == 1 && cls->empty_cnt == 1,
+                     "expected 1 slab and 1 unused, not %d and %d",
+                     cls->slab_cnt, cls->empty_cnt);
+
+        rd_free(rkms);
+        rd_kafka_msgpool_destroy(&pool);
+
+        RD_UT_PASS();
+}
+
+
 int unittest_msg (void) {
         int fails = 0;
 
+        fails += unittest_msgpool();
+
         fails += unittest_msgq_order("FIFO", 1, rd_kafka_msg_cmp_msgid);
         fails += unittest_msg_seq_wrap();
 
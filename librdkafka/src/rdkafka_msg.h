@@ -85,6 +85,7 @@ typedef struct rd_kafka_msg_s {
 #define RD_KAFKA_MSG_F_FREE_RKM     0x10000 /* msg_t is allocated */
 #define RD_KAFKA_MSG_F_ACCOUNT      0x20000 /* accounted for in curr_msgs */
 #define RD_KAFKA_MSG_F_PRODUCER     0x40000 /* Producer message */
+#define RD_KAFKA_MSG_F_POOLED       0x80000 /* msg_t is a msgpool slot */
 
 	rd_kafka_timestamp_type_t rkm_tstype; /* rkm_timestamp type */
 	int64_t    rkm_timestamp;  /* Message format V1.
@@ -209,6 +210,91 @@ size_t rd_kafka_msgq_size (const rd_kafka_msgq_t *rkmq) {
 }
 
 
+/**
+ * @name Producer message pool
+ *
+ * Producer messages are carved out of fixed-size slots in per-instance
+ * slabs rather than being rd_malloc():ed one by one.
+ * Each slot holds the rd_kafka_msg_t followed by an inline area for the
+ * key and the copied (RD_KAFKA_MSG_F_COPY) payload, there is one size class
+ * per inline area size. Messages that do not fit the largest class are
+ * rd_malloc():ed as before.
+ *
+ * Slabs are allocated on demand and freed when they are no longer used,
+ * keeping at most one spare slab per size class.
+ * @{
+ */
+
+/** Inline (key + copied payload) area sizes, one per size class. */
+#define RD_KAFKA_MSGPOOL_INLINE_SIZES  { 64, 256, 1024 }
+#define RD_KAFKA_MSGPOOL_CLASS_CNT     3
+/** Targeted slab size */
+#define RD_KAFKA_MSGPOOL_SLAB_SIZE     (64 * 1024)
+
+/**
+ * @brief Slot header, the rd_kafka_msg_t follows directly after.
+ */
+typedef struct rd_kafka_msgpool_slot_s {
+        struct rd_kafka_msgpool_slab_s *slab; /**< Owning slab */
+        struct rd_kafka_msgpool_slot_s *next; /**< Next free slot, only
+                                               *   valid while the slot is
+                                               *   not in use. */
+} rd_kafka_msgpool_slot_t;
+
+typedef struct rd_kafka_msgpool_slab_s {
+        TAILQ_ENTRY(rd_kafka_msgpool_slab_s) link;     /**< Class' slabs
+                                                        *   with free slots */
+        TAILQ_ENTRY(rd_kafka_msgpool_slab_s) all_link; /**< Class' slabs */
+        struct rd_kafka_msgpool_class_s *cls;  /**< Size class */
+        rd_kafka_msgpool_slot_t *free;         /**< Free slots */
+        int free_cnt;                          /**< Number of free slots */
+} rd_kafka_msgpool_slab_t;
+
+typedef struct rd_kafka_msgpool_class_s {
+        size_t inline_size;  /**< Max key + copied payload size */
+        size_t slot_size;    /**< Total slot size, a pooled message
+                              *   is accounted for in rk_curr_msgs
+                              *   by this plus any non-copied
+                              *   payload. */
+        int    slot_cnt;     /**< Slots per slab */
+        TAILQ_HEAD(, rd_kafka_msgpool_slab_s) slabs; /**< Slabs with free
+                                                      *   slots, partially
+                                                      *   used slabs first. */
+        TAILQ_HEAD(, rd_kafka_msgpool_slab_s) all;   /**< All slabs */
+        int    slab_cnt;     /**< Number of slabs */
+        int    empty_cnt;    /**< Number of unused slabs */
+} rd_kafka_msgpool_class_t;
+
+typedef struct rd_kafka_msgpool_s {
+        mtx_t lock;
+        rd_kafka_msgpool_class_t classes[RD_KAFKA_MSGPOOL_CLASS_CNT];
+} rd_kafka_msgpool_t;
+
+void rd_kafka_msgpool_init (rd_kafka_msgpool_t *pool);
+void rd_kafka_msgpool_destroy (rd_kafka_msgpool_t *pool);
+
+/**
+ * @brief Messages destroyed with rd_kafka_msg_destroy0() are not
+ *        released from rk_curr_msgs nor returned to the message pool
+ *        until rd_kafka_msg_destroy_batch_commit() is called, which does
+ *        so with a single lock of each.
+ */
+typedef struct rd_kafka_msg_destroy_batch_s {
+        rd_kafka_t *rk;
+        rd_kafka_msgpool_slot_t *slots; /**< Slots to return to the pool */
+        unsigned int cnt;               /**< Accounted messages */
+        size_t size;                    /**< Accounted size */
+} rd_kafka_msg_destroy_batch_t;
+
+#define RD_KAFKA_MSG_DESTROY_BATCH_INITIALIZER { NULL, NULL, 0, 0 }
+
+void rd_kafka_msg_destroy_batch_commit (rd_kafka_msg_destroy_batch_t *batch);
+
+/**@}*/
+
+
+void rd_kafka_msg_destroy0 (rd_kafka_t *rk, rd_kafka_msg_t *rkm,
+                            rd_kafka_msg_destroy_batch_t *batch);
 void rd_kafka_msg_destroy (rd_kafka_t *rk, rd_kafka_msg_t *rkm);
 
 int rd_kafka_msg_new (rd_kafka_itopic_t *rkt, int32_t force_partition,
@@ -287,15 +373,19 @@ static RD_INLINE RD_UNUSED void rd_kafka_msgq_prepend (rd_kafka_msgq_t *dst,
 static RD_INLINE RD_UNUSED void rd_kafka_msgq_purge (rd_kafka_t *rk,
                                                     rd_kafka_msgq_t *rkmq) {
 	rd_kafka_msg_t *rkm, *next;
+        rd_kafka_msg_destroy_batch_t batch =
+                RD_KAFKA_MSG_DESTROY_BATCH_INITIALIZER;
 
 	next = TAILQ_FIRST(&rkmq->rkmq_msgs);
 	while (next) {
 		rkm = next;
 		next = TAILQ_NEXT(next, rkm_link);
 
-		rd_kafka_msg_destroy(rk, rkm);
+		rd_kafka_msg_destroy0(rk, rkm, &batch);
 	}
 
+        rd_kafka_msg_destroy_batch_commit(&batch);
+
 	rd_kafka_msgq_init(rkmq);
 }
 
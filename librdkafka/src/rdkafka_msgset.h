@@ -40,6 +40,10 @@ rd_kafka_msgset_create_ProduceRequest (rd_kafka_broker_t *rkb,
                                        const rd_kafka_pid_t pid,
                                        size_t *MessageSetSizep);
 
+int rd_kafka_compress_pool_init (rd_kafka_t *rk,
+                                 char *errstr, size_t errstr_size);
+void rd_kafka_compress_pool_term (rd_kafka_t *rk);
+
 /**
  * @name MessageSet readers
  */
@@ -352,9 +352,10 @@ rd_kafka_msgset_reader_decompress (rd_kafka_msgset_reader_t *msetr,
         case RD_KAFKA_COMPRESSION_ZSTD:
         {
                 err = rd_kafka_zstd_decompress(msetr->msetr_rkb,
-                                              (char *)compressed,
-                                              compressed_size,
-                                              &iov.iov_base, &iov.iov_len);
+                                               rktp->rktp_rkt->rkt_zstd_dict,
+                                               (char *)compressed,
+                                               compressed_size,
+                                               &iov.iov_base, &iov.iov_len);
                 if (err)
                         goto err;
         }
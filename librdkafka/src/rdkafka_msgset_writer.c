@@ -34,6 +34,7 @@
 #include "rdkafka_partition.h"
 #include "rdkafka_header.h"
 #include "rdkafka_lz4.h"
+#include "rdkafka_interceptor.h"
 
 #if WITH_ZSTD
 #include "rdkafka_zstd.h"
@@ -51,6 +52,9 @@ typedef struct rd_kafka_msgset_writer_s {
         int     msetw_MsgVersion;        /* MsgVersion to construct */
         int     msetw_features;          /* Protocol features to use */
         rd_kafka_compression_t msetw_compression; /**< Compression type */
+        size_t  msetw_copy_max_size;     /**< Copy payloads up to this size
+                                          *   to the buffer, larger payloads
+                                          *   are passed by reference. */
         int     msetw_msgcntmax;         /* Max number of messages to send
                                           * in a batch. */
         size_t  msetw_messages_len;      /* Total size of Messages, with Message
@@ -218,6 +222,7 @@ rd_kafka_msgset_writer_alloc_buf (rd_kafka_msgset_writer_t *msetw) {
         size_t hdrsize = 0;
         size_t msgsetsize = 0;
         size_t bufsize;
+        int segcnt = msetw->msetw_msgcntmax/2 + 10;
 
         rd_kafka_assert(NULL, !msetw->msetw_rkbuf);
 
@@ -313,13 +318,35 @@ rd_kafka_msgset_writer_alloc_buf (rd_kafka_msgset_writer_t *msetw) {
          */
         bufsize = hdrsize + msgsetsize;
 
+        /* Payloads in uncompressed MessageSets are passed by reference
+         * in zero-copy mode, reserve room for a payload segment and
+         * the segment following it (see rd_buf_push()) per message. */
+        if (rk->rk_conf.produce_zerocopy &&
+            msetw->msetw_compression == RD_KAFKA_COMPRESSION_NONE) {
+                /* Estimate the number of messages that will fit in the
+                 * MessageSet based on the average message size. */
+                size_t avgsize = rd_kafka_msgq_size(msetw->msetw_msgq) /
+                        RD_MAX(rd_kafka_msgq_len(msetw->msetw_msgq), 1);
+                int refcnt = msetw->msetw_msgcntmax;
+
+                if (avgsize > 0)
+                        refcnt = (int)RD_MIN((size_t)refcnt,
+                                             (size_t)rk->rk_conf.max_msg_size /
+                                             avgsize + 1);
+
+                msetw->msetw_copy_max_size = 0;
+                segcnt += refcnt * 2;
+        } else
+                msetw->msetw_copy_max_size =
+                        (size_t)rk->rk_conf.msg_copy_max_size;
+
         /* If copying for small payloads is enabled, allocate enough
          * space for each message to be copied based on this limit.
          */
-        if (rk->rk_conf.msg_copy_max_size > 0) {
+        if (msetw->msetw_copy_max_size > 0) {
                 size_t queued_bytes = rd_kafka_msgq_size(msetw->msetw_msgq);
                 bufsize += RD_MIN(queued_bytes,
-                                  (size_t)rk->rk_conf.msg_copy_max_size *
+                                  msetw->msetw_copy_max_size *
                                   msetw->msetw_msgcntmax);
         }
 
@@ -336,8 +363,7 @@ rd_kafka_msgset_writer_alloc_buf (rd_kafka_msgset_writer_t *msetw) {
          */
         msetw->msetw_rkbuf =
                 rd_kafka_buf_new_request(msetw->msetw_rkb, RD_KAFKAP_Produce,
-                                         msetw->msetw_msgcntmax/2 + 10,
-                                         bufsize);
+                                         segcnt, bufsize);
 
         rd_kafka_buf_ApiVersion_set(msetw->msetw_rkbuf,
                                     msetw->msetw_ApiVersion,
@@ -522,13 +548,12 @@ static RD_INLINE void
 rd_kafka_msgset_writer_write_msg_payload (rd_kafka_msgset_writer_t *msetw,
                                           const rd_kafka_msg_t *rkm,
                                           void (*free_cb)(void *)) {
-        const rd_kafka_t *rk = msetw->msetw_rkb->rkb_rk;
         rd_kafka_buf_t *rkbuf = msetw->msetw_rkbuf;
 
         /* If payload is below the copy limit and there is still
          * room in the buffer we'll copy the payload to the buffer,
          * otherwise we push a reference to the memory. */
-        if (rkm->rkm_len <= (size_t)rk->rk_conf.msg_copy_max_size &&
+        if (rkm->rkm_len <= msetw->msetw_copy_max_size &&
             rd_buf_write_remains(&rkbuf->rkbuf_buf) > rkm->rkm_len) {
                 rd_kafka_buf_write(rkbuf,
                                    rkm->rkm_payload, rkm->rkm_len);
@@ -1100,11 +1125,11 @@ static int
 rd_kafka_msgset_writer_compress_zstd (rd_kafka_msgset_writer_t *msetw,
                                      rd_slice_t *slice, struct iovec *ciov) {
         rd_kafka_resp_err_t err;
-        int comp_level =
-                msetw->msetw_rktp->rktp_rkt->rkt_conf.compression_level;
+        rd_kafka_itopic_t *rkt = msetw->msetw_rktp->rktp_rkt;
         err = rd_kafka_zstd_compress(msetw->msetw_rkb,
-                                    comp_level,
-                                    slice, &ciov->iov_base, &ciov->iov_len);
+                                     rkt->rkt_conf.compression_level,
+                                     rkt->rkt_zstd_dict,
+                                     slice, &ciov->iov_base, &ciov->iov_len);
         return (err ? -1 : 0);
 }
 #endif
@@ -1310,6 +1335,69 @@ rd_kafka_msgset_writer_finalize_MessageSet (rd_kafka_msgset_writer_t *msetw) {
 }
 
 
+/**
+ * @brief Compress the MessageSet, if configured, and finalize the
+ *        MessageSet header fields and CRC.
+ *
+ * @locality broker thread, or compression thread if the MessageSet
+ *           was handed over to the compression thread pool.
+ */
+static void
+rd_kafka_msgset_writer_complete (rd_kafka_msgset_writer_t *msetw) {
+        rd_kafka_toppar_t *rktp = msetw->msetw_rktp;
+        size_t len = msetw->msetw_messages_len;
+
+        /* Compress the message set */
+        if (msetw->msetw_compression)
+                rd_kafka_msgset_writer_compress(msetw, &len);
+
+        msetw->msetw_messages_len = len;
+
+        /* Finalize MessageSet header fields */
+        rd_kafka_msgset_writer_finalize_MessageSet(msetw);
+
+        rd_rkb_dbg(msetw->msetw_rkb, MSG, "PRODUCE",
+                   "%s [%"PRId32"]: "
+                   "Produce MessageSet with %i message(s) (%"PRIusz" bytes, "
+                   "ApiVersion %d, MsgVersion %d, MsgId %"PRIu64", "
+                   "BaseSeq %"PRId32", %s)",
+                   rktp->rktp_rkt->rkt_topic->str, rktp->rktp_partition,
+                   rd_kafka_msgq_len(&msetw->msetw_batch->msgq),
+                   msetw->msetw_MessageSetSize,
+                   msetw->msetw_ApiVersion, msetw->msetw_MsgVersion,
+                   msetw->msetw_batch->first_msgid,
+                   msetw->msetw_batch->first_seq,
+                   rd_kafka_pid2str(msetw->msetw_pid));
+}
+
+
+/**
+ * @brief Hand the MessageSet over to the compression thread pool.
+ *
+ *        The ProduceRequest is flagged as RD_KAFKA_OP_F_COMPRESSING and
+ *        is held back by the broker until the compression thread returns
+ *        the RD_KAFKA_OP_COMPRESS op to the broker's ops queue.
+ */
+static void
+rd_kafka_msgset_writer_compress_enq (rd_kafka_msgset_writer_t *msetw) {
+        rd_kafka_broker_t *rkb = msetw->msetw_rkb;
+        rd_kafka_op_t *rko;
+
+        rko = rd_kafka_op_new(RD_KAFKA_OP_COMPRESS);
+        rko->rko_u.compress.rkbuf = msetw->msetw_rkbuf;
+        rko->rko_u.compress.msetw = rd_malloc(sizeof(*msetw));
+        *rko->rko_u.compress.msetw = *msetw;
+        /* The xmit queue belongs to the broker thread. */
+        rko->rko_u.compress.msetw->msetw_msgq = NULL;
+        rko->rko_replyq = RD_KAFKA_REPLYQ(rkb->rkb_ops, 0);
+
+        msetw->msetw_rkbuf->rkbuf_flags |= RD_KAFKA_OP_F_COMPRESSING;
+        rd_atomic32_add(&msetw->msetw_rktp->rktp_compress_cnt, 1);
+
+        rd_kafka_q_enq(rkb->rkb_rk->rk_compress.q, rko);
+}
+
+
 /**
  * @brief Finalize the messageset - call when no more messages are to be
  *        added to the messageset.
@@ -1317,7 +1405,10 @@ rd_kafka_msgset_writer_finalize_MessageSet (rd_kafka_msgset_writer_t *msetw) {
  *        Will compress, update final values, CRCs, etc.
  *
  *        The messageset writer is destroyed and the buffer is returned
- *        and ready to be transmitted.
+ *        and ready to be transmitted, unless the MessageSet was handed
+ *        over to the compression thread pool, in which case the buffer
+ *        is flagged RD_KAFKA_OP_F_COMPRESSING and \p MessageSetSizep
+ *        is set to 0.
  *
  * @param MessagetSetSizep will be set to the finalized MessageSetSize
  *
@@ -1329,6 +1420,7 @@ rd_kafka_msgset_writer_finalize (rd_kafka_msgset_writer_t *msetw,
                                  size_t *MessageSetSizep) {
         rd_kafka_buf_t *rkbuf = msetw->msetw_rkbuf;
         rd_kafka_toppar_t *rktp = msetw->msetw_rktp;
+        rd_kafka_t *rk = msetw->msetw_rkb->rkb_rk;
         size_t len;
         int cnt;
 
@@ -1343,7 +1435,7 @@ rd_kafka_msgset_writer_finalize (rd_kafka_msgset_writer_t *msetw,
         len = rd_buf_write_pos(&msetw->msetw_rkbuf->rkbuf_buf) -
                 msetw->msetw_firstmsg.of;
         rd_assert(len > 0);
-        rd_assert(len <= (size_t)rktp->rktp_rkt->rkt_rk->rk_conf.max_msg_size);
+        rd_assert(len <= (size_t)rk->rk_conf.max_msg_size);
 
         rd_atomic64_add(&rktp->rktp_c.tx_msgs, cnt);
         rd_atomic64_add(&rktp->rktp_c.tx_msg_bytes, msetw->msetw_messages_kvlen);
@@ -1354,35 +1446,24 @@ rd_kafka_msgset_writer_finalize (rd_kafka_msgset_writer_t *msetw,
          * the request obsolete. */
         msetw->msetw_rkbuf->rkbuf_u.Produce.batch.pid = msetw->msetw_pid;
 
-        /* Compress the message set */
-        if (msetw->msetw_compression)
-                rd_kafka_msgset_writer_compress(msetw, &len);
-
         msetw->msetw_messages_len = len;
 
-        /* Finalize MessageSet header fields */
-        rd_kafka_msgset_writer_finalize_MessageSet(msetw);
-
-        /* Return final MessageSetSize */
-        *MessageSetSizep = msetw->msetw_MessageSetSize;
-
-        rd_rkb_dbg(msetw->msetw_rkb, MSG, "PRODUCE",
-                   "%s [%"PRId32"]: "
-                   "Produce MessageSet with %i message(s) (%"PRIusz" bytes, "
-                   "ApiVersion %d, MsgVersion %d, MsgId %"PRIu64", "
-                   "BaseSeq %"PRId32", %s)",
-                   rktp->rktp_rkt->rkt_topic->str, rktp->rktp_partition,
-                   cnt, msetw->msetw_MessageSetSize,
-                   msetw->msetw_ApiVersion, msetw->msetw_MsgVersion,
-                   msetw->msetw_batch->first_msgid,
-                   msetw->msetw_batch->first_seq,
-                   rd_kafka_pid2str(msetw->msetw_pid));
-
         rd_kafka_msgq_verify_order(rktp, &msetw->msetw_batch->msgq,
                                    msetw->msetw_batch->first_msgid, rd_false);
 
         rd_kafka_msgbatch_ready_produce(msetw->msetw_batch);
 
+        if (msetw->msetw_compression && rk->rk_compress.q) {
+                rd_kafka_msgset_writer_compress_enq(msetw);
+                *MessageSetSizep = 0;
+                return rkbuf;
+        }
+
+        rd_kafka_msgset_writer_complete(msetw);
+
+        /* Return final MessageSetSize */
+        *MessageSetSizep = msetw->msetw_MessageSetSize;
+
         return rkbuf;
 }
 
@@ -1423,3 +1504,132 @@ rd_kafka_msgset_create_ProduceRequest (rd_kafka_broker_t *rkb,
 
         return rd_kafka_msgset_writer_finalize(&msetw, MessageSetSizep);
 }
+
+
+
+/**
+ * @brief Compress and finalize the MessageSet of an RD_KAFKA_OP_COMPRESS
+ *        op and return the op to the broker thread.
+ *
+ * @locality compression thread
+ */
+static void rd_kafka_msgset_writer_compress_op (rd_kafka_op_t *rko) {
+        rd_kafka_msgset_writer_t *msetw = rko->rko_u.compress.msetw;
+
+        rd_kafka_msgset_writer_complete(msetw);
+
+        rko->rko_u.compress.MessageSetSize = msetw->msetw_MessageSetSize;
+        rd_free(msetw);
+        rko->rko_u.compress.msetw = NULL;
+
+        rd_kafka_replyq_enq(&rko->rko_replyq, rko, 0);
+}
+
+
+/**
+ * @brief Main loop for compression threads.
+ *
+ * The threads serve the compression queue until they receive a
+ * TERMINATE op, which is not sent until all broker threads have exited,
+ * so no MessageSets are left behind.
+ */
+static int rd_kafka_compress_thread_main (void *arg) {
+        rd_kafka_t *rk = arg;
+        rd_kafka_op_t *rko;
+
+        rd_kafka_set_thread_name("compress");
+        rd_kafka_set_thread_sysname("rdk:compress");
+
+        (void)rd_atomic32_add(&rd_kafka_thread_cnt_curr, 1);
+
+        rd_kafka_interceptors_on_thread_start(rk, RD_KAFKA_THREAD_COMPRESS);
+
+        while ((rko = rd_kafka_q_pop(rk->rk_compress.q,
+                                     RD_POLL_INFINITE, 0))) {
+                if (rko->rko_type == RD_KAFKA_OP_TERMINATE) {
+                        rd_kafka_op_destroy(rko);
+                        break;
+                }
+
+                rd_assert(rko->rko_type == RD_KAFKA_OP_COMPRESS);
+                rd_kafka_msgset_writer_compress_op(rko);
+        }
+
+        rd_kafka_interceptors_on_thread_exit(rk, RD_KAFKA_THREAD_COMPRESS);
+
+#if WITH_ZSTD
+        rd_kafka_zstd_thread_cleanup();
+#endif
+
+        rd_atomic32_sub(&rd_kafka_thread_cnt_curr, 1);
+
+        return 0;
+}
+
+
+/**
+ * @brief Create the compression queue and `compression.threads` threads
+ *        serving it.
+ *
+ * @returns 0 on success or -1 on thread creation failure, in which case
+ *          \p errstr is set and the threads created so far remain
+ *          for rd_kafka_compress_pool_term() to clean up.
+ *
+ * @locality application thread calling rd_kafka_new()
+ */
+int rd_kafka_compress_pool_init (rd_kafka_t *rk,
+                                 char *errstr, size_t errstr_size) {
+        int i;
+
+        rk->rk_compress.q = rd_kafka_q_new(rk);
+        rk->rk_compress.thrds = rd_calloc(rk->rk_conf.compression_threads,
+                                          sizeof(*rk->rk_compress.thrds));
+
+        for (i = 0 ; i < rk->rk_conf.compression_threads ; i++) {
+                if (thrd_create(&rk->rk_compress.thrds[i],
+                                rd_kafka_compress_thread_main, rk) !=
+                    thrd_success) {
+                        if (errstr)
+                                rd_snprintf(errstr, errstr_size,
+                                            "Failed to create compression "
+                                            "thread: %s (%i)",
+                                            rd_strerror(errno), errno);
+                        return -1;
+                }
+
+                rk->rk_compress.cnt++;
+        }
+
+        return 0;
+}
+
+
+/**
+ * @brief Terminate the compression threads and destroy the
+ *        compression queue.
+ *
+ * @locality rdkafka main thread, after all broker threads have exited.
+ */
+void rd_kafka_compress_pool_term (rd_kafka_t *rk) {
+        int i;
+
+        rd_kafka_dbg(rk, GENERIC, "TERMINATE",
+                     "Terminating %d compression thread(s)",
+                     rk->rk_compress.cnt);
+
+        for (i = 0 ; i < rk->rk_compress.cnt ; i++)
+                rd_kafka_q_enq(rk->rk_compress.q,
+                               rd_kafka_op_new(RD_KAFKA_OP_TERMINATE));
+
+        for (i = 0 ; i < rk->rk_compress.cnt ; i++) {
+                int res;
+                thrd_join(rk->rk_compress.thrds[i], &res);
+        }
+
+        rd_free(rk->rk_compress.thrds);
+        rk->rk_compress.thrds = NULL;
+        rk->rk_compress.cnt = 0;
+
+        rd_kafka_q_destroy_owner(rk->rk_compress.q);
+        rk->rk_compress.q = NULL;
+}
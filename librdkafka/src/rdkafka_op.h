@@ -67,6 +67,9 @@ typedef struct rd_kafka_replyq_s {
 #define RD_KAFKA_OP_F_BLOCKING    0x8  /* rkbuf: blocking protocol request */
 #define RD_KAFKA_OP_F_REPROCESS   0x10 /* cgrp: Reprocess at a later time. */
 #define RD_KAFKA_OP_F_SENT        0x20 /* rkbuf: request sent on wire */
+#define RD_KAFKA_OP_F_COMPRESSING 0x40 /* rkbuf: MessageSet is being
+                                        *        compressed by the
+                                        *        compression thread pool */
 
 
 typedef enum {
@@ -120,6 +123,9 @@ typedef enum {
         RD_KAFKA_OP_PURGE,           /**< Purge queues */
         RD_KAFKA_OP_CONNECT,         /**< Connect (to broker) */
         RD_KAFKA_OP_OAUTHBEARER_REFRESH, /**< Refresh OAUTHBEARER token */
+        RD_KAFKA_OP_COMPRESS,        /**< Compress MessageSet:
+                                      *   broker thread -> compression thread
+                                      *   -> broker thread */
         RD_KAFKA_OP__END
 } rd_kafka_op_type_t;
 
@@ -305,6 +311,18 @@ struct rd_kafka_op_s {
 			rd_kafka_buf_t *rkbuf;
 		} xbuf; /* XMIT_BUF and RECV_BUF */
 
+                /* RD_KAFKA_OP_COMPRESS */
+                struct {
+                        rd_kafka_buf_t *rkbuf;  /**< ProduceRequest, owned by
+                                                 *   the broker's compressq */
+                        struct rd_kafka_msgset_writer_s *msetw; /**< Writer
+                                                 *   state for finalizing the
+                                                 *   MessageSet. */
+                        size_t MessageSetSize;  /**< Final MessageSet size,
+                                                 *   set by the compression
+                                                 *   thread. */
+                } compress;
+
                 /* RD_KAFKA_OP_METADATA */
                 struct {
                         rd_kafka_metadata_t *md;
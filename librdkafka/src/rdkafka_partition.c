@@ -214,6 +214,7 @@ shptr_rd_kafka_toppar_t *rd_kafka_toppar_new0 (rd_kafka_itopic_t *rkt,
 	rktp->rktp_op_version = rd_atomic32_get(&rktp->rktp_version);
 
         rd_atomic32_init(&rktp->rktp_msgs_inflight, 0);
+        rd_atomic32_init(&rktp->rktp_compress_cnt, 0);
         rd_kafka_pid_reset(&rktp->rktp_eos.pid);
 
         /* Consumer: If statistics is available we query the oldest offset
@@ -390,7 +391,7 @@ shptr_rd_kafka_toppar_t *rd_kafka_toppar_get2 (rd_kafka_t *rk,
                         rd_kafka_wrunlock(rk);
                         return NULL;
                 }
-                s_rkt = rd_kafka_topic_new0(rk, topic, NULL,
+                s_rkt = rd_kafka_topic_new0(rk, topic, NULL, NULL,
 					    NULL, 0/*no-lock*/);
                 if (!s_rkt) {
                         rd_kafka_wrunlock(rk);
@@ -689,6 +690,57 @@ rd_kafka_msgq_insert_msgq_sort (rd_kafka_msgq_t *destq,
 }
 
 
+/**
+ * @brief Enqueue all messages in \p rkmq, in produce order, on the
+ *        partition's message queue.
+ *
+ * This is the bulk version of rd_kafka_toppar_enq_msg(): the toppar lock
+ * is acquired once and the broker thread is woken up at most once.
+ * \p rkmq will be empty on return.
+ */
+void rd_kafka_toppar_enq_msgq (rd_kafka_toppar_t *rktp,
+                               rd_kafka_msgq_t *rkmq) {
+        rd_kafka_q_t *wakeup_q = NULL;
+        int was_empty;
+
+        if (unlikely(RD_KAFKA_MSGQ_EMPTY(rkmq)))
+                return;
+
+        rd_kafka_toppar_lock(rktp);
+
+        if (rktp->rktp_partition != RD_KAFKA_PARTITION_UA) {
+                rd_kafka_msg_t *rkm;
+
+                TAILQ_FOREACH(rkm, &rkmq->rkmq_msgs, rkm_link) {
+                        if (!rkm->rkm_u.producer.msgid)
+                                rkm->rkm_u.producer.msgid = ++rktp->rktp_msgid;
+                }
+        }
+
+        was_empty = rd_kafka_msgq_len(&rktp->rktp_msgq) == 0;
+
+        if (rktp->rktp_partition == RD_KAFKA_PARTITION_UA ||
+            rktp->rktp_rkt->rkt_conf.queuing_strategy == RD_KAFKA_QUEUE_FIFO) {
+                /* No need for sorting, these are the oldest messages. */
+                rd_kafka_msgq_concat(&rktp->rktp_msgq, rkmq);
+        } else {
+                rd_kafka_msgq_insert_msgq_sort(
+                        &rktp->rktp_msgq, rkmq,
+                        rktp->rktp_rkt->rkt_conf.msg_order_cmp);
+        }
+
+        if (unlikely(was_empty && (wakeup_q = rktp->rktp_msgq_wakeup_q)))
+                rd_kafka_q_keep(wakeup_q);
+
+        rd_kafka_toppar_unlock(rktp);
+
+        if (wakeup_q) {
+                rd_kafka_q_yield(wakeup_q);
+                rd_kafka_q_destroy(wakeup_q);
+        }
+}
+
+
 void rd_kafka_msgq_insert_msgq (rd_kafka_msgq_t *destq,
                                 rd_kafka_msgq_t *srcq,
                                 int (*cmp) (const void *a, const void *b)) {
@@ -115,6 +115,10 @@ struct rd_kafka_toppar_s { /* rd_kafka_toppar_t */
         rd_atomic32_t      rktp_msgs_inflight;  /**< Current number of
                                                  *   messages in-flight to/from
                                                  *   the broker. */
+        rd_atomic32_t      rktp_compress_cnt;   /**< Number of ProduceRequests
+                                                 *   for this partition being
+                                                 *   compressed by the
+                                                 *   compression thread pool.*/
 
         uint64_t           rktp_msgid;   /**< Current/last message id.
                                           *   Each message enqueued on a
@@ -407,6 +411,8 @@ void rd_kafka_toppar_set_fetch_state (rd_kafka_toppar_t *rktp,
                                       int fetch_state);
 void rd_kafka_toppar_insert_msg (rd_kafka_toppar_t *rktp, rd_kafka_msg_t *rkm);
 void rd_kafka_toppar_enq_msg (rd_kafka_toppar_t *rktp, rd_kafka_msg_t *rkm);
+void rd_kafka_toppar_enq_msgq (rd_kafka_toppar_t *rktp,
+                               rd_kafka_msgq_t *rkmq);
 int rd_kafka_retry_msgq (rd_kafka_msgq_t *destq,
                          rd_kafka_msgq_t *srcq,
                          int incr_retry, int max_retries, rd_ts_t backoff,
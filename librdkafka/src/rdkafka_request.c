@@ -2727,7 +2727,11 @@ int rd_kafka_ProduceRequest (rd_kafka_broker_t *rkb, rd_kafka_toppar_t *rktp,
         rd_dassert(cnt > 0);
 
         rd_avg_add(&rktp->rktp_rkt->rkt_avg_batchcnt, (int64_t)cnt);
-        rd_avg_add(&rktp->rktp_rkt->rkt_avg_batchsize, (int64_t)MessageSetSize);
+        /* The size of a MessageSet that is being compressed by the
+         * compression thread pool is added when it is compressed. */
+        if (!(rkbuf->rkbuf_flags & RD_KAFKA_OP_F_COMPRESSING))
+                rd_avg_add(&rktp->rktp_rkt->rkt_avg_batchsize,
+                           (int64_t)MessageSetSize);
 
         if (!rkt->rkt_conf.required_acks)
                 rkbuf->rkbuf_flags |= RD_KAFKA_OP_F_NO_RESPONSE;
@@ -2750,9 +2754,8 @@ int rd_kafka_ProduceRequest (rd_kafka_broker_t *rkb, rd_kafka_toppar_t *rktp,
          * capped by socket.timeout.ms */
         rd_kafka_buf_set_abs_timeout(rkbuf, tmout, now);
 
-        rd_kafka_broker_buf_enq_replyq(rkb, rkbuf,
-                                       RD_KAFKA_NO_REPLYQ,
-                                       rd_kafka_handle_Produce, NULL);
+        rd_kafka_broker_buf_enq_produce(rkb, rkbuf,
+                                        rd_kafka_handle_Produce, NULL);
 
         return cnt;
 }
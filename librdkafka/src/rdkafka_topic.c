@@ -41,6 +41,7 @@
 
 #if WITH_ZSTD
 #include <zstd.h>
+#include "rdkafka_zstd.h"
 #endif
 
 
@@ -107,6 +108,66 @@ static void rd_kafka_topic_destroy_app (rd_kafka_topic_t *app_rkt) {
 }
 
 
+/**
+ * @brief Drop the ZSTD dictionary reference \p zdict (may be NULL).
+ */
+static void rd_kafka_topic_zstd_dict_destroy (struct rd_kafka_zstd_dict_s
+                                              *zdict) {
+#if WITH_ZSTD
+        if (zdict)
+                rd_kafka_zstd_dict_destroy(zdict);
+#endif
+}
+
+
+/**
+ * @brief Load the ZSTD dictionary of topic configuration \p tconf, if any:
+ *        the consumer needs it for any zstd-compressed MessageSets, the
+ *        producer only if it compresses with zstd.
+ *
+ * The dictionary file is read here, so this must not be called with
+ * the handle lock held.
+ *
+ * @returns 0 with \p *zdictp set to the dictionary, or NULL if none is
+ *          needed, or -1 with \p errstr set if loading failed.
+ */
+int rd_kafka_topic_conf_zstd_dict_load (rd_kafka_t *rk,
+                                        const rd_kafka_topic_conf_t *tconf,
+                                        struct rd_kafka_zstd_dict_s **zdictp,
+                                        char *errstr, size_t errstr_size) {
+#if WITH_ZSTD
+        int codec = tconf->compression_codec;
+        int level = tconf->compression_level;
+
+        *zdictp = NULL;
+
+        if (!tconf->zstd_dictionary_location)
+                return 0;
+
+        if (codec == RD_KAFKA_COMPRESSION_INHERIT)
+                codec = rk->rk_conf.compression_codec;
+
+        if (rk->rk_type != RD_KAFKA_CONSUMER &&
+            codec != RD_KAFKA_COMPRESSION_ZSTD)
+                return 0;
+
+        /* Same translation as in rd_kafka_topic_new0() */
+        if (level == RD_KAFKA_COMPLEVEL_DEFAULT)
+                level = 3;
+        else if (level > RD_KAFKA_COMPLEVEL_ZSTD_MAX)
+                level = RD_KAFKA_COMPLEVEL_ZSTD_MAX;
+
+        *zdictp = rd_kafka_zstd_dict_new(rk->rk_type,
+                                         tconf->zstd_dictionary_location,
+                                         level, errstr, errstr_size);
+        return *zdictp ? 0 : -1;
+#else
+        *zdictp = NULL;
+        return 0;
+#endif
+}
+
+
 /**
  * Final destructor for topic. Refcnt must be 0.
  */
@@ -125,6 +186,8 @@ void rd_kafka_topic_destroy_final (rd_kafka_itopic_t *rkt) {
         rd_avg_destroy(&rkt->rkt_avg_batchsize);
         rd_avg_destroy(&rkt->rkt_avg_batchcnt);
 
+        rd_kafka_topic_zstd_dict_destroy(rkt->rkt_zstd_dict);
+
 	if (rkt->rkt_topic)
 		rd_kafkap_str_destroy(rkt->rkt_topic);
 
@@ -218,6 +281,8 @@ int rd_kafka_topic_cmp_s_rkt (const void *_a, const void *_b) {
 shptr_rd_kafka_itopic_t *rd_kafka_topic_new0 (rd_kafka_t *rk,
                                               const char *topic,
                                               rd_kafka_topic_conf_t *conf,
+                                              struct rd_kafka_zstd_dict_s
+                                              *zdict,
                                               int *existing,
                                               int do_lock) {
 	rd_kafka_itopic_t *rkt;
@@ -232,6 +297,7 @@ shptr_rd_kafka_itopic_t *rd_kafka_topic_new0 (rd_kafka_t *rk,
 	if (!topic || strlen(topic) > 512) {
 		if (conf)
 			rd_kafka_topic_conf_destroy(conf);
+                rd_kafka_topic_zstd_dict_destroy(zdict);
 		rd_kafka_set_last_error(RD_KAFKA_RESP_ERR__INVALID_ARG,
 					EINVAL);
 		return NULL;
@@ -244,6 +310,7 @@ shptr_rd_kafka_itopic_t *rd_kafka_topic_new0 (rd_kafka_t *rk,
                         rd_kafka_wrunlock(rk);
 		if (conf)
 			rd_kafka_topic_conf_destroy(conf);
+                rd_kafka_topic_zstd_dict_destroy(zdict);
                 if (existing)
                         *existing = 1;
 		return s_rkt;
@@ -254,6 +321,10 @@ shptr_rd_kafka_itopic_t *rd_kafka_topic_new0 (rd_kafka_t *rk,
                         conf = rd_kafka_topic_conf_dup(rk->rk_conf.topic_conf);
                 else
                         conf = rd_kafka_topic_conf_new();
+#if WITH_ZSTD
+                if (rk->rk_zstd_dict)
+                        zdict = rd_kafka_zstd_dict_keep(rk->rk_zstd_dict);
+#endif
         }
 
 
@@ -267,6 +338,7 @@ shptr_rd_kafka_itopic_t *rd_kafka_topic_new0 (rd_kafka_t *rk,
                              "Incompatible configuration settings "
                              "for topic \"%s\": %s", topic, conf_err);
                 rd_kafka_topic_conf_destroy(conf);
+                rd_kafka_topic_zstd_dict_destroy(zdict);
                 rd_kafka_set_last_error(RD_KAFKA_RESP_ERR__INVALID_ARG, EINVAL);
                 return NULL;
         }
@@ -370,6 +442,10 @@ shptr_rd_kafka_itopic_t *rd_kafka_topic_new0 (rd_kafka_t *rk,
                 /* Compression level has no effect in this case */
                 rkt->rkt_conf.compression_level = RD_KAFKA_COMPLEVEL_DEFAULT;
         }
+
+        /* ZSTD dictionary, loaded by the caller since reading it
+         * must not block the handle lock. */
+        rkt->rkt_zstd_dict = zdict;
 	
         rd_avg_init(&rkt->rkt_avg_batchsize, RD_AVG_GAUGE, 0,
                     rk->rk_conf.max_msg_size, 2,
@@ -424,7 +500,25 @@ rd_kafka_topic_t *rd_kafka_topic_new (rd_kafka_t *rk, const char *topic,
         rd_kafka_topic_t *app_rkt;
         int existing;
 
-        s_rkt = rd_kafka_topic_new0(rk, topic, conf, &existing, 1/*lock*/);
+        struct rd_kafka_zstd_dict_s *zdict = NULL;
+        char errstr[256];
+
+        /* Load the topic's own ZSTD dictionary, if any, before
+         * rd_kafka_topic_new0() grabs the handle lock. */
+        if (conf &&
+            rd_kafka_topic_conf_zstd_dict_load(rk, conf, &zdict,
+                                               errstr, sizeof(errstr)) == -1) {
+                rd_kafka_log(rk, LOG_ERR, "TOPICCONF",
+                             "Failed to create topic \"%s\": %s",
+                             topic ? topic : "(null)", errstr);
+                rd_kafka_topic_conf_destroy(conf);
+                rd_kafka_set_last_error(RD_KAFKA_RESP_ERR__INVALID_ARG,
+                                        EINVAL);
+                return NULL;
+        }
+
+        s_rkt = rd_kafka_topic_new0(rk, topic, conf, zdict,
+                                    &existing, 1/*lock*/);
         if (!s_rkt)
                 return NULL;
 
@@ -79,6 +79,10 @@ struct rd_kafka_itopic_s {
 
         shptr_rd_kafka_itopic_t *rkt_shptr_app; /* Application's topic_new() */
 
+        /** ZSTD dictionary from compression.zstd.dictionary.location,
+         *  or NULL. Immutable. */
+        struct rd_kafka_zstd_dict_s *rkt_zstd_dict;
+
 	rd_kafka_topic_conf_t rkt_conf;
 };
 
@@ -131,8 +135,23 @@ rd_kafka_topic_destroy0 (shptr_rd_kafka_itopic_t *s_rkt) {
 }
 
 
+int rd_kafka_topic_conf_zstd_dict_load (rd_kafka_t *rk,
+                                        const rd_kafka_topic_conf_t *tconf,
+                                        struct rd_kafka_zstd_dict_s **zdictp,
+                                        char *errstr, size_t errstr_size);
+
+/**
+ * @brief Create a new topic, or return the existing one.
+ *
+ * \p zdict is the ZSTD dictionary of \p conf as loaded by
+ * rd_kafka_topic_conf_zstd_dict_load(), or NULL. Ownership of both is
+ * transferred. With a NULL \p conf the default topic configuration
+ * and its dictionary are used.
+ */
 shptr_rd_kafka_itopic_t *rd_kafka_topic_new0 (rd_kafka_t *rk, const char *topic,
                                               rd_kafka_topic_conf_t *conf,
+                                              struct rd_kafka_zstd_dict_s
+                                              *zdict,
                                               int *existing, int do_lock);
 
 shptr_rd_kafka_itopic_t *rd_kafka_topic_find_fl (const char *func, int line,
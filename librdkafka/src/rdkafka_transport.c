@@ -129,9 +129,12 @@ rd_kafka_transport_socket_sendmsg (rd_kafka_transport_t *rktrans,
         size_t iovlen;
         ssize_t r;
 
-        rd_slice_get_iov(slice, msg.msg_iov, &iovlen, IOV_MAX,
-                         /* FIXME: Measure the effects of this */
-                         rktrans->rktrans_sndbuf_size);
+        /* Hand the kernel as much of the request as there are iovecs for,
+         * rather than capping it at the socket send buffer size, so that
+         * a request with many (e.g., zero-copy payload) segments is
+         * written with as few calls as possible.
+         * The kernel will only accept what fits in the send buffer. */
+        rd_slice_get_iov(slice, msg.msg_iov, &iovlen, IOV_MAX, SIZE_MAX);
         msg.msg_iovlen = (int)iovlen;
 
 #ifdef __sun
@@ -221,9 +224,8 @@ rd_kafka_transport_socket_send (rd_kafka_transport_t *rktrans,
                                 rd_slice_t *slice,
                                 char *errstr, size_t errstr_size) {
 #ifndef _MSC_VER
-        /* FIXME: Use sendmsg() with iovecs if there's more than one segment
-         * remaining, otherwise (or if platform does not have sendmsg)
-         * use plain send(). */
+        /* Use sendmsg() with iovecs for all remaining segments,
+         * a single remaining segment is simply a single iovec. */
         return rd_kafka_transport_socket_sendmsg(rktrans, slice,
                                                  errstr, errstr_size);
 #endif
@@ -37,16 +37,177 @@
 #include <zstd.h>
 #include <zstd_errors.h>
 
+/* The parametric API (ZSTD_CCtx_reset(), ZSTD_CCtx_refCDict(),
+ * ZSTD_DCtx_refDDict(), ..) is part of the stable API since v1.4.0 */
+#define RD_ZSTD_HAS_PARAMETRIC_API                                     \
+        (ZSTD_VERSION_NUMBER >= (1*100*100+4*100+0))
+
+
+/**
+ * @brief Digested dictionary, see rd_kafka_zstd_dict_new().
+ */
+struct rd_kafka_zstd_dict_s {
+        ZSTD_CDict *cdict;     /**< Compression dictionary (producer) */
+        ZSTD_DDict *ddict;     /**< Decompression dictionary (consumer) */
+        unsigned int dict_id;  /**< Dictionary ID, 0 for raw content
+                                *   dictionaries. */
+        rd_refcnt_t refcnt;    /**< Shared by the topics using it */
+};
+
+
+/**
+ * Per-thread compression and decompression contexts, lazily created
+ * on first use by the broker and compression threads and
+ * reused for all subsequent MessageSets.
+ * Freed by rd_kafka_zstd_thread_cleanup().
+ */
+static RD_TLS ZSTD_CCtx *rd_kafka_zstd_cctx;
+static RD_TLS ZSTD_DCtx *rd_kafka_zstd_dctx;
+
+
+void rd_kafka_zstd_thread_cleanup (void) {
+        if (rd_kafka_zstd_cctx) {
+                ZSTD_freeCCtx(rd_kafka_zstd_cctx);
+                rd_kafka_zstd_cctx = NULL;
+        }
+
+        if (rd_kafka_zstd_dctx) {
+                ZSTD_freeDCtx(rd_kafka_zstd_dctx);
+                rd_kafka_zstd_dctx = NULL;
+        }
+}
+
+
+rd_kafka_zstd_dict_t *rd_kafka_zstd_dict_new (rd_kafka_type_t cltype,
+                                              const char *path,
+                                              int comp_level,
+                                              char *errstr,
+                                              size_t errstr_size) {
+#if !RD_ZSTD_HAS_PARAMETRIC_API
+        rd_snprintf(errstr, errstr_size,
+                    "ZSTD dictionaries require libzstd >= 1.4.0 "
+                    "(librdkafka was built with %s)", ZSTD_VERSION_STRING);
+        return NULL;
+#else
+        rd_kafka_zstd_dict_t *zdict;
+        FILE *fp;
+        long size;
+        char *buf;
+        size_t r;
+
+        if (!(fp = fopen(path, "rb"))) {
+                rd_snprintf(errstr, errstr_size,
+                            "Failed to open "
+                            "compression.zstd.dictionary.location: %s: %s",
+                            path, rd_strerror(errno));
+                return NULL;
+        }
+
+        if (fseek(fp, 0, SEEK_END) == -1 || (size = ftell(fp)) == -1 ||
+            fseek(fp, 0, SEEK_SET) == -1) {
+                rd_snprintf(errstr, errstr_size,
+                            "Failed to read ZSTD dictionary %s: %s",
+                            path, rd_strerror(errno));
+                fclose(fp);
+                return NULL;
+        }
+
+        if (size == 0) {
+                rd_snprintf(errstr, errstr_size,
+                            "ZSTD dictionary %s is empty", path);
+                fclose(fp);
+                return NULL;
+        }
+
+        buf = rd_malloc((size_t)size);
+        r = fread(buf, 1, (size_t)size, fp);
+        fclose(fp);
+
+        if (r != (size_t)size) {
+                rd_snprintf(errstr, errstr_size,
+                            "Failed to read ZSTD dictionary %s: "
+                            "short read (%"PRIusz"/%ld bytes)",
+                            path, r, size);
+                rd_free(buf);
+                return NULL;
+        }
+
+        zdict = rd_calloc(1, sizeof(*zdict));
+        rd_refcnt_init(&zdict->refcnt, 1);
+        zdict->dict_id = ZSTD_getDictID_fromDict(buf, (size_t)size);
+
+        /* The producer only compresses and the consumer only decompresses,
+         * so only digest the dictionary for the direction in use.
+         * The digested dictionaries copy the dictionary content. */
+        if (cltype == RD_KAFKA_PRODUCER) {
+                zdict->cdict = ZSTD_createCDict(buf, (size_t)size,
+                                                comp_level);
+                if (!zdict->cdict)
+                        goto err;
+        } else {
+                zdict->ddict = ZSTD_createDDict(buf, (size_t)size);
+                if (!zdict->ddict)
+                        goto err;
+        }
+
+        rd_free(buf);
+
+        return zdict;
+
+ err:
+        rd_snprintf(errstr, errstr_size,
+                    "Failed to load ZSTD dictionary %s (%ld bytes)",
+                    path, size);
+        rd_free(buf);
+        rd_kafka_zstd_dict_destroy(zdict);
+        return NULL;
+#endif
+}
+
+
+rd_kafka_zstd_dict_t *rd_kafka_zstd_dict_keep (rd_kafka_zstd_dict_t *zdict) {
+        rd_refcnt_add(&zdict->refcnt);
+        return zdict;
+}
+
+
+void rd_kafka_zstd_dict_destroy (rd_kafka_zstd_dict_t *zdict) {
+        if (rd_refcnt_sub(&zdict->refcnt) > 0)
+                return;
+
+        rd_refcnt_destroy(&zdict->refcnt);
+        if (zdict->cdict)
+                ZSTD_freeCDict(zdict->cdict);
+        if (zdict->ddict)
+                ZSTD_freeDDict(zdict->ddict);
+        rd_free(zdict);
+}
+
+
 rd_kafka_resp_err_t
 rd_kafka_zstd_decompress (rd_kafka_broker_t *rkb,
-                         char *inbuf, size_t inlen,
-                         void **outbuf, size_t *outlenp) {
+                          const rd_kafka_zstd_dict_t *zdict,
+                          char *inbuf, size_t inlen,
+                          void **outbuf, size_t *outlenp) {
         unsigned long long out_bufsize = ZSTD_getFrameContentSize(inbuf, inlen);
+        const size_t max_size = (size_t)rkb->rkb_rk->rk_conf.recv_max_msg_size;
+        rd_bool_t size_known = rd_true;
+#if RD_ZSTD_HAS_PARAMETRIC_API
+        unsigned int dict_id = ZSTD_getDictID_fromFrame(inbuf, inlen);
+#else
+        unsigned int dict_id = 0; /* Dictionaries are not supported */
+#endif
+        ZSTD_DCtx *dctx;
+        ZSTD_inBuffer in;
+        ZSTD_outBuffer out;
+        size_t r;
 
         switch (out_bufsize) {
         case ZSTD_CONTENTSIZE_UNKNOWN:
-                /* Decompressed size cannot be determined, make a guess */
-                out_bufsize = inlen * 2;
+                /* Decompressed size cannot be determined, make a guess
+                 * and grow the output buffer as needed. */
+                out_bufsize = RD_MAX(inlen * 2, 4000);
+                size_known = rd_false;
                 break;
         case ZSTD_CONTENTSIZE_ERROR:
                 /* Error calculating frame content size */
@@ -56,60 +217,124 @@ rd_kafka_zstd_decompress (rd_kafka_broker_t *rkb,
                            out_bufsize, "Error in determining frame size");
                 return RD_KAFKA_RESP_ERR__BAD_COMPRESSION;
         default:
+                /* Exact size known: allocate it all up front
+                 * (at least one byte for empty frames). */
+                if (out_bufsize == 0)
+                        out_bufsize = 1;
                 break;
         }
 
-        /* Increase output buffer until it can fit the entire result,
-         * capped by message.max.bytes */
-        while (out_bufsize <=
-               (unsigned long long)rkb->rkb_rk->rk_conf.recv_max_msg_size) {
-                size_t ret;
-                char *decompressed;
+        if (out_bufsize > (unsigned long long)max_size) {
+                if (size_known)
+                        goto err_too_large;
+                out_bufsize = max_size;
+        }
 
-                decompressed = rd_malloc((size_t)out_bufsize);
-                if (!decompressed) {
+        /* A frame compressed with a dictionary carries the dictionary ID
+         * (unless it is a raw content dictionary, which has ID 0).
+         * Only use the topic's dictionary if its ID matches, frames from
+         * producers not using a dictionary must be decompressed
+         * without it. */
+        if (dict_id != 0 && (!zdict || zdict->dict_id != dict_id)) {
+                rd_rkb_dbg(rkb, MSG, "ZSTD",
+                           "Unable to decompress ZSTD: frame was compressed "
+                           "with dictionary ID %u but %s: "
+                           "check compression.zstd.dictionary.location",
+                           dict_id,
+                           zdict ? "a different dictionary is configured" :
+                           "no dictionary is configured");
+                return RD_KAFKA_RESP_ERR__BAD_COMPRESSION;
+        }
+
+        if (unlikely(!rd_kafka_zstd_dctx)) {
+                if (!(rd_kafka_zstd_dctx = ZSTD_createDCtx())) {
                         rd_rkb_dbg(rkb, MSG, "ZSTD",
-                                   "Unable to allocate output buffer "
-                                   "(%llu bytes for %"PRIusz
-                                   " compressed bytes): %s",
-                                   out_bufsize, inlen, rd_strerror(errno));
+                                   "Unable to create ZSTD "
+                                   "decompression context");
                         return RD_KAFKA_RESP_ERR__CRIT_SYS_RESOURCE;
                 }
+        }
+        dctx = rd_kafka_zstd_dctx;
 
+#if RD_ZSTD_HAS_PARAMETRIC_API
+        ZSTD_DCtx_reset(dctx, ZSTD_reset_session_only);
+        /* The dictionary ID was verified above:
+         * zdict is either unset or matches the frame. */
+        r = ZSTD_DCtx_refDDict(dctx,
+                               zdict && zdict->dict_id == dict_id ?
+                               zdict->ddict : NULL);
+#else
+        r = ZSTD_initDStream(dctx);
+#endif
+        if (ZSTD_isError(r)) {
+                rd_rkb_dbg(rkb, MSG, "ZSTD",
+                           "Unable to begin ZSTD decompression: %s",
+                           ZSTD_getErrorName(r));
+                return RD_KAFKA_RESP_ERR__BAD_COMPRESSION;
+        }
+
+        out.dst = rd_malloc((size_t)out_bufsize);
+        out.size = (size_t)out_bufsize;
+        out.pos = 0;
+
+        in.src = inbuf;
+        in.size = inlen;
+        in.pos = 0;
 
-                ret = ZSTD_decompress(decompressed, (size_t)out_bufsize,
-                                      inbuf, inlen);
-                if (!ZSTD_isError(ret)) {
-                        *outlenp = ret;
-                        *outbuf = decompressed;
-                        return RD_KAFKA_RESP_ERR_NO_ERROR;
+        /* Stream decompress into the output buffer, growing it
+         * (rather than starting over) if the decompressed size is
+         * unknown and the initial guess was too small. */
+        while (1) {
+                r = ZSTD_decompressStream(dctx, &out, &in);
+                if (ZSTD_isError(r)) {
+                        rd_rkb_dbg(rkb, MSG, "ZSTD",
+                                   "Unable to decompress ZSTD "
+                                   "(out buffer is %"PRIusz" bytes): %s",
+                                   out.size, ZSTD_getErrorName(r));
+                        goto err;
                 }
 
-                rd_free(decompressed);
+                if (r == 0 && in.pos == in.size)
+                        break; /* Last frame fully decoded */
 
-                /* Check if the destination size is too small */
-                if (ZSTD_getErrorCode(ret) == ZSTD_error_dstSize_tooSmall) {
+                if (out.pos == out.size) {
+                        /* Output buffer full: grow quadratically */
+                        if (out.size >= max_size) {
+                                rd_free(out.dst);
+                                goto err_too_large;
+                        }
 
-                        /* Grow quadratically */
-                        out_bufsize += RD_MAX(out_bufsize * 2, 4000);
+                        out.size = RD_MIN(out.size + RD_MAX(out.size * 2,
+                                                            4000),
+                                          max_size);
+                        out.dst = rd_realloc(out.dst, out.size);
 
                         rd_atomic64_add(&rkb->rkb_c.zbuf_grow, 1);
 
-                } else {
-                        /* Fail on any other error */
+                } else if (in.pos == in.size) {
                         rd_rkb_dbg(rkb, MSG, "ZSTD",
-                                   "Unable to begin ZSTD decompression "
-                                   "(out buffer is %llu bytes): %s",
-                                   out_bufsize, ZSTD_getErrorName(ret));
-                        return RD_KAFKA_RESP_ERR__BAD_COMPRESSION;
+                                   "Unable to decompress ZSTD: "
+                                   "truncated frame (%"PRIusz" bytes)",
+                                   inlen);
+                        goto err;
                 }
         }
 
+        *outbuf = out.dst;
+        *outlenp = out.pos;
+
+        return RD_KAFKA_RESP_ERR_NO_ERROR;
+
+ err:
+        rd_free(out.dst);
+        return RD_KAFKA_RESP_ERR__BAD_COMPRESSION;
+
+ err_too_large:
         rd_rkb_dbg(rkb, MSG, "ZSTD",
                    "Unable to decompress ZSTD "
-                   "(input buffer %"PRIusz", output buffer %llu): "
+                   "(input buffer %"PRIusz"): "
                    "output would exceed receive.message.max.bytes (%d)",
-                   inlen, out_bufsize, rkb->rkb_rk->rk_conf.max_msg_size);
+                   inlen, rkb->rkb_rk->rk_conf.recv_max_msg_size);
 
         return RD_KAFKA_RESP_ERR__BAD_COMPRESSION;
 }
@@ -117,8 +342,9 @@ rd_kafka_zstd_decompress (rd_kafka_broker_t *rkb,
 
 rd_kafka_resp_err_t
 rd_kafka_zstd_compress (rd_kafka_broker_t *rkb, int comp_level,
-                       rd_slice_t *slice, void **outbuf, size_t *outlenp) {
-        ZSTD_CStream *cctx;
+                        const rd_kafka_zstd_dict_t *zdict,
+                        rd_slice_t *slice, void **outbuf, size_t *outlenp) {
+        ZSTD_CCtx *cctx;
         size_t r;
         rd_kafka_resp_err_t err = RD_KAFKA_RESP_ERR_NO_ERROR;
         size_t len = rd_slice_remains(slice);
@@ -137,22 +363,40 @@ rd_kafka_zstd_compress (rd_kafka_broker_t *rkb, int comp_level,
                 return RD_KAFKA_RESP_ERR__CRIT_SYS_RESOURCE;
         }
 
-
-        cctx = ZSTD_createCStream();
-        if (!cctx) {
-                rd_rkb_dbg(rkb, MSG, "ZSTDCOMPR",
-                           "Unable to create ZSTD compression context");
-                err = RD_KAFKA_RESP_ERR__CRIT_SYS_RESOURCE;
-                goto done;
+        if (unlikely(!rd_kafka_zstd_cctx)) {
+                if (!(rd_kafka_zstd_cctx = ZSTD_createCCtx())) {
+                        rd_rkb_dbg(rkb, MSG, "ZSTDCOMPR",
+                                   "Unable to create ZSTD "
+                                   "compression context");
+                        err = RD_KAFKA_RESP_ERR__CRIT_SYS_RESOURCE;
+                        goto done;
+                }
         }
+        cctx = rd_kafka_zstd_cctx;
 
-#if defined(WITH_ZSTD_STATIC) && ZSTD_VERSION_NUMBER >= (1*100*100+2*100+1) /* v1.2.1 */
+#if RD_ZSTD_HAS_PARAMETRIC_API
+        /* Reuse the context: reset the previous (possibly aborted) session
+         * and set this MessageSet's parameters.
+         * The compression level of a dictionary is set when the
+         * dictionary is digested and overrides the CCtx level. */
+        ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+        if (zdict)
+                r = ZSTD_CCtx_refCDict(cctx, zdict->cdict);
+        else if (!ZSTD_isError((r = ZSTD_CCtx_refCDict(cctx, NULL))))
+                r = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+                                           comp_level);
+        /* Include the decompressed size in the frame header */
+        if (!ZSTD_isError(r))
+                r = ZSTD_CCtx_setPledgedSrcSize(cctx, len);
+#elif defined(WITH_ZSTD_STATIC) && ZSTD_VERSION_NUMBER >= (1*100*100+2*100+1) /* v1.2.1 */
         r = ZSTD_initCStream_srcSize(cctx, comp_level, len);
+        (void)zdict; /* Dictionaries are not supported */
 #else
         /* libzstd not linked statically (or zstd version < 1.2.1):
          * decompression in consumer may be more costly due to
          * decompressed size not included in header by librdkafka producer */
         r = ZSTD_initCStream(cctx, comp_level);
+        (void)zdict; /* Dictionaries are not supported */
 #endif
         if (ZSTD_isError(r)) {
                 rd_rkb_dbg(rkb, MSG, "ZSTDCOMPR",
@@ -209,9 +453,6 @@ rd_kafka_zstd_compress (rd_kafka_broker_t *rkb, int comp_level,
         *outlenp = out.pos;
 
  done:
-        if (cctx)
-                ZSTD_freeCStream(cctx);
-
         if (err)
                 rd_free(out.dst);
 
@@ -29,18 +29,56 @@
 #ifndef _RDZSTD_H_
 #define _RDZSTD_H_
 
+typedef struct rd_kafka_zstd_dict_s rd_kafka_zstd_dict_t;
+
+/**
+ * @brief Load the ZSTD dictionary at \p path (a dictionary trained with
+ *        `zstd --train`, or raw content) and digest it for compression
+ *        at \p comp_level if \p cltype is a producer, else for
+ *        decompression.
+ *
+ * @returns the dictionary, or NULL on failure in which case \p errstr
+ *          is set.
+ */
+rd_kafka_zstd_dict_t *rd_kafka_zstd_dict_new (rd_kafka_type_t cltype,
+                                              const char *path,
+                                              int comp_level,
+                                              char *errstr,
+                                              size_t errstr_size);
+
+/**
+ * @returns a new reference to \p zdict.
+ */
+rd_kafka_zstd_dict_t *rd_kafka_zstd_dict_keep (rd_kafka_zstd_dict_t *zdict);
+
+/**
+ * @brief Drop a reference to \p zdict, freeing it with the last one.
+ */
+void rd_kafka_zstd_dict_destroy (rd_kafka_zstd_dict_t *zdict);
+
+/**
+ * @brief Free the calling thread's ZSTD compression and decompression
+ *        contexts, if any. Must be called by threads calling
+ *        rd_kafka_zstd_compress() or rd_kafka_zstd_decompress()
+ *        before they exit.
+ */
+void rd_kafka_zstd_thread_cleanup (void);
+
 /**
- * @brief Decompress ZSTD framed data.
+ * @brief Decompress ZSTD framed data, using \p zdict (optional) for
+ *        frames compressed with that dictionary.
  *
  * @returns allocated buffer in \p *outbuf, length in \p *outlenp on success.
  */
 rd_kafka_resp_err_t
 rd_kafka_zstd_decompress (rd_kafka_broker_t *rkb,
-                         char *inbuf, size_t inlen,
-                         void **outbuf, size_t *outlenp);
+                          const rd_kafka_zstd_dict_t *zdict,
+                          char *inbuf, size_t inlen,
+                          void **outbuf, size_t *outlenp);
 
 /**
- * Allocate space for \p *outbuf and compress all \p iovlen buffers in \p iov.
+ * Allocate space for \p *outbuf and compress all \p iovlen buffers in \p iov,
+ * using dictionary \p zdict (optional).
  * @param MessageSetSize indicates (at least) full uncompressed data size,
  *                       possibly including MessageSet fields that will not
  *                       be compressed.
@@ -49,6 +87,7 @@ rd_kafka_zstd_decompress (rd_kafka_broker_t *rkb,
  */
 rd_kafka_resp_err_t
 rd_kafka_zstd_compress (rd_kafka_broker_t *rkb, int comp_level,
-                       rd_slice_t *slice, void **outbuf, size_t *outlenp);
+                        const rd_kafka_zstd_dict_t *zdict,
+                        rd_slice_t *slice, void **outbuf, size_t *outlenp);
 
 #endif /* _RDZSTD_H_ */
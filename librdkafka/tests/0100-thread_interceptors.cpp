@@ -136,6 +136,7 @@ static void test_thread_cbs () {
   myThreadCb my_threads;
 
   Test::conf_set(conf, "bootstrap.servers", "127.0.0.1:1");
+  Test::conf_set(conf, "compression.threads", "2");
 
   /* Interceptors are not supported in the C++ API, instead use the C API:
    *  1. Extract the C conf_t object
@@ -159,10 +160,11 @@ static void test_thread_cbs () {
   Test::Say(tostr() << my_threads.startCount() << " thread start calls, " <<
             my_threads.exitCount() << " thread exit calls seen\n");
 
-  /* 3 = rdkafka main thread + internal broker + bootstrap broker */
-  if (my_threads.startCount() < 3)
+  /* 5 = rdkafka main thread + internal broker + bootstrap broker +
+   *     2 compression threads */
+  if (my_threads.startCount() < 5)
     Test::Fail("Did not catch enough thread start callback calls");
-  if (my_threads.exitCount() < 3)
+  if (my_threads.exitCount() < 5)
     Test::Fail("Did not catch enough thread exit callback calls");
   if (my_threads.startCount() != my_threads.exitCount())
     Test::Fail("Did not catch same number of start and exit callback calls");
@@ -0,0 +1,129 @@
+/*
+ * librdkafka - Apache Kafka C library
+ *
+ * Copyright (c) 2019, Magnus Edenhill
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test.h"
+
+#include "../src/rdkafka_mock.h"
+
+
+/**
+ * @name Verify the mock cluster: produce to and consume from a topic
+ *       using a consumer group, then verify the committed offsets.
+ */
+
+
+int main_0101_mock_cluster (int argc, char **argv) {
+        const char *topic = test_mk_topic_name("0101_mock_cluster", 1);
+        const int partition_cnt = 4;
+        const int msgcnt = 1000;
+        uint64_t testid = test_id_generate();
+        rd_kafka_mock_cluster_t *mcluster;
+        rd_kafka_conf_t *conf;
+        rd_kafka_topic_conf_t *tconf;
+        rd_kafka_t *p, *c;
+        rd_kafka_topic_t *rkt;
+        rd_kafka_topic_partition_list_t *parts;
+        rd_kafka_resp_err_t err;
+        char *bootstraps;
+        int64_t committed = 0;
+        int i;
+
+        /* Producer, with its own mock cluster */
+        test_conf_init(&conf, NULL, 30);
+        test_conf_set(conf, "test.mock.num.brokers", "3");
+        rd_kafka_conf_set_dr_msg_cb(conf, test_dr_msg_cb);
+        p = test_create_handle(RD_KAFKA_PRODUCER, conf);
+
+        mcluster = rd_kafka_handle_mock_cluster(p);
+        TEST_ASSERT(mcluster, "expected a mock cluster on the producer");
+
+        bootstraps = rd_strdup(rd_kafka_mock_cluster_bootstraps(mcluster));
+        TEST_SAY("Mock cluster bootstrap.servers: %s\n", bootstraps);
+
+        err = rd_kafka_mock_topic_create(mcluster, topic, partition_cnt, 3);
+        TEST_ASSERT(!err, "topic create failed: %s", rd_kafka_err2str(err));
+
+        err = rd_kafka_mock_topic_create(mcluster, topic, partition_cnt, 3);
+        TEST_ASSERT(err == RD_KAFKA_RESP_ERR_TOPIC_ALREADY_EXISTS,
+                    "expected topic create to fail with "
+                    "TOPIC_ALREADY_EXISTS, not %s", rd_kafka_err2name(err));
+
+        rkt = test_create_producer_topic(p, topic, NULL);
+        test_produce_msgs(p, rkt, testid, RD_KAFKA_PARTITION_UA, 0, msgcnt,
+                          NULL, 0);
+        rd_kafka_topic_destroy(rkt);
+
+        /* Balanced consumer connecting to the producer's mock cluster */
+        test_conf_init(&conf, &tconf, 30);
+        test_conf_set(conf, "bootstrap.servers", bootstraps);
+        test_conf_set(conf, "enable.auto.commit", "false");
+        test_topic_conf_set(tconf, "auto.offset.reset", "earliest");
+
+        c = test_create_consumer(topic, NULL, conf, tconf);
+        test_consumer_subscribe(c, topic);
+
+        test_consumer_poll("CONSUME", c, testid, -1, 0, msgcnt, NULL);
+
+        err = rd_kafka_commit(c, NULL, 0/*sync*/);
+        TEST_ASSERT(!err, "commit failed: %s", rd_kafka_err2str(err));
+
+        /* The committed offsets must add up to the number of messages */
+        parts = rd_kafka_topic_partition_list_new(partition_cnt);
+        for (i = 0 ; i < partition_cnt ; i++)
+                rd_kafka_topic_partition_list_add(parts, topic, i);
+
+        err = rd_kafka_committed(c, parts, tmout_multip(5000));
+        TEST_ASSERT(!err, "committed() failed: %s", rd_kafka_err2str(err));
+
+        for (i = 0 ; i < parts->cnt ; i++) {
+                TEST_SAY("%s [%"PRId32"] committed offset %"PRId64"\n",
+                         parts->elems[i].topic, parts->elems[i].partition,
+                         parts->elems[i].offset);
+                TEST_ASSERT(!parts->elems[i].err,
+                            "%s [%"PRId32"] error: %s",
+                            parts->elems[i].topic, parts->elems[i].partition,
+                            rd_kafka_err2str(parts->elems[i].err));
+                if (parts->elems[i].offset > 0)
+                        committed += parts->elems[i].offset;
+        }
+
+        TEST_ASSERT(committed == msgcnt,
+                    "expected committed offsets to sum up to %d, not %"PRId64,
+                    msgcnt, committed);
+
+        rd_kafka_topic_partition_list_destroy(parts);
+
+        test_consumer_close(c);
+        rd_kafka_destroy(c);
+
+        rd_kafka_destroy(p);
+
+        rd_free(bootstraps);
+
+        return 0;
+}
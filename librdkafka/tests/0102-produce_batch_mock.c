@@ -0,0 +1,267 @@
+/*
+ * librdkafka - Apache Kafka C library
+ *
+ * Copyright (c) 2019, Magnus Edenhill
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test.h"
+
+#include "../src/rdkafka_mock.h"
+
+
+/**
+ * @name Verify that rd_kafka_produce_batch() maintains per-partition
+ *       ordering when messages are grouped by partition, for all three
+ *       partitioning modes, and that messages to unknown partitions
+ *       fail without affecting the rest of the batch.
+ *       Also verify that batches blocking on a full queue
+ *       (RD_KAFKA_MSG_F_BLOCK) deliver every message once, in order.
+ *
+ * Uses the mock cluster.
+ */
+
+#define PARTITION_CNT  4
+#define BATCH_SIZE     1000
+#define MAX_SEQ        (3 * BATCH_SIZE)
+
+static int dr_cnt;
+static int dr_fails;
+static int last_seq[PARTITION_CNT];
+static int delivered[MAX_SEQ + 1]; /**< Delivery count per seq */
+
+static void dr_msg_cb (rd_kafka_t *rk, const rd_kafka_message_t *rkmessage,
+                       void *opaque) {
+        int seq = (int)(intptr_t)rkmessage->_private;
+
+        dr_cnt++;
+
+        TEST_ASSERT(seq > 0 && seq <= MAX_SEQ, "unexpected seq %d", seq);
+        TEST_ASSERT(++delivered[seq] == 1,
+                    "message %d delivered %d times", seq, delivered[seq]);
+
+        if (rkmessage->err) {
+                TEST_WARN("Message %d delivery failed: %s\n",
+                          seq, rd_kafka_err2str(rkmessage->err));
+                dr_fails++;
+                return;
+        }
+
+        TEST_ASSERT(rkmessage->partition >= 0 &&
+                    rkmessage->partition < PARTITION_CNT,
+                    "unexpected partition %"PRId32, rkmessage->partition);
+
+        TEST_ASSERT(seq > last_seq[rkmessage->partition],
+                    "message %d delivered after message %d on partition "
+                    "%"PRId32, seq, last_seq[rkmessage->partition],
+                    rkmessage->partition);
+
+        last_seq[rkmessage->partition] = seq;
+}
+
+
+static void do_produce_batch (rd_kafka_topic_t *rkt, const char *what,
+                              int32_t partition, int msgflags,
+                              int *seqp, int bad_partition_cnt) {
+        rd_kafka_message_t *rkmessages;
+        char keys[BATCH_SIZE][16];
+        int i, r, exp_good = BATCH_SIZE - bad_partition_cnt;
+
+        TEST_SAY("%s: producing %d messages (%d to an unknown partition)\n",
+                 what, BATCH_SIZE, bad_partition_cnt);
+
+        rkmessages = calloc(BATCH_SIZE, sizeof(*rkmessages));
+
+        for (i = 0 ; i < BATCH_SIZE ; i++) {
+                rd_snprintf(keys[i], sizeof(keys[i]), "key%d", i % 17);
+                rkmessages[i].key = keys[i];
+                rkmessages[i].key_len = strlen(keys[i]);
+                rkmessages[i].payload = keys[i];
+                rkmessages[i].len = strlen(keys[i]);
+                rkmessages[i]._private = (void *)(intptr_t)++(*seqp);
+                if (i < bad_partition_cnt)
+                        rkmessages[i].partition = PARTITION_CNT + 10;
+                else
+                        rkmessages[i].partition = (i * 7) % PARTITION_CNT;
+        }
+
+        r = rd_kafka_produce_batch(rkt, partition, msgflags,
+                                   rkmessages, BATCH_SIZE);
+        TEST_ASSERT(r == exp_good, "%s: expected %d messages to be produced, "
+                    "not %d", what, exp_good, r);
+
+        for (i = 0 ; i < BATCH_SIZE ; i++) {
+                rd_kafka_resp_err_t exp_err = i < bad_partition_cnt ?
+                        RD_KAFKA_RESP_ERR__UNKNOWN_PARTITION :
+                        RD_KAFKA_RESP_ERR_NO_ERROR;
+                TEST_ASSERT(rkmessages[i].err == exp_err,
+                            "%s: message %d: expected %s, not %s",
+                            what, i, rd_kafka_err2name(exp_err),
+                            rd_kafka_err2name(rkmessages[i].err));
+        }
+
+        free(rkmessages);
+}
+
+
+static void reset_state (void) {
+        dr_cnt = 0;
+        dr_fails = 0;
+        memset(last_seq, 0, sizeof(last_seq));
+        memset(delivered, 0, sizeof(delivered));
+}
+
+
+static rd_atomic32_t poller_term;
+
+/**
+ * @brief Serve delivery reports while the main thread is blocked in
+ *        rd_kafka_produce_batch(), messages are only removed from the
+ *        queue once their delivery report has been served.
+ */
+static int poller_thrd_main (void *arg) {
+        rd_kafka_t *rk = arg;
+
+        while (!rd_atomic32_get(&poller_term))
+                rd_kafka_poll(rk, 100);
+
+        return 0;
+}
+
+
+/**
+ * @brief Produce batches many times the size of
+ *        queue.buffering.max.messages with RD_KAFKA_MSG_F_BLOCK, which
+ *        enqueues the messages collected so far and blocks whenever the
+ *        queue is full.
+ */
+static void do_test_block (void) {
+        const char *topic = test_mk_topic_name("0102_produce_batch_block",
+                                               1);
+        rd_kafka_mock_cluster_t *mcluster;
+        rd_kafka_conf_t *conf;
+        rd_kafka_t *rk;
+        rd_kafka_topic_t *rkt;
+        rd_kafka_resp_err_t err;
+        thrd_t poller;
+        int seq = 0;
+        int i, res;
+
+        TEST_SAY(_C_MAG "[ Test blocking produce_batch ]\n");
+
+        reset_state();
+
+        test_conf_init(&conf, NULL, 30);
+        test_conf_set(conf, "test.mock.num.brokers", "1");
+        test_conf_set(conf, "queue.buffering.max.messages", "50");
+        rd_kafka_conf_set_dr_msg_cb(conf, dr_msg_cb);
+        rk = test_create_handle(RD_KAFKA_PRODUCER, conf);
+
+        mcluster = rd_kafka_handle_mock_cluster(rk);
+        err = rd_kafka_mock_topic_create(mcluster, topic, PARTITION_CNT, 1);
+        TEST_ASSERT(!err, "topic create failed: %s", rd_kafka_err2str(err));
+
+        rkt = test_create_producer_topic(rk, topic, NULL);
+
+        rd_atomic32_init(&poller_term, 0);
+        if (thrd_create(&poller, poller_thrd_main, rk) != thrd_success)
+                TEST_FAIL("Failed to create poller thread");
+
+        do_produce_batch(rkt, "blocking partitioner", RD_KAFKA_PARTITION_UA,
+                         RD_KAFKA_MSG_F_COPY|RD_KAFKA_MSG_F_BLOCK, &seq, 0);
+        do_produce_batch(rkt, "blocking per-message partition",
+                         RD_KAFKA_PARTITION_UA,
+                         RD_KAFKA_MSG_F_COPY|RD_KAFKA_MSG_F_PARTITION|
+                         RD_KAFKA_MSG_F_BLOCK, &seq, 0);
+        do_produce_batch(rkt, "blocking fixed partition", 2,
+                         RD_KAFKA_MSG_F_COPY|RD_KAFKA_MSG_F_BLOCK, &seq, 0);
+
+        rd_atomic32_set(&poller_term, 1);
+        thrd_join(poller, &res);
+
+        test_flush(rk, tmout_multip(10000));
+
+        TEST_ASSERT(dr_cnt == 3 * BATCH_SIZE,
+                    "expected %d delivery reports, not %d",
+                    3 * BATCH_SIZE, dr_cnt);
+        TEST_ASSERT(dr_fails == 0, "%d messages failed delivery", dr_fails);
+        for (i = 1 ; i <= seq ; i++)
+                TEST_ASSERT(delivered[i] == 1,
+                            "message %d delivered %d times", i, delivered[i]);
+
+        rd_kafka_topic_destroy(rkt);
+        rd_kafka_destroy(rk);
+}
+
+
+int main_0102_produce_batch_mock (int argc, char **argv) {
+        const char *topic = test_mk_topic_name("0102_produce_batch_mock", 1);
+        const int bad_cnt = 10;
+        rd_kafka_mock_cluster_t *mcluster;
+        rd_kafka_conf_t *conf;
+        rd_kafka_t *rk;
+        rd_kafka_topic_t *rkt;
+        const struct rd_kafka_metadata *md;
+        rd_kafka_resp_err_t err;
+        int seq = 0;
+
+        test_conf_init(&conf, NULL, 30);
+        test_conf_set(conf, "test.mock.num.brokers", "1");
+        rd_kafka_conf_set_dr_msg_cb(conf, dr_msg_cb);
+        rk = test_create_handle(RD_KAFKA_PRODUCER, conf);
+
+        mcluster = rd_kafka_handle_mock_cluster(rk);
+        err = rd_kafka_mock_topic_create(mcluster, topic, PARTITION_CNT, 1);
+        TEST_ASSERT(!err, "topic create failed: %s", rd_kafka_err2str(err));
+
+        rkt = test_create_producer_topic(rk, topic, NULL);
+
+        /* Make sure the partition count is known so that messages to
+         * unknown partitions fail immediately. */
+        err = rd_kafka_metadata(rk, 0, rkt, &md, tmout_multip(5000));
+        TEST_ASSERT(!err, "metadata failed: %s", rd_kafka_err2str(err));
+        rd_kafka_metadata_destroy(md);
+
+        do_produce_batch(rkt, "partitioner", RD_KAFKA_PARTITION_UA,
+                         RD_KAFKA_MSG_F_COPY, &seq, 0);
+        do_produce_batch(rkt, "per-message partition", RD_KAFKA_PARTITION_UA,
+                         RD_KAFKA_MSG_F_COPY|RD_KAFKA_MSG_F_PARTITION,
+                         &seq, bad_cnt);
+        do_produce_batch(rkt, "fixed partition", 2,
+                         RD_KAFKA_MSG_F_COPY, &seq, 0);
+
+        test_flush(rk, tmout_multip(10000));
+
+        TEST_ASSERT(dr_cnt == 3 * BATCH_SIZE - bad_cnt,
+                    "expected %d delivery reports, not %d",
+                    3 * BATCH_SIZE - bad_cnt, dr_cnt);
+        TEST_ASSERT(dr_fails == 0, "%d messages failed delivery", dr_fails);
+
+        rd_kafka_topic_destroy(rkt);
+        rd_kafka_destroy(rk);
+
+        do_test_block();
+
+        return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * librdkafka - Apache Kafka C library
+ *
+ * Copyright (c) 2019, Magnus Edenhill
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test.h"
+
+#include "../src/rdkafka_mock.h"
+
+
+/**
+ * @name Produce messages of varying sizes with enable.produce.zerocopy
+ *       to the mock cluster, with and without compression, and verify
+ *       that they are consumed intact.
+ */
+
+#define MSGCNT 200
+
+static int dr_cnt;
+
+static void dr_msg_cb (rd_kafka_t *rk, const rd_kafka_message_t *rkmessage,
+                       void *opaque) {
+        TEST_ASSERT(!rkmessage->err, "message delivery failed: %s",
+                    rd_kafka_err2str(rkmessage->err));
+        dr_cnt++;
+}
+
+/**
+ * @returns the payload size for message \p i, 0..~64KB.
+ */
+static size_t msg_size (int i) {
+        static const size_t sizes[] = { 0, 7, 100, 4096, 20000, 65536 };
+        return sizes[i % RD_ARRAYSIZE(sizes)] + (size_t)i;
+}
+
+static void msg_fill (char *p, size_t size, int i) {
+        size_t j;
+        for (j = 0 ; j < size ; j++)
+                p[j] = (char)((i * 31 + j) & 0xff);
+}
+
+static int msg_verify (const char *p, size_t size, int i) {
+        size_t j;
+        for (j = 0 ; j < size ; j++)
+                if (p[j] != (char)((i * 31 + j) & 0xff))
+                        return 0;
+        return 1;
+}
+
+
+static void do_test_zerocopy (const char *compression) {
+        const char *topic = test_mk_topic_name("0103_produce_zerocopy_mock", 1);
+        rd_kafka_mock_cluster_t *mcluster;
+        rd_kafka_conf_t *conf;
+        rd_kafka_t *p, *c;
+        rd_kafka_topic_partition_list_t *parts;
+        rd_kafka_resp_err_t err;
+        char *bootstraps;
+        int i, cnt = 0;
+
+        dr_cnt = 0;
+
+        TEST_SAY(_C_MAG "[ Test zero-copy produce with compression.codec=%s ]\n",
+                 compression);
+
+        test_conf_init(&conf, NULL, 60);
+        test_conf_set(conf, "test.mock.num.brokers", "3");
+        test_conf_set(conf, "enable.produce.zerocopy", "true");
+        test_conf_set(conf, "compression.codec", compression);
+        test_conf_set(conf, "linger.ms", "100");
+        rd_kafka_conf_set_dr_msg_cb(conf, dr_msg_cb);
+        p = test_create_handle(RD_KAFKA_PRODUCER, conf);
+
+        mcluster = rd_kafka_handle_mock_cluster(p);
+        bootstraps = rd_strdup(rd_kafka_mock_cluster_bootstraps(mcluster));
+        err = rd_kafka_mock_topic_create(mcluster, topic, 1, 1);
+        TEST_ASSERT(!err, "topic create failed: %s", rd_kafka_err2str(err));
+
+        /* Alternate between copied and application-owned payloads */
+        for (i = 0 ; i < MSGCNT ; i++) {
+                size_t size = msg_size(i);
+                char *payload = malloc(RD_MAX(size, 1));
+                int msgflags = (i & 1) ? RD_KAFKA_MSG_F_FREE :
+                        RD_KAFKA_MSG_F_COPY;
+
+                msg_fill(payload, size, i);
+
+                err = rd_kafka_producev(p,
+                                        RD_KAFKA_V_TOPIC(topic),
+                                        RD_KAFKA_V_PARTITION(0),
+                                        RD_KAFKA_V_VALUE(payload, size),
+                                        RD_KAFKA_V_MSGFLAGS(msgflags),
+                                        RD_KAFKA_V_END);
+                TEST_ASSERT(!err, "producev() failed: %s",
+                            rd_kafka_err2str(err));
+
+                if (msgflags == RD_KAFKA_MSG_F_COPY)
+                        free(payload);
+        }
+
+        test_flush(p, tmout_multip(10000));
+        TEST_ASSERT(dr_cnt == MSGCNT, "expected %d delivery reports, not %d",
+                    MSGCNT, dr_cnt);
+
+        /* Consume the messages back */
+        test_conf_init(&conf, NULL, 60);
+        test_conf_set(conf, "bootstrap.servers", bootstraps);
+        c = test_create_consumer(topic, NULL, conf, NULL);
+
+        parts = rd_kafka_topic_partition_list_new(1);
+        rd_kafka_topic_partition_list_add(parts, topic, 0)->offset =
+                RD_KAFKA_OFFSET_BEGINNING;
+        test_consumer_assign("ASSIGN", c, parts);
+        rd_kafka_topic_partition_list_destroy(parts);
+
+        while (cnt < MSGCNT) {
+                rd_kafka_message_t *rkm;
+
+                rkm = rd_kafka_consumer_poll(c, tmout_multip(10000));
+                TEST_ASSERT(rkm, "timed out waiting for message %d", cnt);
+
+                if (rkm->err) {
+                        TEST_SAY("Consumer error: %s\n",
+                                 rd_kafka_message_errstr(rkm));
+                        rd_kafka_message_destroy(rkm);
+                        continue;
+                }
+
+                TEST_ASSERT(rkm->offset == cnt,
+                            "expected offset %d, not %"PRId64,
+                            cnt, rkm->offset);
+                TEST_ASSERT(rkm->len == msg_size(cnt),
+                            "message %d: expected size %"PRIusz", "
+                            "not %"PRIusz, cnt, msg_size(cnt), rkm->len);
+                TEST_ASSERT(msg_verify(rkm->payload, rkm->len, cnt),
+                            "message %d: payload mismatch", cnt);
+
+                rd_kafka_message_destroy(rkm);
+                cnt++;
+        }
+
+        TEST_SAY("Consumed and verified %d messages\n", cnt);
+
+        test_consumer_close(c);
+        rd_kafka_destroy(c);
+        rd_kafka_destroy(p);
+        rd_free(bootstraps);
+}
+
+
+int main_0103_produce_zerocopy_mock (int argc, char **argv) {
+        do_test_zerocopy("none");
+        do_test_zerocopy("gzip");
+        return 0;
+}
@@ -0,0 +1,247 @@
+/*
+ * librdkafka - Apache Kafka C library
+ *
+ * Copyright (c) 2019, Magnus Edenhill
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "test.h"
+
+#include "../src/rdkafka_mock.h"
+
+
+/**
+ * @name Produce to the mock cluster with the compression thread pool
+ *       enabled (compression.threads) and verify that messages are
+ *       delivered in order, per partition, at consecutive offsets.
+ */
+
+#define PARTITION_CNT  8
+#define MSGCNT         20000
+
+static int dr_cnt;
+static int last_seq[PARTITION_CNT];
+static int64_t next_offset[PARTITION_CNT];
+
+static void dr_msg_cb (rd_kafka_t *rk, const rd_kafka_message_t *rkmessage,
+                       void *opaque) {
+        int seq = (int)(intptr_t)rkmessage->_private;
+        int32_t partition = rkmessage->partition;
+
+        TEST_ASSERT(!rkmessage->err, "message %d delivery failed: %s",
+                    seq, rd_kafka_err2str(rkmessage->err));
+        TEST_ASSERT(partition >= 0 && partition < PARTITION_CNT,
+                    "unexpected partition %"PRId32, partition);
+
+        TEST_ASSERT(seq > last_seq[partition],
+                    "message %d delivered after message %d on partition "
+                    "%"PRId32, seq, last_seq[partition], partition);
+        TEST_ASSERT(rkmessage->offset == next_offset[partition],
+                    "message %d on partition %"PRId32": expected offset "
+                    "%"PRId64", not %"PRId64,
+                    seq, partition, next_offset[partition],
+                    rkmessage->offset);
+
+        last_seq[partition] = seq;
+        next_offset[partition]++;
+        dr_cnt++;
+}
+
+
+static void do_test_compress_threads (const char *compression,
+                                      rd_bool_t idempotence) {
+        const char *topic = test_mk_topic_name("0104_compress_threads", 1);
+        rd_kafka_mock_cluster_t *mcluster;
+        rd_kafka_conf_t *conf;
+        rd_kafka_t *rk;
+        rd_kafka_resp_err_t err;
+        char payload[200];
+        int i;
+
+        TEST_SAY(_C_MAG "[ Test compression.threads with "
+                 "compression.codec=%s%s ]\n",
+                 compression, idempotence ? " and idempotence" : "");
+
+        dr_cnt = 0;
+        memset(last_seq, 0, sizeof(last_seq));
+        memset(next_offset, 0, sizeof(next_offset));
+
+        test_conf_init(&conf, NULL, 60);
+        test_conf_set(conf, "test.mock.num.brokers", "3");
+        test_conf_set(conf, "compression.threads", "4");
+        test_conf_set(conf, "compression.codec", compression);
+        test_conf_set(conf, "batch.num.messages", "100");
+        test_conf_set(conf, "linger.ms", "5");
+        if (idempotence)
+                test_conf_set(conf, "enable.idempotence", "true");
+        else
+                /* Allow several MessageSets per partition to be
+                 * compressed at the same time. */
+                test_conf_set(conf, "queue.buffering.backpressure.threshold",
+                              "4");
+        rd_kafka_conf_set_dr_msg_cb(conf, dr_msg_cb);
+        rk = test_create_handle(RD_KAFKA_PRODUCER, conf);
+
+        mcluster = rd_kafka_handle_mock_cluster(rk);
+        err = rd_kafka_mock_topic_create(mcluster, topic, PARTITION_CNT, 3);
+        TEST_ASSERT(!err, "topic create failed: %s", rd_kafka_err2str(err));
+
+        for (i = 0 ; i < MSGCNT ; i++) {
+                int32_t partition = i % PARTITION_CNT;
+
+                /* Compressible payload */
+                rd_snprintf(payload, sizeof(payload),
+                            "partition %"PRId32" message %d: "
+                            "0123456789012345678901234567890123456789",
+                            partition, i);
+
+                err = rd_kafka_producev(rk,
+                                        RD_KAFKA_V_TOPIC(topic),
+                                        RD_KAFKA_V_PARTITION(partition),
+                                        RD_KAFKA_V_VALUE(payload,
+                                                         strlen(payload)),
+                                        RD_KAFKA_V_MSGFLAGS(
+                                                RD_KAFKA_MSG_F_COPY),
+                                        RD_KAFKA_V_OPAQUE((void *)
+                                                          (intptr_t)(i+1)),
+                                        RD_KAFKA_V_END);
+                TEST_ASSERT(!err, "producev() failed: %s",
+                            rd_kafka_err2str(err));
+
+                rd_kafka_poll(rk, 0);
+        }
+
+        test_flush(rk, tmout_multip(30000));
+
+        TEST_ASSERT(dr_cnt == MSGCNT, "expected %d delivery reports, not %d",
+                    MSGCNT, dr_cnt);
+
+        rd_kafka_destroy(rk);
+}
+
+
+static int purged_cnt;
+
+static void purge_dr_msg_cb (rd_kafka_t *rk,
+                             const rd_kafka_message_t *rkmessage,
+                             void *opaque) {
+        int seq = (int)(intptr_t)rkmessage->_private;
+
+        if (rkmessage->err == RD_KAFKA_RESP_ERR__PURGE_QUEUE) {
+                purged_cnt++;
+                return;
+        }
+
+        TEST_ASSERT(!rkmessage->err, "message %d delivery failed: %s",
+                    seq, rd_kafka_err2str(rkmessage->err));
+        dr_cnt++;
+}
+
+
+/**
+ * @brief Purge the queues while MessageSets are being compressed and
+ *        verify that every message gets a delivery report.
+ */
+static void do_test_compress_threads_purge (void) {
+        const char *topic = test_mk_topic_name("0104_compress_threads", 1);
+        rd_kafka_mock_cluster_t *mcluster;
+        rd_kafka_conf_t *conf;
+        rd_kafka_t *rk;
+        rd_kafka_resp_err_t err;
+        char payload[200];
+        int i;
+
+        TEST_SAY(_C_MAG "[ Test compression.threads with purge ]\n");
+
+        dr_cnt = 0;
+        purged_cnt = 0;
+
+        test_conf_init(&conf, NULL, 60);
+        test_conf_set(conf, "test.mock.num.brokers", "3");
+        test_conf_set(conf, "compression.threads", "2");
+        test_conf_set(conf, "compression.codec", "lz4");
+        test_conf_set(conf, "batch.num.messages", "100");
+        test_conf_set(conf, "linger.ms", "0");
+        test_conf_set(conf, "queue.buffering.backpressure.threshold", "4");
+        rd_kafka_conf_set_dr_msg_cb(conf, purge_dr_msg_cb);
+        rk = test_create_handle(RD_KAFKA_PRODUCER, conf);
+
+        mcluster = rd_kafka_handle_mock_cluster(rk);
+        err = rd_kafka_mock_topic_create(mcluster, topic, PARTITION_CNT, 3);
+        TEST_ASSERT(!err, "topic create failed: %s", rd_kafka_err2str(err));
+
+        for (i = 0 ; i < MSGCNT ; i++) {
+                int32_t partition = i % PARTITION_CNT;
+
+                rd_snprintf(payload, sizeof(payload),
+                            "partition %"PRId32" message %d: "
+                            "0123456789012345678901234567890123456789",
+                            partition, i);
+
+                err = rd_kafka_producev(rk,
+                                        RD_KAFKA_V_TOPIC(topic),
+                                        RD_KAFKA_V_PARTITION(partition),
+                                        RD_KAFKA_V_VALUE(payload,
+                                                         strlen(payload)),
+                                        RD_KAFKA_V_MSGFLAGS(
+                                                RD_KAFKA_MSG_F_COPY),
+                                        RD_KAFKA_V_OPAQUE((void *)
+                                                          (intptr_t)(i+1)),
+                                        RD_KAFKA_V_END);
+                TEST_ASSERT(!err, "producev() failed: %s",
+                            rd_kafka_err2str(err));
+
+                /* Wait for the partition leaders with the first
+                 * messages, then purge a few times while producing. */
+                if (i == PARTITION_CNT - 1)
+                        test_flush(rk, tmout_multip(10000));
+                else if ((i % (MSGCNT / 4)) == (MSGCNT / 4) - 1) {
+                        err = rd_kafka_purge(rk, RD_KAFKA_PURGE_F_QUEUE);
+                        TEST_ASSERT(!err, "purge failed: %s",
+                                    rd_kafka_err2str(err));
+                }
+
+                rd_kafka_poll(rk, 0);
+        }
+
+        test_flush(rk, tmout_multip(30000));
+
+        TEST_SAY("%d message(s) delivered, %d purged\n",
+                 dr_cnt, purged_cnt);
+        TEST_ASSERT(dr_cnt + purged_cnt == MSGCNT,
+                    "expected %d delivery reports, not %d + %d purged",
+                    MSGCNT, dr_cnt, purged_cnt);
+
+        rd_kafka_destroy(rk);
+}
+
+
+int main_0104_produce_compress_threads_mock (int argc, char **argv) {
+        do_test_compress_threads("lz4", rd_false);
+        do_test_compress_threads("lz4", rd_true);
+        if (test_check_builtin("zstd"))
+                do_test_compress_threads("zstd", rd_false);
+        do_test_compress_threads_purge();
+        return 0;
+}
@@ -0,0 +1,369 @@
+/*
+ * librdkafka - Apache Kafka C library
+ *
+ * Copyright (c) 2019, Magnus Edenhill
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "test.h"
+
+#include "../src/rdkafka_mock.h"
+
+
+/**
+ * @name Produce small zstd-compressed MessageSets using a dictionary
+ *       (compression.zstd.dictionary.location) to the mock cluster
+ *       and verify that a consumer configured with the same dictionary
+ *       consumes them intact, while consumers without the dictionary or
+ *       with a different one fail with __BAD_COMPRESSION.
+ *       This is done for a raw content dictionary (dictionary ID 0) and
+ *       for a trained zstd format dictionary with a dictionary ID.
+ */
+
+#define MSGCNT 1000
+
+static int dr_cnt;
+
+static void dr_msg_cb (rd_kafka_t *rk, const rd_kafka_message_t *rkmessage,
+                       void *opaque) {
+        TEST_ASSERT(!rkmessage->err, "message delivery failed: %s",
+                    rd_kafka_err2str(rkmessage->err));
+        dr_cnt++;
+}
+
+/**
+ * @brief Small, similar JSON records.
+ */
+static void msg_fmt (char *buf, size_t size, int i) {
+        rd_snprintf(buf, size,
+                    "{\"id\": %d, \"user\": \"user%d\", "
+                    "\"event\": \"%s\", \"value\": %d}",
+                    i, i % 17, (i & 1) ? "click" : "view", i * 7);
+}
+
+
+/**
+ * @brief zstd format dictionary with dictionary ID 105, trained on
+ *        2000 msg_fmt() records (ids 2000000..2001999) with:
+ *        zstd --train --dictID=105 --maxdict=256
+ */
+static const unsigned char trained_dict[] = {
+        0x37, 0xa4, 0x30, 0xec, 0x69, 0x00, 0x00, 0x00, 0x17, 0x10, 0xe0, 0x0a,
+        0xa5, 0x0e, 0xff, 0xff, 0xff, 0xff, 0xeb, 0xff, 0xdf, 0xdd, 0xde, 0x7b,
+        0x93, 0xbd, 0x77, 0x03, 0xf0, 0x6b, 0xad, 0x05, 0xd3, 0x01, 0x00, 0x00,
+        0x00, 0x00, 0xb4, 0x3a, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x80,
+        0x18, 0x17, 0x03, 0x45, 0x45, 0x00, 0x15, 0x05, 0x2b, 0x33, 0x0f, 0x01,
+        0xc4, 0x50, 0x00, 0x00, 0x0e, 0x20, 0xea, 0x03, 0x00, 0x00, 0xb0, 0xd0,
+        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd4, 0xef, 0x0b, 0x24,
+        0x44, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x08,
+        0x00, 0x00, 0x00, 0x65, 0x22, 0x3a, 0x20, 0x31, 0x34, 0x30, 0x30, 0x32,
+        0x35, 0x34, 0x38, 0x7d, 0x7b, 0x22, 0x69, 0x64, 0x22, 0x3a, 0x20, 0x32,
+        0x30, 0x30, 0x31, 0x39, 0x32, 0x32, 0x2c, 0x20, 0x22, 0x75, 0x73, 0x65,
+        0x72, 0x22, 0x3a, 0x20, 0x22, 0x75, 0x73, 0x65, 0x72, 0x32, 0x22, 0x2c,
+        0x20, 0x22, 0x65, 0x76, 0x65, 0x65, 0x22, 0x3a, 0x20, 0x31, 0x34, 0x30,
+        0x30, 0x35, 0x34, 0x36, 0x30, 0x7d, 0x7b, 0x22, 0x69, 0x64, 0x22, 0x3a,
+        0x20, 0x32, 0x30, 0x30, 0x31, 0x38, 0x37, 0x35, 0x2c, 0x20, 0x22, 0x75,
+        0x73, 0x65, 0x72, 0x22, 0x3a, 0x20, 0x22, 0x75, 0x73, 0x65, 0x72, 0x36,
+        0x22, 0x2c, 0x20, 0x22, 0x65, 0x76, 0x65, 0x22, 0x3a, 0x20, 0x31, 0x34,
+        0x30, 0x30, 0x38, 0x39, 0x31, 0x38, 0x7d, 0x7b, 0x22, 0x69, 0x64, 0x22,
+        0x3a, 0x20, 0x32, 0x30, 0x30, 0x30, 0x31, 0x38, 0x34, 0x2c, 0x20, 0x22,
+        0x75, 0x73, 0x65, 0x72, 0x22, 0x3a, 0x20, 0x22, 0x75, 0x73, 0x65, 0x72,
+        0x31, 0x35, 0x22, 0x2c
+};
+
+
+/**
+ * @brief Write a raw content dictionary of sample records to \p path,
+ *        or the trained dictionary if \p trained is true.
+ */
+static void dict_write (const char *path, rd_bool_t trained) {
+        FILE *fp;
+        char buf[128];
+        int i;
+
+        fp = fopen(path, "wb");
+        TEST_ASSERT(fp, "failed to open %s for writing", path);
+
+        if (trained) {
+                TEST_ASSERT(fwrite(trained_dict, 1, sizeof(trained_dict),
+                                   fp) == sizeof(trained_dict),
+                            "failed to write %s", path);
+        } else {
+                for (i = 0 ; i < 100 ; i++) {
+                        msg_fmt(buf, sizeof(buf), i + 1000000);
+                        TEST_ASSERT(fwrite(buf, 1, strlen(buf), fp) ==
+                                    strlen(buf), "failed to write %s", path);
+                }
+        }
+
+        fclose(fp);
+}
+
+
+/**
+ * @brief Construct the path of file \p name in the temporary directory.
+ */
+static void tmp_path (char *path, size_t size, const char *name) {
+        const char *tmpdir = getenv("TMPDIR");
+
+#ifdef _MSC_VER
+        if (!tmpdir)
+                tmpdir = getenv("TEMP");
+        if (!tmpdir)
+                tmpdir = ".";
+#else
+        if (!tmpdir)
+                tmpdir = "/tmp";
+#endif
+
+        rd_snprintf(path, size, "%s/%s", tmpdir, name);
+}
+
+
+/**
+ * @brief Client and topic creation must fail if the dictionary
+ *        can't be loaded.
+ */
+static void do_test_dict_missing (rd_kafka_t *rk) {
+        rd_kafka_topic_conf_t *tconf = rd_kafka_topic_conf_new();
+        rd_kafka_conf_t *conf;
+        rd_kafka_topic_t *rkt;
+        rd_kafka_t *c;
+        char errstr[512];
+
+        test_topic_conf_set(tconf, "compression.zstd.dictionary.location",
+                            "/nonexistent/0105.dict");
+        rkt = rd_kafka_topic_new(rk, test_mk_topic_name("0105_missing", 1),
+                                 tconf);
+        TEST_ASSERT(!rkt, "expected topic creation to fail");
+        TEST_ASSERT(rd_kafka_last_error() == RD_KAFKA_RESP_ERR__INVALID_ARG,
+                    "expected INVALID_ARG, not %s",
+                    rd_kafka_err2name(rd_kafka_last_error()));
+
+        test_conf_init(&conf, NULL, 0);
+        test_conf_set(conf, "compression.zstd.dictionary.location",
+                      "/nonexistent/0105.dict");
+        c = rd_kafka_new(RD_KAFKA_CONSUMER, conf, errstr, sizeof(errstr));
+        TEST_ASSERT(!c, "expected consumer creation to fail");
+        TEST_SAY("rd_kafka_new() failed as expected: %s\n", errstr);
+        rd_kafka_conf_destroy(conf);
+}
+
+
+/**
+ * @brief Create a consumer with the dictionary at \p dict_path, or without
+ *        a dictionary if NULL.
+ */
+static rd_kafka_t *consumer_new (const char *bootstraps, const char *topic,
+                                 const char *dict_path) {
+        rd_kafka_conf_t *conf;
+        rd_kafka_t *c;
+
+        test_conf_init(&conf, NULL, 60);
+        test_conf_set(conf, "bootstrap.servers", bootstraps);
+        if (dict_path)
+                test_conf_set(conf, "compression.zstd.dictionary.location",
+                              dict_path);
+        c = test_create_consumer(topic, NULL, conf, NULL);
+
+        return c;
+}
+
+
+static void consumer_assign (rd_kafka_t *c, const char *topic) {
+        rd_kafka_topic_partition_list_t *parts;
+
+        parts = rd_kafka_topic_partition_list_new(1);
+        rd_kafka_topic_partition_list_add(parts, topic, 0)->offset =
+                RD_KAFKA_OFFSET_BEGINNING;
+        test_consumer_assign("ASSIGN", c, parts);
+        rd_kafka_topic_partition_list_destroy(parts);
+}
+
+
+/**
+ * @brief Consume and verify all messages.
+ */
+static void consume_verify (rd_kafka_t *c, const char *topic) {
+        char buf[128];
+        int cnt = 0;
+
+        consumer_assign(c, topic);
+
+        while (cnt < MSGCNT) {
+                rd_kafka_message_t *rkm;
+
+                rkm = rd_kafka_consumer_poll(c, tmout_multip(10000));
+                TEST_ASSERT(rkm, "timed out waiting for message %d", cnt);
+                TEST_ASSERT(!rkm->err, "consumer error: %s",
+                            rd_kafka_message_errstr(rkm));
+
+                msg_fmt(buf, sizeof(buf), cnt);
+                TEST_ASSERT(rkm->offset == cnt,
+                            "expected offset %d, not %"PRId64,
+                            cnt, rkm->offset);
+                TEST_ASSERT(rkm->len == strlen(buf) &&
+                            !memcmp(rkm->payload, buf, rkm->len),
+                            "message %d: payload mismatch: %.*s",
+                            cnt, (int)rkm->len, (const char *)rkm->payload);
+
+                rd_kafka_message_destroy(rkm);
+                cnt++;
+        }
+
+        TEST_SAY("Consumed and verified %d messages\n", cnt);
+}
+
+
+/**
+ * @brief Verify that the first MessageSet fails to decompress.
+ */
+static void consume_bad_compression (rd_kafka_t *c, const char *topic,
+                                     const char *what) {
+        rd_kafka_message_t *rkm;
+
+        consumer_assign(c, topic);
+
+        rkm = rd_kafka_consumer_poll(c, tmout_multip(10000));
+        TEST_ASSERT(rkm, "%s: timed out waiting for consumer error", what);
+        TEST_ASSERT(rkm->err == RD_KAFKA_RESP_ERR__BAD_COMPRESSION,
+                    "%s: expected __BAD_COMPRESSION, not %s (offset "
+                    "%"PRId64")",
+                    what, rd_kafka_err2name(rkm->err), rkm->offset);
+
+        TEST_SAY("%s: %s\n", what, rd_kafka_message_errstr(rkm));
+
+        rd_kafka_message_destroy(rkm);
+}
+
+
+/**
+ * @brief Produce with the dictionary at \p dict_path and consume with
+ *        the same dictionary, without a dictionary, and with the
+ *        dictionary at \p other_dict_path.
+ *
+ *        The dictionaries are only read when the clients are created,
+ *        so both files are removed before anything is produced.
+ */
+static void do_test_dict (const char *what, char *dict_path,
+                          char *other_dict_path) {
+        char *topic = rd_strdup(test_mk_topic_name("0105_zstd_dictionary",
+                                                   1));
+        rd_kafka_mock_cluster_t *mcluster;
+        rd_kafka_conf_t *conf;
+        rd_kafka_t *p, *c, *c_nodict, *c_otherdict;
+        rd_kafka_topic_t *rkt;
+        rd_kafka_resp_err_t err;
+        char *bootstraps;
+        char buf[128];
+        int i;
+
+        TEST_SAY(_C_MAG "[ Test zstd %s dictionary ]\n", what);
+
+        dr_cnt = 0;
+
+        test_conf_init(&conf, NULL, 60);
+        test_conf_set(conf, "test.mock.num.brokers", "3");
+        test_conf_set(conf, "compression.codec", "zstd");
+        test_conf_set(conf, "compression.zstd.dictionary.location", dict_path);
+        test_conf_set(conf, "batch.num.messages", "10");
+        rd_kafka_conf_set_dr_msg_cb(conf, dr_msg_cb);
+        p = test_create_handle(RD_KAFKA_PRODUCER, conf);
+
+        rkt = rd_kafka_topic_new(p, topic, NULL);
+        TEST_ASSERT(rkt, "topic_new failed: %s",
+                    rd_kafka_err2str(rd_kafka_last_error()));
+
+        mcluster = rd_kafka_handle_mock_cluster(p);
+        bootstraps = rd_strdup(rd_kafka_mock_cluster_bootstraps(mcluster));
+
+        err = rd_kafka_mock_topic_create(mcluster, topic, 1, 1);
+        TEST_ASSERT(!err, "topic create failed: %s", rd_kafka_err2str(err));
+
+        c = consumer_new(bootstraps, topic, dict_path);
+        c_nodict = consumer_new(bootstraps, topic, NULL);
+        c_otherdict = consumer_new(bootstraps, topic, other_dict_path);
+
+        remove(dict_path);
+        remove(other_dict_path);
+
+        do_test_dict_missing(p);
+
+        for (i = 0 ; i < MSGCNT ; i++) {
+                msg_fmt(buf, sizeof(buf), i);
+                err = rd_kafka_producev(p,
+                                        RD_KAFKA_V_RKT(rkt),
+                                        RD_KAFKA_V_PARTITION(0),
+                                        RD_KAFKA_V_VALUE(buf, strlen(buf)),
+                                        RD_KAFKA_V_MSGFLAGS(
+                                                RD_KAFKA_MSG_F_COPY),
+                                        RD_KAFKA_V_END);
+                TEST_ASSERT(!err, "producev() failed: %s",
+                            rd_kafka_err2str(err));
+        }
+
+        test_flush(p, tmout_multip(10000));
+        TEST_ASSERT(dr_cnt == MSGCNT, "expected %d delivery reports, not %d",
+                    MSGCNT, dr_cnt);
+
+        consume_verify(c, topic);
+        consume_bad_compression(c_nodict, topic, "without dictionary");
+        consume_bad_compression(c_otherdict, topic, "with other dictionary");
+
+        test_consumer_close(c_otherdict);
+        rd_kafka_destroy(c_otherdict);
+        test_consumer_close(c_nodict);
+        rd_kafka_destroy(c_nodict);
+        test_consumer_close(c);
+        rd_kafka_destroy(c);
+        rd_kafka_topic_destroy(rkt);
+        rd_kafka_destroy(p);
+        rd_free(bootstraps);
+        rd_free(topic);
+}
+
+
+int main_0105_zstd_dictionary_mock (int argc, char **argv) {
+        char raw_path[512], trained_path[512];
+
+        if (!test_check_builtin("zstd")) {
+                TEST_SKIP("zstd not built in\n");
+                return 0;
+        }
+
+        tmp_path(raw_path, sizeof(raw_path),
+                 test_mk_topic_name("0105_raw.dict", 1));
+        tmp_path(trained_path, sizeof(trained_path),
+                 test_mk_topic_name("0105_trained.dict", 1));
+
+        dict_write(raw_path, rd_false);
+        dict_write(trained_path, rd_true);
+        do_test_dict("raw content", raw_path, trained_path);
+
+        dict_write(raw_path, rd_false);
+        dict_write(trained_path, rd_true);
+        do_test_dict("trained", trained_path, raw_path);
+
+        return 0;
+}
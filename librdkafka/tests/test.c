@@ -196,6 +196,11 @@ _TEST_DECL(0095_all_brokers_down);
 _TEST_DECL(0097_ssl_verify);
 _TEST_DECL(0099_commit_metadata);
 _TEST_DECL(0100_thread_interceptors);
+_TEST_DECL(0101_mock_cluster);
+_TEST_DECL(0102_produce_batch_mock);
+_TEST_DECL(0103_produce_zerocopy_mock);
+_TEST_DECL(0104_produce_compress_threads_mock);
+_TEST_DECL(0105_zstd_dictionary_mock);
 
 /* Manual tests */
 _TEST_DECL(8000_idle);
@@ -324,6 +329,11 @@ struct test tests[] = {
         _TEST(0097_ssl_verify, 0),
         _TEST(0099_commit_metadata, 0),
         _TEST(0100_thread_interceptors, TEST_F_LOCAL),
+        _TEST(0101_mock_cluster, TEST_F_LOCAL),
+        _TEST(0102_produce_batch_mock, TEST_F_LOCAL),
+        _TEST(0103_produce_zerocopy_mock, TEST_F_LOCAL),
+        _TEST(0104_produce_compress_threads_mock, TEST_F_LOCAL),
+        _TEST(0105_zstd_dictionary_mock, TEST_F_LOCAL),
 
         /* Manual tests */
         _TEST(8000_idle, TEST_F_MANUAL),
@@ -16,8 +16,14 @@
 #define PARQUET_EXAMPLE_UTIL_H
 
 #include <string>
+#include <boost/shared_ptr.hpp>
 #include <parquet/parquet.h>
+#include <parquet/file-reader.h>
 
-bool GetFileMetadata(const std::string& path, parquet::FileMetaData* metadata);
+// Returns the parsed footer of the file at 'path', or NULL if it could not be read.
+// Footers are cached in parquet_cpp::FileMetadataCache::Global(), so opening the
+// same file again does not read it again unless it changed.
+boost::shared_ptr<const parquet_cpp::FileMetadata> GetFileMetadata(
+    const std::string& path);
 
 #endif
@@ -0,0 +1,1062 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <parquet/parquet.h>
+#include <parquet/file-reader.h>
+#include <parquet/file-writer.h>
+#include <parquet/scanner.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <sstream>
+
+#include "encodings/encodings.h"
+#include "util/stopwatch.h"
+
+using namespace boost;
+using namespace impala;
+using namespace parquet;
+using namespace parquet_cpp;
+using namespace std;
+
+// Benchmarks the read path. Every case is described by the physical type, the
+// encoding, the bit width of the values (the values are drawn from [0, 2^bit_width),
+// so this is also the bit width of the dictionary indices and about the one of the
+// deltas), the fraction of nulls and the compression codec. There are three suites:
+//  - decode: a Decoder over a buffer of encoded values. Nulls and codecs do not
+//    apply.
+//  - column: a ColumnReader over a column chunk in memory, which includes the page
+//    headers, decompression and the definition levels.
+//  - scan: a ParquetScanner over a file with a column of each type, written to
+//    --dir. The file was just written, so it is normally in the page cache.
+// Each case runs until --min_time seconds have passed and prints one CSV line, so
+// the output of two runs can be compared. Rates are per second of wall time; bytes
+// are the PLAIN encoded size of the values, without the nulls.
+//
+// Usage: parquet_benchmark [--suite=decode,column,scan] [--filter=<substring>]
+//     [--num_values=N] [--min_time=S] [--batch_size=N] [--threads=N] [--dir=D]
+// --filter selects the cases whose name contains the substring. Names look like
+// column/INT64/RLE_DICTIONARY/8/0.5/SNAPPY.
+
+struct Flags {
+  string suites;
+  string filter;
+  int num_values;
+  double min_time;
+  int batch_size;
+  int threads;
+  string dir;
+
+  Flags()
+    : suites("decode,column,scan"),
+      num_values(1024 * 1024),
+      min_time(0.2),
+      batch_size(1024),
+      threads(1),
+      dir("/tmp") {
+  }
+};
+
+static const int BIT_WIDTHS[] = { 1, 4, 8, 16, 32 };
+static const double NULL_FRACTIONS[] = { 0, 0.1, 0.5, 0.9 };
+static const Type::type TYPES[] = {
+  Type::BOOLEAN, Type::INT32, Type::INT64, Type::FLOAT, Type::DOUBLE, Type::BYTE_ARRAY
+};
+static const CompressionCodec::type CODECS[] = {
+  CompressionCodec::UNCOMPRESSED, CompressionCodec::SNAPPY, CompressionCodec::GZIP,
+  CompressionCodec::LZ4, CompressionCodec::ZSTD
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static const char* TypeName(Type::type type) {
+  switch (type) {
+    case Type::BOOLEAN: return "BOOLEAN";
+    case Type::INT32: return "INT32";
+    case Type::INT64: return "INT64";
+    case Type::FLOAT: return "FLOAT";
+    case Type::DOUBLE: return "DOUBLE";
+    case Type::BYTE_ARRAY: return "BYTE_ARRAY";
+    default: return "UNKNOWN";
+  }
+}
+
+static const char* EncodingName(Encoding::type encoding) {
+  switch (encoding) {
+    case Encoding::PLAIN: return "PLAIN";
+    case Encoding::RLE_DICTIONARY: return "RLE_DICTIONARY";
+    case Encoding::DELTA_BINARY_PACKED: return "DELTA_BINARY_PACKED";
+    case Encoding::DELTA_LENGTH_BYTE_ARRAY: return "DELTA_LENGTH_BYTE_ARRAY";
+    case Encoding::DELTA_BYTE_ARRAY: return "DELTA_BYTE_ARRAY";
+    default: return "UNKNOWN";
+  }
+}
+
+static const char* CodecName(CompressionCodec::type codec) {
+  switch (codec) {
+    case CompressionCodec::UNCOMPRESSED: return "UNCOMPRESSED";
+    case CompressionCodec::SNAPPY: return "SNAPPY";
+    case CompressionCodec::GZIP: return "GZIP";
+    case CompressionCodec::LZ4: return "LZ4";
+    case CompressionCodec::ZSTD: return "ZSTD";
+    default: return "UNKNOWN";
+  }
+}
+
+// Appends 'v' to 'out' as an unsigned (resp. zigzag) ULEB128 varint.
+static void AppendVlqInt(uint64_t v, vector<uint8_t>* out) {
+  while (v >= 0x80) {
+    out->push_back((v & 0x7F) | 0x80);
+    v >>= 7;
+  }
+  out->push_back(v);
+}
+
+static void AppendZigZagVlqInt(int64_t v, vector<uint8_t>* out) {
+  AppendVlqInt((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63), out);
+}
+
+// Encoder for DELTA_BINARY_PACKED. The library has no writer for the delta
+// encodings, so this one only exists to produce data for the decoders. Blocks
+// have 128 values in 4 miniblocks; the miniblocks after the last value are not
+// written.
+class DeltaBitPackEncoder : public Encoder {
+ public:
+  static const int BLOCK_SIZE = 128;
+  static const int NUM_MINI_BLOCKS = 4;
+  static const int MINI_BLOCK_SIZE = BLOCK_SIZE / NUM_MINI_BLOCKS;
+
+  explicit DeltaBitPackEncoder(const Type::type& type)
+    : Encoder(type, Encoding::DELTA_BINARY_PACKED) {
+    if (type != Type::INT32 && type != Type::INT64) {
+      throw ParquetException("Delta bit pack encoding is only for integers.");
+    }
+  }
+
+  virtual void PutInt32(const int32_t* values, int num_values) {
+    values_.insert(values_.end(), values, values + num_values);
+  }
+
+  virtual void PutInt64(const int64_t* values, int num_values) {
+    values_.insert(values_.end(), values, values + num_values);
+  }
+
+  virtual int EstimatedDataSize() const { return values_.size() * sizeof(int64_t); }
+
+  virtual void FlushValues(vector<uint8_t>* out) {
+    int num_values = values_.size();
+    AppendVlqInt(BLOCK_SIZE, out);
+    AppendVlqInt(NUM_MINI_BLOCKS, out);
+    AppendVlqInt(num_values, out);
+    AppendZigZagVlqInt(num_values > 0 ? values_[0] : 0, out);
+
+    int64_t deltas[BLOCK_SIZE];
+    for (int start = 1; start < num_values; start += BLOCK_SIZE) {
+      int block_len = ::min(BLOCK_SIZE, num_values - start);
+      int64_t min_delta = numeric_limits<int64_t>::max();
+      for (int i = 0; i < block_len; ++i) {
+        deltas[i] = Delta(values_[start + i], values_[start + i - 1]);
+        min_delta = ::min(min_delta, deltas[i]);
+      }
+      for (int i = block_len; i < BLOCK_SIZE; ++i) deltas[i] = min_delta;
+      AppendZigZagVlqInt(min_delta, out);
+
+      // The deltas are stored relative to the min delta, which wraps around like
+      // the decoder does.
+      uint64_t packed[BLOCK_SIZE];
+      uint8_t bit_widths[NUM_MINI_BLOCKS];
+      for (int m = 0; m < NUM_MINI_BLOCKS; ++m) {
+        uint64_t max_packed = 0;
+        for (int i = m * MINI_BLOCK_SIZE; i < (m + 1) * MINI_BLOCK_SIZE; ++i) {
+          packed[i] = Mask(static_cast<uint64_t>(deltas[i]) -
+              static_cast<uint64_t>(min_delta));
+          max_packed |= packed[i];
+        }
+        bit_widths[m] = BitUtil::NumRequiredBits(max_packed);
+      }
+      out->insert(out->end(), bit_widths, bit_widths + NUM_MINI_BLOCKS);
+      for (int m = 0; m * MINI_BLOCK_SIZE < block_len; ++m) {
+        PackBits(packed + m * MINI_BLOCK_SIZE, MINI_BLOCK_SIZE, bit_widths[m], out);
+      }
+    }
+    values_.clear();
+  }
+
+ private:
+  // Returns x - y with the wrap around of the column type.
+  int64_t Delta(int64_t x, int64_t y) const {
+    if (type_ == Type::INT32) {
+      return static_cast<int32_t>(static_cast<uint32_t>(x) - static_cast<uint32_t>(y));
+    }
+    return static_cast<int64_t>(static_cast<uint64_t>(x) - static_cast<uint64_t>(y));
+  }
+
+  uint64_t Mask(uint64_t v) const {
+    return type_ == Type::INT32 ? static_cast<uint32_t>(v) : v;
+  }
+
+  // Appends 'values' bit packed LSB first with 'bit_width' bits each.
+  static void PackBits(const uint64_t* values, int num_values, int bit_width,
+      vector<uint8_t>* out) {
+    int start = out->size();
+    out->resize(start + BitUtil::Ceil(num_values * bit_width, 8), 0);
+    uint8_t* data = &(*out)[start];
+    int64_t bit = 0;
+    for (int i = 0; i < num_values; ++i) {
+      for (int b = 0; b < bit_width; ++b, ++bit) {
+        if ((values[i] >> b) & 1) data[bit / 8] |= 1 << (bit % 8);
+      }
+    }
+  }
+
+  vector<int64_t> values_;
+};
+
+const int DeltaBitPackEncoder::BLOCK_SIZE;
+const int DeltaBitPackEncoder::NUM_MINI_BLOCKS;
+const int DeltaBitPackEncoder::MINI_BLOCK_SIZE;
+
+// Encoder for DELTA_LENGTH_BYTE_ARRAY: the delta encoded lengths followed by the
+// bytes of all the values.
+class DeltaLengthByteArrayEncoder : public Encoder {
+ public:
+  DeltaLengthByteArrayEncoder()
+    : Encoder(Type::BYTE_ARRAY, Encoding::DELTA_LENGTH_BYTE_ARRAY),
+      len_encoder_(Type::INT32) {
+  }
+
+  virtual void PutByteArray(const ByteArray* values, int num_values) {
+    for (int i = 0; i < num_values; ++i) {
+      int32_t len = values[i].len;
+      len_encoder_.PutInt32(&len, 1);
+      data_.insert(data_.end(), values[i].ptr, values[i].ptr + values[i].len);
+    }
+  }
+
+  virtual int EstimatedDataSize() const {
+    return len_encoder_.EstimatedDataSize() + data_.size();
+  }
+
+  virtual void FlushValues(vector<uint8_t>* out) {
+    len_encoder_.FlushValues(out);
+    out->insert(out->end(), data_.begin(), data_.end());
+    data_.clear();
+  }
+
+ private:
+  DeltaBitPackEncoder len_encoder_;
+  vector<uint8_t> data_;
+};
+
+// Encoder for DELTA_BYTE_ARRAY: the delta encoded lengths of the prefixes shared
+// with the previous values, followed by the suffixes encoded with
+// DELTA_LENGTH_BYTE_ARRAY.
+class DeltaByteArrayEncoder : public Encoder {
+ public:
+  DeltaByteArrayEncoder()
+    : Encoder(Type::BYTE_ARRAY, Encoding::DELTA_BYTE_ARRAY),
+      prefix_len_encoder_(Type::INT32) {
+  }
+
+  virtual void PutByteArray(const ByteArray* values, int num_values) {
+    for (int i = 0; i < num_values; ++i) {
+      const uint8_t* ptr = values[i].ptr;
+      int len = values[i].len;
+      int prefix_len = 0;
+      int max_prefix_len = ::min<int>(len, last_value_.size());
+      while (prefix_len < max_prefix_len && ptr[prefix_len] == last_value_[prefix_len]) {
+        ++prefix_len;
+      }
+      prefix_len_encoder_.PutInt32(&prefix_len, 1);
+      ByteArray suffix;
+      suffix.ptr = ptr + prefix_len;
+      suffix.len = len - prefix_len;
+      suffix_encoder_.PutByteArray(&suffix, 1);
+      last_value_.assign(reinterpret_cast<const char*>(ptr), len);
+    }
+  }
+
+  virtual int EstimatedDataSize() const {
+    return prefix_len_encoder_.EstimatedDataSize() + suffix_encoder_.EstimatedDataSize();
+  }
+
+  virtual void FlushValues(vector<uint8_t>* out) {
+    prefix_len_encoder_.FlushValues(out);
+    suffix_encoder_.FlushValues(out);
+    last_value_.clear();
+  }
+
+ private:
+  DeltaBitPackEncoder prefix_len_encoder_;
+  DeltaLengthByteArrayEncoder suffix_encoder_;
+  string last_value_;
+};
+
+// Deterministic xorshift generator, so every run benchmarks the same data.
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state_(seed * 2654435761ULL + 1) {}
+
+  uint64_t Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return state_;
+  }
+
+  // Returns a value in [0, 2^bit_width).
+  uint64_t NextBits(int bit_width) {
+    return bit_width >= 64 ? Next() : Next() & ((1ULL << bit_width) - 1);
+  }
+
+  double NextDouble() { return (Next() >> 11) * (1.0 / (1ULL << 53)); }
+
+ private:
+  uint64_t state_;
+};
+
+// The levels and values of a generated column.
+struct ColumnData {
+  Type::type type;
+  // Definition levels, empty if there are no nulls.
+  vector<int16_t> def_levels;
+  int num_levels;
+  int num_values;
+  // The non-null values as an array of the C++ type of the column.
+  vector<uint8_t> values;
+  // The bytes of the ByteArray values.
+  vector<uint8_t> byte_array_data;
+  // Size of the PLAIN encoded values.
+  int64_t plain_size;
+
+  template <typename T>
+  const T* data() const {
+    return values.empty() ? NULL : reinterpret_cast<const T*>(&values[0]);
+  }
+};
+
+static void GenerateColumn(Type::type type, int bit_width, double null_fraction,
+    int num_levels, uint64_t seed, ColumnData* column) {
+  Random random(seed);
+  column->type = type;
+  column->num_levels = num_levels;
+  column->def_levels.clear();
+  column->num_values = num_levels;
+  if (null_fraction > 0) {
+    column->def_levels.resize(num_levels);
+    column->num_values = 0;
+    for (int i = 0; i < num_levels; ++i) {
+      column->def_levels[i] = random.NextDouble() >= null_fraction;
+      column->num_values += column->def_levels[i];
+    }
+  }
+
+  int n = column->num_values;
+  column->byte_array_data.clear();
+  switch (type) {
+    case Type::BOOLEAN: {
+      column->values.resize(n * sizeof(bool));
+      bool* values = reinterpret_cast<bool*>(&column->values[0]);
+      for (int i = 0; i < n; ++i) values[i] = random.NextBits(1);
+      column->plain_size = BitUtil::Ceil(n, 8);
+      break;
+    }
+    case Type::INT32: {
+      column->values.resize(n * sizeof(int32_t));
+      int32_t* values = reinterpret_cast<int32_t*>(&column->values[0]);
+      for (int i = 0; i < n; ++i) values[i] = random.NextBits(bit_width);
+      column->plain_size = n * sizeof(int32_t);
+      break;
+    }
+    case Type::INT64: {
+      column->values.resize(n * sizeof(int64_t));
+      int64_t* values = reinterpret_cast<int64_t*>(&column->values[0]);
+      for (int i = 0; i < n; ++i) values[i] = random.NextBits(bit_width);
+      column->plain_size = n * sizeof(int64_t);
+      break;
+    }
+    case Type::FLOAT: {
+      column->values.resize(n * sizeof(float));
+      float* values = reinterpret_cast<float*>(&column->values[0]);
+      for (int i = 0; i < n; ++i) values[i] = random.NextBits(bit_width) / 16.0f;
+      column->plain_size = n * sizeof(float);
+      break;
+    }
+    case Type::DOUBLE: {
+      column->values.resize(n * sizeof(double));
+      double* values = reinterpret_cast<double*>(&column->values[0]);
+      for (int i = 0; i < n; ++i) values[i] = random.NextBits(bit_width) / 16.0;
+      column->plain_size = n * sizeof(double);
+      break;
+    }
+    case Type::BYTE_ARRAY: {
+      // Strings that share a prefix and have a variable length.
+      vector<int> offsets(n);
+      for (int i = 0; i < n; ++i) {
+        char buffer[32];
+        int len = snprintf(buffer, sizeof(buffer), "value-%llu",
+            static_cast<unsigned long long>(random.NextBits(bit_width)));
+        offsets[i] = column->byte_array_data.size();
+        column->byte_array_data.insert(column->byte_array_data.end(), buffer,
+            buffer + len);
+      }
+      column->values.resize(n * sizeof(ByteArray));
+      ByteArray* values = reinterpret_cast<ByteArray*>(&column->values[0]);
+      for (int i = 0; i < n; ++i) {
+        int end = i + 1 < n ? offsets[i + 1] : column->byte_array_data.size();
+        values[i].ptr = &column->byte_array_data[offsets[i]];
+        values[i].len = end - offsets[i];
+      }
+      column->plain_size = column->byte_array_data.size() + n * sizeof(uint32_t);
+      break;
+    }
+    default:
+      ParquetException::NYI("Unsupported type");
+  }
+}
+
+static void PutValues(const ColumnData& column, int offset, int num_values,
+    Encoder* encoder) {
+  switch (column.type) {
+    case Type::BOOLEAN:
+      encoder->PutBool(column.data<bool>() + offset, num_values);
+      break;
+    case Type::INT32:
+      encoder->PutInt32(column.data<int32_t>() + offset, num_values);
+      break;
+    case Type::INT64:
+      encoder->PutInt64(column.data<int64_t>() + offset, num_values);
+      break;
+    case Type::FLOAT:
+      encoder->PutFloat(column.data<float>() + offset, num_values);
+      break;
+    case Type::DOUBLE:
+      encoder->PutDouble(column.data<double>() + offset, num_values);
+      break;
+    case Type::BYTE_ARRAY:
+      encoder->PutByteArray(column.data<ByteArray>() + offset, num_values);
+      break;
+    default:
+      ParquetException::NYI("Unsupported type");
+  }
+}
+
+static int GetValues(Type::type type, Decoder* decoder, uint8_t* buffer,
+    int max_values) {
+  switch (type) {
+    case Type::BOOLEAN:
+      return decoder->GetBool(reinterpret_cast<bool*>(buffer), max_values);
+    case Type::INT32:
+      return decoder->GetInt32(reinterpret_cast<int32_t*>(buffer), max_values);
+    case Type::INT64:
+      return decoder->GetInt64(reinterpret_cast<int64_t*>(buffer), max_values);
+    case Type::FLOAT:
+      return decoder->GetFloat(reinterpret_cast<float*>(buffer), max_values);
+    case Type::DOUBLE:
+      return decoder->GetDouble(reinterpret_cast<double*>(buffer), max_values);
+    case Type::BYTE_ARRAY:
+      return decoder->GetByteArray(reinterpret_cast<ByteArray*>(buffer), max_values);
+    default:
+      ParquetException::NYI("Unsupported type");
+  }
+  return 0;
+}
+
+static int ValueSize(Type::type type) {
+  switch (type) {
+    case Type::BOOLEAN: return sizeof(bool);
+    case Type::INT32: return sizeof(int32_t);
+    case Type::INT64: return sizeof(int64_t);
+    case Type::FLOAT: return sizeof(float);
+    case Type::DOUBLE: return sizeof(double);
+    case Type::BYTE_ARRAY: return sizeof(ByteArray);
+    default: ParquetException::NYI("Unsupported type");
+  }
+  return 0;
+}
+
+static bool ValueEquals(Type::type type, const uint8_t* x, const uint8_t* y) {
+  if (type == Type::BYTE_ARRAY) {
+    const ByteArray* a = reinterpret_cast<const ByteArray*>(x);
+    const ByteArray* b = reinterpret_cast<const ByteArray*>(y);
+    return a->len == b->len && memcmp(a->ptr, b->ptr, a->len) == 0;
+  }
+  return memcmp(x, y, ValueSize(type)) == 0;
+}
+
+static bool SupportsEncoding(Type::type type, Encoding::type encoding) {
+  switch (encoding) {
+    case Encoding::PLAIN:
+      return true;
+    case Encoding::RLE_DICTIONARY:
+      return type != Type::BOOLEAN;
+    case Encoding::DELTA_BINARY_PACKED:
+      return type == Type::INT32 || type == Type::INT64;
+    case Encoding::DELTA_LENGTH_BYTE_ARRAY:
+    case Encoding::DELTA_BYTE_ARRAY:
+      return type == Type::BYTE_ARRAY;
+    default:
+      return false;
+  }
+}
+
+struct BenchmarkCase {
+  string suite;
+  string type;
+  string encoding;
+  int bit_width;
+  double null_fraction;
+  string codec;
+
+  string name() const {
+    stringstream ss;
+    ss << suite << "/" << type << "/" << encoding << "/" << bit_width << "/"
+       << null_fraction << "/" << codec;
+    return ss.str();
+  }
+};
+
+// Runs one benchmark case and reports it. Subclasses decode the data once per
+// Run() call.
+class Benchmark {
+ public:
+  virtual ~Benchmark() {}
+
+  // Decodes all the data once.
+  virtual void Run() = 0;
+
+  // Number of values per Run(), including the nulls.
+  virtual int64_t num_values() const = 0;
+  // Bytes decoded per Run().
+  virtual int64_t decoded_bytes() const = 0;
+  // Size of the encoded (and compressed) data.
+  virtual int64_t encoded_bytes() const = 0;
+};
+
+static void PrintHeader() {
+  printf("suite,type,encoding,bit_width,null_fraction,codec,num_values,encoded_bytes,"
+      "decoded_bytes,iterations,seconds,values_per_sec,bytes_per_sec\n");
+}
+
+static void RunBenchmark(const Flags& flags, const BenchmarkCase& c,
+    Benchmark* benchmark) {
+  // Warm up, which also checks that the case works before it is timed.
+  benchmark->Run();
+  StopWatch sw;
+  sw.Start();
+  int64_t iterations = 0;
+  double seconds;
+  do {
+    benchmark->Run();
+    ++iterations;
+    seconds = sw.Stop() / 1e9;
+  } while (seconds < flags.min_time);
+  printf("%s,%s,%s,%d,%g,%s,%lld,%lld,%lld,%lld,%.6f,%.1f,%.1f\n",
+      c.suite.c_str(), c.type.c_str(), c.encoding.c_str(), c.bit_width,
+      c.null_fraction, c.codec.c_str(),
+      static_cast<long long>(benchmark->num_values()),
+      static_cast<long long>(benchmark->encoded_bytes()),
+      static_cast<long long>(benchmark->decoded_bytes()),
+      static_cast<long long>(iterations), seconds,
+      benchmark->num_values() * iterations / seconds,
+      benchmark->decoded_bytes() * iterations / seconds);
+  fflush(stdout);
+}
+
+// Decodes a buffer of values with a Decoder.
+class DecodeBenchmark : public Benchmark {
+ public:
+  DecodeBenchmark(const ColumnData& column, Encoding::type encoding, int batch_size)
+    : column_(column),
+      encoding_(encoding),
+      batch_size_(batch_size),
+      buffer_(batch_size * ValueSize(column.type)) {
+    scoped_ptr<Encoder> encoder;
+    switch (encoding) {
+      case Encoding::PLAIN:
+        encoder.reset(new PlainEncoder(column.type));
+        break;
+      case Encoding::RLE_DICTIONARY:
+        encoder.reset(new DictEncoder(column.type));
+        break;
+      case Encoding::DELTA_BINARY_PACKED:
+        encoder.reset(new DeltaBitPackEncoder(column.type));
+        break;
+      case Encoding::DELTA_LENGTH_BYTE_ARRAY:
+        encoder.reset(new DeltaLengthByteArrayEncoder());
+        break;
+      case Encoding::DELTA_BYTE_ARRAY:
+        encoder.reset(new DeltaByteArrayEncoder());
+        break;
+      default:
+        ParquetException::NYI("Unsupported encoding");
+    }
+    PutValues(column, 0, column.num_values, encoder.get());
+    encoder->FlushValues(&data_);
+
+    switch (encoding) {
+      case Encoding::PLAIN:
+        if (column.type == Type::BOOLEAN) {
+          decoder_.reset(new BoolDecoder());
+        } else {
+          decoder_.reset(new PlainDecoder(column.type));
+        }
+        break;
+      case Encoding::RLE_DICTIONARY: {
+        DictEncoder* dict_encoder = static_cast<DictEncoder*>(encoder.get());
+        vector<uint8_t> dictionary;
+        dict_encoder->WriteDictionary(&dictionary);
+        PlainDecoder dictionary_decoder(column.type);
+        dictionary_decoder.SetData(dict_encoder->num_entries(),
+            dictionary.empty() ? NULL : &dictionary[0], dictionary.size());
+        decoder_.reset(new DictionaryDecoder(column.type, &dictionary_decoder));
+        dictionary_size_ = dictionary.size();
+        break;
+      }
+      case Encoding::DELTA_BINARY_PACKED:
+        decoder_.reset(new DeltaBitPackDecoder(column.type));
+        break;
+      case Encoding::DELTA_LENGTH_BYTE_ARRAY:
+        decoder_.reset(new DeltaLengthByteArrayDecoder());
+        break;
+      case Encoding::DELTA_BYTE_ARRAY:
+        decoder_.reset(new DeltaByteArrayDecoder());
+        break;
+      default:
+        break;
+    }
+    if (encoding != Encoding::RLE_DICTIONARY) dictionary_size_ = 0;
+    Verify();
+  }
+
+  virtual void Run() {
+    decoder_->SetData(column_.num_values, data_.empty() ? NULL : &data_[0],
+        data_.size());
+    for (int i = 0; i < column_.num_values;) {
+      int n = GetValues(column_.type, decoder_.get(), &buffer_[0], batch_size_);
+      if (n == 0) ParquetException::EofException();
+      i += n;
+    }
+  }
+
+  virtual int64_t num_values() const { return column_.num_values; }
+  virtual int64_t decoded_bytes() const { return column_.plain_size; }
+  virtual int64_t encoded_bytes() const { return data_.size() + dictionary_size_; }
+
+ private:
+  // Checks that the decoder returns the generated values.
+  void Verify() {
+    decoder_->SetData(column_.num_values, data_.empty() ? NULL : &data_[0],
+        data_.size());
+    int value_size = ValueSize(column_.type);
+    for (int i = 0; i < column_.num_values;) {
+      int n = GetValues(column_.type, decoder_.get(), &buffer_[0], batch_size_);
+      if (n == 0) ParquetException::EofException();
+      for (int j = 0; j < n; ++j) {
+        if (!ValueEquals(column_.type, &buffer_[j * value_size],
+            &column_.values[(i + j) * value_size])) {
+          stringstream ss;
+          ss << "Value " << i + j << " was not decoded correctly.";
+          throw ParquetException(ss.str());
+        }
+      }
+      i += n;
+    }
+  }
+
+  const ColumnData& column_;
+  const Encoding::type encoding_;
+  const int batch_size_;
+  vector<uint8_t> data_;
+  int64_t dictionary_size_;
+  scoped_ptr<Decoder> decoder_;
+  vector<uint8_t> buffer_;
+};
+
+static SchemaElement MakeSchemaElement(const string& name, Type::type type,
+    bool optional) {
+  SchemaElement element;
+  element.__set_name(name);
+  element.__set_type(type);
+  element.__set_repetition_type(
+      optional ? FieldRepetitionType::OPTIONAL : FieldRepetitionType::REQUIRED);
+  return element;
+}
+
+static void WriteColumn(const ColumnData& column, int first_level, int num_levels,
+    int first_value, int batch_size, ColumnWriter* writer) {
+  int value_size = ValueSize(column.type);
+  int value_idx = first_value;
+  for (int i = first_level; i < first_level + num_levels; i += batch_size) {
+    int n = ::min(batch_size, first_level + num_levels - i);
+    const int16_t* def_levels = column.def_levels.empty() ? NULL : &column.def_levels[i];
+    int num_values = n;
+    if (def_levels != NULL) {
+      num_values = 0;
+      for (int j = 0; j < n; ++j) num_values += def_levels[j];
+    }
+    const uint8_t* values = column.values.empty() ? NULL :
+        &column.values[value_idx * value_size];
+    switch (column.type) {
+      case Type::BOOLEAN:
+        writer->WriteBatch(n, def_levels, NULL, reinterpret_cast<const bool*>(values));
+        break;
+      case Type::INT32:
+        writer->WriteBatch(n, def_levels, NULL, reinterpret_cast<const int32_t*>(values));
+        break;
+      case Type::INT64:
+        writer->WriteBatch(n, def_levels, NULL, reinterpret_cast<const int64_t*>(values));
+        break;
+      case Type::FLOAT:
+        writer->WriteBatch(n, def_levels, NULL, reinterpret_cast<const float*>(values));
+        break;
+      case Type::DOUBLE:
+        writer->WriteBatch(n, def_levels, NULL, reinterpret_cast<const double*>(values));
+        break;
+      case Type::BYTE_ARRAY:
+        writer->WriteBatch(n, def_levels, NULL,
+            reinterpret_cast<const ByteArray*>(values));
+        break;
+      default:
+        ParquetException::NYI("Unsupported type");
+    }
+    value_idx += num_values;
+  }
+}
+
+static ColumnWriter::Config MakeConfig(bool enable_dictionary,
+    CompressionCodec::type codec) {
+  ColumnWriter::Config config = ColumnWriter::Config::DefaultConfig();
+  config.enable_dictionary = enable_dictionary;
+  // Keep the whole chunk dictionary encoded, even for the large bit widths.
+  config.dictionary_page_size_limit = numeric_limits<int>::max();
+  config.codec = codec;
+  return config;
+}
+
+// Reads a column chunk in memory with a ColumnReader.
+class ColumnBenchmark : public Benchmark {
+ public:
+  ColumnBenchmark(const ColumnData& column, Encoding::type encoding,
+      CompressionCodec::type codec, int batch_size)
+    : column_(column),
+      batch_size_(batch_size),
+      schema_(MakeSchemaElement("c", column.type, !column.def_levels.empty())),
+      def_levels_(batch_size),
+      values_(batch_size * ValueSize(column.type)) {
+    bool enable_dictionary = encoding == Encoding::RLE_DICTIONARY;
+    ColumnWriter writer(&schema_, MakeConfig(enable_dictionary, codec));
+    WriteColumn(column, 0, column.num_levels, 0, batch_size, &writer);
+    writer.Close(&stream_, &chunk_);
+  }
+
+  virtual void Run() {
+    const vector<uint8_t>& data = stream_.buffer();
+    InMemoryInputStream stream(data.empty() ? NULL : &data[0], data.size());
+    ColumnReader reader(&chunk_.meta_data, &schema_, &stream);
+    int64_t values_read;
+    int64_t num_levels = 0;
+    while (true) {
+      int n;
+      switch (column_.type) {
+        case Type::BOOLEAN:
+          n = reader.ReadBatch(batch_size_, &def_levels_[0], NULL,
+              reinterpret_cast<bool*>(&values_[0]), &values_read);
+          break;
+        case Type::INT32:
+          n = reader.ReadBatch(batch_size_, &def_levels_[0], NULL,
+              reinterpret_cast<int32_t*>(&values_[0]), &values_read);
+          break;
+        case Type::INT64:
+          n = reader.ReadBatch(batch_size_, &def_levels_[0], NULL,
+              reinterpret_cast<int64_t*>(&values_[0]), &values_read);
+          break;
+        case Type::FLOAT:
+          n = reader.ReadBatch(batch_size_, &def_levels_[0], NULL,
+              reinterpret_cast<float*>(&values_[0]), &values_read);
+          break;
+        case Type::DOUBLE:
+          n = reader.ReadBatch(batch_size_, &def_levels_[0], NULL,
+              reinterpret_cast<double*>(&values_[0]), &values_read);
+          break;
+        case Type::BYTE_ARRAY:
+          n = reader.ReadBatch(batch_size_, &def_levels_[0], NULL,
+              reinterpret_cast<ByteArray*>(&values_[0]), &values_read);
+          break;
+        default:
+          ParquetException::NYI("Unsupported type");
+      }
+      if (n == 0) break;
+      num_levels += n;
+    }
+    if (num_levels != column_.num_levels) {
+      throw ParquetException("The column chunk was not read completely.");
+    }
+  }
+
+  virtual int64_t num_values() const { return column_.num_levels; }
+  virtual int64_t decoded_bytes() const { return column_.plain_size; }
+  virtual int64_t encoded_bytes() const { return stream_.buffer().size(); }
+
+ private:
+  const ColumnData& column_;
+  const int batch_size_;
+  const SchemaElement schema_;
+  InMemoryOutputStream stream_;
+  ColumnChunk chunk_;
+  vector<int16_t> def_levels_;
+  vector<uint8_t> values_;
+};
+
+// Scans a file with a column of each type with a ParquetScanner.
+class ScanBenchmark : public Benchmark {
+ public:
+  static const int NUM_ROW_GROUPS = 4;
+
+  ScanBenchmark(const vector<ColumnData>& columns, CompressionCodec::type codec,
+      const Flags& flags)
+    : flags_(flags),
+      num_rows_(columns[0].num_levels),
+      decoded_bytes_(0) {
+    stringstream ss;
+    ss << flags.dir << "/parquet_benchmark." << getpid() << ".parquet";
+    path_ = ss.str();
+
+    vector<SchemaElement> schema(1);
+    schema[0].__set_name("schema");
+    schema[0].__set_num_children(columns.size());
+    for (int i = 0; i < columns.size(); ++i) {
+      schema.push_back(MakeSchemaElement(TypeName(columns[i].type), columns[i].type,
+          !columns[i].def_levels.empty()));
+      decoded_bytes_ += columns[i].plain_size;
+    }
+
+    LocalFileOutputStream out(path_);
+    ParquetFileWriter writer(&out, schema, MakeConfig(true, codec));
+    vector<int> value_offsets(columns.size(), 0);
+    int rows_per_row_group = BitUtil::Ceil(num_rows_, NUM_ROW_GROUPS);
+    for (int first_row = 0; first_row < num_rows_; first_row += rows_per_row_group) {
+      int num_rows = ::min(rows_per_row_group, num_rows_ - first_row);
+      writer.NewRowGroup();
+      for (int i = 0; i < columns.size(); ++i) {
+        WriteColumn(columns[i], first_row, num_rows, value_offsets[i],
+            flags.batch_size, writer.column_writer(i));
+        if (columns[i].def_levels.empty()) {
+          value_offsets[i] += num_rows;
+        } else {
+          for (int j = first_row; j < first_row + num_rows; ++j) {
+            value_offsets[i] += columns[i].def_levels[j];
+          }
+        }
+      }
+    }
+    writer.Close();
+    out.Close();
+    encoded_bytes_ = out.Tell();
+
+    for (int i = 0; i < columns.size(); ++i) columns_.push_back(i);
+  }
+
+  virtual ~ScanBenchmark() { unlink(path_.c_str()); }
+
+  virtual void Run() {
+    ParquetFileReader reader(path_);
+    ParquetScanner::Options options = ParquetScanner::Options::DefaultOptions();
+    options.num_threads = flags_.threads;
+    options.batch_size = flags_.batch_size;
+    ParquetScanner scanner(&reader, columns_, options);
+    int64_t num_rows = 0;
+    while (shared_ptr<RowGroupData> row_group = scanner.Next()) {
+      num_rows += row_group->num_rows;
+    }
+    if (num_rows != num_rows_) {
+      throw ParquetException("The file was not read completely.");
+    }
+  }
+
+  virtual int64_t num_values() const { return num_rows_ * columns_.size(); }
+  virtual int64_t decoded_bytes() const { return decoded_bytes_; }
+  virtual int64_t encoded_bytes() const { return encoded_bytes_; }
+
+ private:
+  const Flags& flags_;
+  const int num_rows_;
+  string path_;
+  vector<int> columns_;
+  int64_t decoded_bytes_;
+  int64_t encoded_bytes_;
+};
+
+static bool Selected(const Flags& flags, const BenchmarkCase& c) {
+  return flags.filter.empty() || c.name().find(flags.filter) != string::npos;
+}
+
+static void RunDecodeSuite(const Flags& flags) {
+  static const Encoding::type ENCODINGS[] = {
+    Encoding::PLAIN, Encoding::RLE_DICTIONARY, Encoding::DELTA_BINARY_PACKED,
+    Encoding::DELTA_LENGTH_BYTE_ARRAY, Encoding::DELTA_BYTE_ARRAY
+  };
+  for (int t = 0; t < ARRAY_SIZE(TYPES); ++t) {
+    for (int b = 0; b < ARRAY_SIZE(BIT_WIDTHS); ++b) {
+      // Booleans only have one bit.
+      if (TYPES[t] == Type::BOOLEAN && BIT_WIDTHS[b] != 1) continue;
+      ColumnData column;
+      bool generated = false;
+      for (int e = 0; e < ARRAY_SIZE(ENCODINGS); ++e) {
+        if (!SupportsEncoding(TYPES[t], ENCODINGS[e])) continue;
+        BenchmarkCase c;
+        c.suite = "decode";
+        c.type = TypeName(TYPES[t]);
+        c.encoding = EncodingName(ENCODINGS[e]);
+        c.bit_width = BIT_WIDTHS[b];
+        c.null_fraction = 0;
+        c.codec = CodecName(CompressionCodec::UNCOMPRESSED);
+        if (!Selected(flags, c)) continue;
+        if (!generated) {
+          GenerateColumn(TYPES[t], BIT_WIDTHS[b], 0, flags.num_values, t, &column);
+          generated = true;
+        }
+        DecodeBenchmark benchmark(column, ENCODINGS[e], flags.batch_size);
+        RunBenchmark(flags, c, &benchmark);
+      }
+    }
+  }
+}
+
+static void RunColumnSuite(const Flags& flags) {
+  // The encodings ColumnWriter produces.
+  static const Encoding::type ENCODINGS[] = {
+    Encoding::PLAIN, Encoding::RLE_DICTIONARY
+  };
+  for (int t = 0; t < ARRAY_SIZE(TYPES); ++t) {
+    for (int b = 0; b < ARRAY_SIZE(BIT_WIDTHS); ++b) {
+      if (TYPES[t] == Type::BOOLEAN && BIT_WIDTHS[b] != 1) continue;
+      for (int n = 0; n < ARRAY_SIZE(NULL_FRACTIONS); ++n) {
+        ColumnData column;
+        bool generated = false;
+        for (int e = 0; e < ARRAY_SIZE(ENCODINGS); ++e) {
+          if (!SupportsEncoding(TYPES[t], ENCODINGS[e])) continue;
+          for (int k = 0; k < ARRAY_SIZE(CODECS); ++k) {
+            BenchmarkCase c;
+            c.suite = "column";
+            c.type = TypeName(TYPES[t]);
+            c.encoding = EncodingName(ENCODINGS[e]);
+            c.bit_width = BIT_WIDTHS[b];
+            c.null_fraction = NULL_FRACTIONS[n];
+            c.codec = CodecName(CODECS[k]);
+            if (!Selected(flags, c)) continue;
+            if (!generated) {
+              GenerateColumn(TYPES[t], BIT_WIDTHS[b], NULL_FRACTIONS[n],
+                  flags.num_values, t, &column);
+              generated = true;
+            }
+            ColumnBenchmark benchmark(column, ENCODINGS[e], CODECS[k],
+                flags.batch_size);
+            RunBenchmark(flags, c, &benchmark);
+          }
+        }
+      }
+    }
+  }
+}
+
+static void RunScanSuite(const Flags& flags) {
+  for (int b = 0; b < ARRAY_SIZE(BIT_WIDTHS); ++b) {
+    for (int n = 0; n < ARRAY_SIZE(NULL_FRACTIONS); ++n) {
+      vector<ColumnData> columns;
+      for (int k = 0; k < ARRAY_SIZE(CODECS); ++k) {
+        BenchmarkCase c;
+        c.suite = "scan";
+        c.type = "ALL";
+        // Every column but the boolean one is dictionary encoded.
+        c.encoding = EncodingName(Encoding::RLE_DICTIONARY);
+        c.bit_width = BIT_WIDTHS[b];
+        c.null_fraction = NULL_FRACTIONS[n];
+        c.codec = CodecName(CODECS[k]);
+        if (!Selected(flags, c)) continue;
+        if (columns.empty()) {
+          columns.resize(ARRAY_SIZE(TYPES));
+          for (int t = 0; t < ARRAY_SIZE(TYPES); ++t) {
+            GenerateColumn(TYPES[t], TYPES[t] == Type::BOOLEAN ? 1 : BIT_WIDTHS[b],
+                NULL_FRACTIONS[n], flags.num_values, t, &columns[t]);
+          }
+        }
+        ScanBenchmark benchmark(columns, CODECS[k], flags);
+        RunBenchmark(flags, c, &benchmark);
+      }
+    }
+  }
+}
+
+static bool ParseFlag(const char* arg, const char* name, string* value) {
+  int len = strlen(name);
+  if (strncmp(arg, name, len) != 0 || arg[len] != '=') return false;
+  *value = arg + len + 1;
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Flags flags;
+  for (int i = 1; i < argc; ++i) {
+    string value;
+    if (ParseFlag(argv[i], "--suite", &value)) {
+      flags.suites = value;
+    } else if (ParseFlag(argv[i], "--filter", &value)) {
+      flags.filter = value;
+    } else if (ParseFlag(argv[i], "--num_values", &value)) {
+      flags.num_values = atoi(value.c_str());
+    } else if (ParseFlag(argv[i], "--min_time", &value)) {
+      flags.min_time = atof(value.c_str());
+    } else if (ParseFlag(argv[i], "--batch_size", &value)) {
+      flags.batch_size = atoi(value.c_str());
+    } else if (ParseFlag(argv[i], "--threads", &value)) {
+      flags.threads = atoi(value.c_str());
+    } else if (ParseFlag(argv[i], "--dir", &value)) {
+      flags.dir = value;
+    } else {
+      cerr << "Usage: parquet_benchmark [--suite=decode,column,scan] "
+           << "[--filter=<substring>] [--num_values=N] [--min_time=S] "
+           << "[--batch_size=N] [--threads=N] [--dir=D]" << endl;
+      return -1;
+    }
+  }
+  if (flags.num_values <= 0 || flags.batch_size <= 0 || flags.threads <= 0) {
+    cerr << "--num_values, --batch_size and --threads must be positive." << endl;
+    return -1;
+  }
+
+  try {
+    PrintHeader();
+    stringstream suites(flags.suites);
+    string suite;
+    while (getline(suites, suite, ',')) {
+      if (suite == "decode") {
+        RunDecodeSuite(flags);
+      } else if (suite == "column") {
+        RunColumnSuite(flags);
+      } else if (suite == "scan") {
+        RunScanSuite(flags);
+      } else {
+        cerr << "Unknown suite: " << suite << endl;
+        return -1;
+      }
+    }
+  } catch (const ParquetException& e) {
+    cerr << e.what() << endl;
+    return -1;
+  }
+  return 0;
+}
@@ -97,13 +97,22 @@ enum FieldRepetitionType {
  * All fields are optional.
  */
 struct Statistics {
-   /** min and max value of the column, encoded in PLAIN encoding */
+   /**
+    * DEPRECATED: min and max value of the column, encoded in PLAIN encoding. Use
+    * min_value and max_value. Some writers ordered byte arrays by signed bytes.
+    */
    1: optional binary max;
    2: optional binary min;
    /** count of null value in the column */
    3: optional i64 null_count;
    /** count of distinct values occurring */
    4: optional i64 distinct_count;
+   /**
+    * min and max value of the column, encoded in PLAIN encoding without the length
+    * prefix of byte arrays. Byte arrays are ordered by unsigned bytes.
+    */
+   5: optional binary max_value;
+   6: optional binary min_value;
 }
 
 /**
@@ -217,6 +226,9 @@ enum CompressionCodec {
   SNAPPY = 1;
   GZIP = 2;
   LZO = 3;
+  BROTLI = 4;
+  LZ4 = 5;
+  ZSTD = 6;
 }
 
 enum PageType {
@@ -378,6 +390,13 @@ struct ColumnMetaData {
 
   /** optional statistics for this column chunk */
   12: optional Statistics statistics;
+
+  /** Byte offset from beginning of file to the Bloom filter header of this column
+   * chunk. The header is followed by the bitset. **/
+  14: optional i64 bloom_filter_offset;
+
+  /** Size of the Bloom filter header and bitset in bytes **/
+  15: optional i32 bloom_filter_length;
 }
 
 struct ColumnChunk {
@@ -394,6 +413,18 @@ struct ColumnChunk {
    * metadata.
    **/
   3: optional ColumnMetaData meta_data
+
+  /** File offset of the OffsetIndex of this column chunk **/
+  4: optional i64 offset_index_offset
+
+  /** Size of the OffsetIndex in bytes **/
+  5: optional i32 offset_index_length
+
+  /** File offset of the ColumnIndex of this column chunk **/
+  6: optional i64 column_index_offset
+
+  /** Size of the ColumnIndex in bytes **/
+  7: optional i32 column_index_length
 }
 
 struct RowGroup {
@@ -442,3 +473,79 @@ struct FileMetaData {
   6: optional string created_by
 }
 
+/**
+ * Bloom filters and page indexes. Writers put them after the last row group and
+ * before the footer, so readers can fetch the ones they need without touching the
+ * column chunks.
+ */
+
+/** Block based algorithm: the bitset is a list of 256 bit blocks of 8 words, a value
+ * sets one bit in each word of a single block. */
+struct SplitBlockAlgorithm {}
+
+union BloomFilterAlgorithm {
+  1: SplitBlockAlgorithm BLOCK;
+}
+
+/** 64 bit xxHash with seed 0 of the PLAIN encoding of the value (without the length
+ * prefix for byte arrays). */
+struct XxHash {}
+
+union BloomFilterHash {
+  1: XxHash XXHASH;
+}
+
+struct Uncompressed {}
+
+union BloomFilterCompression {
+  1: Uncompressed UNCOMPRESSED;
+}
+
+/** Header of a Bloom filter. It is followed by the bitset. */
+struct BloomFilterHeader {
+  /** Size of the bitset in bytes **/
+  1: required i32 numBytes;
+  2: required BloomFilterAlgorithm algorithm;
+  3: required BloomFilterHash hash;
+  4: required BloomFilterCompression compression;
+}
+
+struct PageLocation {
+  /** Offset of the page header in the file **/
+  1: required i64 offset
+
+  /** Size of the page, including the header **/
+  2: required i32 compressed_page_size
+
+  /** Index of the first row of the page in the row group **/
+  3: required i64 first_row_index
+}
+
+/** Location of the data pages of a column chunk, in order. */
+struct OffsetIndex {
+  1: required list<PageLocation> page_locations
+}
+
+/** Whether the min and max values of the pages of a ColumnIndex are ordered. */
+enum BoundaryOrder {
+  UNORDERED = 0;
+  ASCENDING = 1;
+  DESCENDING = 2;
+}
+
+/**
+ * Statistics of the data pages of a column chunk, in the order of the OffsetIndex.
+ * Like Statistics, min and max are PLAIN encoded.
+ */
+struct ColumnIndex {
+  /** True for the pages that only have null values. Their min and max are empty. **/
+  1: required list<bool> null_pages
+
+  2: required list<binary> min_values
+  3: required list<binary> max_values
+
+  4: required BoundaryOrder boundary_order
+
+  /** Number of null values of each page **/
+  5: optional list<i64> null_counts
+}
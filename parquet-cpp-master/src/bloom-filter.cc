@@ -0,0 +1,207 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parquet/bloom-filter.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace parquet;
+using namespace std;
+
+namespace parquet_cpp {
+
+const int BloomFilter::BYTES_PER_BLOCK;
+const int BloomFilter::MIN_BYTES;
+const int BloomFilter::MAX_BYTES;
+
+// Number of 32 bit words in a block, one bit is set in each.
+static const int WORDS_PER_BLOCK = 8;
+
+// Multiplied with the lower 32 bits of the hash to pick the bit of each word.
+static const uint32_t SALT[WORDS_PER_BLOCK] = {
+  0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+  0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+static int RoundUpNumBytes(int64_t num_bytes) {
+  int result = BloomFilter::MIN_BYTES;
+  while (result < num_bytes && result < BloomFilter::MAX_BYTES) result *= 2;
+  return result;
+}
+
+int BloomFilter::OptimalNumBytes(int64_t num_distinct_values, double fpp) {
+  if (num_distinct_values <= 0) return MIN_BYTES;
+  if (fpp <= 0 || fpp >= 1) throw ParquetException("Invalid Bloom filter fpp.");
+  // With k = 8 bits set per value, the false positive rate of m bits and n values is
+  // about (1 - e^(-k * n / m))^k.
+  double num_bits = -WORDS_PER_BLOCK * num_distinct_values /
+      log(1 - pow(fpp, 1.0 / WORDS_PER_BLOCK));
+  return RoundUpNumBytes(static_cast<int64_t>(ceil(num_bits / 8)));
+}
+
+BloomFilter::BloomFilter(int num_bytes)
+  : bitset_(RoundUpNumBytes(num_bytes) / sizeof(uint32_t)) {
+}
+
+BloomFilter::BloomFilter(const uint8_t* bitset, int num_bytes) {
+  if (num_bytes < MIN_BYTES || num_bytes > MAX_BYTES ||
+      (num_bytes & (num_bytes - 1)) != 0) {
+    throw ParquetException("Invalid Bloom filter size.");
+  }
+  bitset_.resize(num_bytes / sizeof(uint32_t));
+  memcpy(&bitset_[0], bitset, num_bytes);
+}
+
+BloomFilter* BloomFilter::Deserialize(const uint8_t* data, int64_t len) {
+  BloomFilterHeader header;
+  uint32_t header_len = len;
+  DeserializeThriftMsg(data, &header_len, &header);
+  if (!header.algorithm.__isset.BLOCK || !header.hash.__isset.XXHASH ||
+      !header.compression.__isset.UNCOMPRESSED) {
+    ParquetException::NYI("Bloom filter algorithm, hash or compression");
+  }
+  if (header.numBytes > len - header_len) {
+    throw ParquetException("Bloom filter is truncated.");
+  }
+  return new BloomFilter(data + header_len, header.numBytes);
+}
+
+void BloomFilter::Serialize(OutputStream* out) const {
+  BloomFilterHeader header;
+  header.__set_numBytes(num_bytes());
+  header.algorithm.__set_BLOCK(SplitBlockAlgorithm());
+  header.hash.__set_XXHASH(XxHash());
+  header.compression.__set_UNCOMPRESSED(Uncompressed());
+  SerializeThriftMsg(header, out);
+  out->Write(reinterpret_cast<const uint8_t*>(&bitset_[0]), num_bytes());
+}
+
+int64_t BloomFilter::BlockIndex(uint64_t hash) const {
+  // Maps the upper 32 bits to [0, number of blocks) without a division.
+  uint64_t num_blocks = bitset_.size() / WORDS_PER_BLOCK;
+  return ((hash >> 32) * num_blocks) >> 32;
+}
+
+void BloomFilter::Insert(uint64_t hash) {
+  uint32_t* block = &bitset_[BlockIndex(hash) * WORDS_PER_BLOCK];
+  uint32_t key = static_cast<uint32_t>(hash);
+  for (int i = 0; i < WORDS_PER_BLOCK; ++i) {
+    block[i] |= 1U << ((key * SALT[i]) >> 27);
+  }
+}
+
+bool BloomFilter::Find(uint64_t hash) const {
+  const uint32_t* block = &bitset_[BlockIndex(hash) * WORDS_PER_BLOCK];
+  uint32_t key = static_cast<uint32_t>(hash);
+  for (int i = 0; i < WORDS_PER_BLOCK; ++i) {
+    if ((block[i] & (1U << ((key * SALT[i]) >> 27))) == 0) return false;
+  }
+  return true;
+}
+
+// 64 bit xxHash (http://cyan4973.github.io/xxHash/) with seed 0.
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t RotateLeft(uint64_t x, int bits) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+static inline uint64_t Load64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t Load32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t XxHashRound(uint64_t acc, uint64_t input) {
+  acc += input * PRIME64_2;
+  return RotateLeft(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t XxHashMergeRound(uint64_t acc, uint64_t val) {
+  acc ^= XxHashRound(0, val);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t BloomFilter::Hash(const uint8_t* data, int len) {
+  const uint8_t* p = data;
+  const uint8_t* end = data + len;
+  uint64_t h;
+  if (len >= 32) {
+    uint64_t v1 = PRIME64_1 + PRIME64_2;
+    uint64_t v2 = PRIME64_2;
+    uint64_t v3 = 0;
+    uint64_t v4 = -PRIME64_1;
+    for (; p + 32 <= end; p += 32) {
+      v1 = XxHashRound(v1, Load64(p));
+      v2 = XxHashRound(v2, Load64(p + 8));
+      v3 = XxHashRound(v3, Load64(p + 16));
+      v4 = XxHashRound(v4, Load64(p + 24));
+    }
+    h = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+    h = XxHashMergeRound(h, v1);
+    h = XxHashMergeRound(h, v2);
+    h = XxHashMergeRound(h, v3);
+    h = XxHashMergeRound(h, v4);
+  } else {
+    h = PRIME64_5;
+  }
+  h += len;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= XxHashRound(0, Load64(p));
+    h = RotateLeft(h, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (p + 4 <= end) {
+    h ^= Load32(p) * PRIME64_1;
+    h = RotateLeft(h, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    h ^= *p * PRIME64_5;
+    h = RotateLeft(h, 11) * PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= PRIME64_2;
+  h ^= h >> 29;
+  h *= PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t BloomFilter::Hash(int32_t value) {
+  return Hash(reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+}
+
+uint64_t BloomFilter::Hash(int64_t value) {
+  return Hash(reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+}
+
+uint64_t BloomFilter::Hash(const ByteArray& value) {
+  return Hash(value.ptr, value.len);
+}
+
+}
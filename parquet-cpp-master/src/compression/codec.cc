@@ -0,0 +1,104 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codec.h"
+
+using namespace boost;
+using namespace parquet;
+using namespace parquet_cpp;
+using namespace std;
+
+Codec* Codec::Create(const CompressionCodec::type& codec) {
+  switch (codec) {
+    case CompressionCodec::UNCOMPRESSED:
+      return NULL;
+    case CompressionCodec::SNAPPY:
+      return new SnappyCodec();
+    case CompressionCodec::GZIP:
+      return new GZipCodec();
+    case CompressionCodec::LZ4:
+      return new Lz4Codec();
+    case CompressionCodec::ZSTD:
+      return new ZstdCodec();
+    default:
+      ParquetException::NYI("Unsupported compression codec");
+  }
+  return NULL;
+}
+
+CodecPool* CodecPool::instance() {
+  // Intentionally leaked so the pool outlives readers in static destructors.
+  static CodecPool* pool = new CodecPool();
+  return pool;
+}
+
+CodecPool::~CodecPool() {
+  for (unordered_map<int, vector<Codec*> >::iterator it = codecs_.begin();
+      it != codecs_.end(); ++it) {
+    for (int i = 0; i < it->second.size(); ++i) delete it->second[i];
+  }
+  for (int i = 0; i < buffers_.size(); ++i) delete buffers_[i];
+}
+
+Codec* CodecPool::Acquire(const CompressionCodec::type& codec) {
+  if (codec == CompressionCodec::UNCOMPRESSED) return NULL;
+  {
+    mutex::scoped_lock l(lock_);
+    vector<Codec*>& codecs = codecs_[codec];
+    if (!codecs.empty()) {
+      Codec* result = codecs.back();
+      codecs.pop_back();
+      return result;
+    }
+  }
+  return Codec::Create(codec);
+}
+
+void CodecPool::Release(const CompressionCodec::type& type, Codec* codec) {
+  if (codec == NULL) return;
+  {
+    mutex::scoped_lock l(lock_);
+    vector<Codec*>& codecs = codecs_[type];
+    if (codecs.size() < MAX_POOLED_CODECS) {
+      codecs.push_back(codec);
+      return;
+    }
+  }
+  delete codec;
+}
+
+void CodecPool::AcquireBuffer(vector<uint8_t>* buffer) {
+  vector<uint8_t>* pooled = NULL;
+  {
+    mutex::scoped_lock l(lock_);
+    if (buffers_.empty()) return;
+    pooled = buffers_.back();
+    buffers_.pop_back();
+  }
+  buffer->swap(*pooled);
+  delete pooled;
+}
+
+void CodecPool::ReleaseBuffer(vector<uint8_t>* buffer) {
+  vector<uint8_t>* pooled = new vector<uint8_t>();
+  pooled->swap(*buffer);
+  if (pooled->capacity() > 0 && pooled->capacity() <= MAX_POOLED_BUFFER_SIZE) {
+    mutex::scoped_lock l(lock_);
+    if (buffers_.size() < MAX_POOLED_BUFFERS) {
+      buffers_.push_back(pooled);
+      return;
+    }
+  }
+  delete pooled;
+}
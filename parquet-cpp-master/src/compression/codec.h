@@ -17,14 +17,27 @@
 
 #include "parquet/parquet.h"
 
+#include <vector>
 #include <boost/cstdint.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 #include "gen-cpp/parquet_constants.h"
 #include "gen-cpp/parquet_types.h"
 
+struct z_stream_s;
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
 namespace parquet_cpp {
 
+// Codecs are not thread safe. Codecs that need a context (zlib streams, zstd
+// contexts) create it on first use and reuse it for all later calls.
 class Codec {
  public:
+  // Returns a new codec object for 'codec', or NULL for UNCOMPRESSED. The caller
+  // owns the result. Throws ParquetException for unsupported codecs.
+  static Codec* Create(const parquet::CompressionCodec::type& codec);
+
   virtual ~Codec() {}
   virtual void Decompress(int input_len, const uint8_t* input,
       int output_len, uint8_t* output_buffer) = 0;
@@ -66,6 +79,87 @@ class Lz4Codec : public Codec {
   virtual const char* name() const { return "lz4"; }
 };
 
+// GZip codec (zlib). Decompression also accepts zlib streams.
+class GZipCodec : public Codec {
+ public:
+  GZipCodec();
+  virtual ~GZipCodec();
+
+  virtual void Decompress(int input_len, const uint8_t* input,
+      int output_len, uint8_t* output_buffer);
+
+  virtual int Compress(int input_len, const uint8_t* input,
+      int output_buffer_len, uint8_t* output_buffer);
+
+  virtual int MaxCompressedLen(int input_len, const uint8_t* input);
+
+  virtual const char* name() const { return "gzip"; }
+
+ private:
+  void InitCompressor();
+
+  z_stream_s* inflate_stream_;
+  z_stream_s* deflate_stream_;
+};
+
+// ZStandard codec.
+class ZstdCodec : public Codec {
+ public:
+  ZstdCodec();
+  virtual ~ZstdCodec();
+
+  virtual void Decompress(int input_len, const uint8_t* input,
+      int output_len, uint8_t* output_buffer);
+
+  virtual int Compress(int input_len, const uint8_t* input,
+      int output_buffer_len, uint8_t* output_buffer);
+
+  virtual int MaxCompressedLen(int input_len, const uint8_t* input);
+
+  virtual const char* name() const { return "zstd"; }
+
+ private:
+  ZSTD_CCtx_s* cctx_;
+  ZSTD_DCtx_s* dctx_;
+};
+
+// Process wide pool of codecs and decompression buffers. Creating a codec context
+// and growing a buffer to the page size is expensive compared to decompressing a
+// page, so column readers borrow both from the pool for their lifetime and give
+// them back when they are done. This is thread safe.
+class CodecPool {
+ public:
+  static CodecPool* instance();
+
+  ~CodecPool();
+
+  // Returns a codec for 'codec', reusing a released one if possible. Returns NULL
+  // for UNCOMPRESSED. The codec must be given back with Release().
+  Codec* Acquire(const parquet::CompressionCodec::type& codec);
+
+  // Returns 'codec', which was acquired for 'type', to the pool. 'codec' can be NULL.
+  void Release(const parquet::CompressionCodec::type& type, Codec* codec);
+
+  // Swaps a pooled buffer into 'buffer'. The contents of the buffer are undefined,
+  // only its capacity is reused.
+  void AcquireBuffer(std::vector<uint8_t>* buffer);
+
+  // Returns the memory of 'buffer' to the pool. 'buffer' is left empty.
+  void ReleaseBuffer(std::vector<uint8_t>* buffer);
+
+ private:
+  // Bounds for what the pool keeps, anything over these is freed.
+  static const int MAX_POOLED_CODECS = 64;
+  static const int MAX_POOLED_BUFFERS = 64;
+  static const int64_t MAX_POOLED_BUFFER_SIZE = 64 * 1024 * 1024;
+
+  CodecPool() {}
+
+  boost::mutex lock_;
+  boost::unordered_map<int, std::vector<Codec*> > codecs_;
+  std::vector<std::vector<uint8_t>*> buffers_;
+};
+
 }
 
 #endif
@@ -0,0 +1,107 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codec.h"
+
+#include <string.h>
+#include <zlib.h>
+#include <sstream>
+
+using namespace parquet_cpp;
+using namespace std;
+
+// Window bits to write gzip headers, and to detect gzip or zlib headers when reading.
+const int GZIP_WINDOW_BITS = 15 + 16;
+const int DETECT_WINDOW_BITS = 15 + 32;
+
+static void ThrowZlibError(const char* what, z_stream_s* stream, int ret) {
+  stringstream ss;
+  ss << what << " (" << (stream->msg != NULL ? stream->msg : zError(ret)) << ")";
+  throw ParquetException(ss.str());
+}
+
+GZipCodec::GZipCodec() : inflate_stream_(NULL), deflate_stream_(NULL) {
+}
+
+GZipCodec::~GZipCodec() {
+  if (inflate_stream_ != NULL) {
+    inflateEnd(inflate_stream_);
+    delete inflate_stream_;
+  }
+  if (deflate_stream_ != NULL) {
+    deflateEnd(deflate_stream_);
+    delete deflate_stream_;
+  }
+}
+
+void GZipCodec::Decompress(int input_len, const uint8_t* input,
+      int output_len, uint8_t* output_buffer) {
+  if (inflate_stream_ == NULL) {
+    inflate_stream_ = new z_stream_s();
+    memset(inflate_stream_, 0, sizeof(z_stream_s));
+    int ret = inflateInit2(inflate_stream_, DETECT_WINDOW_BITS);
+    if (ret != Z_OK) {
+      delete inflate_stream_;
+      inflate_stream_ = NULL;
+      throw ParquetException("Could not initialize zlib inflate.");
+    }
+  } else {
+    inflateReset(inflate_stream_);
+  }
+
+  inflate_stream_->next_in = const_cast<Bytef*>(input);
+  inflate_stream_->avail_in = input_len;
+  inflate_stream_->next_out = output_buffer;
+  inflate_stream_->avail_out = output_len;
+  int ret = inflate(inflate_stream_, Z_FINISH);
+  if (ret != Z_STREAM_END) {
+    ThrowZlibError("Corrupt gzip compressed data.", inflate_stream_, ret);
+  }
+  if (inflate_stream_->total_out != output_len) {
+    throw ParquetException("Corrupt gzip compressed data.");
+  }
+}
+
+void GZipCodec::InitCompressor() {
+  if (deflate_stream_ != NULL) return;
+  deflate_stream_ = new z_stream_s();
+  memset(deflate_stream_, 0, sizeof(z_stream_s));
+  int ret = deflateInit2(deflate_stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+      GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY);
+  if (ret != Z_OK) {
+    delete deflate_stream_;
+    deflate_stream_ = NULL;
+    throw ParquetException("Could not initialize zlib deflate.");
+  }
+}
+
+int GZipCodec::MaxCompressedLen(int input_len, const uint8_t* input) {
+  InitCompressor();
+  return deflateBound(deflate_stream_, input_len);
+}
+
+int GZipCodec::Compress(int input_len, const uint8_t* input,
+    int output_buffer_len, uint8_t* output_buffer) {
+  InitCompressor();
+  deflateReset(deflate_stream_);
+  deflate_stream_->next_in = const_cast<Bytef*>(input);
+  deflate_stream_->avail_in = input_len;
+  deflate_stream_->next_out = output_buffer;
+  deflate_stream_->avail_out = output_buffer_len;
+  int ret = deflate(deflate_stream_, Z_FINISH);
+  if (ret != Z_STREAM_END) {
+    ThrowZlibError("Could not gzip compress data.", deflate_stream_, ret);
+  }
+  return deflate_stream_->total_out;
+}
@@ -18,11 +18,46 @@
 
 using namespace parquet_cpp;
 
+// Size of the header of each block of the Hadoop lz4 framing: the big endian
+// uncompressed and compressed lengths.
+const int HADOOP_LZ4_HEADER_SIZE = 8;
+
+static uint32_t ReadBigEndian32(const uint8_t* data) {
+  return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) |
+      data[3];
+}
+
+// Decompresses data in the framing of Hadoop's Lz4Codec, which some writers use for
+// the LZ4 codec. Returns false if the data does not look like this framing.
+static bool DecompressHadoopLz4(int input_len, const uint8_t* input,
+    int output_len, uint8_t* output_buffer) {
+  int output_offset = 0;
+  while (input_len >= HADOOP_LZ4_HEADER_SIZE) {
+    uint32_t uncompressed_len = ReadBigEndian32(input);
+    uint32_t compressed_len = ReadBigEndian32(input + 4);
+    input += HADOOP_LZ4_HEADER_SIZE;
+    input_len -= HADOOP_LZ4_HEADER_SIZE;
+    if (compressed_len > input_len || uncompressed_len > output_len - output_offset) {
+      return false;
+    }
+    int n = LZ4_decompress_safe(reinterpret_cast<const char*>(input),
+        reinterpret_cast<char*>(output_buffer + output_offset), compressed_len,
+        uncompressed_len);
+    if (n != uncompressed_len) return false;
+    input += compressed_len;
+    input_len -= compressed_len;
+    output_offset += n;
+  }
+  return input_len == 0 && output_offset == output_len;
+}
+
 void Lz4Codec::Decompress(int input_len, const uint8_t* input,
       int output_len, uint8_t* output_buffer) {
-  int n = LZ4_decompress_fast(reinterpret_cast<const char*>(input),
-      reinterpret_cast<char*>(output_buffer), output_len);
-  if (n != input_len) {
+  // Try the raw lz4 block format first and fall back to the Hadoop framing.
+  int n = LZ4_decompress_safe(reinterpret_cast<const char*>(input),
+      reinterpret_cast<char*>(output_buffer), input_len, output_len);
+  if (n == output_len) return;
+  if (!DecompressHadoopLz4(input_len, input, output_len, output_buffer)) {
     throw ParquetException("Corrupt lz4 compressed data.");
   }
 }
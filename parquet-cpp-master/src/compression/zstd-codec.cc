@@ -0,0 +1,68 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "codec.h"
+
+#include <zstd.h>
+#include <sstream>
+
+using namespace parquet_cpp;
+using namespace std;
+
+// Compression level used when writing. Level 1 is the fastest; ZSTD is mostly
+// picked over SNAPPY for its better ratio at a similar speed.
+const int ZSTD_COMPRESSION_LEVEL = 1;
+
+ZstdCodec::ZstdCodec() : cctx_(NULL), dctx_(NULL) {
+}
+
+ZstdCodec::~ZstdCodec() {
+  if (cctx_ != NULL) ZSTD_freeCCtx(cctx_);
+  if (dctx_ != NULL) ZSTD_freeDCtx(dctx_);
+}
+
+void ZstdCodec::Decompress(int input_len, const uint8_t* input,
+      int output_len, uint8_t* output_buffer) {
+  if (dctx_ == NULL) {
+    dctx_ = ZSTD_createDCtx();
+    if (dctx_ == NULL) throw ParquetException("Could not create zstd context.");
+  }
+  size_t ret = ZSTD_decompressDCtx(dctx_, output_buffer, output_len, input, input_len);
+  if (ZSTD_isError(ret) || ret != output_len) {
+    stringstream ss;
+    ss << "Corrupt zstd compressed data.";
+    if (ZSTD_isError(ret)) ss << " (" << ZSTD_getErrorName(ret) << ")";
+    throw ParquetException(ss.str());
+  }
+}
+
+int ZstdCodec::MaxCompressedLen(int input_len, const uint8_t* input) {
+  return ZSTD_compressBound(input_len);
+}
+
+int ZstdCodec::Compress(int input_len, const uint8_t* input,
+    int output_buffer_len, uint8_t* output_buffer) {
+  if (cctx_ == NULL) {
+    cctx_ = ZSTD_createCCtx();
+    if (cctx_ == NULL) throw ParquetException("Could not create zstd context.");
+  }
+  size_t ret = ZSTD_compressCCtx(cctx_, output_buffer, output_buffer_len,
+      input, input_len, ZSTD_COMPRESSION_LEVEL);
+  if (ZSTD_isError(ret)) {
+    stringstream ss;
+    ss << "Could not zstd compress data. (" << ZSTD_getErrorName(ret) << ")";
+    throw ParquetException(ss.str());
+  }
+  return ret;
+}
@@ -23,22 +23,23 @@ class BoolDecoder : public Decoder {
  public:
   BoolDecoder() : Decoder(parquet::Type::BOOLEAN, parquet::Encoding::PLAIN) { }
 
+  // PLAIN encoded booleans are bit packed, LSB first, without a run header.
   virtual void SetData(int num_values, const uint8_t* data, int len) {
     num_values_ = num_values;
-    decoder_ = impala::RleDecoder(data, len, 1);
+    decoder_ = impala::BitReader(data, len);
   }
 
   virtual int GetBool(bool* buffer, int max_values) {
     max_values = std::min(max_values, num_values_);
     for (int i = 0; i < max_values; ++i) {
-      if (!decoder_.Get(&buffer[i])) ParquetException::EofException();
+      if (!decoder_.GetValue(1, &buffer[i])) ParquetException::EofException();
     }
     num_values_ -= max_values;
     return max_values;
   }
 
  private:
-  impala::RleDecoder decoder_;
+  impala::BitReader decoder_;
 };
 
 }
@@ -15,10 +15,72 @@
 #ifndef PARQUET_DELTA_BIT_PACK_ENCODING_H
 #define PARQUET_DELTA_BIT_PACK_ENCODING_H
 
+#include <boost/type_traits/make_unsigned.hpp>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "encodings.h"
+#include "impala/bit-unpack.h"
 
 namespace parquet_cpp {
 
+// In place inclusive prefix sum of 'values', starting from '*last'. '*last' is
+// updated to the last sum. All arithmetic wraps around, as the deltas are computed
+// with wrap around by the writers.
+inline void DeltaPrefixSum(uint32_t* values, int num_values, uint32_t* last) {
+  int i = 0;
+  uint32_t sum = *last;
+#ifdef __SSE2__
+  // Sums 4 values at a time with two shifted adds and carries the last lane into
+  // the next group.
+  __m128i carry = _mm_set1_epi32(sum);
+  for (; i + 4 <= num_values; i += 4) {
+    __m128i* p = reinterpret_cast<__m128i*>(values + i);
+    __m128i x = _mm_loadu_si128(p);
+    x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi32(x, carry);
+    _mm_storeu_si128(p, x);
+    carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  sum = _mm_cvtsi128_si32(carry);
+#endif
+  for (; i < num_values; ++i) {
+    sum += values[i];
+    values[i] = sum;
+  }
+  *last = sum;
+}
+
+inline void DeltaPrefixSum(uint64_t* values, int num_values, uint64_t* last) {
+  int i = 0;
+  uint64_t sum = *last;
+#ifdef __SSE2__
+  __m128i carry = _mm_set1_epi64x(sum);
+  for (; i + 2 <= num_values; i += 2) {
+    __m128i* p = reinterpret_cast<__m128i*>(values + i);
+    __m128i x = _mm_loadu_si128(p);
+    x = _mm_add_epi64(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi64(x, carry);
+    _mm_storeu_si128(p, x);
+    carry = _mm_unpackhi_epi64(x, x);
+  }
+  if (i > 0) sum = values[i - 1];
+#endif
+  for (; i < num_values; ++i) {
+    sum += values[i];
+    values[i] = sum;
+  }
+  *last = sum;
+}
+
+// Decoder for DELTA_BINARY_PACKED. The data starts with a header
+//   <block size> <number of miniblocks per block> <total value count> <first value>
+// followed by blocks of
+//   <min delta> <bit width of each miniblock> <miniblocks>
+// Each miniblock is decoded at once: its deltas are unpacked 32 at a time, the
+// min delta is added and the values are rebuilt with a prefix sum.
 class DeltaBitPackDecoder : public Decoder {
  public:
   DeltaBitPackDecoder(const parquet::Type::type& type)
@@ -29,10 +91,11 @@ class DeltaBitPackDecoder : public Decoder {
   }
 
   virtual void SetData(int num_values, const uint8_t* data, int len) {
-    num_values_ = num_values;
     decoder_ = impala::BitReader(data, len);
-    values_current_block_ = 0;
-    values_current_mini_block_ = 0;
+    len_ = len;
+    InitHeader();
+    // 'num_values' includes the nulls of the page, the header has the actual count.
+    num_values_ = std::min<uint64_t>(num_values, total_value_count_);
   }
 
   virtual int GetInt32(int32_t* buffer, int max_values) {
@@ -43,68 +106,122 @@ class DeltaBitPackDecoder : public Decoder {
     return GetInternal(buffer, max_values);
   }
 
+  // Returns the number of bytes of the data read so far. Once all the values are
+  // read this is the size of the encoded values, which is needed to find the data
+  // that follows them in the DELTA_(LENGTH_)BYTE_ARRAY encodings.
+  int bytes_consumed() { return len_ - decoder_.bytes_left(); }
+
  private:
-  void InitBlock() {
+  void InitHeader() {
     uint64_t block_size;
     if (!decoder_.GetVlqInt(&block_size)) ParquetException::EofException();
     if (!decoder_.GetVlqInt(&num_mini_blocks_)) ParquetException::EofException();
-    if (!decoder_.GetVlqInt(&values_current_block_)) {
-      ParquetException::EofException();
-    }
+    if (!decoder_.GetVlqInt(&total_value_count_)) ParquetException::EofException();
     if (!decoder_.GetZigZagVlqInt(&last_value_)) ParquetException::EofException();
+    if (num_mini_blocks_ == 0 || block_size % num_mini_blocks_ != 0 ||
+        (block_size / num_mini_blocks_) % 32 != 0) {
+      throw ParquetException("Invalid delta bit pack block size.");
+    }
+    values_per_mini_block_ = block_size / num_mini_blocks_;
     delta_bit_widths_.resize(num_mini_blocks_);
+    mini_block_values_.resize(values_per_mini_block_);
+    // The first value is stored in the header. The blocks start after it.
+    first_value_pending_ = total_value_count_ > 0;
+    mini_block_idx_ = num_mini_blocks_;
+    values_current_mini_block_ = 0;
+    mini_block_offset_ = 0;
+  }
 
+  void InitBlock() {
     if (!decoder_.GetZigZagVlqInt(&min_delta_)) ParquetException::EofException();
     for (int i = 0; i < num_mini_blocks_; ++i) {
       if (!decoder_.GetAligned<uint8_t>(1, &delta_bit_widths_[i])) {
         ParquetException::EofException();
       }
     }
-    values_per_mini_block_ = block_size / num_mini_blocks_;
     mini_block_idx_ = 0;
-    delta_bit_width_ = delta_bit_widths_[0];
-    values_current_mini_block_ = values_per_mini_block_;
+  }
+
+  // Decodes the next miniblock into mini_block_values_. U is the unsigned type of
+  // the column values.
+  template <typename U>
+  void DecodeMiniBlock() {
+    if (mini_block_idx_ == num_mini_blocks_) InitBlock();
+    int bit_width = delta_bit_widths_[mini_block_idx_++];
+    if (bit_width > sizeof(U) * 8) {
+      throw ParquetException("Invalid delta bit pack bit width.");
+    }
+    int num_values = values_per_mini_block_;
+    int num_bytes = num_values / 8 * bit_width;
+    const uint8_t* data = decoder_.GetBytes(num_bytes);
+    if (data == NULL) {
+      // Writers are not required to pad the last miniblock of a page.
+      int bytes_left = decoder_.bytes_left();
+      if (bytes_left <= 0) ParquetException::EofException();
+      padded_mini_block_.assign(num_bytes, 0);
+      memcpy(&padded_mini_block_[0], decoder_.GetBytes(bytes_left), bytes_left);
+      data = &padded_mini_block_[0];
+    }
+
+    U* values = reinterpret_cast<U*>(&mini_block_values_[0]);
+    // The miniblock size is a multiple of 32, checked in InitHeader().
+    for (int i = 0; i < num_values; i += 32) {
+      data = impala::Unpack32Values(data, bit_width, values + i);
+    }
+
+    U min_delta = static_cast<U>(min_delta_);
+    for (int i = 0; i < num_values; ++i) {
+      values[i] += min_delta;
+    }
+    U last_value = static_cast<U>(last_value_);
+    DeltaPrefixSum(values, num_values, &last_value);
+    last_value_ = static_cast<int64_t>(last_value);
+
+    values_current_mini_block_ = num_values;
+    mini_block_offset_ = 0;
   }
 
   template <typename T>
   int GetInternal(T* buffer, int max_values) {
+    typedef typename boost::make_unsigned<T>::type U;
     max_values = std::min(max_values, num_values_);
-    for (int i = 0; i < max_values; ++i) {
-      if (UNLIKELY(values_current_mini_block_ == 0)) {
-        ++mini_block_idx_;
-        if (mini_block_idx_ < delta_bit_widths_.size()) {
-          delta_bit_width_ = delta_bit_widths_[mini_block_idx_];
-          values_current_mini_block_ = values_per_mini_block_;
-        } else {
-          InitBlock();
-          buffer[i] = last_value_;
-          continue;
-        }
-      }
-
-      // TODO: the key to this algorithm is to decode the entire miniblock at once.
-      int64_t delta;
-      if (!decoder_.GetValue(delta_bit_width_, &delta)) ParquetException::EofException();
-      delta += min_delta_;
-      last_value_ += delta;
-      buffer[i] = last_value_;
-      --values_current_mini_block_;
+    int i = 0;
+    if (UNLIKELY(first_value_pending_) && max_values > 0) {
+      buffer[i++] = static_cast<T>(last_value_);
+      first_value_pending_ = false;
+    }
+    while (i < max_values) {
+      if (values_current_mini_block_ == 0) DecodeMiniBlock<U>();
+      int n = std::min<int>(max_values - i, values_current_mini_block_);
+      const U* values = reinterpret_cast<const U*>(&mini_block_values_[0]);
+      memcpy(buffer + i, values + mini_block_offset_, n * sizeof(T));
+      mini_block_offset_ += n;
+      values_current_mini_block_ -= n;
+      i += n;
     }
     num_values_ -= max_values;
     return max_values;
   }
 
   impala::BitReader decoder_;
-  uint64_t values_current_block_;
+  int len_;
+  uint64_t total_value_count_;
   uint64_t num_mini_blocks_;
-  uint64_t values_per_mini_block_;
-  uint64_t values_current_mini_block_;
+  int values_per_mini_block_;
 
   int64_t min_delta_;
   int mini_block_idx_;
   std::vector<uint8_t> delta_bit_widths_;
-  int delta_bit_width_;
 
+  // Decoded values of the current miniblock, stored as uint32_t or uint64_t
+  // depending on the column type. uint64_t storage is large enough for both.
+  std::vector<uint64_t> mini_block_values_;
+  int mini_block_offset_;
+  int values_current_mini_block_;
+  std::vector<uint8_t> padded_mini_block_;
+
+  bool first_value_pending_;
+  // The first value, and then the last value of the last decoded miniblock.
   int64_t last_value_;
 };
 
@@ -27,36 +27,66 @@ class DeltaByteArrayDecoder : public Decoder {
       suffix_decoder_() {
   }
 
+  // The prefix lengths are DELTA_BINARY_PACKED and directly followed by the
+  // suffixes. The size of the encoded prefix lengths is only known once they are
+  // decoded, so they are all decoded here.
   virtual void SetData(int num_values, const uint8_t* data, int len) {
-    num_values_ = num_values;
+    num_values_ = 0;
+    prefix_lengths_idx_ = 0;
+    values_len_ = 0;
+    last_value_.len = 0;
+    last_value_.ptr = NULL;
     if (len == 0) return;
-    int prefix_len_length = *reinterpret_cast<const int*>(data);
-    data += 4;
-    len -= 4;
-    prefix_len_decoder_.SetData(num_values, data, prefix_len_length);
-    data += prefix_len_length;
-    len -= prefix_len_length;
-    suffix_decoder_.SetData(num_values, data, len);
+    prefix_len_decoder_.SetData(num_values, data, len);
+    if (prefix_lengths_.size() < num_values) prefix_lengths_.resize(num_values);
+    if (num_values > 0) {
+      num_values_ = prefix_len_decoder_.GetInt32(&prefix_lengths_[0], num_values);
+    }
+    int prefix_lengths_len = prefix_len_decoder_.bytes_consumed();
+    int suffixes_len = len - prefix_lengths_len;
+    suffix_decoder_.SetData(num_values_, data + prefix_lengths_len, suffixes_len);
+
+    // No value is longer than all the suffixes together, which bounds the prefix
+    // lengths. Size the buffer for all the values of the page, so it is never
+    // reallocated while earlier values point into it.
+    int64_t values_len = suffixes_len;
+    for (int i = 0; i < num_values_; ++i) {
+      if (UNLIKELY(prefix_lengths_[i] < 0 || prefix_lengths_[i] > suffixes_len)) {
+        throw ParquetException("Invalid delta byte array prefix length.");
+      }
+      values_len += prefix_lengths_[i];
+    }
+    if (values_buffer_.size() < values_len) values_buffer_.resize(values_len);
   }
 
-  // TODO: this doesn't work and requires memory management. We need to allocate
-  // new strings to store the results.
+  // The values are built from the prefix of the previous value and a suffix. They
+  // are stored in a buffer owned by the decoder and stay valid until the next call
+  // to SetData().
   virtual int GetByteArray(ByteArray* buffer, int max_values) {
     max_values = std::min(max_values, num_values_);
-    for (int  i = 0; i < max_values; ++i) {
-      int prefix_len = 0;
-      prefix_len_decoder_.GetInt32(&prefix_len, 1);
-      ByteArray suffix;
-      suffix_decoder_.GetByteArray(&suffix, 1);
-      buffer[i].len = prefix_len + suffix.len;
-
-      uint8_t* result = reinterpret_cast<uint8_t*>(malloc(buffer[i].len));
-      memcpy(result, last_value_.ptr, prefix_len);
-      memcpy(result + prefix_len, suffix.ptr, suffix.len);
+    const int32_t* prefix_lengths =
+        max_values > 0 ? &prefix_lengths_[prefix_lengths_idx_] : NULL;
+    prefix_lengths_idx_ += max_values;
+    if (suffix_decoder_.GetByteArray(buffer, max_values) != max_values) {
+      ParquetException::EofException();
+    }
 
-      buffer[i].ptr = result;
+    uint8_t* start = values_buffer_.empty() ? NULL : &values_buffer_[0] + values_len_;
+    uint8_t* out = start;
+    for (int i = 0; i < max_values; ++i) {
+      int prefix_len = prefix_lengths[i];
+      if (UNLIKELY(prefix_len > last_value_.len)) {
+        throw ParquetException("Invalid delta byte array prefix length.");
+      }
+      const ByteArray suffix = buffer[i];
+      if (prefix_len > 0) memcpy(out, last_value_.ptr, prefix_len);
+      memcpy(out + prefix_len, suffix.ptr, suffix.len);
+      buffer[i].ptr = out;
+      buffer[i].len = prefix_len + suffix.len;
       last_value_ = buffer[i];
+      out += buffer[i].len;
     }
+    values_len_ += out - start;
     num_values_ -= max_values;
     return max_values;
   }
@@ -64,7 +94,16 @@ class DeltaByteArrayDecoder : public Decoder {
  private:
   DeltaBitPackDecoder prefix_len_decoder_;
   DeltaLengthByteArrayDecoder suffix_decoder_;
+  // The last value returned, which the prefix of the next one is taken from.
   ByteArray last_value_;
+
+  // The decoded prefix lengths of the page and the index of the next one.
+  std::vector<int32_t> prefix_lengths_;
+  int prefix_lengths_idx_;
+
+  // The values of the page returned so far take the first values_len_ bytes.
+  std::vector<uint8_t> values_buffer_;
+  int64_t values_len_;
 };
 
 }
@@ -26,26 +26,34 @@ class DeltaLengthByteArrayDecoder : public Decoder {
       len_decoder_(parquet::Type::INT32) {
   }
 
+  // The lengths are DELTA_BINARY_PACKED and directly followed by the bytes of the
+  // values. The size of the encoded lengths is only known once they are decoded,
+  // so they are all decoded here.
   virtual void SetData(int num_values, const uint8_t* data, int len) {
-    num_values_ = num_values;
+    num_values_ = 0;
+    lengths_idx_ = 0;
     if (len == 0) return;
-    int total_lengths_len = *reinterpret_cast<const int*>(data);
-    data += 4;
-    len_decoder_.SetData(num_values, data, total_lengths_len);
-    data_ = data + total_lengths_len;
-    len_ = len - 4 - total_lengths_len;
+    len_decoder_.SetData(num_values, data, len);
+    if (lengths_.size() < num_values) lengths_.resize(num_values);
+    if (num_values > 0) num_values_ = len_decoder_.GetInt32(&lengths_[0], num_values);
+    int lengths_len = len_decoder_.bytes_consumed();
+    data_ = data + lengths_len;
+    len_ = len - lengths_len;
   }
 
   virtual int GetByteArray(ByteArray* buffer, int max_values) {
     max_values = std::min(max_values, num_values_);
-    int lengths[max_values];
-    len_decoder_.GetInt32(lengths, max_values);
+    const int32_t* lengths = max_values > 0 ? &lengths_[lengths_idx_] : NULL;
     for (int  i = 0; i < max_values; ++i) {
+      if (UNLIKELY(lengths[i] < 0 || lengths[i] > len_)) {
+        ParquetException::EofException();
+      }
       buffer[i].len = lengths[i];
       buffer[i].ptr = data_;
       data_ += lengths[i];
       len_ -= lengths[i];
     }
+    lengths_idx_ += max_values;
     num_values_ -= max_values;
     return max_values;
   }
@@ -54,6 +62,9 @@ class DeltaLengthByteArrayDecoder : public Decoder {
   DeltaBitPackDecoder len_decoder_;
   const uint8_t* data_;
   int len_;
+  // The decoded lengths of the page and the index of the next one.
+  std::vector<int32_t> lengths_;
+  int lengths_idx_;
 };
 
 }
@@ -17,6 +17,10 @@
 
 #include "encodings.h"
 
+#include <boost/functional/hash.hpp>
+#include <boost/shared_array.hpp>
+#include <boost/unordered_map.hpp>
+
 namespace parquet_cpp {
 
 class DictionaryDecoder : public Decoder {
@@ -27,6 +31,7 @@ class DictionaryDecoder : public Decoder {
   DictionaryDecoder(const parquet::Type::type& type, Decoder* dictionary)
     : Decoder(type, parquet::Encoding::RLE_DICTIONARY) {
     int num_dictionary_values = dictionary->values_left();
+    num_entries_ = num_dictionary_values;
     switch (type) {
       case parquet::Type::BOOLEAN:
         throw ParquetException("Boolean cols should not be dictionary encoded.");
@@ -78,53 +83,82 @@ class DictionaryDecoder : public Decoder {
     idx_decoder_ = impala::RleDecoder(data, len, bit_width);
   }
 
-  virtual int GetInt32(int32_t* buffer, int max_values) {
+  // Decodes up to 'max_values' dictionary indices of the current page into
+  // 'indices', without looking up the values. Returns the number of indices decoded.
+  // Throws ParquetException if an index is not in the dictionary.
+  int GetIndices(int32_t* indices, int max_values) {
     max_values = std::min(max_values, num_values_);
+    if (max_values == 0) return 0;
+    if (idx_decoder_.GetBatch(indices, max_values) != max_values) {
+      ParquetException::EofException();
+    }
     for (int i = 0; i < max_values; ++i) {
-      buffer[i] = int32_dictionary_[index()];
+      if (UNLIKELY(static_cast<uint32_t>(indices[i]) >= num_entries_)) {
+        throw ParquetException("Invalid dictionary index.");
+      }
     }
+    num_values_ -= max_values;
     return max_values;
   }
 
+  // Skips the indices of the next 'num_values' values without looking them up;
+  // repeated runs of indices are skipped at once.
+  virtual int Skip(int num_values) {
+    num_values = std::min(num_values, num_values_);
+    if (num_values == 0) return 0;
+    if (idx_decoder_.Skip(num_values) != num_values) ParquetException::EofException();
+    num_values_ -= num_values;
+    return num_values;
+  }
+
+  // Returns the number of values in the dictionary.
+  int num_entries() const { return num_entries_; }
+
+  // The dictionary values. Only the one for the column type is set. The values,
+  // including the byte array data, stay valid for the lifetime of the decoder.
+  const std::vector<int32_t>& int32_dictionary() const { return int32_dictionary_; }
+  const std::vector<int64_t>& int64_dictionary() const { return int64_dictionary_; }
+  const std::vector<float>& float_dictionary() const { return float_dictionary_; }
+  const std::vector<double>& double_dictionary() const { return double_dictionary_; }
+  const std::vector<ByteArray>& byte_array_dictionary() const {
+    return byte_array_dictionary_;
+  }
+
+  virtual int GetInt32(int32_t* buffer, int max_values) {
+    return DecodeValues(int32_dictionary_, buffer, max_values);
+  }
+
   virtual int GetInt64(int64_t* buffer, int max_values) {
-    max_values = std::min(max_values, num_values_);
-    for (int i = 0; i < max_values; ++i) {
-      buffer[i] = int64_dictionary_[index()];
-    }
-    return max_values;
+    return DecodeValues(int64_dictionary_, buffer, max_values);
   }
 
   virtual int GetFloat(float* buffer, int max_values) {
-    max_values = std::min(max_values, num_values_);
-    for (int i = 0; i < max_values; ++i) {
-      buffer[i] = float_dictionary_[index()];
-    }
-    return max_values;
+    return DecodeValues(float_dictionary_, buffer, max_values);
   }
 
   virtual int GetDouble(double* buffer, int max_values) {
-    max_values = std::min(max_values, num_values_);
-    for (int i = 0; i < max_values; ++i) {
-      buffer[i] = double_dictionary_[index()];
-    }
-    return max_values;
+    return DecodeValues(double_dictionary_, buffer, max_values);
   }
 
   virtual int GetByteArray(ByteArray* buffer, int max_values) {
+    return DecodeValues(byte_array_dictionary_, buffer, max_values);
+  }
+
+ private:
+  // Decodes a batch of indices and looks them up in 'dictionary'.
+  template <typename T>
+  int DecodeValues(const std::vector<T>& dictionary, T* buffer, int max_values) {
     max_values = std::min(max_values, num_values_);
+    if (max_values == 0) return 0;
+    if (indices_.size() < max_values) indices_.resize(max_values);
+    GetIndices(&indices_[0], max_values);
     for (int i = 0; i < max_values; ++i) {
-      buffer[i] = byte_array_dictionary_[index()];
+      buffer[i] = dictionary[indices_[i]];
     }
     return max_values;
   }
 
- private:
-  int index() {
-    int idx = 0;
-    if (!idx_decoder_.Get(&idx)) ParquetException::EofException();
-    --num_values_;
-    return idx;
-  }
+  uint32_t num_entries_;
 
   // Only one is set.
   std::vector<int32_t> int32_dictionary_;
@@ -138,6 +172,207 @@ class DictionaryDecoder : public Decoder {
   std::vector<uint8_t> byte_array_data_;
 
   impala::RleDecoder idx_decoder_;
+  // Scratch buffer for the decoded indices.
+  std::vector<int32_t> indices_;
+};
+
+// Encoder for RLE_DICTIONARY. The dictionary is built over the whole column chunk,
+// each data page holds the RLE/bit-packed indices of its values. Values are
+// hashed by their bit pattern, so e.g. NaNs are deduplicated like other values.
+class DictEncoder : public Encoder {
+ public:
+  DictEncoder(const parquet::Type::type& type)
+    : Encoder(type, parquet::Encoding::RLE_DICTIONARY),
+      dict_encoded_size_(0),
+      pool_offset_(0),
+      pool_capacity_(0) {
+    if (type == parquet::Type::BOOLEAN) {
+      throw ParquetException("Boolean cols should not be dictionary encoded.");
+    }
+  }
+
+  virtual void PutInt32(const int32_t* values, int num_values) {
+    PutFixedWidth(&map32_, &int32_dictionary_, values, num_values);
+  }
+
+  virtual void PutInt64(const int64_t* values, int num_values) {
+    PutFixedWidth(&map64_, &int64_dictionary_, values, num_values);
+  }
+
+  virtual void PutFloat(const float* values, int num_values) {
+    PutFixedWidth(&map32_, &float_dictionary_, values, num_values);
+  }
+
+  virtual void PutDouble(const double* values, int num_values) {
+    PutFixedWidth(&map64_, &double_dictionary_, values, num_values);
+  }
+
+  virtual void PutByteArray(const ByteArray* values, int num_values) {
+    for (int i = 0; i < num_values; ++i) {
+      ByteArrayMap::iterator it = byte_array_map_.find(values[i]);
+      if (it != byte_array_map_.end()) {
+        indices_.push_back(it->second);
+        continue;
+      }
+      // The dictionary needs its own copy of the bytes.
+      ByteArray value;
+      value.len = values[i].len;
+      value.ptr = CopyToPool(values[i].ptr, values[i].len);
+      int index = byte_array_dictionary_.size();
+      byte_array_map_.insert(std::make_pair(value, index));
+      byte_array_dictionary_.push_back(value);
+      dict_encoded_size_ += sizeof(uint32_t) + value.len;
+      indices_.push_back(index);
+    }
+  }
+
+  virtual int EstimatedDataSize() const {
+    return 1 + impala::BitUtil::Ceil(indices_.size() * bit_width(), 8);
+  }
+
+  // Writes the bit width followed by the RLE encoded indices.
+  virtual void FlushValues(std::vector<uint8_t>* out) {
+    int bit_width = this->bit_width();
+    int max_len = impala::RleEncoder::MaxBufferSize(bit_width, indices_.size());
+    int start = out->size();
+    out->resize(start + 1 + max_len);
+    (*out)[start] = bit_width;
+    impala::RleEncoder encoder(&(*out)[start + 1], max_len, bit_width);
+    for (int i = 0; i < indices_.size(); ++i) {
+      if (!encoder.Put(indices_[i])) {
+        throw ParquetException("Dictionary indices do not fit in the page buffer.");
+      }
+    }
+    int len = encoder.Flush();
+    out->resize(start + 1 + len);
+    indices_.clear();
+  }
+
+  // Number of entries in the dictionary.
+  int num_entries() const { return num_entries(type_); }
+
+  // Size of the PLAIN encoded dictionary.
+  int dict_encoded_size() const { return dict_encoded_size_; }
+
+  // Appends the PLAIN encoded dictionary to 'out'.
+  void WriteDictionary(std::vector<uint8_t>* out) const {
+    PlainEncoder encoder(type_);
+    switch (type_) {
+      case parquet::Type::INT32:
+        if (!int32_dictionary_.empty()) {
+          encoder.PutInt32(&int32_dictionary_[0], int32_dictionary_.size());
+        }
+        break;
+      case parquet::Type::INT64:
+        if (!int64_dictionary_.empty()) {
+          encoder.PutInt64(&int64_dictionary_[0], int64_dictionary_.size());
+        }
+        break;
+      case parquet::Type::FLOAT:
+        if (!float_dictionary_.empty()) {
+          encoder.PutFloat(&float_dictionary_[0], float_dictionary_.size());
+        }
+        break;
+      case parquet::Type::DOUBLE:
+        if (!double_dictionary_.empty()) {
+          encoder.PutDouble(&double_dictionary_[0], double_dictionary_.size());
+        }
+        break;
+      case parquet::Type::BYTE_ARRAY:
+        if (!byte_array_dictionary_.empty()) {
+          encoder.PutByteArray(&byte_array_dictionary_[0],
+              byte_array_dictionary_.size());
+        }
+        break;
+      default:
+        ParquetException::NYI("Unsupported dictionary type");
+    }
+    encoder.FlushValues(out);
+  }
+
+ private:
+  struct ByteArrayHash {
+    size_t operator()(const ByteArray& v) const {
+      return boost::hash_range(v.ptr, v.ptr + v.len);
+    }
+  };
+
+  struct ByteArrayEq {
+    bool operator()(const ByteArray& x, const ByteArray& y) const {
+      return x.len == y.len && memcmp(x.ptr, y.ptr, x.len) == 0;
+    }
+  };
+
+  typedef boost::unordered_map<ByteArray, int, ByteArrayHash, ByteArrayEq> ByteArrayMap;
+
+  // Chunks of the byte array pool are at least this big.
+  static const int POOL_CHUNK_SIZE = 64 * 1024;
+
+  int num_entries(const parquet::Type::type& type) const {
+    switch (type) {
+      case parquet::Type::INT32: return int32_dictionary_.size();
+      case parquet::Type::INT64: return int64_dictionary_.size();
+      case parquet::Type::FLOAT: return float_dictionary_.size();
+      case parquet::Type::DOUBLE: return double_dictionary_.size();
+      case parquet::Type::BYTE_ARRAY: return byte_array_dictionary_.size();
+      default: return 0;
+    }
+  }
+
+  // Number of bits needed for the indices, at least 1.
+  int bit_width() const {
+    return std::max(1, impala::BitUtil::Log2(num_entries()));
+  }
+
+  // K is an unsigned integer of the same size as T, the key is T's bit pattern.
+  template <typename K, typename T>
+  void PutFixedWidth(boost::unordered_map<K, int>* map, std::vector<T>* dictionary,
+      const T* values, int num_values) {
+    for (int i = 0; i < num_values; ++i) {
+      K key;
+      memcpy(&key, &values[i], sizeof(K));
+      std::pair<typename boost::unordered_map<K, int>::iterator, bool> result =
+          map->insert(std::make_pair(key, static_cast<int>(dictionary->size())));
+      if (result.second) {
+        dictionary->push_back(values[i]);
+        dict_encoded_size_ += sizeof(T);
+      }
+      indices_.push_back(result.first->second);
+    }
+  }
+
+  // Copies 'len' bytes to memory owned by the encoder. The memory never moves.
+  const uint8_t* CopyToPool(const uint8_t* data, int len) {
+    if (pool_offset_ + len > pool_capacity_) {
+      pool_capacity_ = std::max(len, static_cast<int>(POOL_CHUNK_SIZE));
+      pool_.push_back(boost::shared_array<uint8_t>(new uint8_t[pool_capacity_]));
+      pool_offset_ = 0;
+    }
+    uint8_t* result = pool_.back().get() + pool_offset_;
+    memcpy(result, data, len);
+    pool_offset_ += len;
+    return result;
+  }
+
+  // Indices of the values in the current page.
+  std::vector<int> indices_;
+  int dict_encoded_size_;
+
+  // Only the ones for type_ are used.
+  boost::unordered_map<uint32_t, int> map32_;
+  boost::unordered_map<uint64_t, int> map64_;
+  ByteArrayMap byte_array_map_;
+
+  std::vector<int32_t> int32_dictionary_;
+  std::vector<int64_t> int64_dictionary_;
+  std::vector<float> float_dictionary_;
+  std::vector<double> double_dictionary_;
+  std::vector<ByteArray> byte_array_dictionary_;
+
+  // Storage for the bytes of byte_array_dictionary_.
+  std::vector<boost::shared_array<uint8_t> > pool_;
+  int pool_offset_;
+  int pool_capacity_;
 };
 
 }
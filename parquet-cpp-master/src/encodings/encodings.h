@@ -15,6 +15,7 @@
 #ifndef PARQUET_ENCODINGS_H
 #define PARQUET_ENCODINGS_H
 
+#include <vector>
 #include <boost/cstdint.hpp>
 #include "gen-cpp/parquet_constants.h"
 #include "gen-cpp/parquet_types.h"
@@ -55,6 +56,45 @@ class Decoder {
     throw ParquetException("Decoder does not implement this type.");
   }
 
+  // Skips the next 'num_values' values. Returns the number of values skipped, which
+  // is less than 'num_values' only at the end of the page. This decodes the values
+  // into a scratch buffer; decoders that can move past values without decoding them
+  // override it.
+  virtual int Skip(int num_values) {
+    static const int BATCH_SIZE = 64;
+    // Large enough for a batch of any type.
+    uint64_t buffer[BATCH_SIZE * sizeof(ByteArray) / sizeof(uint64_t)];
+    int num_skipped = 0;
+    while (num_skipped < num_values) {
+      int n = std::min(num_values - num_skipped, BATCH_SIZE);
+      switch (type_) {
+        case parquet::Type::BOOLEAN:
+          n = GetBool(reinterpret_cast<bool*>(buffer), n);
+          break;
+        case parquet::Type::INT32:
+          n = GetInt32(reinterpret_cast<int32_t*>(buffer), n);
+          break;
+        case parquet::Type::INT64:
+          n = GetInt64(reinterpret_cast<int64_t*>(buffer), n);
+          break;
+        case parquet::Type::FLOAT:
+          n = GetFloat(reinterpret_cast<float*>(buffer), n);
+          break;
+        case parquet::Type::DOUBLE:
+          n = GetDouble(reinterpret_cast<double*>(buffer), n);
+          break;
+        case parquet::Type::BYTE_ARRAY:
+          n = GetByteArray(reinterpret_cast<ByteArray*>(buffer), n);
+          break;
+        default:
+          throw ParquetException("Decoder does not implement this type.");
+      }
+      if (n == 0) break;
+      num_skipped += n;
+    }
+    return num_skipped;
+  }
+
   // Returns the number of values left (for the last call to SetData()). This is
   // the number of values left in this page.
   int values_left() const { return num_values_; }
@@ -70,6 +110,49 @@ class Decoder {
   int num_values_;
 };
 
+class Encoder {
+ public:
+  virtual ~Encoder() {}
+
+  // Subclasses should override the ones they support. In each of these functions,
+  // the encoder appends 'num_values' values from 'values' to the current page.
+  virtual void PutBool(const bool* values, int num_values) {
+    throw ParquetException("Encoder does not implement this type.");
+  }
+  virtual void PutInt32(const int32_t* values, int num_values) {
+    throw ParquetException("Encoder does not implement this type.");
+  }
+  virtual void PutInt64(const int64_t* values, int num_values) {
+    throw ParquetException("Encoder does not implement this type.");
+  }
+  virtual void PutFloat(const float* values, int num_values) {
+    throw ParquetException("Encoder does not implement this type.");
+  }
+  virtual void PutDouble(const double* values, int num_values) {
+    throw ParquetException("Encoder does not implement this type.");
+  }
+  virtual void PutByteArray(const ByteArray* values, int num_values) {
+    throw ParquetException("Encoder does not implement this type.");
+  }
+
+  // Returns an estimate of the encoded size in bytes of the values in the current
+  // page.
+  virtual int EstimatedDataSize() const = 0;
+
+  // Appends the encoded values of the current page to 'out' and resets the encoder
+  // for the next page.
+  virtual void FlushValues(std::vector<uint8_t>* out) = 0;
+
+  const parquet::Encoding::type encoding() const { return encoding_; }
+
+ protected:
+  Encoder(const parquet::Type::type& type, const parquet::Encoding::type& encoding)
+    : type_(type), encoding_(encoding) {}
+
+  const parquet::Type::type type_;
+  const parquet::Encoding::type encoding_;
+};
+
 }
 
 #include "bool-encoding.h"
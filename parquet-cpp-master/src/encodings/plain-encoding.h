@@ -71,11 +71,104 @@ class PlainDecoder : public Decoder {
     return max_values;
   }
 
+  // Fixed width values are skipped by moving past their bytes, byte arrays by
+  // following their lengths, without copying anything.
+  virtual int Skip(int num_values) {
+    num_values = std::min(num_values, num_values_);
+    int byte_size;
+    switch (type_) {
+      case parquet::Type::INT32:
+      case parquet::Type::FLOAT:
+        byte_size = 4;
+        break;
+      case parquet::Type::INT64:
+      case parquet::Type::DOUBLE:
+        byte_size = 8;
+        break;
+      case parquet::Type::BYTE_ARRAY:
+        for (int i = 0; i < num_values; ++i) {
+          uint32_t len;
+          if (len_ < sizeof(uint32_t)) ParquetException::EofException();
+          memcpy(&len, data_, sizeof(uint32_t));
+          if (len_ < sizeof(uint32_t) + len) ParquetException::EofException();
+          data_ += sizeof(uint32_t) + len;
+          len_ -= sizeof(uint32_t) + len;
+        }
+        num_values_ -= num_values;
+        return num_values;
+      default:
+        return Decoder::Skip(num_values);
+    }
+    int size = num_values * byte_size;
+    if (len_ < size) ParquetException::EofException();
+    data_ += size;
+    len_ -= size;
+    num_values_ -= num_values;
+    return num_values;
+  }
+
  private:
   const uint8_t* data_;
   int len_;
 };
 
+class PlainEncoder : public Encoder {
+ public:
+  PlainEncoder(const parquet::Type::type& type)
+    : Encoder(type, parquet::Encoding::PLAIN), num_bools_(0) {
+  }
+
+  // Booleans are bit packed, LSB first.
+  virtual void PutBool(const bool* values, int num_values) {
+    for (int i = 0; i < num_values; ++i) {
+      int bit = num_bools_ % 8;
+      if (bit == 0) buffer_.push_back(0);
+      buffer_.back() |= static_cast<uint8_t>(values[i]) << bit;
+      ++num_bools_;
+    }
+  }
+
+  virtual void PutInt32(const int32_t* values, int num_values) {
+    PutValues(values, num_values * sizeof(int32_t));
+  }
+
+  virtual void PutInt64(const int64_t* values, int num_values) {
+    PutValues(values, num_values * sizeof(int64_t));
+  }
+
+  virtual void PutFloat(const float* values, int num_values) {
+    PutValues(values, num_values * sizeof(float));
+  }
+
+  virtual void PutDouble(const double* values, int num_values) {
+    PutValues(values, num_values * sizeof(double));
+  }
+
+  virtual void PutByteArray(const ByteArray* values, int num_values) {
+    for (int i = 0; i < num_values; ++i) {
+      PutValues(&values[i].len, sizeof(uint32_t));
+      PutValues(values[i].ptr, values[i].len);
+    }
+  }
+
+  virtual int EstimatedDataSize() const { return buffer_.size(); }
+
+  virtual void FlushValues(std::vector<uint8_t>* out) {
+    out->insert(out->end(), buffer_.begin(), buffer_.end());
+    buffer_.clear();
+    num_bools_ = 0;
+  }
+
+ private:
+  void PutValues(const void* values, int len) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(values);
+    buffer_.insert(buffer_.end(), data, data + len);
+  }
+
+  std::vector<uint8_t> buffer_;
+  int num_bools_;
+};
+
 }
 
 #endif
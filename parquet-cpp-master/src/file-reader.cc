@@ -0,0 +1,517 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parquet/file-reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sstream>
+
+// 4 byte metadata len + 4 byte magic number.
+const int64_t FOOTER_SIZE = 8;
+const uint8_t PARQUET_MAGIC[4] = {'P', 'A', 'R', '1'};
+
+// Number of bytes read from the end of the file when looking for the footer. If the
+// file metadata fits, the whole footer is read with a single read.
+const int64_t DEFAULT_FOOTER_READ_SIZE = 64 * 1024;
+
+using namespace boost;
+using namespace parquet;
+using namespace std;
+
+namespace parquet_cpp {
+
+LocalFile::LocalFile(const string& path)
+  : path_(path), fd_(-1), size_(0), mtime_ns_(0) {
+  fd_ = open(path.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    stringstream ss;
+    ss << "Could not open file: " << path << " (" << strerror(errno) << ")";
+    throw ParquetException(ss.str());
+  }
+  struct stat st;
+  if (fstat(fd_, &st) != 0) {
+    close(fd_);
+    stringstream ss;
+    ss << "Could not stat file: " << path << " (" << strerror(errno) << ")";
+    throw ParquetException(ss.str());
+  }
+  size_ = st.st_size;
+#ifdef __APPLE__
+  mtime_ns_ = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+  mtime_ns_ = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
+LocalFile::~LocalFile() {
+  if (fd_ >= 0) close(fd_);
+}
+
+int64_t LocalFile::ReadAt(int64_t position, int64_t num_bytes, uint8_t* out) {
+  int64_t total_read = 0;
+  while (total_read < num_bytes) {
+    ssize_t n = pread(fd_, out + total_read, num_bytes - total_read,
+        position + total_read);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      stringstream ss;
+      ss << "Could not read file: " << path_ << " (" << strerror(errno) << ")";
+      throw ParquetException(ss.str());
+    }
+    if (n == 0) break;
+    total_read += n;
+  }
+  return total_read;
+}
+
+MemoryMappedFile::MemoryMappedFile(const string& path)
+  : path_(path), data_(NULL), size_(0), mtime_ns_(0) {
+  LocalFile file(path);
+  size_ = file.Size();
+  mtime_ns_ = file.mtime_ns();
+  // mmap() does not allow empty mappings. Empty files are not valid parquet
+  // files and are rejected when parsing the footer.
+  if (size_ == 0) return;
+  void* data = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, file.fd(), 0);
+  if (data == MAP_FAILED) {
+    stringstream ss;
+    ss << "Could not memory map file: " << path << " (" << strerror(errno) << ")";
+    throw ParquetException(ss.str());
+  }
+  data_ = reinterpret_cast<const uint8_t*>(data);
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+  if (data_ != NULL) munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+int64_t MemoryMappedFile::ReadAt(int64_t position, int64_t num_bytes, uint8_t* out) {
+  if (position >= size_) return 0;
+  num_bytes = ::min(num_bytes, size_ - position);
+  memcpy(out, data_ + position, num_bytes);
+  return num_bytes;
+}
+
+MemoryMappedInputStream::MemoryMappedInputStream(const string& path)
+  : file_(new MemoryMappedFile(path)),
+    data_(file_->data()),
+    len_(file_->Size()),
+    offset_(0) {
+}
+
+MemoryMappedInputStream::MemoryMappedInputStream(shared_ptr<MemoryMappedFile> file,
+    int64_t offset, int64_t length)
+  : file_(file),
+    data_(file->data() + offset),
+    len_(length),
+    offset_(0) {
+  if (offset < 0 || length < 0 || offset + length > file->Size()) {
+    throw ParquetException("Memory mapped stream range is out of bounds.");
+  }
+  if (length > 0) {
+    // The range will be read sequentially, let the kernel start reading it. The
+    // address passed to madvise() must be page aligned.
+    int64_t page_size = sysconf(_SC_PAGESIZE);
+    int64_t aligned_offset = offset / page_size * page_size;
+    madvise(const_cast<uint8_t*>(file->data()) + aligned_offset,
+        offset + length - aligned_offset, MADV_WILLNEED);
+  }
+}
+
+const uint8_t* MemoryMappedInputStream::Peek(int num_to_peek, int* num_bytes) {
+  *num_bytes = ::min(static_cast<int64_t>(num_to_peek), len_ - offset_);
+  return data_ + offset_;
+}
+
+const uint8_t* MemoryMappedInputStream::Read(int num_to_read, int* num_bytes) {
+  const uint8_t* result = Peek(num_to_read, num_bytes);
+  offset_ += *num_bytes;
+  return result;
+}
+
+FileInputStream::FileInputStream(shared_ptr<RandomAccessFile> file, int64_t offset,
+    int64_t length, int buffer_size)
+  : file_(file),
+    position_(offset),
+    end_(offset + length),
+    buffer_size_(buffer_size),
+    buffer_offset_(0),
+    buffer_len_(0) {
+  if (offset < 0 || length < 0 || end_ > file->Size()) {
+    throw ParquetException("File stream range is out of bounds.");
+  }
+}
+
+void FileInputStream::FillBuffer(int num_bytes) {
+  int buffered = buffer_len_ - buffer_offset_;
+  if (buffered >= num_bytes) return;
+
+  // Move the unread bytes to the front of the buffer and read at least
+  // buffer_size_ more bytes (bounded by the end of the range) after them.
+  int64_t file_offset = position_ + buffered;
+  int to_read = ::min(end_ - file_offset,
+      static_cast<int64_t>(::max(num_bytes - buffered, buffer_size_)));
+  if (buffer_.size() < buffered + to_read) buffer_.resize(buffered + to_read);
+  if (buffered > 0) memmove(&buffer_[0], &buffer_[buffer_offset_], buffered);
+  buffer_offset_ = 0;
+  buffer_len_ = buffered;
+
+  int64_t bytes_read = file_->ReadAt(file_offset, to_read, &buffer_[buffered]);
+  if (bytes_read != to_read) ParquetException::EofException();
+  buffer_len_ += bytes_read;
+}
+
+const uint8_t* FileInputStream::Peek(int num_to_peek, int* num_bytes) {
+  *num_bytes = ::min(static_cast<int64_t>(num_to_peek), end_ - position_);
+  if (*num_bytes == 0) return NULL;
+  FillBuffer(*num_bytes);
+  return &buffer_[buffer_offset_];
+}
+
+const uint8_t* FileInputStream::Read(int num_to_read, int* num_bytes) {
+  const uint8_t* result = Peek(num_to_read, num_bytes);
+  position_ += *num_bytes;
+  buffer_offset_ += *num_bytes;
+  return result;
+}
+
+int64_t FileInputStream::Skip(int64_t num_bytes) {
+  num_bytes = ::min(num_bytes, end_ - position_);
+  int buffered = buffer_len_ - buffer_offset_;
+  if (num_bytes < buffered) {
+    buffer_offset_ += num_bytes;
+  } else {
+    buffer_offset_ = buffer_len_ = 0;
+  }
+  position_ += num_bytes;
+  return num_bytes;
+}
+
+ParquetFileReader::ParquetFileReader(const string& path, bool memory_map,
+    FileMetadataCache* cache) {
+  int64_t mtime_ns;
+  if (memory_map) {
+    MemoryMappedFile* file = new MemoryMappedFile(path);
+    file_.reset(file);
+    mtime_ns = file->mtime_ns();
+  } else {
+    LocalFile* file = new LocalFile(path);
+    file_.reset(file);
+    mtime_ns = file->mtime_ns();
+  }
+  if (cache != NULL) metadata_ = cache->Lookup(path, file_->Size(), mtime_ns);
+  if (metadata_ == NULL) {
+    metadata_ = ParseFooter(file_.get());
+    if (cache != NULL) cache->Insert(path, file_->Size(), mtime_ns, metadata_);
+  }
+}
+
+ParquetFileReader::ParquetFileReader(shared_ptr<RandomAccessFile> file)
+  : file_(file), metadata_(ParseFooter(file.get())) {
+}
+
+ParquetFileReader::ParquetFileReader(shared_ptr<RandomAccessFile> file,
+    shared_ptr<const FileMetadata> metadata)
+  : file_(file), metadata_(metadata) {
+}
+
+ParquetFileReader::~ParquetFileReader() {
+}
+
+shared_ptr<const FileMetadata> ParquetFileReader::ParseFooter(RandomAccessFile* file) {
+  int64_t file_len = file->Size();
+  if (file_len < FOOTER_SIZE) {
+    throw ParquetException("Invalid parquet file. Corrupt footer.");
+  }
+
+  // Speculatively read enough of the tail of the file to usually contain the
+  // metadata as well, so small footers only need one read.
+  int64_t tail_len = ::min(file_len, DEFAULT_FOOTER_READ_SIZE);
+  vector<uint8_t> tail(tail_len);
+  if (file->ReadAt(file_len - tail_len, tail_len, &tail[0]) != tail_len) {
+    throw ParquetException("Invalid parquet file. Corrupt footer.");
+  }
+  const uint8_t* footer = &tail[tail_len - FOOTER_SIZE];
+  if (memcmp(footer + 4, PARQUET_MAGIC, 4) != 0) {
+    throw ParquetException("Invalid parquet file. Corrupt footer.");
+  }
+
+  uint32_t metadata_len = *reinterpret_cast<const uint32_t*>(footer);
+  int64_t metadata_start = file_len - FOOTER_SIZE - metadata_len;
+  if (metadata_start < 0) {
+    throw ParquetException(
+        "Invalid parquet file. File is less than file metadata size.");
+  }
+
+  const uint8_t* metadata_buffer;
+  vector<uint8_t> large_metadata;
+  if (metadata_len + FOOTER_SIZE <= tail_len) {
+    metadata_buffer = &tail[tail_len - FOOTER_SIZE - metadata_len];
+  } else {
+    // Only read the part of the metadata that is not already in 'tail'.
+    large_metadata.resize(metadata_len);
+    int64_t in_tail = tail_len - FOOTER_SIZE;
+    int64_t remaining = metadata_len - in_tail;
+    if (file->ReadAt(metadata_start, remaining, &large_metadata[0]) != remaining) {
+      throw ParquetException("Invalid parquet file. Could not read metadata bytes.");
+    }
+    memcpy(&large_metadata[remaining], &tail[0], in_tail);
+    metadata_buffer = &large_metadata[0];
+  }
+
+  FileMetaData metadata;
+  DeserializeThriftMsg(metadata_buffer, &metadata_len, &metadata);
+  return shared_ptr<const FileMetadata>(new FileMetadata(&metadata, metadata_len));
+}
+
+const RowGroup& ParquetFileReader::row_group(int row_group) const {
+  if (row_group < 0 || row_group >= num_row_groups()) {
+    throw ParquetException("Row group index out of range.");
+  }
+  return metadata().row_groups[row_group];
+}
+
+const ColumnChunk& ParquetFileReader::column_chunk(int row_group, int column) const {
+  const RowGroup& group = this->row_group(row_group);
+  if (column < 0 || column >= group.columns.size()) {
+    throw ParquetException("Column index out of range.");
+  }
+  return group.columns[column];
+}
+
+const SchemaElement& ParquetFileReader::column_schema(int column) const {
+  if (column < 0 || column >= num_columns()) {
+    throw ParquetException("Column index out of range.");
+  }
+  return schema().column(column)->element();
+}
+
+bool ParquetFileReader::RowGroupCanMatch(int row_group,
+    const Predicate& predicate) const {
+  predicate.Validate(schema());
+  const RowGroup& group = this->row_group(row_group);
+  vector<const Statistics*> stats(group.columns.size());
+  for (int i = 0; i < group.columns.size(); ++i) {
+    const ColumnChunk& chunk = group.columns[i];
+    if (chunk.__isset.meta_data && chunk.meta_data.__isset.statistics) {
+      stats[i] = &chunk.meta_data.statistics;
+    }
+  }
+  bool use_deprecated_min_max = metadata().__isset.created_by &&
+      Predicate::CanUseDeprecatedByteArrayMinMax(metadata().created_by);
+  if (!predicate.CanMatch(stats, use_deprecated_min_max)) return false;
+
+  // Only the filters of the columns compared with EQ or IN are read.
+  vector<int> columns;
+  predicate.GetBloomFilterColumns(&columns);
+  if (columns.empty()) return true;
+  vector<shared_ptr<BloomFilter> > bloom_filters(group.columns.size());
+  vector<const BloomFilter*> filters(group.columns.size());
+  for (int i = 0; i < columns.size(); ++i) {
+    int column = columns[i];
+    if (column >= group.columns.size() || bloom_filters[column] != NULL) continue;
+    bloom_filters[column] = GetBloomFilter(row_group, column);
+    filters[column] = bloom_filters[column].get();
+  }
+  return predicate.CanMatchBloomFilters(filters);
+}
+
+vector<int> ParquetFileReader::SelectRowGroups(const Predicate& predicate) const {
+  vector<int> row_groups;
+  for (int i = 0; i < num_row_groups(); ++i) {
+    if (RowGroupCanMatch(i, predicate)) row_groups.push_back(i);
+  }
+  return row_groups;
+}
+
+void ParquetFileReader::ReadRange(int64_t offset, int64_t length,
+    vector<uint8_t>* buffer) const {
+  if (offset < 0 || length < 0 || offset + length > file_->Size()) {
+    throw ParquetException("Invalid parquet file. Metadata out of range.");
+  }
+  buffer->resize(length);
+  if (length == 0) return;
+  if (file_->ReadAt(offset, length, &(*buffer)[0]) != length) {
+    throw ParquetException("Invalid parquet file. Could not read metadata bytes.");
+  }
+}
+
+shared_ptr<BloomFilter> ParquetFileReader::GetBloomFilter(int row_group,
+    int column) const {
+  const ColumnChunk& chunk = column_chunk(row_group, column);
+  // Without the length we would have to guess how much to read.
+  if (!chunk.meta_data.__isset.bloom_filter_offset ||
+      !chunk.meta_data.__isset.bloom_filter_length) {
+    return shared_ptr<BloomFilter>();
+  }
+  vector<uint8_t> buffer;
+  ReadRange(chunk.meta_data.bloom_filter_offset, chunk.meta_data.bloom_filter_length,
+      &buffer);
+  if (buffer.empty()) throw ParquetException("Invalid parquet file. Empty Bloom filter.");
+  return shared_ptr<BloomFilter>(BloomFilter::Deserialize(&buffer[0], buffer.size()));
+}
+
+// Deserializes a thrift struct that fills 'buffer'.
+template <typename T>
+static shared_ptr<T> ReadThrift(const vector<uint8_t>& buffer) {
+  if (buffer.empty()) throw ParquetException("Invalid parquet file. Empty page index.");
+  shared_ptr<T> result(new T());
+  uint32_t len = buffer.size();
+  DeserializeThriftMsg(&buffer[0], &len, result.get());
+  return result;
+}
+
+shared_ptr<ColumnIndex> ParquetFileReader::GetColumnIndex(int row_group,
+    int column) const {
+  const ColumnChunk& chunk = column_chunk(row_group, column);
+  if (!chunk.__isset.column_index_offset || !chunk.__isset.column_index_length) {
+    return shared_ptr<ColumnIndex>();
+  }
+  vector<uint8_t> buffer;
+  ReadRange(chunk.column_index_offset, chunk.column_index_length, &buffer);
+  shared_ptr<ColumnIndex> index = ReadThrift<ColumnIndex>(buffer);
+  int num_pages = index->null_pages.size();
+  if (index->min_values.size() != num_pages || index->max_values.size() != num_pages ||
+      (index->__isset.null_counts && index->null_counts.size() != num_pages)) {
+    throw ParquetException("Invalid parquet file. Corrupt column index.");
+  }
+  return index;
+}
+
+shared_ptr<OffsetIndex> ParquetFileReader::GetOffsetIndex(int row_group,
+    int column) const {
+  const ColumnChunk& chunk = column_chunk(row_group, column);
+  if (!chunk.__isset.offset_index_offset || !chunk.__isset.offset_index_length) {
+    return shared_ptr<OffsetIndex>();
+  }
+  vector<uint8_t> buffer;
+  ReadRange(chunk.offset_index_offset, chunk.offset_index_length, &buffer);
+  return ReadThrift<OffsetIndex>(buffer);
+}
+
+vector<int> ParquetFileReader::SelectPages(int row_group, int column,
+    const Predicate& predicate) const {
+  predicate.Validate(schema());
+  shared_ptr<ColumnIndex> column_index = GetColumnIndex(row_group, column);
+  if (column_index == NULL) {
+    throw ParquetException("Column chunk does not have a page index.");
+  }
+  vector<int> pages;
+  for (int i = 0; i < column_index->null_pages.size(); ++i) {
+    if (predicate.CanMatchPage(column, *column_index, i)) pages.push_back(i);
+  }
+  return pages;
+}
+
+shared_ptr<ColumnReader> ParquetFileReader::GetColumnReader(int row_group, int column,
+    const vector<int>& pages) {
+  shared_ptr<OffsetIndex> offset_index = GetOffsetIndex(row_group, column);
+  if (offset_index == NULL) {
+    throw ParquetException("Column chunk does not have an offset index.");
+  }
+  const vector<PageLocation>& locations = offset_index->page_locations;
+  int64_t chunk_offset, chunk_length;
+  GetColumnChunkRange(column_chunk(row_group, column).meta_data, &chunk_offset,
+      &chunk_length);
+  int64_t chunk_end = chunk_offset + chunk_length;
+
+  // Byte ranges to read. The dictionary page, if any, is in front of the first data
+  // page.
+  vector<pair<int64_t, int64_t> > ranges;
+  int64_t first_page_offset = locations.empty() ? chunk_end : locations[0].offset;
+  if (first_page_offset < chunk_offset || first_page_offset > chunk_end) {
+    throw ParquetException("Invalid parquet file. Corrupt offset index.");
+  }
+  if (first_page_offset > chunk_offset) {
+    ranges.push_back(make_pair(chunk_offset, first_page_offset - chunk_offset));
+  }
+  int64_t total_length = first_page_offset - chunk_offset;
+  for (int i = 0; i < pages.size(); ++i) {
+    if (pages[i] < 0 || pages[i] >= locations.size() ||
+        (i > 0 && pages[i] <= pages[i - 1])) {
+      throw ParquetException("Page indices must be increasing and in range.");
+    }
+    const PageLocation& location = locations[pages[i]];
+    if (location.offset < chunk_offset || location.compressed_page_size < 0 ||
+        location.offset + location.compressed_page_size > chunk_end) {
+      throw ParquetException("Invalid parquet file. Corrupt offset index.");
+    }
+    if (!ranges.empty() &&
+        ranges.back().first + ranges.back().second == location.offset) {
+      ranges.back().second += location.compressed_page_size;
+    } else {
+      ranges.push_back(make_pair(location.offset,
+          static_cast<int64_t>(location.compressed_page_size)));
+    }
+    total_length += location.compressed_page_size;
+  }
+
+  shared_ptr<vector<uint8_t> > buffer(new vector<uint8_t>(total_length));
+  int64_t buffer_offset = 0;
+  for (int i = 0; i < ranges.size(); ++i) {
+    if (file_->ReadAt(ranges[i].first, ranges[i].second, &(*buffer)[buffer_offset]) !=
+        ranges[i].second) {
+      throw ParquetException("Invalid parquet file. Column chunk out of range.");
+    }
+    buffer_offset += ranges[i].second;
+  }
+  return GetColumnReader(row_group, column,
+      shared_ptr<InputStream>(new SharedBufferInputStream(buffer,
+          buffer->empty() ? NULL : &(*buffer)[0], buffer->size())));
+}
+
+void ParquetFileReader::GetColumnChunkRange(const ColumnMetaData& metadata,
+    int64_t* offset, int64_t* length) {
+  *offset = metadata.data_page_offset;
+  if (metadata.__isset.dictionary_page_offset &&
+      metadata.dictionary_page_offset < *offset) {
+    *offset = metadata.dictionary_page_offset;
+  }
+  *length = metadata.total_compressed_size;
+}
+
+shared_ptr<ColumnReader> ParquetFileReader::GetColumnReader(int row_group, int column) {
+  const ColumnChunk& chunk = column_chunk(row_group, column);
+  if (chunk.__isset.file_path) {
+    ParquetException::NYI("Column chunks in other files");
+  }
+  int64_t offset, length;
+  GetColumnChunkRange(chunk.meta_data, &offset, &length);
+  if (offset < 0 || offset + length > file_->Size()) {
+    throw ParquetException("Invalid parquet file. Column chunk out of range.");
+  }
+  shared_ptr<InputStream> stream;
+  shared_ptr<MemoryMappedFile> mapped_file = dynamic_pointer_cast<MemoryMappedFile>(file_);
+  if (mapped_file != NULL) {
+    stream.reset(new MemoryMappedInputStream(mapped_file, offset, length));
+  } else {
+    stream.reset(new FileInputStream(file_, offset, length));
+  }
+  return GetColumnReader(row_group, column, stream);
+}
+
+shared_ptr<ColumnReader> ParquetFileReader::GetColumnReader(int row_group, int column,
+    shared_ptr<InputStream> stream) {
+  const ColumnChunk& chunk = column_chunk(row_group, column);
+  const SchemaNode* node = schema().column(column);
+  return shared_ptr<ColumnReader>(new ColumnReader(&chunk.meta_data, &node->element(),
+      stream, node->max_definition_level(), node->max_repetition_level()));
+}
+
+}
@@ -0,0 +1,128 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <vector>
+
+#include "parquet/file-writer.h"
+#include "parquet/parquet.h"
+#include "util/test-util.h"
+
+using namespace parquet;
+using namespace parquet_cpp;
+using namespace std;
+
+static SchemaElement MakeSchemaElement(Type::type type, bool optional) {
+  SchemaElement element;
+  element.__set_name("c");
+  element.__set_type(type);
+  element.__set_repetition_type(
+      optional ? FieldRepetitionType::OPTIONAL : FieldRepetitionType::REQUIRED);
+  return element;
+}
+
+// Writes an optional INT32 column whose dictionary has 2^bit_width entries and
+// reads it back. The values and nulls are random, so the dictionary indices and
+// the definition levels alternate between short literal and repeated runs, which
+// is the worst case for the size of their RLE encoded buffers.
+static void TestDictionaryRoundTrip(int bit_width) {
+  const int num_levels = 100000;
+  const int num_entries = 1 << bit_width;
+
+  vector<int32_t> dictionary(num_entries);
+  for (int i = 0; i < num_entries; ++i) dictionary[i] = rand();
+  vector<int16_t> def_levels(num_levels);
+  vector<int32_t> values;
+  for (int i = 0; i < num_levels; ++i) {
+    def_levels[i] = rand() % 2;
+    if (def_levels[i] == 1) values.push_back(dictionary[rand() % num_entries]);
+  }
+
+  SchemaElement schema = MakeSchemaElement(Type::INT32, true);
+  ColumnWriter::Config config = ColumnWriter::Config::DefaultConfig();
+  // Several pages, so the buffers are sized for partial runs too.
+  config.data_page_size = 16 * 1024;
+  ColumnWriter writer(&schema, config);
+  int value_idx = 0;
+  for (int i = 0; i < num_levels; i += 1000) {
+    writer.WriteBatch(1000, &def_levels[i], NULL, &values[0] + value_idx);
+    for (int j = i; j < i + 1000; ++j) value_idx += def_levels[j];
+  }
+  InMemoryOutputStream out;
+  ColumnChunk chunk;
+  writer.Close(&out, &chunk);
+
+  const vector<uint8_t>& data = out.buffer();
+  InMemoryInputStream in(&data[0], data.size());
+  ColumnReader reader(&chunk.meta_data, &schema, &in);
+  vector<int16_t> read_def_levels(1024);
+  vector<int32_t> read_values(1024);
+  int level_idx = 0;
+  value_idx = 0;
+  while (true) {
+    int64_t values_read;
+    int n = reader.ReadBatch(read_def_levels.size(), &read_def_levels[0], NULL,
+        &read_values[0], &values_read);
+    if (n == 0) break;
+    PARQUET_CHECK(level_idx + n <= num_levels);
+    for (int i = 0; i < n; ++i) {
+      PARQUET_CHECK_EQ(read_def_levels[i], def_levels[level_idx + i]);
+    }
+    for (int i = 0; i < values_read; ++i) {
+      PARQUET_CHECK_EQ(read_values[i], values[value_idx + i]);
+    }
+    level_idx += n;
+    value_idx += values_read;
+  }
+  PARQUET_CHECK_EQ(level_idx, num_levels);
+  PARQUET_CHECK_EQ(value_idx, static_cast<int>(values.size()));
+}
+
+// A row count mismatch between the columns of a row group must be detected before
+// any of its column chunks is written.
+static void TestRowGroupRowCountMismatch() {
+  vector<SchemaElement> schema;
+  SchemaElement root;
+  root.__set_name("schema");
+  root.__set_num_children(2);
+  schema.push_back(root);
+  schema.push_back(MakeSchemaElement(Type::INT32, false));
+  schema.push_back(MakeSchemaElement(Type::INT32, false));
+
+  InMemoryOutputStream out;
+  ParquetFileWriter writer(&out, schema);
+  int64_t file_start = out.Tell();
+  writer.NewRowGroup();
+  vector<int32_t> values(10, 1);
+  writer.column_writer(0)->WriteBatch(10, NULL, NULL, &values[0]);
+  writer.column_writer(1)->WriteBatch(9, NULL, NULL, &values[0]);
+
+  bool thrown = false;
+  try {
+    writer.Close();
+  } catch (const ParquetException& e) {
+    thrown = true;
+  }
+  PARQUET_CHECK(thrown);
+  PARQUET_CHECK_EQ(out.Tell(), file_start);
+}
+
+int main(int argc, char** argv) {
+  srand(0);
+  for (int bit_width = 1; bit_width <= 4; ++bit_width) {
+    TestDictionaryRoundTrip(bit_width);
+  }
+  TestRowGroupRowCountMismatch();
+  return 0;
+}
@@ -0,0 +1,559 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parquet/file-writer.h"
+#include "encodings/encodings.h"
+#include "compression/codec.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+
+const uint8_t PARQUET_MAGIC[4] = {'P', 'A', 'R', '1'};
+
+// Number of levels encoded at a time by WriteBatch(). This bounds by how much a page
+// can exceed the target page size.
+const int WRITE_BATCH_SIZE = 1024;
+
+using namespace boost;
+using namespace impala;
+using namespace parquet;
+using namespace std;
+
+namespace parquet_cpp {
+
+LocalFileOutputStream::LocalFileOutputStream(const string& path)
+  : path_(path), fd_(-1), position_(0) {
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    stringstream ss;
+    ss << "Could not open file for writing: " << path << " (" << strerror(errno) << ")";
+    throw ParquetException(ss.str());
+  }
+}
+
+LocalFileOutputStream::~LocalFileOutputStream() {
+  if (fd_ >= 0) close(fd_);
+}
+
+void LocalFileOutputStream::Write(const uint8_t* data, int64_t length) {
+  int64_t written = 0;
+  while (written < length) {
+    ssize_t n = write(fd_, data + written, length - written);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      stringstream ss;
+      ss << "Could not write file: " << path_ << " (" << strerror(errno) << ")";
+      throw ParquetException(ss.str());
+    }
+    written += n;
+  }
+  position_ += length;
+}
+
+void LocalFileOutputStream::Close() {
+  if (fd_ < 0) return;
+  int result = close(fd_);
+  fd_ = -1;
+  if (result != 0) {
+    stringstream ss;
+    ss << "Could not close file: " << path_ << " (" << strerror(errno) << ")";
+    throw ParquetException(ss.str());
+  }
+}
+
+ColumnWriter::ColumnWriter(const SchemaElement* schema, const Config& config)
+  : schema_(schema),
+    config_(config),
+    closed_(false),
+    current_encoder_(NULL),
+    num_page_values_(0),
+    page_stats_(schema->type),
+    chunk_stats_(schema->type),
+    num_data_pages_(0),
+    num_values_(0),
+    total_uncompressed_size_(0),
+    bloom_filter_enabled_(false) {
+  switch (schema_->type) {
+    case Type::BOOLEAN:
+    case Type::INT32:
+    case Type::INT64:
+    case Type::FLOAT:
+    case Type::DOUBLE:
+    case Type::BYTE_ARRAY:
+      break;
+    default:
+      ParquetException::NYI("Unsupported type");
+  }
+  if (schema_->repetition_type == FieldRepetitionType::REPEATED) {
+    ParquetException::NYI("Writing repeated columns");
+  }
+
+  if (config_.enable_bloom_filter) {
+    if (config_.bloom_filter_fpp <= 0 || config_.bloom_filter_fpp >= 1) {
+      throw ParquetException("Bloom filter fpp must be between 0 and 1.");
+    }
+    bloom_filter_enabled_ = schema_->type == Type::INT32 ||
+        schema_->type == Type::INT64 || schema_->type == Type::BYTE_ARRAY;
+  }
+  column_index_.__set_boundary_order(BoundaryOrder::UNORDERED);
+
+  compressor_.reset(Codec::Create(config_.codec));
+  plain_encoder_.reset(new PlainEncoder(schema_->type));
+  if (config_.enable_dictionary && schema_->type != Type::BOOLEAN) {
+    dict_encoder_.reset(new DictEncoder(schema_->type));
+    current_encoder_ = dict_encoder_.get();
+  } else {
+    current_encoder_ = plain_encoder_.get();
+  }
+}
+
+ColumnWriter::~ColumnWriter() {
+}
+
+// Overloads to dispatch to the encoder function for each value type.
+static void EncodeValues(Encoder* encoder, const bool* values, int num_values) {
+  encoder->PutBool(values, num_values);
+}
+static void EncodeValues(Encoder* encoder, const int32_t* values, int num_values) {
+  encoder->PutInt32(values, num_values);
+}
+static void EncodeValues(Encoder* encoder, const int64_t* values, int num_values) {
+  encoder->PutInt64(values, num_values);
+}
+static void EncodeValues(Encoder* encoder, const float* values, int num_values) {
+  encoder->PutFloat(values, num_values);
+}
+static void EncodeValues(Encoder* encoder, const double* values, int num_values) {
+  encoder->PutDouble(values, num_values);
+}
+static void EncodeValues(Encoder* encoder, const ByteArray* values, int num_values) {
+  encoder->PutByteArray(values, num_values);
+}
+
+template <typename T>
+void ColumnWriter::AddToBloomFilter(const T* values, int num_values) {
+  for (int i = 0; i < num_values; ++i) {
+    AddHashToBloomFilter(BloomFilter::Hash(values[i]));
+  }
+}
+
+// There are no Bloom filters for the other types.
+template <>
+void ColumnWriter::AddToBloomFilter(const bool* values, int num_values) {
+}
+
+template <>
+void ColumnWriter::AddToBloomFilter(const float* values, int num_values) {
+}
+
+template <>
+void ColumnWriter::AddToBloomFilter(const double* values, int num_values) {
+}
+
+void ColumnWriter::AddHashToBloomFilter(uint64_t hash) {
+  if (bloom_filter_ != NULL) {
+    bloom_filter_->Insert(hash);
+    return;
+  }
+  if (!bloom_filter_hashes_.insert(hash).second) return;
+  // The size of the filter only changes when the number of values doubles.
+  size_t num_hashes = bloom_filter_hashes_.size();
+  if ((num_hashes & (num_hashes - 1)) != 0) return;
+  if (BloomFilter::OptimalNumBytes(num_hashes, config_.bloom_filter_fpp) >=
+      config_.bloom_filter_max_bytes) {
+    bloom_filter_.reset(new BloomFilter(config_.bloom_filter_max_bytes));
+    for (unordered_set<uint64_t>::const_iterator it = bloom_filter_hashes_.begin();
+        it != bloom_filter_hashes_.end(); ++it) {
+      bloom_filter_->Insert(*it);
+    }
+    unordered_set<uint64_t>().swap(bloom_filter_hashes_);
+  }
+}
+
+template <typename T>
+void ColumnWriter::WriteBatchInternal(const Type::type& type, int num_levels,
+    const int16_t* def_levels, const int16_t* rep_levels, const T* values) {
+  if (closed_) throw ParquetException("Column writer is already closed.");
+  if (schema_->type != type) {
+    throw ParquetException("WriteBatch() called with the wrong value type.");
+  }
+  if (rep_levels != NULL) ParquetException::NYI("Writing repetition levels");
+  bool optional = schema_->repetition_type == FieldRepetitionType::OPTIONAL;
+  if (optional && def_levels == NULL && num_levels > 0) {
+    throw ParquetException("Optional columns need definition levels.");
+  }
+
+  // Encode in smaller batches so the page size is checked regularly.
+  for (int offset = 0; offset < num_levels; offset += WRITE_BATCH_SIZE) {
+    int batch_levels = ::min(WRITE_BATCH_SIZE, num_levels - offset);
+    int batch_values = batch_levels;
+    if (optional) {
+      const int16_t* levels = def_levels + offset;
+      def_levels_.insert(def_levels_.end(), levels, levels + batch_levels);
+      batch_values = 0;
+      for (int i = 0; i < batch_levels; ++i) {
+        batch_values += levels[i] != 0;
+      }
+    }
+
+    EncodeValues(current_encoder_, values, batch_values);
+    page_stats_.Update(values, batch_values);
+    page_stats_.IncrementNullCount(batch_levels - batch_values);
+    if (bloom_filter_enabled_) AddToBloomFilter(values, batch_values);
+    values += batch_values;
+    num_page_values_ += batch_levels;
+    num_values_ += batch_levels;
+
+    if (current_encoder_ == dict_encoder_.get() &&
+        dict_encoder_->dict_encoded_size() >= config_.dictionary_page_size_limit) {
+      FallbackToPlain();
+    } else if (current_encoder_->EstimatedDataSize() + def_levels_.size() / 8 >=
+        config_.data_page_size) {
+      FlushPage();
+    }
+  }
+}
+
+void ColumnWriter::WriteBatch(int num_levels, const int16_t* def_levels,
+    const int16_t* rep_levels, const bool* values) {
+  WriteBatchInternal(Type::BOOLEAN, num_levels, def_levels, rep_levels, values);
+}
+
+void ColumnWriter::WriteBatch(int num_levels, const int16_t* def_levels,
+    const int16_t* rep_levels, const int32_t* values) {
+  WriteBatchInternal(Type::INT32, num_levels, def_levels, rep_levels, values);
+}
+
+void ColumnWriter::WriteBatch(int num_levels, const int16_t* def_levels,
+    const int16_t* rep_levels, const int64_t* values) {
+  WriteBatchInternal(Type::INT64, num_levels, def_levels, rep_levels, values);
+}
+
+void ColumnWriter::WriteBatch(int num_levels, const int16_t* def_levels,
+    const int16_t* rep_levels, const float* values) {
+  WriteBatchInternal(Type::FLOAT, num_levels, def_levels, rep_levels, values);
+}
+
+void ColumnWriter::WriteBatch(int num_levels, const int16_t* def_levels,
+    const int16_t* rep_levels, const double* values) {
+  WriteBatchInternal(Type::DOUBLE, num_levels, def_levels, rep_levels, values);
+}
+
+void ColumnWriter::WriteBatch(int num_levels, const int16_t* def_levels,
+    const int16_t* rep_levels, const ByteArray* values) {
+  WriteBatchInternal(Type::BYTE_ARRAY, num_levels, def_levels, rep_levels, values);
+}
+
+void ColumnWriter::FallbackToPlain() {
+  FlushPage();
+  current_encoder_ = plain_encoder_.get();
+}
+
+void ColumnWriter::AddEncoding(const Encoding::type& encoding) {
+  if (find(encodings_.begin(), encodings_.end(), encoding) == encodings_.end()) {
+    encodings_.push_back(encoding);
+  }
+}
+
+Encoding::type ColumnWriter::DataPageEncoding() const {
+  Encoding::type encoding = current_encoder_->encoding();
+  return encoding == Encoding::RLE_DICTIONARY ? Encoding::PLAIN_DICTIONARY : encoding;
+}
+
+void ColumnWriter::FlushPage() {
+  if (num_page_values_ == 0) return;
+  page_buffer_.clear();
+
+  if (schema_->repetition_type == FieldRepetitionType::OPTIONAL) {
+    // The definition levels are a 4 byte length followed by the RLE encoded levels.
+    int max_len = RleEncoder::MaxBufferSize(1, def_levels_.size());
+    page_buffer_.resize(sizeof(uint32_t) + max_len);
+    RleEncoder encoder(&page_buffer_[sizeof(uint32_t)], max_len, 1);
+    for (int i = 0; i < def_levels_.size(); ++i) {
+      if (!encoder.Put(def_levels_[i])) {
+        throw ParquetException("Definition levels do not fit in the page buffer.");
+      }
+    }
+    uint32_t len = encoder.Flush();
+    memcpy(&page_buffer_[0], &len, sizeof(uint32_t));
+    page_buffer_.resize(sizeof(uint32_t) + len);
+    def_levels_.clear();
+    AddEncoding(Encoding::RLE);
+  }
+  current_encoder_->FlushValues(&page_buffer_);
+
+  DataPageHeader data_page_header;
+  data_page_header.__set_num_values(num_page_values_);
+  data_page_header.__set_encoding(DataPageEncoding());
+  data_page_header.__set_definition_level_encoding(Encoding::RLE);
+  data_page_header.__set_repetition_level_encoding(Encoding::RLE);
+  data_page_header.__set_statistics(page_stats_.ToThrift());
+  PageHeader header;
+  header.__set_type(PageType::DATA_PAGE);
+  header.__set_data_page_header(data_page_header);
+  int64_t page_offset = data_pages_.Tell();
+  int64_t page_len = WritePage(&header, &data_pages_);
+  AddEncoding(DataPageEncoding());
+
+  if (config_.write_page_index) {
+    PageLocation location;
+    location.__set_offset(page_offset);
+    location.__set_compressed_page_size(page_len);
+    location.__set_first_row_index(num_values_ - num_page_values_);
+    offset_index_.page_locations.push_back(location);
+
+    // A page of NaNs has neither nulls nor a min and max. Its empty min and max do
+    // not have the size of the type, so readers cannot use them to prune it.
+    const Statistics& stats = data_page_header.statistics;
+    bool null_page = page_stats_.null_count() == num_page_values_;
+    column_index_.null_pages.push_back(null_page);
+    column_index_.min_values.push_back(stats.__isset.min ? stats.min : "");
+    column_index_.max_values.push_back(stats.__isset.max ? stats.max : "");
+    column_index_.null_counts.push_back(page_stats_.null_count());
+  }
+
+  chunk_stats_.Merge(page_stats_);
+  page_stats_.Reset();
+  num_page_values_ = 0;
+  ++num_data_pages_;
+}
+
+int64_t ColumnWriter::WritePage(PageHeader* header, OutputStream* out) {
+  int uncompressed_len = page_buffer_.size();
+  const uint8_t* data = page_buffer_.empty() ? NULL : &page_buffer_[0];
+  int compressed_len = uncompressed_len;
+  if (compressor_ != NULL) {
+    int max_len = compressor_->MaxCompressedLen(uncompressed_len, data);
+    if (compressed_buffer_.size() < max_len) compressed_buffer_.resize(max_len);
+    compressed_len = compressor_->Compress(uncompressed_len, data, max_len,
+        &compressed_buffer_[0]);
+    data = &compressed_buffer_[0];
+  }
+  header->__set_uncompressed_page_size(uncompressed_len);
+  header->__set_compressed_page_size(compressed_len);
+
+  int64_t start = out->Tell();
+  SerializeThriftMsg(*header, out);
+  int64_t header_len = out->Tell() - start;
+  out->Write(data, compressed_len);
+  total_uncompressed_size_ += header_len + uncompressed_len;
+  return out->Tell() - start;
+}
+
+void ColumnWriter::Close(OutputStream* out, ColumnChunk* chunk) {
+  if (closed_) throw ParquetException("Column writer is already closed.");
+  FlushPage();
+  closed_ = true;
+
+  ColumnMetaData metadata;
+  int64_t chunk_start = out->Tell();
+  bool has_dictionary = find(encodings_.begin(), encodings_.end(),
+      Encoding::PLAIN_DICTIONARY) != encodings_.end();
+  if (has_dictionary) {
+    page_buffer_.clear();
+    dict_encoder_->WriteDictionary(&page_buffer_);
+    DictionaryPageHeader dictionary_page_header;
+    dictionary_page_header.__set_num_values(dict_encoder_->num_entries());
+    dictionary_page_header.__set_encoding(Encoding::PLAIN_DICTIONARY);
+    PageHeader header;
+    header.__set_type(PageType::DICTIONARY_PAGE);
+    header.__set_dictionary_page_header(dictionary_page_header);
+    WritePage(&header, out);
+    metadata.__set_dictionary_page_offset(chunk_start);
+  }
+
+  int64_t data_page_offset = out->Tell();
+  const vector<uint8_t>& data_pages = data_pages_.buffer();
+  if (!data_pages.empty()) out->Write(&data_pages[0], data_pages.size());
+
+  metadata.__set_type(schema_->type);
+  metadata.__set_encodings(encodings_);
+  metadata.__set_path_in_schema(vector<string>(1, schema_->name));
+  metadata.__set_codec(config_.codec);
+  metadata.__set_num_values(num_values_);
+  metadata.__set_total_uncompressed_size(total_uncompressed_size_);
+  metadata.__set_total_compressed_size(out->Tell() - chunk_start);
+  metadata.__set_data_page_offset(data_page_offset);
+  metadata.__set_statistics(chunk_stats_.ToThrift());
+
+  chunk->__set_file_offset(chunk_start);
+  chunk->__set_meta_data(metadata);
+
+  // Release the buffered pages, the writer cannot be used anymore.
+  data_pages_.Clear();
+
+  if (config_.write_page_index) {
+    for (int i = 0; i < offset_index_.page_locations.size(); ++i) {
+      offset_index_.page_locations[i].offset += data_page_offset;
+    }
+    column_index_.__isset.null_counts = true;
+  }
+  if (bloom_filter_enabled_ && bloom_filter_ == NULL) {
+    int num_bytes = ::min(config_.bloom_filter_max_bytes, BloomFilter::OptimalNumBytes(
+        bloom_filter_hashes_.size(), config_.bloom_filter_fpp));
+    bloom_filter_.reset(new BloomFilter(num_bytes));
+    for (unordered_set<uint64_t>::const_iterator it = bloom_filter_hashes_.begin();
+        it != bloom_filter_hashes_.end(); ++it) {
+      bloom_filter_->Insert(*it);
+    }
+    unordered_set<uint64_t>().swap(bloom_filter_hashes_);
+  }
+}
+
+const ColumnIndex* ColumnWriter::column_index() const {
+  return closed_ && config_.write_page_index ? &column_index_ : NULL;
+}
+
+const OffsetIndex* ColumnWriter::offset_index() const {
+  return closed_ && config_.write_page_index ? &offset_index_ : NULL;
+}
+
+ParquetFileWriter::ParquetFileWriter(OutputStream* sink,
+    const vector<SchemaElement>& schema, const ColumnWriter::Config& config)
+  : sink_(sink), closed_(false) {
+  if (schema.size() < 2) throw ParquetException("Schema has no columns.");
+  if (!schema[0].__isset.num_children || schema[0].num_children != schema.size() - 1) {
+    ParquetException::NYI("Writing nested schemas");
+  }
+  for (int i = 1; i < schema.size(); ++i) {
+    if (schema[i].__isset.num_children || !schema[i].__isset.type) {
+      ParquetException::NYI("Writing nested schemas");
+    }
+  }
+
+  configs_.resize(schema.size() - 1, config);
+
+  metadata_.__set_version(1);
+  metadata_.__set_schema(schema);
+  metadata_.__set_num_rows(0);
+  metadata_.__set_created_by("parquet-cpp");
+  sink_->Write(PARQUET_MAGIC, sizeof(PARQUET_MAGIC));
+}
+
+ParquetFileWriter::~ParquetFileWriter() {
+}
+
+void ParquetFileWriter::NewRowGroup() {
+  if (closed_) throw ParquetException("File writer is already closed.");
+  if (!column_writers_.empty()) CloseRowGroup();
+  for (int i = 0; i < num_columns(); ++i) {
+    column_writers_.push_back(shared_ptr<ColumnWriter>(
+        new ColumnWriter(&metadata_.schema[i + 1], configs_[i])));
+  }
+}
+
+ColumnWriter* ParquetFileWriter::column_writer(int column) {
+  if (column_writers_.empty()) throw ParquetException("No row group was started.");
+  if (column < 0 || column >= column_writers_.size()) {
+    throw ParquetException("Column index out of range.");
+  }
+  return column_writers_[column].get();
+}
+
+void ParquetFileWriter::SetColumnConfig(int column, const ColumnWriter::Config& config) {
+  if (column < 0 || column >= num_columns()) {
+    throw ParquetException("Column index out of range.");
+  }
+  configs_[column] = config;
+}
+
+void ParquetFileWriter::CloseRowGroup() {
+  // Flat schemas only, every level is a row.
+  int64_t num_rows = column_writers_[0]->num_values();
+  RowGroup row_group;
+  row_group.__set_num_rows(num_rows);
+  row_group.__set_total_byte_size(0);
+  // Check all the columns before any of them is written, so a mismatch does not
+  // leave a partial row group in the sink.
+  for (int i = 0; i < column_writers_.size(); ++i) {
+    if (column_writers_[i]->num_values() != num_rows) {
+      throw ParquetException("Columns in a row group have different numbers of rows.");
+    }
+  }
+  for (int i = 0; i < column_writers_.size(); ++i) {
+    ColumnChunk chunk;
+    column_writers_[i]->Close(sink_, &chunk);
+
+    const BloomFilter* bloom_filter = column_writers_[i]->bloom_filter();
+    if (bloom_filter != NULL) {
+      int64_t offset = bloom_filters_.Tell();
+      bloom_filter->Serialize(&bloom_filters_);
+      chunk.meta_data.__set_bloom_filter_offset(offset);
+      chunk.meta_data.__set_bloom_filter_length(bloom_filters_.Tell() - offset);
+    }
+    const ColumnIndex* column_index = column_writers_[i]->column_index();
+    if (column_index != NULL) {
+      int64_t offset = page_indexes_.Tell();
+      SerializeThriftMsg(*column_index, &page_indexes_);
+      chunk.__set_column_index_offset(offset);
+      chunk.__set_column_index_length(page_indexes_.Tell() - offset);
+    }
+    const OffsetIndex* offset_index = column_writers_[i]->offset_index();
+    if (offset_index != NULL) {
+      int64_t offset = page_indexes_.Tell();
+      SerializeThriftMsg(*offset_index, &page_indexes_);
+      chunk.__set_offset_index_offset(offset);
+      chunk.__set_offset_index_length(page_indexes_.Tell() - offset);
+    }
+    row_group.total_byte_size += chunk.meta_data.total_uncompressed_size;
+    row_group.columns.push_back(chunk);
+  }
+  metadata_.row_groups.push_back(row_group);
+  metadata_.num_rows += num_rows;
+  column_writers_.clear();
+}
+
+void ParquetFileWriter::Close() {
+  if (closed_) return;
+  if (!column_writers_.empty()) CloseRowGroup();
+  closed_ = true;
+
+  // The Bloom filters and page indexes go in front of the footer, so a reader can
+  // fetch them without reading any column chunk.
+  int64_t bloom_filters_start = sink_->Tell();
+  const vector<uint8_t>& bloom_filters = bloom_filters_.buffer();
+  if (!bloom_filters.empty()) sink_->Write(&bloom_filters[0], bloom_filters.size());
+  int64_t page_indexes_start = sink_->Tell();
+  const vector<uint8_t>& page_indexes = page_indexes_.buffer();
+  if (!page_indexes.empty()) sink_->Write(&page_indexes[0], page_indexes.size());
+  for (int i = 0; i < metadata_.row_groups.size(); ++i) {
+    vector<ColumnChunk>& chunks = metadata_.row_groups[i].columns;
+    for (int j = 0; j < chunks.size(); ++j) {
+      if (chunks[j].meta_data.__isset.bloom_filter_offset) {
+        chunks[j].meta_data.bloom_filter_offset += bloom_filters_start;
+      }
+      if (chunks[j].__isset.column_index_offset) {
+        chunks[j].column_index_offset += page_indexes_start;
+      }
+      if (chunks[j].__isset.offset_index_offset) {
+        chunks[j].offset_index_offset += page_indexes_start;
+      }
+    }
+  }
+  bloom_filters_.Clear();
+  page_indexes_.Clear();
+
+  // The footer is the metadata, its 4 byte length and the magic number.
+  int64_t metadata_start = sink_->Tell();
+  SerializeThriftMsg(metadata_, sink_);
+  uint32_t metadata_len = sink_->Tell() - metadata_start;
+  sink_->Write(reinterpret_cast<const uint8_t*>(&metadata_len), sizeof(uint32_t));
+  sink_->Write(PARQUET_MAGIC, sizeof(PARQUET_MAGIC));
+}
+
+}
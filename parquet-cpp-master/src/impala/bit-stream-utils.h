@@ -121,6 +121,11 @@ class BitReader {
   bool GetVlqInt(uint64_t* v);
   bool GetZigZagVlqInt(int64_t* v);
 
+  // Returns a pointer to the next 'num_bytes' bytes of the buffer and advances past
+  // them. Like GetAligned(), the bytes start at the next byte boundary. Returns NULL if
+  // there are not enough bytes left.
+  const uint8_t* GetBytes(int num_bytes);
+
   // Returns the number of bytes left in the stream, not including the current byte (i.e.,
   // there may be an additional fraction of a byte).
   int bytes_left() { return max_bytes_ - (byte_offset_ + BitUtil::Ceil(bit_offset_, 8)); }
@@ -128,6 +133,9 @@ class BitReader {
   // Maximum byte length of a vlq encoded int
   static const int MAX_VLQ_BYTE_LEN = 5;
 
+  // Maximum byte length of a vlq encoded 64 bit int
+  static const int MAX_VLQ_BYTE_LEN_64 = 10;
+
  private:
   const uint8_t* buffer_;
   int max_bytes_;
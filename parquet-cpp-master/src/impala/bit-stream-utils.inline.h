@@ -138,6 +138,25 @@ inline bool BitReader::GetAligned(int num_bytes, T* v) {
   return true;
 }
 
+inline const uint8_t* BitReader::GetBytes(int num_bytes) {
+  int bytes_read = BitUtil::Ceil(bit_offset_, 8);
+  if (UNLIKELY(byte_offset_ + bytes_read + num_bytes > max_bytes_)) return NULL;
+
+  byte_offset_ += bytes_read;
+  const uint8_t* ptr = buffer_ + byte_offset_;
+  byte_offset_ += num_bytes;
+
+  // Reset buffered_values_
+  bit_offset_ = 0;
+  int bytes_remaining = max_bytes_ - byte_offset_;
+  if (LIKELY(bytes_remaining >= 8)) {
+    memcpy(&buffered_values_, buffer_ + byte_offset_, 8);
+  } else {
+    memcpy(&buffered_values_, buffer_ + byte_offset_, bytes_remaining);
+  }
+  return ptr;
+}
+
 inline bool BitReader::GetVlqInt(uint64_t* v) {
   *v = 0;
   int shift = 0;
@@ -145,9 +164,9 @@ inline bool BitReader::GetVlqInt(uint64_t* v) {
   uint8_t byte = 0;
   do {
     if (!GetAligned<uint8_t>(1, &byte)) return false;
-    *v |= (byte & 0x7F) << shift;
+    *v |= static_cast<uint64_t>(byte & 0x7F) << shift;
     shift += 7;
-    DCHECK_LE(++num_bytes, MAX_VLQ_BYTE_LEN);
+    DCHECK_LE(++num_bytes, MAX_VLQ_BYTE_LEN_64);
   } while ((byte & 0x80) != 0);
   return true;
 }
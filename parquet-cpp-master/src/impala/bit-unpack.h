@@ -0,0 +1,198 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_UTIL_BIT_UNPACK_H
+#define IMPALA_UTIL_BIT_UNPACK_H
+
+#include <boost/cstdint.hpp>
+#include <string.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+#include "impala/compiler-util.h"
+#include "impala/logging.h"
+
+namespace impala {
+
+// Kernels to unpack bit packed values (LSB first, as used by the RLE/bit-packed
+// hybrid and the delta encodings) 32 values at a time. 32 values of any bit width
+// end on a 4 byte boundary, so the input is read as 32 bit words and the kernels
+// never read past the 4 * bit_width bytes of the group.
+// Each kernel is a template on the bit width. The value loop is unrolled with
+// templates so the word index, shift and mask of every value are constants.
+
+// Loads the 'idx'th 32 bit little endian word of 'in'.
+inline uint32_t LoadWord32(const uint8_t* in, int idx) {
+  uint32_t word;
+  memcpy(&word, in + idx * sizeof(uint32_t), sizeof(uint32_t));
+  return word;
+}
+
+// Unpacks value I of a group and recurses to value I + 1.
+template <typename T, int BIT_WIDTH, int I>
+struct UnpackStep {
+  static inline void Run(const uint8_t* in, T* out) {
+    const int BIT = I * BIT_WIDTH;
+    const int WORD = BIT / 32;
+    const int SHIFT = BIT % 32;
+    const uint64_t MASK = BIT_WIDTH == 64 ? ~0ULL : (1ULL << (BIT_WIDTH % 64)) - 1;
+    // A value starts in word WORD and can span up to 3 words for widths > 32.
+    uint64_t v = LoadWord32(in, WORD) >> SHIFT;
+    if (SHIFT + BIT_WIDTH > 32) {
+      v |= static_cast<uint64_t>(LoadWord32(in, WORD + 1)) << ((32 - SHIFT) % 64);
+    }
+    if (SHIFT + BIT_WIDTH > 64) {
+      v |= static_cast<uint64_t>(LoadWord32(in, WORD + 2)) << ((64 - SHIFT) % 64);
+    }
+    out[I] = static_cast<T>(v & MASK);
+    UnpackStep<T, BIT_WIDTH, I + 1>::Run(in, out);
+  }
+};
+
+template <typename T, int BIT_WIDTH>
+struct UnpackStep<T, BIT_WIDTH, 32> {
+  static inline void Run(const uint8_t* in, T* out) {}
+};
+
+template <typename T>
+struct UnpackStep<T, 0, 0> {
+  static inline void Run(const uint8_t* in, T* out) {
+    memset(out, 0, 32 * sizeof(T));
+  }
+};
+
+// Unpacks 32 values of BIT_WIDTH bits from 'in' into 'out'. Returns the input
+// position after the values.
+template <typename T, int BIT_WIDTH>
+inline const uint8_t* Unpack32(const uint8_t* in, T* out) {
+  UnpackStep<T, BIT_WIDTH, 0>::Run(in, out);
+  return in + 4 * BIT_WIDTH;
+}
+
+// Unpacks 32 values of 'bit_width' bits from 'in' into 'out'. 'bit_width' must be
+// at most the number of bits in T. Returns the input position after the values.
+template <typename T>
+inline const uint8_t* Unpack32Values(const uint8_t* in, int bit_width, T* out) {
+  const int MAX_WIDTH = sizeof(T) * 8;
+  DCHECK_LE(bit_width, MAX_WIDTH);
+  // Widths larger than T are clamped so they are never instantiated.
+  switch (bit_width) {
+#define UNPACK_CASE(w) \
+    case w: return Unpack32<T, ((w) < MAX_WIDTH ? (w) : MAX_WIDTH)>(in, out)
+    UNPACK_CASE(0); UNPACK_CASE(1); UNPACK_CASE(2); UNPACK_CASE(3);
+    UNPACK_CASE(4); UNPACK_CASE(5); UNPACK_CASE(6); UNPACK_CASE(7);
+    UNPACK_CASE(8); UNPACK_CASE(9); UNPACK_CASE(10); UNPACK_CASE(11);
+    UNPACK_CASE(12); UNPACK_CASE(13); UNPACK_CASE(14); UNPACK_CASE(15);
+    UNPACK_CASE(16); UNPACK_CASE(17); UNPACK_CASE(18); UNPACK_CASE(19);
+    UNPACK_CASE(20); UNPACK_CASE(21); UNPACK_CASE(22); UNPACK_CASE(23);
+    UNPACK_CASE(24); UNPACK_CASE(25); UNPACK_CASE(26); UNPACK_CASE(27);
+    UNPACK_CASE(28); UNPACK_CASE(29); UNPACK_CASE(30); UNPACK_CASE(31);
+    UNPACK_CASE(32); UNPACK_CASE(33); UNPACK_CASE(34); UNPACK_CASE(35);
+    UNPACK_CASE(36); UNPACK_CASE(37); UNPACK_CASE(38); UNPACK_CASE(39);
+    UNPACK_CASE(40); UNPACK_CASE(41); UNPACK_CASE(42); UNPACK_CASE(43);
+    UNPACK_CASE(44); UNPACK_CASE(45); UNPACK_CASE(46); UNPACK_CASE(47);
+    UNPACK_CASE(48); UNPACK_CASE(49); UNPACK_CASE(50); UNPACK_CASE(51);
+    UNPACK_CASE(52); UNPACK_CASE(53); UNPACK_CASE(54); UNPACK_CASE(55);
+    UNPACK_CASE(56); UNPACK_CASE(57); UNPACK_CASE(58); UNPACK_CASE(59);
+    UNPACK_CASE(60); UNPACK_CASE(61); UNPACK_CASE(62); UNPACK_CASE(63);
+    UNPACK_CASE(64);
+#undef UNPACK_CASE
+    default:
+      DCHECK(false) << "Invalid bit width " << bit_width;
+      return in;
+  }
+}
+
+#ifdef __SSE4_1__
+// Unpacks 32 values of BIT_WIDTH <= 16 bits with SSE, 4 values per instruction. In a
+// group of 8 values (BIT_WIDTH bytes), the bytes that contain value i are shuffled
+// into lane i with pshufb. The lanes are then shifted by a different amount each,
+// which is done with a multiply (left shift) followed by a constant right shift.
+template <int BIT_WIDTH>
+inline const uint8_t* Unpack32Sse(const uint8_t* in, uint32_t* out) {
+  // Byte k of the 4 bytes that hold value i of a group, or -1 (zero) if the value
+  // ends before that byte, so the shuffle never reads past the group.
+#define BYTE(i, k) static_cast<char>((i) * BIT_WIDTH / 8 + (k) <= \
+    ((i) * BIT_WIDTH + BIT_WIDTH - 1) / 8 ? (i) * BIT_WIDTH / 8 + (k) : -1)
+#define LANE(i) BYTE(i, 0), BYTE(i, 1), BYTE(i, 2), BYTE(i, 3)
+#define MULT(i) (1 << (8 - (i) * BIT_WIDTH % 8))
+  const __m128i shuffle_lo = _mm_setr_epi8(LANE(0), LANE(1), LANE(2), LANE(3));
+  const __m128i shuffle_hi = _mm_setr_epi8(LANE(4), LANE(5), LANE(6), LANE(7));
+  const __m128i mult_lo = _mm_setr_epi32(MULT(0), MULT(1), MULT(2), MULT(3));
+  const __m128i mult_hi = _mm_setr_epi32(MULT(4), MULT(5), MULT(6), MULT(7));
+#undef MULT
+#undef LANE
+#undef BYTE
+  const __m128i mask = _mm_set1_epi32((1 << BIT_WIDTH) - 1);
+
+  // The 16 byte loads of the last groups would read past the 4 * BIT_WIDTH input
+  // bytes, so they are done from a padded copy.
+  uint8_t buffer[4 * BIT_WIDTH + 16];
+  memcpy(buffer, in, 4 * BIT_WIDTH);
+  for (int g = 0; g < 4; ++g) {
+    const uint8_t* group = buffer + g * BIT_WIDTH;
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    __m128i lo = _mm_shuffle_epi8(x, shuffle_lo);
+    __m128i hi = _mm_shuffle_epi8(x, shuffle_hi);
+    lo = _mm_and_si128(_mm_srli_epi32(_mm_mullo_epi32(lo, mult_lo), 8), mask);
+    hi = _mm_and_si128(_mm_srli_epi32(_mm_mullo_epi32(hi, mult_hi), 8), mask);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + g * 8), lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + g * 8 + 4), hi);
+  }
+  return in + 4 * BIT_WIDTH;
+}
+#endif
+
+// 32 bit outputs, which are used for dictionary indices, use the SSE kernels for
+// the low bit widths.
+inline const uint8_t* Unpack32Values(const uint8_t* in, int bit_width, uint32_t* out) {
+#ifdef __SSE4_1__
+  switch (bit_width) {
+#define UNPACK_CASE(w) case w: return Unpack32Sse<w>(in, out)
+    UNPACK_CASE(1); UNPACK_CASE(2); UNPACK_CASE(3); UNPACK_CASE(4);
+    UNPACK_CASE(5); UNPACK_CASE(6); UNPACK_CASE(7); UNPACK_CASE(8);
+    UNPACK_CASE(9); UNPACK_CASE(10); UNPACK_CASE(11); UNPACK_CASE(12);
+    UNPACK_CASE(13); UNPACK_CASE(14); UNPACK_CASE(15); UNPACK_CASE(16);
+#undef UNPACK_CASE
+    default:
+      break;
+  }
+#endif
+  return Unpack32Values<uint32_t>(in, bit_width, out);
+}
+
+inline const uint8_t* Unpack32Values(const uint8_t* in, int bit_width, int32_t* out) {
+  return Unpack32Values(in, bit_width, reinterpret_cast<uint32_t*>(out));
+}
+
+// Unpacks 'num_values' values of 'bit_width' bits, one at a time. This is the
+// fallback for groups of less than 32 values. 'in' must hold
+// ceil(num_values * bit_width / 8) bytes.
+template <typename T>
+inline void UnpackValues(const uint8_t* in, int bit_width, int num_values, T* out) {
+  int64_t bit = 0;
+  for (int i = 0; i < num_values; ++i) {
+    uint64_t v = 0;
+    for (int b = 0; b < bit_width; ++b, ++bit) {
+      v |= static_cast<uint64_t>((in[bit / 8] >> (bit % 8)) & 1) << b;
+    }
+    out[i] = static_cast<T>(v);
+  }
+}
+
+}
+
+#endif
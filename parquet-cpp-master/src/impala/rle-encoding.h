@@ -16,9 +16,11 @@
 #define IMPALA_RLE_ENCODING_H
 
 #include <math.h>
+#include <algorithm>
 
 #include "impala/compiler-util.h"
 #include "impala/bit-stream-utils.inline.h"
+#include "impala/bit-unpack.h"
 #include "impala/bit-util.h"
 #include "impala/logging.h"
 
@@ -84,7 +86,10 @@ class RleDecoder {
       bit_width_(bit_width),
       current_value_(0),
       repeat_count_(0),
-      literal_count_(0) {
+      literal_count_(0),
+      literal_data_(NULL),
+      unpacked_offset_(0),
+      num_unpacked_(0) {
     DCHECK_GE(bit_width_, 0);
     DCHECK_LE(bit_width_, 64);
   }
@@ -95,12 +100,51 @@ class RleDecoder {
   template<typename T>
   bool Get(T* val);
 
+  // Gets up to 'batch_size' values into 'values'. Repeated runs are filled in
+  // directly and literal runs are unpacked 32 values at a time. Returns the number of
+  // values read, which is less than 'batch_size' only if the end of the buffer was
+  // reached.
+  template<typename T>
+  int GetBatch(T* values, int batch_size);
+
+  // Skips up to 'num_values' values. Repeated runs are skipped without being
+  // expanded and whole groups of 8 literals by moving past their bytes. If 'count' is
+  // not NULL, the number of skipped values equal to 'value' is added to *count, e.g.
+  // to count the non-null values among definition levels; the literals are then
+  // unpacked to be compared. Returns the number of values skipped, which is less
+  // than 'num_values' only if the end of the buffer was reached.
+  int Skip(int num_values, uint64_t value = 0, int* count = NULL);
+
  private:
+  // Reads the indicator of the next run and sets up repeat_count_ or
+  // literal_count_. Returns false if there are no more runs.
+  template<typename T>
+  bool NextCounts();
+
+  // Gets up to 'batch_size' values of the current literal run. Returns the number
+  // of values read.
+  template<typename T>
+  int GetLiterals(T* values, int batch_size);
+
+  // Unpacks the next (up to) 32 values of the current literal run into unpacked_.
+  void UnpackLiterals();
+
   BitReader bit_reader_;
   int bit_width_;
   uint64_t current_value_;
   uint32_t repeat_count_;
+
+  // Number of values of the current literal run that are not unpacked yet and the
+  // bit packed data of those values.
   uint32_t literal_count_;
+  const uint8_t* literal_data_;
+
+  // Literals that were unpacked but not returned yet. Whole groups of 32 are
+  // unpacked directly into the output; a group that only partially fits in the
+  // output is unpacked here first.
+  uint64_t unpacked_[32];
+  int unpacked_offset_;
+  int num_unpacked_;
 };
 
 // Class to incrementally build the rle data.   This class does not allocate any memory.
@@ -141,11 +185,13 @@ class RleEncoder {
 
   // Returns the maximum byte size it could take to encode 'num_values'.
   static int MaxBufferSize(int bit_width, int num_values) {
-    int bytes_per_run = BitUtil::Ceil(bit_width * MAX_VALUES_PER_LITERAL_RUN, 8.0);
-    int num_runs = BitUtil::Ceil(num_values, MAX_VALUES_PER_LITERAL_RUN);
-    int literal_max_size = num_runs + num_runs * bytes_per_run;
+    // The worst case alternates literal runs of 8 values, each with its own
+    // indicator byte, and repeated runs of 8 values.
+    int num_groups = BitUtil::Ceil(num_values, 8);
+    int literal_max_size = num_groups * (1 + bit_width);
+    int repeated_max_size = num_groups * (1 + BitUtil::Ceil(bit_width, 8));
     int min_run_size = MinBufferSize(bit_width);
-    return std::max(min_run_size, literal_max_size) + min_run_size;
+    return std::max(literal_max_size, repeated_max_size) + min_run_size;
   }
 
   // Encode value.  Returns true if the value fits in buffer, false otherwise.
@@ -228,37 +274,139 @@ class RleEncoder {
 };
 
 template<typename T>
-inline bool RleDecoder::Get(T* val) {
-  if (UNLIKELY(literal_count_ == 0 && repeat_count_ == 0)) {
-    // Read the next run's indicator int, it could be a literal or repeated run
-    // The int is encoded as a vlq-encoded value.
-    uint64_t indicator_value = 0;
-    bool result = bit_reader_.GetVlqInt(&indicator_value);
-    if (!result) return false;
-
-    // lsb indicates if it is a literal run or repeated run
-    bool is_literal = indicator_value & 1;
-    if (is_literal) {
-      literal_count_ = (indicator_value >> 1) * 8;
-    } else {
-      repeat_count_ = indicator_value >> 1;
-      bool result = bit_reader_.GetAligned<T>(
-          BitUtil::Ceil(bit_width_, 8), reinterpret_cast<T*>(&current_value_));
-      DCHECK(result);
+inline bool RleDecoder::NextCounts() {
+  // Read the next run's indicator int, it could be a literal or repeated run
+  // The int is encoded as a vlq-encoded value.
+  uint64_t indicator_value = 0;
+  bool result = bit_reader_.GetVlqInt(&indicator_value);
+  if (!result) return false;
+
+  // lsb indicates if it is a literal run or repeated run
+  bool is_literal = indicator_value & 1;
+  if (is_literal) {
+    literal_count_ = (indicator_value >> 1) * 8;
+    // Literal runs start at a byte boundary and are a multiple of 8 values, so the
+    // run is a whole number of bytes.
+    int num_bytes = literal_count_ / 8 * bit_width_;
+    literal_data_ = bit_reader_.GetBytes(num_bytes);
+    if (UNLIKELY(literal_data_ == NULL)) {
+      // Only decode the values that are actually in the buffer.
+      int bytes_left = bit_reader_.bytes_left();
+      literal_count_ = std::min<int64_t>(literal_count_, bytes_left * 8L / bit_width_);
+      literal_data_ = bit_reader_.GetBytes(bytes_left);
     }
+  } else {
+    repeat_count_ = indicator_value >> 1;
+    bool result = bit_reader_.GetAligned<T>(
+        BitUtil::Ceil(bit_width_, 8), reinterpret_cast<T*>(&current_value_));
+    DCHECK(result);
   }
+  return true;
+}
 
+template<typename T>
+inline bool RleDecoder::Get(T* val) {
   if (LIKELY(repeat_count_ > 0)) {
     *val = current_value_;
     --repeat_count_;
+    return true;
+  }
+  return GetBatch(val, 1) == 1;
+}
+
+inline void RleDecoder::UnpackLiterals() {
+  DCHECK_GT(literal_count_, 0);
+  int n = std::min<uint32_t>(literal_count_, 32);
+  if (n == 32) {
+    literal_data_ = Unpack32Values(literal_data_, bit_width_, unpacked_);
   } else {
-    DCHECK(literal_count_ > 0);
-    bool result = bit_reader_.GetValue(bit_width_, val);
-    DCHECK(result);
-    --literal_count_;
+    // Only the end of a run can have less than 32 values.
+    UnpackValues(literal_data_, bit_width_, n, unpacked_);
+    literal_data_ += n * bit_width_ / 8;
+  }
+  literal_count_ -= n;
+  unpacked_offset_ = 0;
+  num_unpacked_ = n;
+}
+
+template<typename T>
+inline int RleDecoder::GetLiterals(T* values, int batch_size) {
+  int values_read = 0;
+  while (values_read < batch_size) {
+    if (unpacked_offset_ < num_unpacked_) {
+      int n = std::min(batch_size - values_read, num_unpacked_ - unpacked_offset_);
+      for (int i = 0; i < n; ++i) {
+        values[values_read + i] = static_cast<T>(unpacked_[unpacked_offset_ + i]);
+      }
+      unpacked_offset_ += n;
+      values_read += n;
+    } else if (literal_count_ >= 32 && batch_size - values_read >= 32) {
+      literal_data_ = Unpack32Values(literal_data_, bit_width_, values + values_read);
+      literal_count_ -= 32;
+      values_read += 32;
+    } else if (literal_count_ > 0) {
+      UnpackLiterals();
+    } else {
+      break;
+    }
   }
+  return values_read;
+}
 
-  return true;
+template<typename T>
+inline int RleDecoder::GetBatch(T* values, int batch_size) {
+  int values_read = 0;
+  while (values_read < batch_size) {
+    if (UNLIKELY(literal_count_ == 0 && repeat_count_ == 0 &&
+        unpacked_offset_ == num_unpacked_)) {
+      if (!NextCounts<T>()) break;
+    }
+
+    if (repeat_count_ > 0) {
+      int n = std::min(batch_size - values_read, static_cast<int>(repeat_count_));
+      std::fill(values + values_read, values + values_read + n,
+          static_cast<T>(current_value_));
+      repeat_count_ -= n;
+      values_read += n;
+    } else {
+      values_read += GetLiterals(values + values_read, batch_size - values_read);
+    }
+  }
+  return values_read;
+}
+
+inline int RleDecoder::Skip(int num_values, uint64_t value, int* count) {
+  int num_skipped = 0;
+  while (num_skipped < num_values) {
+    if (UNLIKELY(literal_count_ == 0 && repeat_count_ == 0 &&
+        unpacked_offset_ == num_unpacked_)) {
+      if (!NextCounts<uint64_t>()) break;
+    }
+
+    int num_left = num_values - num_skipped;
+    if (repeat_count_ > 0) {
+      int n = std::min(num_left, static_cast<int>(repeat_count_));
+      if (count != NULL && current_value_ == value) *count += n;
+      repeat_count_ -= n;
+      num_skipped += n;
+    } else if (unpacked_offset_ < num_unpacked_) {
+      int n = std::min(num_left, num_unpacked_ - unpacked_offset_);
+      if (count != NULL) {
+        for (int i = 0; i < n; ++i) *count += unpacked_[unpacked_offset_ + i] == value;
+      }
+      unpacked_offset_ += n;
+      num_skipped += n;
+    } else if (count == NULL && literal_count_ >= 8 && num_left >= 8) {
+      // Groups of 8 literals are a whole number of bytes.
+      int n = std::min<uint32_t>(literal_count_, num_left) / 8 * 8;
+      literal_data_ += n / 8 * bit_width_;
+      literal_count_ -= n;
+      num_skipped += n;
+    } else {
+      UnpackLiterals();
+    }
+  }
+  return num_skipped;
 }
 
 // This function buffers input values 8 at a time.  After seeing all 8 values,
@@ -0,0 +1,132 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parquet/metadata-cache.h"
+
+#include <boost/thread/once.hpp>
+
+using namespace boost;
+using namespace parquet;
+using namespace std;
+
+namespace parquet_cpp {
+
+FileMetadata::FileMetadata(FileMetaData* metadata, int64_t footer_size)
+  : footer_size_(footer_size) {
+  swap(metadata_, *metadata);
+  schema_.reset(new Schema(metadata_.schema));
+}
+
+const int64_t FileMetadataCache::DEFAULT_CAPACITY;
+
+FileMetadataCache::FileMetadataCache(int64_t capacity)
+  : capacity_(capacity), size_(0), num_hits_(0), num_misses_(0) {
+}
+
+static FileMetadataCache* global_cache = NULL;
+static once_flag global_cache_once = BOOST_ONCE_INIT;
+
+static void CreateGlobalCache() {
+  global_cache = new FileMetadataCache();
+}
+
+FileMetadataCache* FileMetadataCache::Global() {
+  call_once(global_cache_once, CreateGlobalCache);
+  return global_cache;
+}
+
+shared_ptr<const FileMetadata> FileMetadataCache::Lookup(const string& path,
+    int64_t size, int64_t mtime_ns) {
+  mutex::scoped_lock l(lock_);
+  unordered_map<string, EntryList::iterator>::iterator it = index_.find(path);
+  if (it == index_.end()) {
+    ++num_misses_;
+    return shared_ptr<const FileMetadata>();
+  }
+  EntryList::iterator entry = it->second;
+  if (entry->size != size || entry->mtime_ns != mtime_ns) {
+    // The file was rewritten.
+    EraseLocked(entry);
+    ++num_misses_;
+    return shared_ptr<const FileMetadata>();
+  }
+  entries_.splice(entries_.begin(), entries_, entry);
+  ++num_hits_;
+  return entry->metadata;
+}
+
+void FileMetadataCache::Insert(const string& path, int64_t size, int64_t mtime_ns,
+    shared_ptr<const FileMetadata> metadata) {
+  mutex::scoped_lock l(lock_);
+  unordered_map<string, EntryList::iterator>::iterator it = index_.find(path);
+  if (it != index_.end()) EraseLocked(it->second);
+  if (metadata->footer_size() > capacity_) return;
+
+  Entry entry;
+  entry.path = path;
+  entry.size = size;
+  entry.mtime_ns = mtime_ns;
+  entry.metadata = metadata;
+  entries_.push_front(entry);
+  index_[path] = entries_.begin();
+  size_ += metadata->footer_size();
+  EvictLocked();
+}
+
+void FileMetadataCache::SetCapacity(int64_t capacity) {
+  mutex::scoped_lock l(lock_);
+  capacity_ = capacity;
+  EvictLocked();
+}
+
+void FileMetadataCache::Clear() {
+  mutex::scoped_lock l(lock_);
+  entries_.clear();
+  index_.clear();
+  size_ = 0;
+}
+
+int64_t FileMetadataCache::capacity() const {
+  mutex::scoped_lock l(lock_);
+  return capacity_;
+}
+
+int64_t FileMetadataCache::size() const {
+  mutex::scoped_lock l(lock_);
+  return size_;
+}
+
+int64_t FileMetadataCache::num_hits() const {
+  mutex::scoped_lock l(lock_);
+  return num_hits_;
+}
+
+int64_t FileMetadataCache::num_misses() const {
+  mutex::scoped_lock l(lock_);
+  return num_misses_;
+}
+
+void FileMetadataCache::EvictLocked() {
+  while (size_ > capacity_ && !entries_.empty()) {
+    EraseLocked(--entries_.end());
+  }
+}
+
+void FileMetadataCache::EraseLocked(EntryList::iterator it) {
+  size_ -= it->metadata->footer_size();
+  index_.erase(it->path);
+  entries_.erase(it);
+}
+
+}
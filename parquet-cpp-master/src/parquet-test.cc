@@ -0,0 +1,174 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "parquet/parquet.h"
+#include "util/test-util.h"
+
+using namespace parquet;
+using namespace parquet_cpp;
+using namespace std;
+
+static void AppendVlqInt(uint64_t v, vector<uint8_t>* out) {
+  while (v >= 0x80) {
+    out->push_back((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  out->push_back(v);
+}
+
+// Appends 'values' encoded with DELTA_BINARY_PACKED, in blocks of 128 values with 4
+// miniblocks. The deltas are stored with 16 bits, which is enough for the lengths of
+// the test values.
+static void AppendDeltaBitPacked(const vector<int32_t>& values, vector<uint8_t>* out) {
+  AppendVlqInt(128, out);
+  AppendVlqInt(4, out);
+  AppendVlqInt(values.size(), out);
+  int64_t first = values.empty() ? 0 : values[0];
+  AppendVlqInt((first << 1) ^ (first >> 63), out);
+  for (int start = 1; start < values.size(); start += 128) {
+    int block_len = ::min<int>(128, values.size() - start);
+    int64_t min_delta = values[start] - values[start - 1];
+    for (int i = 1; i < block_len; ++i) {
+      min_delta = ::min<int64_t>(min_delta, values[start + i] - values[start + i - 1]);
+    }
+    AppendVlqInt((min_delta << 1) ^ (min_delta >> 63), out);
+    // Only the miniblocks with values have a body, the last one padded with the
+    // min delta.
+    int num_mini_blocks = (block_len + 31) / 32;
+    for (int m = 0; m < 4; ++m) out->push_back(m < num_mini_blocks ? 16 : 0);
+    for (int i = 0; i < num_mini_blocks * 32; ++i) {
+      int64_t delta = i < block_len ?
+          values[start + i] - values[start + i - 1] : min_delta;
+      uint16_t packed = delta - min_delta;
+      out->push_back(packed & 0xff);
+      out->push_back(packed >> 8);
+    }
+  }
+}
+
+// Appends 'values' encoded with DELTA_BYTE_ARRAY.
+static void AppendDeltaByteArray(const vector<string>& values, vector<uint8_t>* out) {
+  vector<int32_t> prefix_lengths;
+  vector<int32_t> suffix_lengths;
+  string suffixes;
+  for (int i = 0; i < values.size(); ++i) {
+    int prefix_len = 0;
+    if (i > 0) {
+      while (prefix_len < values[i].size() && prefix_len < values[i - 1].size() &&
+          values[i][prefix_len] == values[i - 1][prefix_len]) {
+        ++prefix_len;
+      }
+    }
+    prefix_lengths.push_back(prefix_len);
+    suffix_lengths.push_back(values[i].size() - prefix_len);
+    suffixes += values[i].substr(prefix_len);
+  }
+  AppendDeltaBitPacked(prefix_lengths, out);
+  AppendDeltaBitPacked(suffix_lengths, out);
+  out->insert(out->end(), suffixes.begin(), suffixes.end());
+}
+
+static string ValueOfRow(int row) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "value of row %05d", row);
+  return buf;
+}
+
+// Writes a required BYTE_ARRAY column chunk with 'num_pages' DELTA_BYTE_ARRAY pages
+// of 'rows_per_page' rows to 'out'.
+static void WriteDeltaByteArrayChunk(int num_pages, int rows_per_page,
+    InMemoryOutputStream* out, ColumnMetaData* metadata) {
+  for (int page = 0; page < num_pages; ++page) {
+    vector<string> values;
+    for (int i = 0; i < rows_per_page; ++i) {
+      values.push_back(ValueOfRow(page * rows_per_page + i));
+    }
+    vector<uint8_t> data;
+    AppendDeltaByteArray(values, &data);
+
+    DataPageHeader data_page_header;
+    data_page_header.__set_num_values(rows_per_page);
+    data_page_header.__set_encoding(Encoding::DELTA_BYTE_ARRAY);
+    data_page_header.__set_definition_level_encoding(Encoding::RLE);
+    data_page_header.__set_repetition_level_encoding(Encoding::RLE);
+    PageHeader header;
+    header.__set_type(PageType::DATA_PAGE);
+    header.__set_uncompressed_page_size(data.size());
+    header.__set_compressed_page_size(data.size());
+    header.__set_data_page_header(data_page_header);
+    SerializeThriftMsg(header, out);
+    out->Write(&data[0], data.size());
+  }
+  metadata->__set_type(Type::BYTE_ARRAY);
+  metadata->__set_encodings(vector<Encoding::type>(1, Encoding::DELTA_BYTE_ARRAY));
+  metadata->__set_path_in_schema(vector<string>(1, "c"));
+  metadata->__set_codec(CompressionCodec::UNCOMPRESSED);
+  metadata->__set_num_values(num_pages * rows_per_page);
+  metadata->__set_total_uncompressed_size(out->Tell());
+  metadata->__set_total_compressed_size(out->Tell());
+  metadata->__set_data_page_offset(0);
+}
+
+// Reads a DELTA_BYTE_ARRAY column with selections of several non-contiguous runs,
+// within and across pages. All the values of a batch must stay valid until the
+// next call, although the decoder builds them in a buffer that is reused by the next
+// page.
+static void TestReadBatchSelectedDeltaByteArray() {
+  const int num_pages = 3;
+  const int rows_per_page = 200;
+  const int num_rows = num_pages * rows_per_page;
+
+  InMemoryOutputStream out;
+  ColumnMetaData metadata;
+  WriteDeltaByteArrayChunk(num_pages, rows_per_page, &out, &metadata);
+  SchemaElement schema;
+  schema.__set_name("c");
+  schema.__set_type(Type::BYTE_ARRAY);
+  schema.__set_repetition_type(FieldRepetitionType::REQUIRED);
+
+  // Runs of 3 rows every 10 rows, read in batches of 'batch_rows' rows.
+  const int batch_sizes[] = { num_rows, rows_per_page / 2, rows_per_page + 30 };
+  for (int b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); ++b) {
+    const vector<uint8_t>& data = out.buffer();
+    InMemoryInputStream in(&data[0], data.size());
+    ColumnReader reader(&metadata, &schema, &in);
+    int batch_rows = batch_sizes[b];
+    for (int first_row = 0; first_row < num_rows; first_row += batch_rows) {
+      int n = ::min(batch_rows, num_rows - first_row);
+      vector<int32_t> selection;
+      for (int i = 0; i < n; ++i) {
+        if ((first_row + i) % 10 < 3) selection.push_back(i);
+      }
+      vector<ByteArray> values(selection.size() + 1);
+      int64_t values_read;
+      int rows = reader.ReadBatch(n, &selection[0], selection.size(), NULL,
+          &values[0], &values_read);
+      PARQUET_CHECK_EQ(rows, n);
+      PARQUET_CHECK_EQ(values_read, static_cast<int64_t>(selection.size()));
+      for (int i = 0; i < selection.size(); ++i) {
+        string value(reinterpret_cast<const char*>(values[i].ptr), values[i].len);
+        PARQUET_CHECK_EQ(value, ValueOfRow(first_row + selection[i]));
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  TestReadBatchSelectedDeltaByteArray();
+  return 0;
+}
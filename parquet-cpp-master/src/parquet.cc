@@ -15,7 +15,10 @@
 #include "parquet/parquet.h"
 #include "encodings/encodings.h"
 #include "compression/codec.h"
+#include "parquet/predicate.h"
 
+#include <limits>
+#include <sstream>
 #include <string>
 #include <string.h>
 
@@ -44,20 +47,72 @@ const uint8_t* InMemoryInputStream::Read(int num_to_read, int* num_bytes) {
   return result;
 }
 
+int64_t InputStream::Skip(int64_t num_bytes) {
+  int64_t skipped = 0;
+  while (skipped < num_bytes) {
+    int bytes_read;
+    Read(::min(num_bytes - skipped, static_cast<int64_t>(DATA_PAGE_SIZE)), &bytes_read);
+    if (bytes_read == 0) break;
+    skipped += bytes_read;
+  }
+  return skipped;
+}
+
+void InMemoryOutputStream::Write(const uint8_t* data, int64_t length) {
+  buffer_.insert(buffer_.end(), data, data + length);
+}
+
 ColumnReader::~ColumnReader() {
+  CodecPool::instance()->Release(metadata_->codec, decompressor_);
+  CodecPool::instance()->ReleaseBuffer(&decompression_buffer_);
 }
 
 ColumnReader::ColumnReader(const ColumnMetaData* metadata,
-    const SchemaElement* schema, InputStream* stream)
+    const SchemaElement* schema, InputStream* stream,
+    int max_definition_level, int max_repetition_level)
   : metadata_(metadata),
     schema_(schema),
     stream_(stream),
+    decompressor_(NULL),
+    max_definition_level_(max_definition_level),
+    max_repetition_level_(max_repetition_level),
+    current_decoder_(NULL),
+    dictionary_(NULL),
+    num_buffered_values_(0),
+    num_decoded_values_(0),
+    buffered_values_offset_(0),
+    page_predicate_column_(-1),
+    page_predicate_deprecated_min_max_(false),
+    next_page_first_row_(0),
+    levels_to_skip_(0) {
+  Init();
+}
+
+ColumnReader::ColumnReader(const ColumnMetaData* metadata,
+    const SchemaElement* schema, shared_ptr<InputStream> stream,
+    int max_definition_level, int max_repetition_level)
+  : metadata_(metadata),
+    schema_(schema),
+    stream_(stream.get()),
+    stream_owner_(stream),
+    decompressor_(NULL),
+    max_definition_level_(max_definition_level),
+    max_repetition_level_(max_repetition_level),
     current_decoder_(NULL),
+    dictionary_(NULL),
     num_buffered_values_(0),
     num_decoded_values_(0),
-    buffered_values_offset_(0) {
+    buffered_values_offset_(0),
+    page_predicate_column_(-1),
+    page_predicate_deprecated_min_max_(false),
+    next_page_first_row_(0),
+    levels_to_skip_(0) {
+  Init();
+}
+
+void ColumnReader::Init() {
   int value_byte_size;
-  switch (metadata->type) {
+  switch (metadata_->type) {
     case parquet::Type::BOOLEAN:
       value_byte_size = 1;
       break;
@@ -80,16 +135,17 @@ ColumnReader::ColumnReader(const ColumnMetaData* metadata,
       ParquetException::NYI("Unsupported type");
   }
 
-  switch (metadata->codec) {
-    case CompressionCodec::UNCOMPRESSED:
-      break;
-    case CompressionCodec::SNAPPY:
-      decompressor_.reset(new SnappyCodec());
-      break;
-    default:
-      ParquetException::NYI("Reading compressed data");
+  // Top level field.
+  if (max_definition_level_ < 0) {
+    max_definition_level_ = schema_->repetition_type != FieldRepetitionType::REQUIRED;
+  }
+  if (max_repetition_level_ < 0) {
+    max_repetition_level_ = schema_->repetition_type == FieldRepetitionType::REPEATED;
   }
 
+  decompressor_ = CodecPool::instance()->Acquire(metadata_->codec);
+  if (decompressor_ != NULL) CodecPool::instance()->AcquireBuffer(&decompression_buffer_);
+
   config_ = Config::DefaultConfig();
   values_buffer_.resize(config_.batch_size * value_byte_size);
 }
@@ -128,12 +184,511 @@ void ColumnReader::BatchDecode() {
   }
 }
 
+// Overloads to dispatch to the decoder function for each value type.
+static int DecodeValues(Decoder* decoder, bool* values, int num_values) {
+  return decoder->GetBool(values, num_values);
+}
+static int DecodeValues(Decoder* decoder, int32_t* values, int num_values) {
+  return decoder->GetInt32(values, num_values);
+}
+static int DecodeValues(Decoder* decoder, int64_t* values, int num_values) {
+  return decoder->GetInt64(values, num_values);
+}
+static int DecodeValues(Decoder* decoder, float* values, int num_values) {
+  return decoder->GetFloat(values, num_values);
+}
+static int DecodeValues(Decoder* decoder, double* values, int num_values) {
+  return decoder->GetDouble(values, num_values);
+}
+static int DecodeValues(Decoder* decoder, ByteArray* values, int num_values) {
+  return decoder->GetByteArray(values, num_values);
+}
+
+int ColumnReader::DecodeLevels(int num_levels, int16_t* def_levels,
+    int16_t* rep_levels) {
+  if (num_levels == 0) return 0;
+  if (repetition_level_decoder_ == NULL) {
+    // Not repeated, every value starts a new record.
+    if (rep_levels != NULL) std::fill(rep_levels, rep_levels + num_levels, 0);
+  } else {
+    if (rep_levels == NULL) {
+      if (rep_levels_scratch_.size() < num_levels) {
+        rep_levels_scratch_.resize(num_levels);
+      }
+      rep_levels = &rep_levels_scratch_[0];
+    }
+    if (repetition_level_decoder_->GetBatch(rep_levels, num_levels) != num_levels) {
+      ParquetException::EofException();
+    }
+  }
+
+  if (definition_level_decoder_ == NULL) {
+    // Required column, every value is defined.
+    if (def_levels != NULL) std::fill(def_levels, def_levels + num_levels, 0);
+    return num_levels;
+  }
+  if (def_levels == NULL) {
+    if (def_levels_scratch_.size() < num_levels) def_levels_scratch_.resize(num_levels);
+    def_levels = &def_levels_scratch_[0];
+  }
+  if (definition_level_decoder_->GetBatch(def_levels, num_levels) != num_levels) {
+    ParquetException::EofException();
+  }
+  int num_values = 0;
+  for (int i = 0; i < num_levels; ++i) {
+    num_values += def_levels[i] == max_definition_level_;
+  }
+  return num_values;
+}
+
+int ColumnReader::ReadLevels(int batch_size, int16_t* def_levels,
+    int16_t* rep_levels, int* num_values) {
+  int num_levels = ::min(batch_size, num_buffered_values_);
+  *num_values = DecodeLevels(num_levels, def_levels, rep_levels);
+  num_buffered_values_ -= num_levels;
+  return num_levels;
+}
+
+void ColumnReader::InitLevelDecoder(const Encoding::type& encoding, int max_level,
+    const uint8_t** data, int* data_len, scoped_ptr<impala::RleDecoder>* decoder) {
+  if (encoding != Encoding::RLE) {
+    stringstream ss;
+    ss << "Unsupported encoding for levels: " << encoding;
+    throw ParquetException(ss.str());
+  }
+  uint32_t num_bytes;
+  if (*data_len < sizeof(uint32_t)) ParquetException::EofException();
+  memcpy(&num_bytes, *data, sizeof(uint32_t));
+  *data += sizeof(uint32_t);
+  *data_len -= sizeof(uint32_t);
+  if (num_bytes > *data_len) ParquetException::EofException();
+  decoder->reset(new impala::RleDecoder(*data, num_bytes,
+      impala::BitUtil::NumRequiredBits(max_level)));
+  *data += num_bytes;
+  *data_len -= num_bytes;
+}
+
+template <typename T>
+int ColumnReader::ReadBatchInternal(const Type::type& type, int batch_size,
+    int16_t* def_levels, int16_t* rep_levels, T* values, int64_t* values_read) {
+  if (metadata_->type != type) {
+    throw ParquetException("ReadBatch() called with the wrong value type.");
+  }
+  *values_read = 0;
+  if (!HasNext()) return 0;
+
+  int num_values;
+  int num_levels = ReadLevels(batch_size, def_levels, rep_levels, &num_values);
+  if (num_values > 0) {
+    if (DecodeValues(current_decoder_, values, num_values) != num_values) {
+      ParquetException::EofException();
+    }
+  }
+  *values_read = num_values;
+  return num_levels;
+}
+
+// Builds the validity bitmap of 'num_levels' slots from their definition levels.
+// Returns the number of nulls.
+static int64_t BuildValidityBitmap(const int16_t* def_levels, int num_levels,
+    int max_def_level, uint8_t* bitmap) {
+  int64_t num_valid = 0;
+  for (int i = 0; i < num_levels; i += 8) {
+    int n = ::min(8, num_levels - i);
+    uint8_t byte = 0;
+    for (int k = 0; k < n; ++k) {
+      bool valid = def_levels[i + k] == max_def_level;
+      byte |= valid << k;
+      num_valid += valid;
+    }
+    bitmap[i / 8] = byte;
+  }
+  return num_levels - num_valid;
+}
+
+// Moves the 'num_values' values at the start of 'values' to the slots of the
+// non-null levels, starting from the end so every value is moved only once.
+// Null slots are zeroed.
+template <typename T>
+static void SpreadValues(const int16_t* def_levels, int num_levels,
+    int max_def_level, int num_values, T* values) {
+  int j = num_values - 1;
+  for (int i = num_levels - 1; i >= 0; --i) {
+    if (def_levels[i] == max_def_level) {
+      values[i] = values[j--];
+    } else {
+      values[i] = T();
+    }
+  }
+}
+
+template <typename T>
+static void DecodeFixedWidth(Decoder* decoder, const int16_t* def_levels,
+    int num_levels, int max_def_level, int num_values, vector<uint8_t>* out) {
+  out->resize(num_levels * sizeof(T));
+  if (num_levels == 0) return;
+  T* values = reinterpret_cast<T*>(&(*out)[0]);
+  if (num_values > 0 && DecodeValues(decoder, values, num_values) != num_values) {
+    ParquetException::EofException();
+  }
+  if (num_values < num_levels) {
+    SpreadValues(def_levels, num_levels, max_def_level, num_values, values);
+  }
+}
+
+int ColumnReader::ReadBatch(int batch_size, ColumnVector* out) {
+  if (max_repetition_level_ > 0) {
+    throw ParquetException("Repeated columns cannot be read into a ColumnVector.");
+  }
+  out->type = metadata_->type;
+  out->length = 0;
+  out->null_count = 0;
+  out->validity.clear();
+  out->values.clear();
+  out->offsets.clear();
+  out->data.clear();
+  if (!HasNext()) return 0;
+
+  int16_t* def_levels = NULL;
+  if (max_definition_level_ > 0) {
+    // At least one entry, so the scratch space can be addressed for an empty batch.
+    if (def_levels_scratch_.size() < ::max(batch_size, 1)) {
+      def_levels_scratch_.resize(::max(batch_size, 1));
+    }
+    def_levels = &def_levels_scratch_[0];
+  }
+  int num_values;
+  int num_levels = ReadLevels(batch_size, def_levels, NULL, &num_values);
+  out->length = num_levels;
+  if (def_levels != NULL && num_levels > 0) {
+    out->validity.resize((num_levels + 7) / 8);
+    out->null_count = BuildValidityBitmap(def_levels, num_levels,
+        max_definition_level_, &out->validity[0]);
+  }
+
+  switch (metadata_->type) {
+    case Type::BOOLEAN: {
+      int scratch_size = ::max(num_values, 1) * sizeof(bool);
+      if (values_scratch_.size() < scratch_size) values_scratch_.resize(scratch_size);
+      bool* values = reinterpret_cast<bool*>(&values_scratch_[0]);
+      if (num_values > 0 && DecodeValues(current_decoder_, values, num_values) !=
+          num_values) {
+        ParquetException::EofException();
+      }
+      out->values.resize((num_levels + 7) / 8, 0);
+      for (int i = 0, j = 0; i < num_levels; ++i) {
+        if (def_levels != NULL && def_levels[i] != max_definition_level_) continue;
+        out->values[i / 8] |= values[j++] << (i % 8);
+      }
+      break;
+    }
+    case Type::INT32:
+      DecodeFixedWidth<int32_t>(current_decoder_, def_levels, num_levels,
+          max_definition_level_, num_values, &out->values);
+      break;
+    case Type::INT64:
+      DecodeFixedWidth<int64_t>(current_decoder_, def_levels, num_levels,
+          max_definition_level_, num_values, &out->values);
+      break;
+    case Type::FLOAT:
+      DecodeFixedWidth<float>(current_decoder_, def_levels, num_levels,
+          max_definition_level_, num_values, &out->values);
+      break;
+    case Type::DOUBLE:
+      DecodeFixedWidth<double>(current_decoder_, def_levels, num_levels,
+          max_definition_level_, num_values, &out->values);
+      break;
+    case Type::BYTE_ARRAY: {
+      int scratch_size = ::max(num_values, 1) * sizeof(ByteArray);
+      if (values_scratch_.size() < scratch_size) values_scratch_.resize(scratch_size);
+      ByteArray* values = reinterpret_cast<ByteArray*>(&values_scratch_[0]);
+      if (num_values > 0 && DecodeValues(current_decoder_, values, num_values) !=
+          num_values) {
+        ParquetException::EofException();
+      }
+      int64_t data_len = 0;
+      for (int i = 0; i < num_values; ++i) data_len += values[i].len;
+      if (data_len > numeric_limits<int32_t>::max()) {
+        throw ParquetException("Byte array batch too large for 32 bit offsets.");
+      }
+      out->offsets.resize(num_levels + 1);
+      out->data.resize(data_len);
+      int32_t offset = 0;
+      for (int i = 0, j = 0; i < num_levels; ++i) {
+        out->offsets[i] = offset;
+        if (def_levels != NULL && def_levels[i] != max_definition_level_) continue;
+        if (values[j].len > 0) memcpy(&out->data[offset], values[j].ptr, values[j].len);
+        offset += values[j++].len;
+      }
+      out->offsets[num_levels] = offset;
+      break;
+    }
+    default:
+      ParquetException::NYI("Unsupported type");
+  }
+  return num_levels;
+}
+
+int64_t ColumnReader::Skip(int64_t num_rows) {
+  if (max_repetition_level_ > 0) {
+    throw ParquetException("Skip() does not support repeated columns.");
+  }
+  int64_t num_left = num_rows;
+  while (num_left > 0) {
+    if (num_buffered_values_ == 0) {
+      levels_to_skip_ = num_left;
+      bool has_next = HasNext();
+      num_left = levels_to_skip_;
+      levels_to_skip_ = 0;
+      if (!has_next) break;
+      if (num_left == 0) break;
+    }
+    int num_levels = ::min<int64_t>(num_left, num_buffered_values_);
+    int num_values = num_levels;
+    if (definition_level_decoder_ != NULL) {
+      num_values = 0;
+      if (definition_level_decoder_->Skip(num_levels, max_definition_level_,
+          &num_values) != num_levels) {
+        ParquetException::EofException();
+      }
+    }
+    if (num_values > 0 && current_decoder_->Skip(num_values) != num_values) {
+      ParquetException::EofException();
+    }
+    num_buffered_values_ -= num_levels;
+    num_left -= num_levels;
+  }
+  return num_rows - num_left;
+}
+
+// Byte arrays point into the page they were read from, which does not outlive the
+// next page. Before a selection ReadBatch() moves to the next page, the values it
+// read so far, 'begin' to 'end', are appended to 'buffer'. Once the buffer stops
+// growing, RestoreSelectedValues() points the first 'num_values' values at their
+// copies. Other types are copied out of the page and need neither.
+template <typename T>
+static void SaveSelectedValues(const T* values, int64_t begin, int64_t end,
+    vector<uint8_t>* buffer) {
+}
+
+static void SaveSelectedValues(const ByteArray* values, int64_t begin, int64_t end,
+    vector<uint8_t>* buffer) {
+  for (int64_t i = begin; i < end; ++i) {
+    buffer->insert(buffer->end(), values[i].ptr, values[i].ptr + values[i].len);
+  }
+}
+
+template <typename T>
+static void RestoreSelectedValues(T* values, int64_t num_values,
+    const vector<uint8_t>& buffer) {
+}
+
+static void RestoreSelectedValues(ByteArray* values, int64_t num_values,
+    const vector<uint8_t>& buffer) {
+  const uint8_t* ptr = buffer.empty() ? NULL : &buffer[0];
+  for (int64_t i = 0; i < num_values; ++i) {
+    values[i].ptr = ptr;
+    ptr += values[i].len;
+  }
+}
+
+template <typename T>
+int ColumnReader::ReadBatchSelectedInternal(const Type::type& type, int num_rows,
+    const int32_t* selection, int num_selected, int16_t* def_levels, T* values,
+    int64_t* values_read) {
+  if (max_repetition_level_ > 0) {
+    throw ParquetException("ReadBatch() with a selection does not support repeated "
+        "columns.");
+  }
+  *values_read = 0;
+  selected_values_buffer_.clear();
+  // Number of values at the start of 'values' saved to selected_values_buffer_.
+  int64_t num_saved = 0;
+  int row = 0;
+  int i = 0;
+  bool eof = false;
+  while (i < num_selected && !eof) {
+    int first = selection[i];
+    if (first < row || first >= num_rows) {
+      throw ParquetException("Selection indices must be increasing and less than "
+          "the number of rows.");
+    }
+    if (first > row) {
+      if (first - row > num_buffered_values_) {
+        SaveSelectedValues(values, num_saved, *values_read, &selected_values_buffer_);
+        num_saved = *values_read;
+      }
+      int skipped = Skip(first - row);
+      row += skipped;
+      if (row < first) break;
+    }
+    // Read the run of consecutive selected rows.
+    int run_length = 1;
+    while (i + run_length < num_selected &&
+        selection[i + run_length] == first + run_length) {
+      ++run_length;
+    }
+    while (run_length > 0) {
+      if (num_buffered_values_ == 0) {
+        SaveSelectedValues(values, num_saved, *values_read, &selected_values_buffer_);
+        num_saved = *values_read;
+      }
+      int64_t num_values;
+      int num_levels = ReadBatchInternal(type, run_length,
+          def_levels == NULL ? NULL : def_levels + i, NULL, values + *values_read,
+          &num_values);
+      if (num_levels == 0) {
+        eof = true;
+        break;
+      }
+      *values_read += num_values;
+      row += num_levels;
+      i += num_levels;
+      run_length -= num_levels;
+    }
+  }
+  if (!eof && row < num_rows) {
+    if (num_rows - row > num_buffered_values_) {
+      SaveSelectedValues(values, num_saved, *values_read, &selected_values_buffer_);
+      num_saved = *values_read;
+    }
+    row += Skip(num_rows - row);
+  }
+  RestoreSelectedValues(values, num_saved, selected_values_buffer_);
+  return row;
+}
+
+int ColumnReader::ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+    int16_t* def_levels, bool* values, int64_t* values_read) {
+  return ReadBatchSelectedInternal(Type::BOOLEAN, num_rows, selection, num_selected,
+      def_levels, values, values_read);
+}
+
+int ColumnReader::ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+    int16_t* def_levels, int32_t* values, int64_t* values_read) {
+  return ReadBatchSelectedInternal(Type::INT32, num_rows, selection, num_selected,
+      def_levels, values, values_read);
+}
+
+int ColumnReader::ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+    int16_t* def_levels, int64_t* values, int64_t* values_read) {
+  return ReadBatchSelectedInternal(Type::INT64, num_rows, selection, num_selected,
+      def_levels, values, values_read);
+}
+
+int ColumnReader::ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+    int16_t* def_levels, float* values, int64_t* values_read) {
+  return ReadBatchSelectedInternal(Type::FLOAT, num_rows, selection, num_selected,
+      def_levels, values, values_read);
+}
+
+int ColumnReader::ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+    int16_t* def_levels, double* values, int64_t* values_read) {
+  return ReadBatchSelectedInternal(Type::DOUBLE, num_rows, selection, num_selected,
+      def_levels, values, values_read);
+}
+
+int ColumnReader::ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+    int16_t* def_levels, ByteArray* values, int64_t* values_read) {
+  return ReadBatchSelectedInternal(Type::BYTE_ARRAY, num_rows, selection,
+      num_selected, def_levels, values, values_read);
+}
+
+bool ColumnReader::IsDictionaryEncodedPage() const {
+  return current_decoder_ != NULL && current_decoder_ == dictionary_;
+}
+
+int ColumnReader::ReadBatchIndices(int batch_size, int16_t* def_levels,
+    int16_t* rep_levels, int32_t* indices, int64_t* values_read) {
+  *values_read = 0;
+  if (!HasNext()) return 0;
+  if (!IsDictionaryEncodedPage()) {
+    throw ParquetException("ReadBatchIndices() called for a page that is not "
+        "dictionary encoded.");
+  }
+
+  int num_values;
+  int num_levels = ReadLevels(batch_size, def_levels, rep_levels, &num_values);
+  if (num_values > 0) {
+    if (dictionary_->GetIndices(indices, num_values) != num_values) {
+      ParquetException::EofException();
+    }
+  }
+  *values_read = num_values;
+  return num_levels;
+}
+
+int ColumnReader::ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+    bool* values, int64_t* values_read) {
+  return ReadBatchInternal(Type::BOOLEAN, batch_size, def_levels, rep_levels,
+      values, values_read);
+}
+
+int ColumnReader::ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+    int32_t* values, int64_t* values_read) {
+  return ReadBatchInternal(Type::INT32, batch_size, def_levels, rep_levels,
+      values, values_read);
+}
+
+int ColumnReader::ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+    int64_t* values, int64_t* values_read) {
+  return ReadBatchInternal(Type::INT64, batch_size, def_levels, rep_levels,
+      values, values_read);
+}
+
+int ColumnReader::ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+    float* values, int64_t* values_read) {
+  return ReadBatchInternal(Type::FLOAT, batch_size, def_levels, rep_levels,
+      values, values_read);
+}
+
+int ColumnReader::ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+    double* values, int64_t* values_read) {
+  return ReadBatchInternal(Type::DOUBLE, batch_size, def_levels, rep_levels,
+      values, values_read);
+}
+
+int ColumnReader::ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+    ByteArray* values, int64_t* values_read) {
+  return ReadBatchInternal(Type::BYTE_ARRAY, batch_size, def_levels, rep_levels,
+      values, values_read);
+}
+
+void ColumnReader::SetPagePredicate(shared_ptr<const Predicate> predicate, int column,
+    const string& created_by) {
+  if (max_repetition_level_ > 0) {
+    throw ParquetException("Page predicates do not support repeated columns.");
+  }
+  page_predicate_ = predicate;
+  page_predicate_column_ = column;
+  page_predicate_deprecated_min_max_ =
+      Predicate::CanUseDeprecatedByteArrayMinMax(created_by);
+}
+
+bool ColumnReader::PageCanMatch(const DataPageHeader& header) {
+  if (!header.__isset.statistics) return true;
+  vector<const Statistics*> stats(page_predicate_column_ + 1);
+  stats[page_predicate_column_] = &header.statistics;
+  return page_predicate_->CanMatch(stats, page_predicate_deprecated_min_max_);
+}
+
 // PLAIN_DICTIONARY is deprecated but used to be used as a dictionary index
 // encoding.
 static bool IsDictionaryIndexEncoding(const Encoding::type& e) {
   return e == Encoding::RLE_DICTIONARY || e == Encoding::PLAIN_DICTIONARY;
 }
 
+// Clears the optional fields of a page header that is reused for the next page.
+// The other fields are always set by the deserializer.
+static void ResetPageHeader(PageHeader* header) {
+  header->__isset = _PageHeader__isset();
+  header->data_page_header.__isset = _DataPageHeader__isset();
+  header->data_page_header.statistics.__isset = _Statistics__isset();
+  header->dictionary_page_header.__isset = _DictionaryPageHeader__isset();
+  header->data_page_header_v2.__isset = _DataPageHeaderV2__isset();
+  header->data_page_header_v2.statistics.__isset = _Statistics__isset();
+}
+
 bool ColumnReader::ReadNewPage() {
   // Loop until we find the next data page.
 
@@ -142,12 +697,36 @@ bool ColumnReader::ReadNewPage() {
     const uint8_t* buffer = stream_->Peek(DATA_PAGE_SIZE, &bytes_read);
     if (bytes_read == 0) return false;
     uint32_t header_size = bytes_read;
-    DeserializeThriftMsg(buffer, &header_size, &current_page_header_);
+    ResetPageHeader(&current_page_header_);
+    page_header_deserializer_.Deserialize(buffer, &header_size, &current_page_header_);
     stream_->Read(header_size, &bytes_read);
 
     int compressed_len = current_page_header_.compressed_page_size;
     int uncompressed_len = current_page_header_.uncompressed_page_size;
 
+    if (current_page_header_.type == PageType::DATA_PAGE && page_predicate_ != NULL &&
+        !PageCanMatch(current_page_header_.data_page_header)) {
+      if (stream_->Skip(compressed_len) != compressed_len) {
+        ParquetException::EofException();
+      }
+      PrunedPage pruned;
+      pruned.first_row = next_page_first_row_;
+      pruned.num_rows = current_page_header_.data_page_header.num_values;
+      pruned_pages_.push_back(pruned);
+      next_page_first_row_ += pruned.num_rows;
+      continue;
+    }
+    if (current_page_header_.type == PageType::DATA_PAGE &&
+        current_page_header_.data_page_header.num_values <= levels_to_skip_) {
+      // Skip() goes past the whole page.
+      if (stream_->Skip(compressed_len) != compressed_len) {
+        ParquetException::EofException();
+      }
+      levels_to_skip_ -= current_page_header_.data_page_header.num_values;
+      next_page_first_row_ += current_page_header_.data_page_header.num_values;
+      continue;
+    }
+
     // Read the compressed data page.
     buffer = stream_->Read(compressed_len, &bytes_read);
     if (bytes_read != compressed_len) ParquetException::EofException();
@@ -173,26 +752,27 @@ bool ColumnReader::ReadNewPage() {
       PlainDecoder dictionary(schema_->type);
       dictionary.SetData(current_page_header_.dictionary_page_header.num_values,
           buffer, uncompressed_len);
-      shared_ptr<Decoder> decoder(new DictionaryDecoder(schema_->type, &dictionary));
-      decoders_[Encoding::RLE_DICTIONARY] = decoder;
-      current_decoder_ = decoders_[Encoding::RLE_DICTIONARY].get();
+      dictionary_ = new DictionaryDecoder(schema_->type, &dictionary);
+      decoders_[Encoding::RLE_DICTIONARY] = shared_ptr<Decoder>(dictionary_);
+      current_decoder_ = dictionary_;
       continue;
     } else if (current_page_header_.type == PageType::DATA_PAGE) {
       // Read a data page.
       num_buffered_values_ = current_page_header_.data_page_header.num_values;
+      next_page_first_row_ += num_buffered_values_;
 
-      // Read definition levels.
-      if (schema_->repetition_type != FieldRepetitionType::REQUIRED) {
-        int num_definition_bytes = *reinterpret_cast<const uint32_t*>(buffer);
-        buffer += sizeof(uint32_t);
-        definition_level_decoder_.reset(
-            new impala::RleDecoder(buffer, num_definition_bytes, 1));
-        buffer += num_definition_bytes;
-        uncompressed_len -= sizeof(uint32_t);
-        uncompressed_len -= num_definition_bytes;
+      // Read the repetition levels followed by the definition levels.
+      const DataPageHeader& data_page_header = current_page_header_.data_page_header;
+      if (max_repetition_level_ > 0) {
+        InitLevelDecoder(data_page_header.repetition_level_encoding,
+            max_repetition_level_, &buffer, &uncompressed_len,
+            &repetition_level_decoder_);
+      }
+      if (max_definition_level_ > 0) {
+        InitLevelDecoder(data_page_header.definition_level_encoding,
+            max_definition_level_, &buffer, &uncompressed_len,
+            &definition_level_decoder_);
       }
-
-      // TODO: repetition levels
 
       // Get a decoder object for this page or create a new decoder if this is the
       // first page with this encoding.
@@ -204,29 +784,41 @@ bool ColumnReader::ReadNewPage() {
       if (it != decoders_.end()) {
         current_decoder_ = it->second.get();
       } else {
+        shared_ptr<Decoder> decoder;
         switch (encoding) {
-          case Encoding::PLAIN: {
-            shared_ptr<Decoder> decoder;
+          case Encoding::PLAIN:
             if (schema_->type == Type::BOOLEAN) {
               decoder.reset(new BoolDecoder());
             } else {
               decoder.reset(new PlainDecoder(schema_->type));
             }
-            decoders_[encoding] = decoder;
-            current_decoder_ = decoder.get();
             break;
-          }
           case Encoding::RLE_DICTIONARY:
             throw ParquetException("Dictionary page must be before data page.");
 
           case Encoding::DELTA_BINARY_PACKED:
+            decoder.reset(new DeltaBitPackDecoder(schema_->type));
+            break;
           case Encoding::DELTA_LENGTH_BYTE_ARRAY:
+            if (schema_->type != Type::BYTE_ARRAY) {
+              throw ParquetException(
+                  "Delta length byte array encoding should only be for byte arrays.");
+            }
+            decoder.reset(new DeltaLengthByteArrayDecoder());
+            break;
           case Encoding::DELTA_BYTE_ARRAY:
-            ParquetException::NYI("Unsupported encoding");
+            if (schema_->type != Type::BYTE_ARRAY) {
+              throw ParquetException(
+                  "Delta byte array encoding should only be for byte arrays.");
+            }
+            decoder.reset(new DeltaByteArrayDecoder());
+            break;
 
           default:
             throw ParquetException("Unknown encoding type.");
         }
+        decoders_[encoding] = decoder;
+        current_decoder_ = decoder.get();
       }
       current_decoder_->SetData(num_buffered_values_, buffer, uncompressed_len);
       return true;
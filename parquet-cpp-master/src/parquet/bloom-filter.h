@@ -0,0 +1,82 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_BLOOM_FILTER_H
+#define PARQUET_BLOOM_FILTER_H
+
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include "parquet/parquet.h"
+
+namespace parquet_cpp {
+
+// Split block Bloom filter of the values of a column chunk. The bitset is made of
+// 256 bit blocks; the upper 32 bits of the hash of a value pick a block and the lower
+// 32 bits set one bit in each of its eight 32 bit words, so a lookup touches a single
+// cache line. Values are hashed with Hash(), the 64 bit xxHash of their PLAIN
+// encoding. Filters are only written for INT32, INT64 and BYTE_ARRAY columns: the
+// bytes of floating point values that compare equal, like 0.0 and -0.0, can differ.
+//   BloomFilter filter(BloomFilter::OptimalNumBytes(num_distinct_values, 0.01));
+//   filter.Insert(BloomFilter::Hash(value));
+//   if (!filter.Find(BloomFilter::Hash(value))) { /* the value is not there */ }
+class BloomFilter {
+ public:
+  static const int BYTES_PER_BLOCK = 32;
+  static const int MIN_BYTES = BYTES_PER_BLOCK;
+  static const int MAX_BYTES = 128 * 1024 * 1024;
+
+  // Returns the bitset size, a power of 2 in [MIN_BYTES, MAX_BYTES], for which
+  // 'num_distinct_values' values give a false positive rate of at most 'fpp'.
+  static int OptimalNumBytes(int64_t num_distinct_values, double fpp);
+
+  // Empty filter. 'num_bytes' is rounded up to a power of 2 and clamped to
+  // [MIN_BYTES, MAX_BYTES].
+  explicit BloomFilter(int num_bytes);
+
+  // Filter with the bitset of a serialized filter, i.e. the bytes that follow the
+  // BloomFilterHeader. 'num_bytes' must be a power of 2 in [MIN_BYTES, MAX_BYTES].
+  BloomFilter(const uint8_t* bitset, int num_bytes);
+
+  // Deserializes a BloomFilterHeader and its bitset from 'len' bytes at 'data'.
+  // Throws ParquetException if the filter is truncated or uses an unsupported
+  // algorithm, hash or compression.
+  static BloomFilter* Deserialize(const uint8_t* data, int64_t len);
+
+  // Hashes of the values of each type, as they are inserted by ColumnWriter.
+  static uint64_t Hash(const uint8_t* data, int len);
+  static uint64_t Hash(int32_t value);
+  static uint64_t Hash(int64_t value);
+  static uint64_t Hash(const ByteArray& value);
+
+  void Insert(uint64_t hash);
+
+  // Returns false if no value with 'hash' was inserted. True can be a false positive.
+  bool Find(uint64_t hash) const;
+
+  int num_bytes() const { return bitset_.size() * sizeof(uint32_t); }
+
+  // Appends the BloomFilterHeader and the bitset to 'out'.
+  void Serialize(OutputStream* out) const;
+
+ private:
+  // Returns the index of the block of 'hash'.
+  int64_t BlockIndex(uint64_t hash) const;
+
+  std::vector<uint32_t> bitset_;
+};
+
+}
+
+#endif
@@ -0,0 +1,255 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_FILE_READER_H
+#define PARQUET_FILE_READER_H
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "parquet/bloom-filter.h"
+#include "parquet/metadata-cache.h"
+#include "parquet/parquet.h"
+#include "parquet/predicate.h"
+#include "parquet/schema.h"
+
+namespace parquet_cpp {
+
+// Interface to read bytes at arbitrary offsets of a file. ReadAt() does not have
+// a current position so it can be called from multiple threads, and for several
+// column chunks of the same file, without any coordination.
+class RandomAccessFile {
+ public:
+  virtual ~RandomAccessFile() {}
+
+  // Returns the size of the file in bytes.
+  virtual int64_t Size() const = 0;
+
+  // Reads up to 'num_bytes' starting at 'position' into 'out'. Returns the number
+  // of bytes read, which can only be less than 'num_bytes' at the end of the file.
+  virtual int64_t ReadAt(int64_t position, int64_t num_bytes, uint8_t* out) = 0;
+
+ protected:
+  RandomAccessFile() {}
+};
+
+// Implementation of RandomAccessFile for a local file using pread().
+class LocalFile : public RandomAccessFile {
+ public:
+  // Opens the file at 'path'. Throws ParquetException if it cannot be opened.
+  explicit LocalFile(const std::string& path);
+  virtual ~LocalFile();
+
+  virtual int64_t Size() const { return size_; }
+  virtual int64_t ReadAt(int64_t position, int64_t num_bytes, uint8_t* out);
+
+  const std::string& path() const { return path_; }
+  int fd() const { return fd_; }
+  // Modification time of the file when it was opened, in nanoseconds.
+  int64_t mtime_ns() const { return mtime_ns_; }
+
+ private:
+  std::string path_;
+  int fd_;
+  int64_t size_;
+  int64_t mtime_ns_;
+};
+
+// RandomAccessFile over a read-only memory mapping of a local file. The mapped
+// bytes can be accessed directly with data().
+class MemoryMappedFile : public RandomAccessFile {
+ public:
+  // Maps the file at 'path'. Throws ParquetException if it cannot be mapped.
+  explicit MemoryMappedFile(const std::string& path);
+  virtual ~MemoryMappedFile();
+
+  virtual int64_t Size() const { return size_; }
+  virtual int64_t ReadAt(int64_t position, int64_t num_bytes, uint8_t* out);
+
+  const uint8_t* data() const { return data_; }
+  const std::string& path() const { return path_; }
+  int64_t mtime_ns() const { return mtime_ns_; }
+
+ private:
+  std::string path_;
+  const uint8_t* data_;
+  int64_t size_;
+  int64_t mtime_ns_;
+};
+
+// InputStream over a byte range of a memory mapped file. Peek() and Read() return
+// pointers into the mapping so no bytes are copied; only the pages that are
+// actually touched are read from disk.
+class MemoryMappedInputStream : public InputStream {
+ public:
+  // Maps the entire file at 'path'.
+  explicit MemoryMappedInputStream(const std::string& path);
+
+  // Stream over 'length' bytes starting at 'offset' of 'file'.
+  MemoryMappedInputStream(boost::shared_ptr<MemoryMappedFile> file,
+      int64_t offset, int64_t length);
+
+  virtual const uint8_t* Peek(int num_to_peek, int* num_bytes);
+  virtual const uint8_t* Read(int num_to_read, int* num_bytes);
+
+ private:
+  boost::shared_ptr<MemoryMappedFile> file_;
+  const uint8_t* data_;
+  int64_t len_;
+  int64_t offset_;
+};
+
+// InputStream over a byte range of a RandomAccessFile. Bytes are read with ReadAt()
+// in chunks of at least 'buffer_size' bytes, so memory use is bounded by the largest
+// page rather than by the size of the range.
+class FileInputStream : public InputStream {
+ public:
+  static const int DEFAULT_BUFFER_SIZE = 1024 * 1024;
+
+  // Stream over 'length' bytes starting at 'offset' of 'file'.
+  FileInputStream(boost::shared_ptr<RandomAccessFile> file, int64_t offset,
+      int64_t length, int buffer_size = DEFAULT_BUFFER_SIZE);
+
+  virtual const uint8_t* Peek(int num_to_peek, int* num_bytes);
+  virtual const uint8_t* Read(int num_to_read, int* num_bytes);
+  // Only the bytes that are already buffered are consumed, the rest is not read.
+  virtual int64_t Skip(int64_t num_bytes);
+
+ private:
+  // Makes sure at least 'num_bytes' bytes starting at the current position are
+  // buffered. 'num_bytes' must not exceed the bytes left in the range.
+  void FillBuffer(int num_bytes);
+
+  boost::shared_ptr<RandomAccessFile> file_;
+  // Range of the file, position_ is relative to the start of the file.
+  int64_t position_;
+  int64_t end_;
+  int buffer_size_;
+
+  std::vector<uint8_t> buffer_;
+  // Offset in buffer_ of the current position and number of valid bytes in buffer_.
+  int buffer_offset_;
+  int buffer_len_;
+};
+
+// Reader for a parquet file. The footer is read and deserialized once when the
+// reader is created, or taken from a FileMetadataCache; after that the metadata is
+// immutable and any number of column readers can be created for the file's column
+// chunks. Columns are numbered by their position among the leaves of the schema.
+class ParquetFileReader {
+ public:
+  // Opens the file at 'path' and reads its footer. If 'memory_map' is true, the file
+  // is memory mapped and uncompressed pages are decoded directly from the mapping.
+  // Otherwise the column chunks are read with buffered positional reads.
+  // If 'cache' is not NULL, the footer is looked up in it with the size and
+  // modification time of the opened file, and added to it if it is not there.
+  explicit ParquetFileReader(const std::string& path, bool memory_map = false,
+      FileMetadataCache* cache = NULL);
+
+  // Reads the footer of 'file'.
+  explicit ParquetFileReader(boost::shared_ptr<RandomAccessFile> file);
+
+  // Reader for 'file' with its already parsed footer.
+  ParquetFileReader(boost::shared_ptr<RandomAccessFile> file,
+      boost::shared_ptr<const FileMetadata> metadata);
+
+  ~ParquetFileReader();
+
+  const parquet::FileMetaData& metadata() const { return metadata_->metadata(); }
+  // The parsed footer, which can be shared with other readers of the file.
+  boost::shared_ptr<const FileMetadata> shared_metadata() const { return metadata_; }
+  RandomAccessFile* file() const { return file_.get(); }
+
+  int num_row_groups() const { return metadata().row_groups.size(); }
+  int num_columns() const { return schema().num_columns(); }
+  int64_t num_rows() const { return metadata().num_rows; }
+
+  const parquet::RowGroup& row_group(int row_group) const;
+  const parquet::ColumnChunk& column_chunk(int row_group, int column) const;
+  const parquet::SchemaElement& column_schema(int column) const;
+
+  // Returns the schema tree of the file. Use this to get the levels and path of
+  // nested columns.
+  const Schema& schema() const { return metadata_->schema(); }
+
+  // Returns false if the column chunk statistics of 'row_group' show that none of
+  // its rows can match 'predicate'. If the statistics do not rule the row group out,
+  // the Bloom filters of the columns compared with EQ or IN are read, for the chunks
+  // that have one, and checked as well. Throws ParquetException if 'predicate' is
+  // not valid for the schema of the file.
+  bool RowGroupCanMatch(int row_group, const Predicate& predicate) const;
+
+  // Returns the row groups that can match 'predicate', in file order.
+  std::vector<int> SelectRowGroups(const Predicate& predicate) const;
+
+  // Reads the Bloom filter of a column chunk. Returns NULL if the chunk does not have
+  // one (see ColumnWriter::Config::enable_bloom_filter).
+  boost::shared_ptr<BloomFilter> GetBloomFilter(int row_group, int column) const;
+
+  // Read the page index of a column chunk: the statistics and the location of each
+  // data page. Return NULL if the chunk does not have one.
+  boost::shared_ptr<parquet::ColumnIndex> GetColumnIndex(int row_group,
+      int column) const;
+  boost::shared_ptr<parquet::OffsetIndex> GetOffsetIndex(int row_group,
+      int column) const;
+
+  // Returns the data pages of a column chunk whose column index entries do not rule
+  // out 'predicate' (see Predicate::CanMatchPage()), as indices in the OffsetIndex
+  // of the chunk. Throws ParquetException if the chunk does not have a page index.
+  std::vector<int> SelectPages(int row_group, int column,
+      const Predicate& predicate) const;
+
+  // Returns a reader over the given data pages of a column chunk, e.g. the result of
+  // SelectPages(). 'pages' are indices in the OffsetIndex of the chunk, in
+  // increasing order. Only these pages and the dictionary page are read, with one
+  // read per run of adjacent pages, and they are buffered in memory. As with
+  // ColumnReader::SetPagePredicate(), the values of the other pages are not
+  // returned; the OffsetIndex has the first row of each page. Throws
+  // ParquetException if the chunk does not have an OffsetIndex.
+  boost::shared_ptr<ColumnReader> GetColumnReader(int row_group, int column,
+      const std::vector<int>& pages);
+
+  // Returns a reader for 'column' in 'row_group'. The returned reader only
+  // references this object's metadata and must not outlive it. This can be called
+  // from several threads, and the readers can be used concurrently.
+  boost::shared_ptr<ColumnReader> GetColumnReader(int row_group, int column);
+
+  // Same as above, but the chunk is read from 'stream', which must start at the
+  // beginning of the chunk, e.g. a stream from ColumnChunkPrefetcher.
+  boost::shared_ptr<ColumnReader> GetColumnReader(int row_group, int column,
+      boost::shared_ptr<InputStream> stream);
+
+  // Computes the byte range of a column chunk in the file. This includes the
+  // dictionary page if there is one.
+  static void GetColumnChunkRange(const parquet::ColumnMetaData& metadata,
+      int64_t* offset, int64_t* length);
+
+ private:
+  // Reads and deserializes the footer of 'file'.
+  static boost::shared_ptr<const FileMetadata> ParseFooter(RandomAccessFile* file);
+
+  // Reads 'length' bytes at 'offset' of the file into 'buffer'. Throws
+  // ParquetException if the range is not in the file.
+  void ReadRange(int64_t offset, int64_t length, std::vector<uint8_t>* buffer) const;
+
+  boost::shared_ptr<RandomAccessFile> file_;
+  boost::shared_ptr<const FileMetadata> metadata_;
+};
+
+}
+
+#endif
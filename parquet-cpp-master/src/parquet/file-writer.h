@@ -0,0 +1,259 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_FILE_WRITER_H
+#define PARQUET_FILE_WRITER_H
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "parquet/bloom-filter.h"
+#include "parquet/parquet.h"
+#include "parquet/statistics.h"
+
+namespace parquet_cpp {
+
+class Codec;
+class DictEncoder;
+class Encoder;
+class PlainEncoder;
+
+// OutputStream that writes to a local file.
+class LocalFileOutputStream : public OutputStream {
+ public:
+  // Creates (or truncates) the file at 'path'. Throws ParquetException on failure.
+  explicit LocalFileOutputStream(const std::string& path);
+  virtual ~LocalFileOutputStream();
+
+  virtual void Write(const uint8_t* data, int64_t length);
+  virtual int64_t Tell() { return position_; }
+
+  // Closes the file. Throws ParquetException if the data could not be written.
+  void Close();
+
+ private:
+  std::string path_;
+  int fd_;
+  int64_t position_;
+};
+
+// API to write the values of a single column chunk. This is the counterpart of
+// ColumnReader.
+// Values are encoded into pages as they are written. The column chunk is
+// dictionary encoded until the dictionary grows past dictionary_page_size_limit,
+// after which the remaining pages fall back to PLAIN. Finished pages are compressed
+// and buffered in memory until Close(), so the dictionary page can be written
+// in front of the data pages.
+// Optionally, the writer also builds the page index (the statistics and location of
+// every data page) and a Bloom filter of the values of the chunk. They are not part
+// of the chunk, ParquetFileWriter writes them in front of the footer.
+class ColumnWriter {
+ public:
+  struct Config {
+    // Target size of the uncompressed data pages.
+    int data_page_size;
+    // Maximum size of the PLAIN encoded dictionary.
+    int dictionary_page_size_limit;
+    bool enable_dictionary;
+    parquet::CompressionCodec::type codec;
+    // If true, the ColumnIndex and OffsetIndex of the chunk are built.
+    bool write_page_index;
+    // If true, a Bloom filter is built for INT32, INT64 and BYTE_ARRAY columns. It is
+    // sized for the number of distinct values of the chunk and a false positive rate
+    // of bloom_filter_fpp, but is not larger than bloom_filter_max_bytes (rounded up
+    // to a power of 2).
+    bool enable_bloom_filter;
+    double bloom_filter_fpp;
+    int bloom_filter_max_bytes;
+
+    static Config DefaultConfig() {
+      Config config;
+      config.data_page_size = 1024 * 1024;
+      config.dictionary_page_size_limit = 1024 * 1024;
+      config.enable_dictionary = true;
+      config.codec = parquet::CompressionCodec::UNCOMPRESSED;
+      config.write_page_index = true;
+      config.enable_bloom_filter = false;
+      config.bloom_filter_fpp = 0.01;
+      config.bloom_filter_max_bytes = 1024 * 1024;
+      return config;
+    }
+  };
+
+  // 'schema' is the schema element of the (leaf) column and must outlive the writer.
+  ColumnWriter(const parquet::SchemaElement* schema, const Config& config);
+
+  ~ColumnWriter();
+
+  // Writes 'num_levels' definition levels and the corresponding values. As for
+  // ColumnReader::ReadBatch(), 'values' only contains the non-null values, which
+  // are the ones whose definition level is the maximum. 'def_levels' can be NULL
+  // for required columns. Repetition levels are not supported yet, 'rep_levels'
+  // must be NULL.
+  // The type of 'values' must match the column type.
+  void WriteBatch(int num_levels, const int16_t* def_levels,
+      const int16_t* rep_levels, const bool* values);
+  void WriteBatch(int num_levels, const int16_t* def_levels,
+      const int16_t* rep_levels, const int32_t* values);
+  void WriteBatch(int num_levels, const int16_t* def_levels,
+      const int16_t* rep_levels, const int64_t* values);
+  void WriteBatch(int num_levels, const int16_t* def_levels,
+      const int16_t* rep_levels, const float* values);
+  void WriteBatch(int num_levels, const int16_t* def_levels,
+      const int16_t* rep_levels, const double* values);
+  void WriteBatch(int num_levels, const int16_t* def_levels,
+      const int16_t* rep_levels, const ByteArray* values);
+
+  // Returns the number of levels written so far.
+  int64_t num_values() const { return num_values_; }
+
+  // Finishes the column chunk and writes all its pages to 'out'. The metadata of the
+  // chunk is returned in 'chunk'. The writer cannot be used after this.
+  void Close(OutputStream* out, parquet::ColumnChunk* chunk);
+
+  // The page index and Bloom filter of the chunk, only valid after Close(). NULL if
+  // they are disabled in the config.
+  const parquet::ColumnIndex* column_index() const;
+  const parquet::OffsetIndex* offset_index() const;
+  const BloomFilter* bloom_filter() const { return bloom_filter_.get(); }
+
+ private:
+  template <typename T>
+  void WriteBatchInternal(const parquet::Type::type& type, int num_levels,
+      const int16_t* def_levels, const int16_t* rep_levels, const T* values);
+
+  // Writes the buffered levels and values as a data page.
+  void FlushPage();
+
+  // Switches from the dictionary encoder to PLAIN for the remaining pages.
+  void FallbackToPlain();
+
+  // Compresses 'page_buffer_' if needed and appends the page with 'header' to 'out'.
+  // Returns the number of bytes appended.
+  int64_t WritePage(parquet::PageHeader* header, OutputStream* out);
+
+  void AddEncoding(const parquet::Encoding::type& encoding);
+
+  // Returns the encoding recorded for the data pages of the current encoder. Data
+  // page v1 readers expect dictionary indices to be marked PLAIN_DICTIONARY.
+  parquet::Encoding::type DataPageEncoding() const;
+
+  // Adds 'num_values' non-null values to the Bloom filter. Only called if it is
+  // enabled, so only for the types that have filters.
+  template <typename T>
+  void AddToBloomFilter(const T* values, int num_values);
+
+  // Records the Bloom filter hash of a value.
+  void AddHashToBloomFilter(uint64_t hash);
+
+  const parquet::SchemaElement* schema_;
+  Config config_;
+  bool closed_;
+
+  boost::scoped_ptr<Codec> compressor_;
+
+  // The dictionary encoder is only set if dictionary encoding is enabled.
+  boost::scoped_ptr<DictEncoder> dict_encoder_;
+  boost::scoped_ptr<PlainEncoder> plain_encoder_;
+  Encoder* current_encoder_;
+
+  // Definition levels of the current page. Not used for required columns.
+  std::vector<int16_t> def_levels_;
+  int num_page_values_;
+  ColumnStatistics page_stats_;
+  ColumnStatistics chunk_stats_;
+
+  // The finished data pages of the column chunk, including their headers.
+  InMemoryOutputStream data_pages_;
+  int num_data_pages_;
+
+  // Scratch buffers for the page being written.
+  std::vector<uint8_t> page_buffer_;
+  std::vector<uint8_t> compressed_buffer_;
+
+  int64_t num_values_;
+  int64_t total_uncompressed_size_;
+  std::vector<parquet::Encoding::type> encodings_;
+
+  // The page index, with page offsets relative to data_pages_ until Close().
+  parquet::ColumnIndex column_index_;
+  parquet::OffsetIndex offset_index_;
+
+  // The distinct hashes of the values are collected until the filter can be sized
+  // in Close(). Once there are too many of them for bloom_filter_max_bytes, a filter
+  // of that size is created and the values are inserted as they are written.
+  bool bloom_filter_enabled_;
+  boost::unordered_set<uint64_t> bloom_filter_hashes_;
+  boost::scoped_ptr<BloomFilter> bloom_filter_;
+};
+
+// Writer for a parquet file. Values are written column by column for one row group
+// at a time:
+//   ParquetFileWriter writer(&out, schema);
+//   writer.NewRowGroup();
+//   writer.column_writer(0)->WriteBatch(...);
+//   ...
+//   writer.Close();
+// Only flat schemas are supported.
+class ParquetFileWriter {
+ public:
+  // 'schema' is the flattened schema, starting with the root. 'sink' must outlive
+  // the writer. 'config' is used for all the columns.
+  ParquetFileWriter(OutputStream* sink, const std::vector<parquet::SchemaElement>& schema,
+      const ColumnWriter::Config& config = ColumnWriter::Config::DefaultConfig());
+
+  ~ParquetFileWriter();
+
+  // Finishes the current row group, if any, and starts a new one.
+  void NewRowGroup();
+
+  int num_columns() const { return metadata_.schema.size() - 1; }
+
+  // Returns the writer for 'column' in the current row group. The writer is valid
+  // until the next call to NewRowGroup() or Close().
+  ColumnWriter* column_writer(int column);
+
+  // Sets the config of 'column' for the row groups started after this call, e.g. to
+  // only build Bloom filters for the columns used in lookups.
+  void SetColumnConfig(int column, const ColumnWriter::Config& config);
+
+  // Finishes the last row group, then writes the Bloom filters and page indexes of
+  // all the column chunks, followed by the file footer.
+  void Close();
+
+ private:
+  // Writes the column chunks of the current row group to sink_.
+  void CloseRowGroup();
+
+  OutputStream* sink_;
+  // Config of each column.
+  std::vector<ColumnWriter::Config> configs_;
+  parquet::FileMetaData metadata_;
+  std::vector<boost::shared_ptr<ColumnWriter> > column_writers_;
+  bool closed_;
+
+  // The serialized Bloom filters and page indexes of the finished row groups. Their
+  // offsets in the column chunk metadata are relative to the start of these buffers
+  // until Close() writes them to sink_.
+  InMemoryOutputStream bloom_filters_;
+  InMemoryOutputStream page_indexes_;
+};
+
+}
+
+#endif
@@ -0,0 +1,121 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_METADATA_CACHE_H
+#define PARQUET_METADATA_CACHE_H
+
+#include <list>
+#include <string>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "parquet/parquet.h"
+#include "parquet/schema.h"
+
+namespace parquet_cpp {
+
+// The parsed footer of a file: the thrift metadata and the schema tree built from
+// it. It is immutable, so it can be shared by any number of readers and threads.
+class FileMetadata {
+ public:
+  // Takes the contents of 'metadata', which is left empty. 'footer_size' is the
+  // size of the serialized metadata, used to account for it in FileMetadataCache.
+  // Throws ParquetException if the schema is not valid.
+  FileMetadata(parquet::FileMetaData* metadata, int64_t footer_size);
+
+  const parquet::FileMetaData& metadata() const { return metadata_; }
+  const Schema& schema() const { return *schema_; }
+  int64_t footer_size() const { return footer_size_; }
+
+ private:
+  // The schema references metadata_, so this is not copyable.
+  FileMetadata(const FileMetadata&);
+  FileMetadata& operator=(const FileMetadata&);
+
+  parquet::FileMetaData metadata_;
+  boost::scoped_ptr<Schema> schema_;
+  const int64_t footer_size_;
+};
+
+// Cache of parsed footers, so readers that reopen the same files do not read and
+// deserialize their footers again. Entries are keyed by path and are only returned
+// if the size and modification time of the file did not change. The least recently
+// used entries are evicted once the total size of the cached footers exceeds the
+// capacity. Parsed footers take a few times more memory than their serialized
+// size, which is what is counted. This can be used from several threads.
+//   ParquetFileReader reader(path, false, FileMetadataCache::Global());
+class FileMetadataCache {
+ public:
+  static const int64_t DEFAULT_CAPACITY = 256 * 1024 * 1024;
+
+  // 'capacity' is in bytes of serialized footers.
+  explicit FileMetadataCache(int64_t capacity = DEFAULT_CAPACITY);
+
+  // Returns the process wide cache, which has DEFAULT_CAPACITY.
+  static FileMetadataCache* Global();
+
+  // Returns the metadata of 'path' if it was cached for a file with the same size
+  // and modification time, NULL otherwise. A stale entry is dropped.
+  boost::shared_ptr<const FileMetadata> Lookup(const std::string& path, int64_t size,
+      int64_t mtime_ns);
+
+  // Caches 'metadata' for 'path', replacing any previous entry. Footers larger than
+  // the capacity are not cached.
+  void Insert(const std::string& path, int64_t size, int64_t mtime_ns,
+      boost::shared_ptr<const FileMetadata> metadata);
+
+  // Evicts entries until the cached footers fit in 'capacity'.
+  void SetCapacity(int64_t capacity);
+
+  void Clear();
+
+  int64_t capacity() const;
+  // Total footer_size() of the cached entries.
+  int64_t size() const;
+  int64_t num_hits() const;
+  int64_t num_misses() const;
+
+ private:
+  struct Entry {
+    std::string path;
+    int64_t size;
+    int64_t mtime_ns;
+    boost::shared_ptr<const FileMetadata> metadata;
+  };
+  typedef std::list<Entry> EntryList;
+
+  // Removes the least recently used entries until size_ fits in capacity_. Must be
+  // called with lock_ held.
+  void EvictLocked();
+
+  // Removes 'it' from the cache. Must be called with lock_ held.
+  void EraseLocked(EntryList::iterator it);
+
+  mutable boost::mutex lock_;
+  // The following are protected by lock_.
+  int64_t capacity_;
+  int64_t size_;
+  int64_t num_hits_;
+  int64_t num_misses_;
+  // Most recently used first.
+  EntryList entries_;
+  boost::unordered_map<std::string, EntryList::iterator> index_;
+};
+
+}
+
+#endif
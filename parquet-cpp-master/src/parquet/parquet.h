@@ -17,8 +17,10 @@
 
 #include <exception>
 #include <sstream>
+#include <vector>
 #include <boost/cstdint.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
 #include "gen-cpp/parquet_constants.h"
 #include "gen-cpp/parquet_types.h"
@@ -39,12 +41,43 @@ namespace parquet_cpp {
 
 class Codec;
 class Decoder;
+class DictionaryDecoder;
+class Predicate;
 
 struct ByteArray {
   uint32_t len;
   const uint8_t* ptr;
 };
 
+// A batch of values of a column in the Arrow columnar memory layout. Every value,
+// null or not, has a slot.
+//  - validity: bit i (least significant bit first) is set if slot i is not null.
+//    Empty if the column cannot have nulls.
+//  - values: for fixed width types, one value per slot; null slots are zeroed.
+//    Booleans are packed as bits, like the validity bitmap. Empty for BYTE_ARRAY.
+//  - offsets and data: for BYTE_ARRAY only, value i is the bytes of data from
+//    offsets[i] to offsets[i + 1]. There are length + 1 offsets, null slots are
+//    empty.
+// The vectors keep their capacity when the batch is reused, so reading into the
+// same ColumnVector does not allocate once it is large enough.
+struct ColumnVector {
+  parquet::Type::type type;
+  // Number of slots.
+  int64_t length;
+  int64_t null_count;
+  std::vector<uint8_t> validity;
+  std::vector<uint8_t> values;
+  std::vector<int32_t> offsets;
+  std::vector<uint8_t> data;
+
+  ColumnVector() : type(parquet::Type::BOOLEAN), length(0), null_count(0) {}
+
+  template <typename T>
+  const T* values_as() const {
+    return values.empty() ? NULL : reinterpret_cast<const T*>(&values[0]);
+  }
+};
+
 class ParquetException : public std::exception {
  public:
   static void EofException() { throw ParquetException("Unexpected end of stream."); }
@@ -82,6 +115,11 @@ class InputStream {
   // *num_bytes.
   virtual const uint8_t* Read(int num_to_read, int* num_bytes) = 0;
 
+  // Advances the current position by up to 'num_bytes' without returning the bytes.
+  // Returns the number of bytes skipped. Streams that would otherwise have to
+  // fetch the bytes should override this.
+  virtual int64_t Skip(int64_t num_bytes);
+
   virtual ~InputStream() {}
 
  protected:
@@ -101,6 +139,84 @@ class InMemoryInputStream : public InputStream {
   int64_t offset_;
 };
 
+// InMemoryInputStream over bytes held by 'owner', e.g. a buffer read from a file.
+// Keeps 'owner' alive as long as the stream.
+class SharedBufferInputStream : public InMemoryInputStream {
+ public:
+  SharedBufferInputStream(boost::shared_ptr<void> owner, const uint8_t* buffer,
+      int64_t len)
+    : InMemoryInputStream(buffer, len), owner_(owner) {}
+
+ private:
+  boost::shared_ptr<void> owner_;
+};
+
+// Interface for the writers to output bytes. Bytes are appended in order.
+class OutputStream {
+ public:
+  // Appends 'length' bytes from 'data' to the stream.
+  virtual void Write(const uint8_t* data, int64_t length) = 0;
+
+  // Returns the number of bytes written to the stream so far.
+  virtual int64_t Tell() = 0;
+
+  virtual ~OutputStream() {}
+
+ protected:
+  OutputStream() {}
+};
+
+// Implementation of an OutputStream that appends to a buffer in memory.
+class InMemoryOutputStream : public OutputStream {
+ public:
+  InMemoryOutputStream() {}
+  virtual void Write(const uint8_t* data, int64_t length);
+  virtual int64_t Tell() { return buffer_.size(); }
+
+  const std::vector<uint8_t>& buffer() const { return buffer_; }
+  void Clear() { buffer_.clear(); }
+
+ private:
+  std::vector<uint8_t> buffer_;
+};
+
+// Deserializes thrift messages like DeserializeThriftMsg() below, but the transport
+// and protocol are created once and reused for every message. Together with a
+// reused message object, whose strings keep their capacity, this lets readers
+// decode page headers without allocating.
+// Thrift does not reset the __isset flags of a reused message, this is up to the
+// caller.
+class ThriftDeserializer {
+ public:
+  ThriftDeserializer()
+    : transport_(new apache::thrift::transport::TMemoryBuffer()) {
+    ResetProtocol();
+  }
+
+  template <class T>
+  void Deserialize(const uint8_t* buf, uint32_t* len, T* deserialized_msg) {
+    transport_->resetBuffer(const_cast<uint8_t*>(buf), *len);
+    try {
+      deserialized_msg->read(protocol_.get());
+    } catch (apache::thrift::protocol::TProtocolException& e) {
+      // The protocol may be left in the middle of a struct.
+      ResetProtocol();
+      throw ParquetException("Couldn't deserialize thrift.", e);
+    }
+    uint32_t bytes_left = transport_->available_read();
+    *len = *len - bytes_left;
+  }
+
+ private:
+  typedef apache::thrift::protocol::TCompactProtocolT<
+      apache::thrift::transport::TMemoryBuffer> Protocol;
+
+  void ResetProtocol() { protocol_.reset(new Protocol(transport_)); }
+
+  boost::shared_ptr<apache::thrift::transport::TMemoryBuffer> transport_;
+  boost::scoped_ptr<Protocol> protocol_;
+};
+
 // API to read values from a single column. This is the main client facing API.
 class ColumnReader {
  public:
@@ -114,16 +230,143 @@ class ColumnReader {
     }
   };
 
+  // 'max_definition_level' and 'max_repetition_level' are the levels of the column
+  // in the schema (see SchemaNode). If they are -1, the column is a top level field
+  // and the levels are derived from its repetition type.
+  ColumnReader(const parquet::ColumnMetaData*,
+      const parquet::SchemaElement*, InputStream* stream,
+      int max_definition_level = -1, int max_repetition_level = -1);
+
+  // Same as above, but the reader shares ownership of 'stream'.
   ColumnReader(const parquet::ColumnMetaData*,
-      const parquet::SchemaElement*, InputStream* stream);
+      const parquet::SchemaElement*, boost::shared_ptr<InputStream> stream,
+      int max_definition_level = -1, int max_repetition_level = -1);
 
   ~ColumnReader();
 
   // Returns true if there are still values in this column.
   bool HasNext();
 
-  // Returns the next value of this type.
-  // TODO: batchify this interface.
+  int max_definition_level() const { return max_definition_level_; }
+  int max_repetition_level() const { return max_repetition_level_; }
+
+  // Reads a batch of up to 'batch_size' levels, moving on to the next data page
+  // if the current one is exhausted (a batch never spans pages).
+  // The definition and repetition levels are written to 'def_levels' and
+  // 'rep_levels', either of which may be NULL if the caller does not need them.
+  // The non-null values, whose definition level is max_definition_level(), are
+  // written contiguously to 'values', which must have room for 'batch_size' values;
+  // *values_read is set to the number of values written. RecordAssembler rebuilds
+  // the nesting of the values from the levels.
+  // Returns the number of levels read, which is 0 at the end of the column.
+  // The type of 'values' must match the column type. These functions should not
+  // be interleaved with the single value Get*() functions below.
+  int ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+      bool* values, int64_t* values_read);
+  int ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+      int32_t* values, int64_t* values_read);
+  int ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+      int64_t* values, int64_t* values_read);
+  int ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+      float* values, int64_t* values_read);
+  int ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+      double* values, int64_t* values_read);
+  int ReadBatch(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+      ByteArray* values, int64_t* values_read);
+
+  // Reads up to 'batch_size' values, including nulls, into 'out' in the Arrow layout,
+  // replacing its contents. As for the other ReadBatch() functions, a batch never
+  // spans pages. A value is null if its definition level is less than
+  // max_definition_level(), i.e. the nulls of the leaf's ancestors are folded into
+  // the leaf. Repeated columns are not supported, use RecordAssembler for them.
+  // Returns the number of values read, which is 0 at the end of the column.
+  int ReadBatch(int batch_size, ColumnVector* out);
+
+  // Skips the next 'num_rows' rows without decoding their values where possible:
+  // data pages that are skipped entirely are not decompressed, runs of levels and of
+  // dictionary indices are skipped at once, and PLAIN values are stepped over.
+  // Unlike ReadBatch(), this moves across pages. Returns the number of rows
+  // skipped, which is less than 'num_rows' only at the end of the column. Repeated
+  // columns are not supported. Should not be interleaved with the Get*() functions.
+  int64_t Skip(int64_t num_rows);
+
+  // Late materialization version of ReadBatch(): of the next 'num_rows' rows, only
+  // the 'num_selected' rows whose indices are in 'selection' are read; the others are
+  // skipped as with Skip(). The indices are relative to the current row and must be
+  // increasing, e.g. the rows of another column of the row group that passed a
+  // filter. The definition levels of the selected rows are written to 'def_levels',
+  // which may be NULL, and their non-null values to 'values'; both must have room
+  // for 'num_selected' entries. Like Skip(), this moves across pages; byte arrays
+  // read from earlier pages are copied into a buffer owned by the reader, so all of
+  // them stay valid until the next call. Returns the number of rows consumed, which
+  // is less than 'num_rows' only at the end of the column. Repeated columns are not
+  // supported.
+  int ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+      int16_t* def_levels, bool* values, int64_t* values_read);
+  int ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+      int16_t* def_levels, int32_t* values, int64_t* values_read);
+  int ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+      int16_t* def_levels, int64_t* values, int64_t* values_read);
+  int ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+      int16_t* def_levels, float* values, int64_t* values_read);
+  int ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+      int16_t* def_levels, double* values, int64_t* values_read);
+  int ReadBatch(int num_rows, const int32_t* selection, int num_selected,
+      int16_t* def_levels, ByteArray* values, int64_t* values_read);
+
+  // Returns true if the current data page is dictionary encoded. Only valid after
+  // HasNext() returned true; the encoding can change from one page to the next, e.g.
+  // when the writer fell back to PLAIN.
+  bool IsDictionaryEncodedPage() const;
+
+  // Returns the dictionary of the column chunk, or NULL if the chunk does not have
+  // one. The dictionary page is the first page of the chunk, so this is set once
+  // HasNext() returned true. The dictionary is owned by the reader.
+  const DictionaryDecoder* dictionary() const { return dictionary_; }
+
+  // Dictionary preserving version of ReadBatch(): instead of the values, their
+  // indices in dictionary() are written to 'indices'. This lets callers work on the
+  // indices and, e.g., evaluate predicates once per dictionary entry. The levels are
+  // returned as in ReadBatch(). The current page must be dictionary encoded (see
+  // IsDictionaryEncodedPage()), otherwise ParquetException is thrown. Batches of
+  // indices and batches of values can be mixed.
+  int ReadBatchIndices(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+      int32_t* indices, int64_t* values_read);
+
+  // Rows of a data page skipped by the page predicate. Rows are numbered from the
+  // start of the column chunk.
+  struct PrunedPage {
+    int64_t first_row;
+    int32_t num_rows;
+  };
+
+  // Skips the data pages whose statistics show that none of their values can match
+  // 'predicate' (see Predicate::CanMatch()), without decompressing them. 'column' is
+  // the index of this reader's column in the predicate; predicates on other columns
+  // cannot prune pages. The values of skipped pages are not returned. To keep the
+  // other columns of the row group aligned, callers skip the same rows in them,
+  // e.g. with Skip(), using pruned_pages() or current_row(). Repeated columns are
+  // not supported, as their pages do not tell where rows start. 'created_by' is
+  // FileMetaData.created_by of the file, which tells if the deprecated min and max
+  // of byte arrays can be used (see Predicate::CanUseDeprecatedByteArrayMinMax()).
+  void SetPagePredicate(boost::shared_ptr<const Predicate> predicate, int column,
+      const std::string& created_by);
+
+  // Number of data pages skipped by the page predicate so far.
+  int64_t num_pruned_pages() const { return pruned_pages_.size(); }
+
+  // The data pages skipped by the page predicate so far, in order.
+  const std::vector<PrunedPage>& pruned_pages() const { return pruned_pages_; }
+
+  // Returns the row of the next value, numbered from the start of the column chunk.
+  // Pages skipped by the page predicate are only skipped when the reader moves to
+  // the next page, so this is only up to date after HasNext() returned true. A
+  // reader over selected pages (see FileReader::GetColumnReader()) only counts the
+  // rows of these pages. Repeated columns are not supported.
+  int64_t current_row() const { return next_page_first_row_ - num_buffered_values_; }
+
+  // Returns the next value of this type. NULL values (definition level less than
+  // max_definition_level()) are returned as the default value of the type.
   bool GetBool(int* definition_level, int* repetition_level);
   int32_t GetInt32(int* definition_level, int* repetition_level);
   int64_t GetInt64(int* definition_level, int* repetition_level);
@@ -132,37 +375,105 @@ class ColumnReader {
   ByteArray GetByteArray(int* definition_level, int* repetition_level);
 
  private:
+  // Common initialization for the constructors.
+  void Init();
+
   bool ReadNewPage();
+  // Returns false if page_predicate_ rules out the page with 'header'.
+  bool PageCanMatch(const parquet::DataPageHeader& header);
   // Reads the next definition and repetition level. Returns true if the value is NULL.
   bool ReadDefinitionRepetitionLevels(int* def_level, int* rep_level);
 
   void BatchDecode();
 
+  // Implementation of ReadBatch() for value type T. 'type' is the column type
+  // T corresponds to.
+  template <typename T>
+  int ReadBatchInternal(const parquet::Type::type& type, int batch_size,
+      int16_t* def_levels, int16_t* rep_levels, T* values, int64_t* values_read);
+
+  // Implementation of the selection vector ReadBatch() for value type T.
+  template <typename T>
+  int ReadBatchSelectedInternal(const parquet::Type::type& type, int num_rows,
+      const int32_t* selection, int num_selected, int16_t* def_levels, T* values,
+      int64_t* values_read);
+
+  // Reads the levels of the next batch of up to 'batch_size' levels of the current
+  // page. Returns the number of levels read and sets *num_values to the number of
+  // non-null values among them. Does not decode the values.
+  int ReadLevels(int batch_size, int16_t* def_levels, int16_t* rep_levels,
+      int* num_values);
+
+  // Decodes the levels of the next 'num_levels' values into 'def_levels' and
+  // 'rep_levels', which may be NULL. Returns the number of non-null values among them.
+  int DecodeLevels(int num_levels, int16_t* def_levels, int16_t* rep_levels);
+
+  // Initializes 'decoder' with the levels of a data page that start at *data and
+  // advances *data and *data_len past them.
+  void InitLevelDecoder(const parquet::Encoding::type& encoding, int max_level,
+      const uint8_t** data, int* data_len,
+      boost::scoped_ptr<impala::RleDecoder>* decoder);
+
   Config config_;
 
   const parquet::ColumnMetaData* metadata_;
   const parquet::SchemaElement* schema_;
   InputStream* stream_;
+  // Only set if the reader owns the stream.
+  boost::shared_ptr<InputStream> stream_owner_;
 
-  // Compression codec to use.
-  boost::scoped_ptr<Codec> decompressor_;
+  // Compression codec to use. The codec and the decompression buffer are borrowed
+  // from the CodecPool for the lifetime of the reader.
+  Codec* decompressor_;
   std::vector<uint8_t> decompression_buffer_;
 
   // Map of compression type to decompressor object.
   boost::unordered_map<parquet::Encoding::type, boost::shared_ptr<Decoder> > decoders_;
 
+  // Reused for every page, so reading a page header does not allocate.
+  ThriftDeserializer page_header_deserializer_;
   parquet::PageHeader current_page_header_;
 
-  // Not set if field is required.
+  int max_definition_level_;
+  int max_repetition_level_;
+
+  // Not set if max_definition_level_ is 0, i.e. the field and its ancestors are
+  // required.
   boost::scoped_ptr<impala::RleDecoder> definition_level_decoder_;
-  // Not set for flat schemas.
+  // Not set if max_repetition_level_ is 0, i.e. the field is not repeated.
   boost::scoped_ptr<impala::RleDecoder> repetition_level_decoder_;
   Decoder* current_decoder_;
+  // Set once the dictionary page was read. Owned by decoders_.
+  DictionaryDecoder* dictionary_;
   int num_buffered_values_;
 
   std::vector<uint8_t> values_buffer_;
   int num_decoded_values_;
   int buffered_values_offset_;
+
+  boost::shared_ptr<const Predicate> page_predicate_;
+  int page_predicate_column_;
+  // True if the deprecated min and max of byte arrays can be used to prune pages.
+  bool page_predicate_deprecated_min_max_;
+  std::vector<PrunedPage> pruned_pages_;
+
+  // Number of rows of the data pages read, skipped or pruned so far, i.e. the first
+  // row of the next page.
+  int64_t next_page_first_row_;
+
+  // Number of levels Skip() still has to skip while it looks for the next page.
+  // ReadNewPage() skips the data pages that are not larger, without decompressing
+  // them, and subtracts their levels.
+  int64_t levels_to_skip_;
+
+  // Scratch space for the levels when ReadBatch() is not passed buffers.
+  std::vector<int16_t> def_levels_scratch_;
+  std::vector<int16_t> rep_levels_scratch_;
+  // Scratch space for the non-null values of a ColumnVector batch.
+  std::vector<uint8_t> values_scratch_;
+  // Copies of the byte arrays of a selection ReadBatch() that were read from
+  // earlier pages than the current one.
+  std::vector<uint8_t> selected_values_buffer_;
 };
 
 
@@ -211,10 +522,16 @@ inline ByteArray ColumnReader::GetByteArray(int* def_level, int* rep_level) {
 }
 
 inline bool ColumnReader::ReadDefinitionRepetitionLevels(int* def_level, int* rep_level) {
-  *rep_level = 1;
-  if (!definition_level_decoder_->Get(def_level)) ParquetException::EofException();
+  *def_level = 0;
+  *rep_level = 0;
+  if (definition_level_decoder_ != NULL && !definition_level_decoder_->Get(def_level)) {
+    ParquetException::EofException();
+  }
+  if (repetition_level_decoder_ != NULL && !repetition_level_decoder_->Get(rep_level)) {
+    ParquetException::EofException();
+  }
   --num_buffered_values_;
-  return *def_level == 0;
+  return *def_level < max_definition_level_;
 }
 
 // Deserialize a thrift message from buf/len.  buf/len must at least contain
@@ -238,6 +555,26 @@ inline void DeserializeThriftMsg(const uint8_t* buf, uint32_t* len, T* deseriali
   *len = *len - bytes_left;
 }
 
+// Serializes 'msg' with the compact protocol and appends the bytes to 'out'.
+template <class T>
+inline void SerializeThriftMsg(const T& msg, OutputStream* out) {
+  boost::shared_ptr<apache::thrift::transport::TMemoryBuffer> tmem_transport(
+      new apache::thrift::transport::TMemoryBuffer());
+  apache::thrift::protocol::TCompactProtocolFactoryT<
+      apache::thrift::transport::TMemoryBuffer> tproto_factory;
+  boost::shared_ptr<apache::thrift::protocol::TProtocol> tproto =
+      tproto_factory.getProtocol(tmem_transport);
+  try {
+    msg.write(tproto.get());
+  } catch (apache::thrift::protocol::TProtocolException& e) {
+    throw ParquetException("Couldn't serialize thrift.", e);
+  }
+  uint8_t* buffer;
+  uint32_t len;
+  tmem_transport->getBuffer(&buffer, &len);
+  out->Write(buffer, len);
+}
+
 }
 
 #endif
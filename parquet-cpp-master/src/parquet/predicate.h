@@ -0,0 +1,145 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_PREDICATE_H
+#define PARQUET_PREDICATE_H
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "parquet/parquet.h"
+
+namespace parquet_cpp {
+
+class BloomFilter;
+class Schema;
+
+// Filter on the rows of a file, used to skip row groups and pages whose statistics
+// show that none of their rows can match. Predicates only prune, they are not
+// evaluated against individual values. For example, rows with 100 <= ts < 200:
+//   shared_ptr<Predicate> p = Predicate::And(
+//       Predicate::Compare(Predicate::GE, ts_column, static_cast<int64_t>(100)),
+//       Predicate::Compare(Predicate::LT, ts_column, static_cast<int64_t>(200)));
+// As in SQL, a comparison never matches a NULL value. Columns are numbered as in
+// ParquetFileReader.
+class Predicate {
+ public:
+  enum Op {
+    EQ,
+    NE,
+    LT,
+    LE,
+    GT,
+    GE,
+    IN,
+    IS_NULL,
+    IS_NOT_NULL,
+    AND,
+    OR
+  };
+
+  // Literal of a comparison. The value is stored with the PLAIN encoding, like the
+  // min and max of parquet::Statistics. Strings can be compared with BYTE_ARRAY and
+  // FIXED_LEN_BYTE_ARRAY columns.
+  class Value {
+   public:
+    Value(bool value);
+    Value(int32_t value);
+    Value(int64_t value);
+    Value(float value);
+    Value(double value);
+    Value(const std::string& value);
+    // Without this, string literals would convert to bool.
+    Value(const char* value);
+
+    parquet::Type::type type() const { return type_; }
+    const std::string& encoded() const { return encoded_; }
+
+   private:
+    parquet::Type::type type_;
+    std::string encoded_;
+  };
+
+  // Comparison of 'column' with 'value', 'op' must be one of EQ to GE.
+  static boost::shared_ptr<Predicate> Compare(Op op, int column, const Value& value);
+  // Matches the values of 'column' that are equal to one of 'values'.
+  static boost::shared_ptr<Predicate> In(int column, const std::vector<Value>& values);
+  static boost::shared_ptr<Predicate> IsNull(int column);
+  static boost::shared_ptr<Predicate> IsNotNull(int column);
+  static boost::shared_ptr<Predicate> And(boost::shared_ptr<Predicate> left,
+      boost::shared_ptr<Predicate> right);
+  static boost::shared_ptr<Predicate> Or(boost::shared_ptr<Predicate> left,
+      boost::shared_ptr<Predicate> right);
+
+  Op op() const { return op_; }
+
+  // Throws ParquetException if a column is out of range for 'schema' or a value
+  // cannot be compared with its column.
+  void Validate(const Schema& schema) const;
+
+  // Returns false if no row summarized by 'stats' can match. 'stats' contains the
+  // statistics of each column of a row group or page, indexed by column; columns
+  // past its end or with a NULL entry are unknown and can match anything.
+  // The deprecated min and max are only used for byte arrays, which have
+  // min_value and max_value instead, if 'use_deprecated_byte_array_min_max' is true
+  // (see CanUseDeprecatedByteArrayMinMax()).
+  bool CanMatch(const std::vector<const parquet::Statistics*>& stats,
+      bool use_deprecated_byte_array_min_max) const;
+
+  // Returns true if the writer 'created_by' (FileMetaData.created_by) is known to
+  // order the deprecated min and max of byte arrays by unsigned bytes. Others, e.g.
+  // older parquet-mr versions (PARQUET-686), ordered them by signed bytes, so
+  // pruning with them would drop matching rows.
+  static bool CanUseDeprecatedByteArrayMinMax(const std::string& created_by);
+
+  // Returns false if the Bloom filters show that none of the values of an EQ or IN
+  // comparison are in its column. 'filters' is indexed by column like 'stats' above.
+  bool CanMatchBloomFilters(const std::vector<const BloomFilter*>& filters) const;
+
+  // Adds the columns of the EQ and IN comparisons, the only ones that use Bloom
+  // filters, to 'columns'. A column can be added more than once.
+  void GetBloomFilterColumns(std::vector<int>* columns) const;
+
+  // Returns false if no row of data page 'page' of 'column' can match, according to
+  // the page index 'column_index' of that column. Comparisons on other columns can
+  // match anything.
+  bool CanMatchPage(int column, const parquet::ColumnIndex& column_index,
+      int page) const;
+
+ private:
+  Predicate(Op op, int column) : op_(op), column_(column) {}
+
+  // Returns true if a comparison with 'value' can match a value in [min, max].
+  bool CanMatchValue(const Value& value, const std::string& min,
+      const std::string& max) const;
+
+  // Returns false if no value summarized by 'stats' can match this comparison.
+  bool CanMatchStatistics(const parquet::Statistics& stats,
+      bool use_deprecated_byte_array_min_max) const;
+
+  const Op op_;
+  // Not used for AND and OR.
+  const int column_;
+  // The literals of comparisons. IN has any number of values, the other
+  // comparisons exactly one.
+  std::vector<Value> values_;
+  // The operands of AND and OR.
+  std::vector<boost::shared_ptr<Predicate> > children_;
+};
+
+}
+
+#endif
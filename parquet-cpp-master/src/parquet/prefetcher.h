@@ -0,0 +1,124 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_PREFETCHER_H
+#define PARQUET_PREFETCHER_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "parquet/file-reader.h"
+
+namespace parquet_cpp {
+
+// Reads the column chunks of a scan ahead of their readers. The byte range of
+// every chunk is known from the footer, so the ranges are sorted and ranges that
+// are close to each other are merged into large reads, which are issued in order
+// by a background thread. The memory of the buffered reads is bounded; the
+// thread waits for the readers to release data before it reads further.
+//   ColumnChunkPrefetcher prefetcher(&reader, chunks, Options::DefaultOptions());
+//   shared_ptr<ColumnReader> column_reader = reader.GetColumnReader(row_group,
+//       column, prefetcher.GetStream(row_group, column));
+class ColumnChunkPrefetcher {
+ public:
+  struct Options {
+    // Ranges separated by at most this many bytes are read together; the bytes in
+    // between are read and discarded.
+    int64_t max_hole_size;
+    // Merged ranges are not grown past this size. A single chunk can be larger.
+    int64_t max_read_size;
+    // Maximum number of bytes buffered and not released by the readers yet. A read
+    // larger than this is still issued once nothing else is buffered. The limit is
+    // exceeded when a reader would otherwise wait for a chunk that is not read.
+    int64_t memory_limit;
+
+    static Options DefaultOptions() {
+      Options options;
+      options.max_hole_size = 1024 * 1024;
+      options.max_read_size = 64 * 1024 * 1024;
+      options.memory_limit = 256 * 1024 * 1024;
+      return options;
+    }
+  };
+
+  // Prefetches 'chunks', a list of (row group, column) pairs, from the file read by
+  // 'reader', which must outlive the prefetcher. The chunks should be listed in
+  // the order in which they are going to be read. The background thread is
+  // started right away.
+  ColumnChunkPrefetcher(ParquetFileReader* reader,
+      const std::vector<std::pair<int, int> >& chunks, const Options& options);
+
+  // Stops the background thread. Streams returned by GetStream() remain valid.
+  ~ColumnChunkPrefetcher();
+
+  // Returns a stream over the column chunk, which must be one of the prefetched
+  // chunks. Blocks until the chunk has been read. The buffered bytes are released
+  // once the streams of all the chunks that were read together are destroyed, so
+  // every chunk should be requested. Throws ParquetException if the read failed.
+  // This can be called from several threads.
+  boost::shared_ptr<InputStream> GetStream(int row_group, int column);
+
+ private:
+  class Buffer;
+  class MemoryBudget;
+
+  // One read of the background thread.
+  struct Range {
+    int64_t offset;
+    int64_t length;
+    // Chunks of the range that were not requested with GetStream() yet.
+    int num_pending_chunks;
+    // Set once the range is read. Released when num_pending_chunks drops to 0; the
+    // streams keep the buffer alive.
+    boost::shared_ptr<Buffer> buffer;
+    bool done;
+  };
+
+  struct Chunk {
+    int range;
+    // Offset of the chunk in the range.
+    int64_t offset;
+    int64_t length;
+    bool requested;
+  };
+
+  // Main loop of the background thread.
+  void ReadLoop();
+
+  ParquetFileReader* reader_;
+  const Options options_;
+  boost::shared_ptr<MemoryBudget> budget_;
+
+  boost::mutex lock_;
+  // Signaled when a range is read or the read failed.
+  boost::condition_variable range_read_cv_;
+  // The following are protected by lock_.
+  std::vector<Range> ranges_;
+  std::map<std::pair<int, int>, Chunk> chunks_;
+  // Set if a read failed. GetStream() throws it.
+  std::string error_;
+
+  boost::thread read_thread_;
+};
+
+}
+
+#endif
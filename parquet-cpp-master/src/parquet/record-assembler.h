@@ -0,0 +1,85 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_RECORD_ASSEMBLER_H
+#define PARQUET_RECORD_ASSEMBLER_H
+
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include "parquet/schema.h"
+
+namespace parquet_cpp {
+
+// Rebuilds the nesting of a column from its definition and repetition levels, as
+// described in the Dremel paper. Instead of materializing records, the structure
+// is appended to flat arrays, one layer per node on the path from the top level
+// field down to the leaf:
+//  - Each layer has a number of slots. Layer 0 has one slot per record. A repeated
+//    node has one slot per list element, any other node one slot per slot of the
+//    layer above.
+//  - A repeated node has 'offsets': the elements of the list in slot i of the layer
+//    above are slots offsets[i] to offsets[i + 1] of this layer.
+//  - Optional nodes and the leaf have 'valid', one entry per slot, which is 0 if
+//    the slot is null (or an ancestor is). The valid leaf slots are the values
+//    returned by ColumnReader::ReadBatch(), in order.
+// For example, for 'optional group a { repeated int32 b; }' with the records
+// {a: {b: [1, 2]}}, {a: null}, {a: {b: []}}:
+//   layer 0 (a): valid = [1, 0, 1]
+//   layer 1 (b): offsets = [0, 2, 2, 2], valid = [1, 1]
+// Usage:
+//   RecordAssembler assembler(reader->schema().column(i));
+//   while (column_reader->HasNext()) {
+//     int n = column_reader->ReadBatch(size, def, rep, values, &values_read);
+//     assembler.Append(def, rep, n);
+//   }
+class RecordAssembler {
+ public:
+  struct Layer {
+    const SchemaNode* node;
+    // Only set for repeated nodes. Starts with 0.
+    std::vector<int32_t> offsets;
+    // Only set for optional nodes and the leaf.
+    std::vector<uint8_t> valid;
+  };
+
+  // 'column' is the leaf node of the column and must outlive the assembler.
+  explicit RecordAssembler(const SchemaNode* column);
+
+  // Appends 'num_levels' levels. 'def_levels' can be NULL if the maximum definition
+  // level is 0, 'rep_levels' if the maximum repetition level is 0.
+  // Throws ParquetException if the levels are not valid for the column.
+  void Append(const int16_t* def_levels, const int16_t* rep_levels, int num_levels);
+
+  // Number of records started so far. The last record may be continued by the next
+  // call to Append(), unless the column chunk is exhausted.
+  int64_t num_records() const { return num_records_; }
+
+  int num_layers() const { return layers_.size(); }
+  const Layer& layer(int i) const { return layers_[i]; }
+
+  // Removes all the assembled records. The next level must start a new record, so
+  // this should only be called between column chunks or once a record is known to
+  // be complete.
+  void Clear();
+
+ private:
+  const SchemaNode* column_;
+  std::vector<Layer> layers_;
+  int64_t num_records_;
+};
+
+}
+
+#endif
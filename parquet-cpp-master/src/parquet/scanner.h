@@ -0,0 +1,156 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_SCANNER_H
+#define PARQUET_SCANNER_H
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "parquet/file-reader.h"
+#include "parquet/prefetcher.h"
+
+namespace parquet_cpp {
+
+// All the levels and values of one column chunk.
+struct ColumnChunkData {
+  // Index of the column in the file.
+  int column;
+  parquet::Type::type type;
+  int64_t num_levels;
+  int64_t num_values;
+  // Only filled if the maximum definition (resp. repetition) level of the column
+  // is not 0, otherwise all the levels are 0.
+  std::vector<int16_t> def_levels;
+  std::vector<int16_t> rep_levels;
+  // The non-null values, as for ColumnReader::ReadBatch(). The buffer holds values
+  // of the C++ type of the column (bool, int32_t, int64_t, float, double or
+  // ByteArray), use data<T>() to access them.
+  std::vector<uint8_t> values;
+  // The bytes the ByteArray values point to.
+  std::vector<uint8_t> byte_array_data;
+
+  template <typename T>
+  const T* data() const {
+    return values.empty() ? NULL : reinterpret_cast<const T*>(&values[0]);
+  }
+};
+
+// The projected columns of a row group.
+struct RowGroupData {
+  int row_group;
+  int64_t num_rows;
+  // In the order of the projection.
+  std::vector<ColumnChunkData> columns;
+};
+
+// Scans the projected columns of a file with a pool of threads. Every column chunk
+// is read, decompressed and decoded by a worker thread, so the chunks of a row
+// group and the following row groups are decoded concurrently, while the consumer
+// processes the row groups that are ready. Row groups are returned in file order.
+//   ParquetScanner scanner(&reader, columns, ParquetScanner::Options::DefaultOptions());
+//   while (shared_ptr<RowGroupData> data = scanner.Next()) { ... }
+class ParquetScanner {
+ public:
+  struct Options {
+    int num_threads;
+    // Maximum number of row groups decoded ahead of the consumer. This bounds the
+    // memory used to about this many decoded row groups.
+    int max_row_groups_in_flight;
+    // Levels decoded per ColumnReader::ReadBatch() call.
+    int batch_size;
+    // If set, the row groups whose statistics rule out a match are skipped.
+    boost::shared_ptr<const Predicate> predicate;
+    // If true, the column chunks are read ahead with a ColumnChunkPrefetcher.
+    bool read_ahead;
+    ColumnChunkPrefetcher::Options read_ahead_options;
+
+    static Options DefaultOptions() {
+      Options options;
+      options.num_threads = ::std::max(1U, boost::thread::hardware_concurrency());
+      options.max_row_groups_in_flight = 4;
+      options.batch_size = 1024;
+      options.read_ahead = false;
+      options.read_ahead_options = ColumnChunkPrefetcher::Options::DefaultOptions();
+      return options;
+    }
+  };
+
+  // Scans 'columns' of the file read by 'reader', which must outlive the scanner.
+  // The threads are started right away.
+  ParquetScanner(ParquetFileReader* reader, const std::vector<int>& columns,
+      const Options& options);
+
+  // Stops the threads. Row groups returned by Next() remain valid.
+  ~ParquetScanner();
+
+  // Returns the next row group, or NULL after the last one. Blocks until the row
+  // group is decoded. Throws ParquetException if a column chunk could not be read.
+  boost::shared_ptr<RowGroupData> Next();
+
+ private:
+  // Main loop of the worker threads.
+  void WorkerLoop();
+
+  // Reads column 'column' of 'row_group' into 'data'.
+  void DecodeColumnChunk(int row_group, int column, ColumnChunkData* data);
+
+  // Reads all the levels and values of 'reader' into 'data'. 'num_levels_hint' is
+  // the number of levels in the chunk metadata.
+  template <typename T>
+  void DecodeValues(ColumnReader* reader, int64_t num_levels_hint,
+      ColumnChunkData* data);
+
+  ParquetFileReader* reader_;
+  const std::vector<int> columns_;
+  const Options options_;
+  // The row groups to scan, in file order.
+  std::vector<int> row_groups_;
+
+  boost::mutex lock_;
+  // Signaled when a row group is complete or the scanner fails.
+  boost::condition_variable row_group_done_cv_;
+  // Signaled when the consumer takes a row group, which lets the workers start on
+  // the next ones.
+  boost::condition_variable row_group_taken_cv_;
+
+  // The following are protected by lock_.
+  // Column chunks are numbered row group by row group; this is the next one to
+  // decode.
+  int64_t next_task_;
+  // Index in row_groups_ of the next row group returned by Next().
+  int next_row_group_;
+  // Row groups being decoded, keyed by index in row_groups_, with the number of
+  // column chunks that are not done yet.
+  std::map<int, std::pair<boost::shared_ptr<RowGroupData>, int> > in_flight_;
+  // Set if a worker failed. Next() throws it.
+  std::string error_;
+  bool cancelled_;
+
+  // Only set if options_.read_ahead is true. Destroyed after the workers stopped.
+  boost::scoped_ptr<ColumnChunkPrefetcher> prefetcher_;
+  boost::thread_group workers_;
+};
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_SCHEMA_H
+#define PARQUET_SCHEMA_H
+
+#include <string>
+#include <vector>
+
+#include "parquet/parquet.h"
+
+namespace parquet_cpp {
+
+// Node of the schema tree. Each node corresponds to one SchemaElement of the
+// file metadata.
+class SchemaNode {
+ public:
+  const parquet::SchemaElement& element() const { return *element_; }
+  const std::string& name() const { return element_->name; }
+
+  // Returns NULL for the root.
+  const SchemaNode* parent() const { return parent_; }
+  int num_children() const { return children_.size(); }
+  const SchemaNode* child(int i) const { return children_[i]; }
+
+  bool is_root() const { return parent_ == NULL; }
+  bool is_leaf() const { return children_.empty() && !is_root(); }
+  bool is_repeated() const {
+    return !is_root() &&
+        element_->repetition_type == parquet::FieldRepetitionType::REPEATED;
+  }
+  bool is_optional() const {
+    return !is_root() &&
+        element_->repetition_type == parquet::FieldRepetitionType::OPTIONAL;
+  }
+
+  // The definition level of a value at this node is at least max_definition_level()
+  // if this node is defined, i.e. it counts the optional and repeated nodes from
+  // the root down to and including this node. Likewise max_repetition_level()
+  // counts the repeated nodes.
+  int max_definition_level() const { return max_definition_level_; }
+  int max_repetition_level() const { return max_repetition_level_; }
+
+  // Index of the column for leaves, -1 otherwise.
+  int column_index() const { return column_index_; }
+
+  // Returns the dot separated path of the node, excluding the root.
+  std::string path() const;
+
+ private:
+  friend class Schema;
+
+  SchemaNode()
+    : element_(NULL), parent_(NULL), max_definition_level_(0),
+      max_repetition_level_(0), column_index_(-1) {}
+
+  const parquet::SchemaElement* element_;
+  const SchemaNode* parent_;
+  std::vector<const SchemaNode*> children_;
+  int max_definition_level_;
+  int max_repetition_level_;
+  int column_index_;
+};
+
+// Schema tree of a file. The metadata stores the schema as a depth first
+// traversal of the tree, starting with the root; groups have num_children set.
+// Columns are numbered by their position among the leaves.
+class Schema {
+ public:
+  // Builds the tree for 'elements'. The schema references the elements, which must
+  // outlive it. Throws ParquetException if the elements are not a valid tree.
+  explicit Schema(const std::vector<parquet::SchemaElement>& elements);
+
+  const SchemaNode* root() const { return &nodes_[0]; }
+
+  int num_columns() const { return columns_.size(); }
+  const SchemaNode* column(int i) const { return columns_[i]; }
+
+  // Returns true if no column is nested or repeated.
+  bool is_flat() const;
+
+ private:
+  // Builds the subtree of the element at nodes_[*idx], with parent 'parent'.
+  // *idx is advanced past the subtree.
+  void BuildTree(SchemaNode* parent, int* idx);
+
+  // The nodes reference each other, so the schema is not copyable.
+  Schema(const Schema&);
+  Schema& operator=(const Schema&);
+
+  const std::vector<parquet::SchemaElement>& elements_;
+  // One node per element, in the same order.
+  std::vector<SchemaNode> nodes_;
+  std::vector<const SchemaNode*> columns_;
+};
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_STATISTICS_H
+#define PARQUET_STATISTICS_H
+
+#include <string>
+#include <boost/cstdint.hpp>
+
+#include "parquet/parquet.h"
+
+namespace parquet_cpp {
+
+// Accumulates the min, max and null count of the values of a column. In the
+// thrift Statistics, min_value and max_value, as well as the deprecated min and
+// max, are stored with the PLAIN encoding of the value (without the length prefix
+// for byte arrays). Byte arrays are compared as unsigned bytes and NaNs are ignored.
+class ColumnStatistics {
+ public:
+  explicit ColumnStatistics(const parquet::Type::type& type);
+
+  // Updates the min and max with 'num_values' non-null values.
+  void Update(const bool* values, int num_values);
+  void Update(const int32_t* values, int num_values);
+  void Update(const int64_t* values, int num_values);
+  void Update(const float* values, int num_values);
+  void Update(const double* values, int num_values);
+  void Update(const ByteArray* values, int num_values);
+
+  void IncrementNullCount(int64_t num_nulls) { null_count_ += num_nulls; }
+
+  // Adds the values summarized by 'other', which must be for the same type.
+  void Merge(const ColumnStatistics& other);
+
+  void Reset();
+
+  bool has_min_max() const { return has_min_max_; }
+  int64_t null_count() const { return null_count_; }
+
+  parquet::Statistics ToThrift() const;
+
+ private:
+  template <typename T>
+  void UpdateInternal(const T* values, int num_values, T* min, T* max);
+
+  const parquet::Type::type type_;
+  bool has_min_max_;
+  int64_t null_count_;
+
+  // Only the member for type_ is used. Byte arrays are stored in min_bytes_ and
+  // max_bytes_.
+  union Value {
+    bool bool_val;
+    int32_t int32_val;
+    int64_t int64_val;
+    float float_val;
+    double double_val;
+  };
+  Value min_;
+  Value max_;
+  std::string min_bytes_;
+  std::string max_bytes_;
+};
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "parquet/predicate.h"
+#include "parquet/statistics.h"
+#include "util/test-util.h"
+
+using namespace parquet;
+using namespace parquet_cpp;
+using namespace std;
+
+typedef Predicate P;
+
+// Byte arrays are only pruned with the deprecated min and max if the writer is
+// known to order them by unsigned bytes.
+static void TestDeprecatedByteArrayMinMax() {
+  // Ordered by signed bytes, as older parquet-mr versions did for "a" and "\xe9t\xe9":
+  // every string between them, e.g. "b", can be in the column chunk.
+  Statistics stats;
+  stats.__set_min("\xe9t\xe9");
+  stats.__set_max("a");
+  vector<const Statistics*> column_stats(1, &stats);
+  PARQUET_CHECK(P::Compare(P::EQ, 0, "b")->CanMatch(column_stats, false));
+  PARQUET_CHECK(P::Compare(P::GT, 0, "a")->CanMatch(column_stats, false));
+  // If the writer is trusted, they are used as they are.
+  PARQUET_CHECK(!P::Compare(P::EQ, 0, "b")->CanMatch(column_stats, true));
+
+  // min_value and max_value are always ordered by unsigned bytes.
+  stats.__set_min_value("a");
+  stats.__set_max_value("\xe9t\xe9");
+  PARQUET_CHECK(P::Compare(P::EQ, 0, "b")->CanMatch(column_stats, false));
+  PARQUET_CHECK(!P::Compare(P::LT, 0, "a")->CanMatch(column_stats, false));
+  PARQUET_CHECK(!P::Compare(P::GT, 0, "\xe9t\xe9")->CanMatch(column_stats, false));
+
+  PARQUET_CHECK(P::CanUseDeprecatedByteArrayMinMax("parquet-cpp"));
+  PARQUET_CHECK(!P::CanUseDeprecatedByteArrayMinMax(
+      "parquet-mr version 1.8.1 (build 4aba4dae7bb0d4edbcf7923ae1339f28fd3f7fcf)"));
+  PARQUET_CHECK(!P::CanUseDeprecatedByteArrayMinMax(""));
+}
+
+// The deprecated min and max of the other types are ordered correctly by all
+// writers.
+static void TestDeprecatedMinMax() {
+  ColumnStatistics column_stats(Type::INT64);
+  int64_t values[] = { 100, 150, 199 };
+  column_stats.Update(values, 3);
+  Statistics stats = column_stats.ToThrift();
+  stats.__isset.min_value = false;
+  stats.__isset.max_value = false;
+  vector<const Statistics*> stats_vector(1, &stats);
+  PARQUET_CHECK(P::Compare(P::EQ, 0, static_cast<int64_t>(150))->CanMatch(
+      stats_vector, false));
+  PARQUET_CHECK(!P::Compare(P::GE, 0, static_cast<int64_t>(200))->CanMatch(
+      stats_vector, false));
+}
+
+// The statistics of ParquetFileWriter have both min_value and max_value and the
+// deprecated min and max.
+static void TestColumnStatistics() {
+  ColumnStatistics column_stats(Type::BYTE_ARRAY);
+  ByteArray values[2];
+  values[0].ptr = reinterpret_cast<const uint8_t*>("a");
+  values[0].len = 1;
+  values[1].ptr = reinterpret_cast<const uint8_t*>("\xe9t\xe9");
+  values[1].len = 3;
+  column_stats.Update(values, 2);
+  Statistics stats = column_stats.ToThrift();
+  PARQUET_CHECK(stats.__isset.min_value && stats.__isset.max_value);
+  PARQUET_CHECK_EQ(stats.min_value, "a");
+  PARQUET_CHECK_EQ(stats.max_value, "\xe9t\xe9");
+  PARQUET_CHECK_EQ(stats.min, stats.min_value);
+  PARQUET_CHECK_EQ(stats.max, stats.max_value);
+}
+
+int main(int argc, char** argv) {
+  TestDeprecatedByteArrayMinMax();
+  TestDeprecatedMinMax();
+  TestColumnStatistics();
+  return 0;
+}
@@ -0,0 +1,339 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parquet/predicate.h"
+
+#include <string.h>
+#include <sstream>
+
+#include "parquet/bloom-filter.h"
+#include "parquet/schema.h"
+
+using namespace boost;
+using namespace parquet;
+using namespace std;
+
+namespace parquet_cpp {
+
+static string EncodeValue(const void* value, int len) {
+  return string(reinterpret_cast<const char*>(value), len);
+}
+
+Predicate::Value::Value(bool value) : type_(Type::BOOLEAN) {
+  uint8_t byte = value;
+  encoded_ = EncodeValue(&byte, 1);
+}
+
+Predicate::Value::Value(int32_t value)
+  : type_(Type::INT32), encoded_(EncodeValue(&value, sizeof(value))) {
+}
+
+Predicate::Value::Value(int64_t value)
+  : type_(Type::INT64), encoded_(EncodeValue(&value, sizeof(value))) {
+}
+
+Predicate::Value::Value(float value)
+  : type_(Type::FLOAT), encoded_(EncodeValue(&value, sizeof(value))) {
+}
+
+Predicate::Value::Value(double value)
+  : type_(Type::DOUBLE), encoded_(EncodeValue(&value, sizeof(value))) {
+}
+
+Predicate::Value::Value(const string& value)
+  : type_(Type::BYTE_ARRAY), encoded_(value) {
+}
+
+Predicate::Value::Value(const char* value)
+  : type_(Type::BYTE_ARRAY), encoded_(value) {
+}
+
+shared_ptr<Predicate> Predicate::Compare(Op op, int column, const Value& value) {
+  if (op < EQ || op > GE) {
+    throw ParquetException("Predicate::Compare() requires a comparison operator.");
+  }
+  shared_ptr<Predicate> predicate(new Predicate(op, column));
+  predicate->values_.push_back(value);
+  return predicate;
+}
+
+shared_ptr<Predicate> Predicate::In(int column, const vector<Value>& values) {
+  shared_ptr<Predicate> predicate(new Predicate(IN, column));
+  predicate->values_ = values;
+  return predicate;
+}
+
+shared_ptr<Predicate> Predicate::IsNull(int column) {
+  return shared_ptr<Predicate>(new Predicate(IS_NULL, column));
+}
+
+shared_ptr<Predicate> Predicate::IsNotNull(int column) {
+  return shared_ptr<Predicate>(new Predicate(IS_NOT_NULL, column));
+}
+
+shared_ptr<Predicate> Predicate::And(shared_ptr<Predicate> left,
+    shared_ptr<Predicate> right) {
+  shared_ptr<Predicate> predicate(new Predicate(AND, -1));
+  predicate->children_.push_back(left);
+  predicate->children_.push_back(right);
+  return predicate;
+}
+
+shared_ptr<Predicate> Predicate::Or(shared_ptr<Predicate> left,
+    shared_ptr<Predicate> right) {
+  shared_ptr<Predicate> predicate(new Predicate(OR, -1));
+  predicate->children_.push_back(left);
+  predicate->children_.push_back(right);
+  return predicate;
+}
+
+void Predicate::Validate(const Schema& schema) const {
+  if (op_ == AND || op_ == OR) {
+    for (int i = 0; i < children_.size(); ++i) children_[i]->Validate(schema);
+    return;
+  }
+  if (column_ < 0 || column_ >= schema.num_columns()) {
+    stringstream ss;
+    ss << "Predicate column " << column_ << " out of range.";
+    throw ParquetException(ss.str());
+  }
+  Type::type type = schema.column(column_)->element().type;
+  for (int i = 0; i < values_.size(); ++i) {
+    Type::type value_type = values_[i].type();
+    if (value_type == type) continue;
+    if (value_type == Type::BYTE_ARRAY && type == Type::FIXED_LEN_BYTE_ARRAY) continue;
+    stringstream ss;
+    ss << "Predicate value of type " << value_type << " cannot be compared with "
+       << "column " << schema.column(column_)->path() << " of type " << type;
+    throw ParquetException(ss.str());
+  }
+}
+
+template <typename T>
+static int CompareFixed(const string& x, const string& y) {
+  T x_val, y_val;
+  memcpy(&x_val, x.data(), sizeof(T));
+  memcpy(&y_val, y.data(), sizeof(T));
+  // NaNs compare equal to everything, which keeps them from pruning anything.
+  if (x_val < y_val) return -1;
+  if (x_val > y_val) return 1;
+  return 0;
+}
+
+// Compares PLAIN encoded values. Byte arrays are compared as unsigned bytes, like
+// ColumnStatistics does. Returns false if the values do not have the size of 'type'.
+static bool CompareValues(const Type::type& type, const string& x, const string& y,
+    int* cmp) {
+  switch (type) {
+    case Type::BOOLEAN:
+      if (x.size() != 1 || y.size() != 1) return false;
+      *cmp = CompareFixed<uint8_t>(x, y);
+      return true;
+    case Type::INT32:
+      if (x.size() != sizeof(int32_t) || y.size() != sizeof(int32_t)) return false;
+      *cmp = CompareFixed<int32_t>(x, y);
+      return true;
+    case Type::INT64:
+      if (x.size() != sizeof(int64_t) || y.size() != sizeof(int64_t)) return false;
+      *cmp = CompareFixed<int64_t>(x, y);
+      return true;
+    case Type::FLOAT:
+      if (x.size() != sizeof(float) || y.size() != sizeof(float)) return false;
+      *cmp = CompareFixed<float>(x, y);
+      return true;
+    case Type::DOUBLE:
+      if (x.size() != sizeof(double) || y.size() != sizeof(double)) return false;
+      *cmp = CompareFixed<double>(x, y);
+      return true;
+    case Type::BYTE_ARRAY: {
+      int c = memcmp(x.data(), y.data(), ::min(x.size(), y.size()));
+      *cmp = c != 0 ? c : static_cast<int>(x.size()) - static_cast<int>(y.size());
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+bool Predicate::CanMatchValue(const Value& value, const string& min,
+    const string& max) const {
+  int cmp_min, cmp_max;
+  if (!CompareValues(value.type(), value.encoded(), min, &cmp_min) ||
+      !CompareValues(value.type(), value.encoded(), max, &cmp_max)) {
+    // The statistics are not usable for this value.
+    return true;
+  }
+  switch (op_) {
+    case EQ:
+    case IN:
+      return cmp_min >= 0 && cmp_max <= 0;
+    case NE:
+      return cmp_min != 0 || cmp_max != 0;
+    case LT:
+      return cmp_min > 0;
+    case LE:
+      return cmp_min >= 0;
+    case GT:
+      return cmp_max < 0;
+    case GE:
+      return cmp_max <= 0;
+    default:
+      return true;
+  }
+}
+
+bool Predicate::CanMatch(const vector<const Statistics*>& stats,
+    bool use_deprecated_byte_array_min_max) const {
+  switch (op_) {
+    case AND:
+      for (int i = 0; i < children_.size(); ++i) {
+        if (!children_[i]->CanMatch(stats, use_deprecated_byte_array_min_max)) {
+          return false;
+        }
+      }
+      return true;
+    case OR:
+      for (int i = 0; i < children_.size(); ++i) {
+        if (children_[i]->CanMatch(stats, use_deprecated_byte_array_min_max)) {
+          return true;
+        }
+      }
+      return false;
+    default:
+      break;
+  }
+
+  const Statistics* column_stats = column_ < stats.size() ? stats[column_] : NULL;
+  if (column_stats == NULL) return true;
+  return CanMatchStatistics(*column_stats, use_deprecated_byte_array_min_max);
+}
+
+bool Predicate::CanUseDeprecatedByteArrayMinMax(const string& created_by) {
+  // ParquetFileWriter, whose min and max come from ColumnStatistics.
+  return created_by == "parquet-cpp";
+}
+
+bool Predicate::CanMatchStatistics(const Statistics& stats,
+    bool use_deprecated_byte_array_min_max) const {
+  switch (op_) {
+    case IS_NULL:
+      return !stats.__isset.null_count || stats.null_count > 0;
+    case IS_NOT_NULL:
+      // The statistics do not have the number of values, so we cannot tell if they
+      // are all NULL.
+      return true;
+    default:
+      break;
+  }
+  const string* min;
+  const string* max;
+  if (stats.__isset.min_value && stats.__isset.max_value) {
+    min = &stats.min_value;
+    max = &stats.max_value;
+  } else if (stats.__isset.min && stats.__isset.max) {
+    // Byte arrays may have been ordered by signed bytes, unlike CompareValues().
+    if (!values_.empty() && values_[0].type() == Type::BYTE_ARRAY &&
+        !use_deprecated_byte_array_min_max) {
+      return true;
+    }
+    min = &stats.min;
+    max = &stats.max;
+  } else {
+    // Without min and max, e.g. if all the values are NULL, nothing can be pruned.
+    return true;
+  }
+  for (int i = 0; i < values_.size(); ++i) {
+    if (CanMatchValue(values_[i], *min, *max)) return true;
+  }
+  return false;
+}
+
+bool Predicate::CanMatchBloomFilters(const vector<const BloomFilter*>& filters) const {
+  switch (op_) {
+    case AND:
+      for (int i = 0; i < children_.size(); ++i) {
+        if (!children_[i]->CanMatchBloomFilters(filters)) return false;
+      }
+      return true;
+    case OR:
+      for (int i = 0; i < children_.size(); ++i) {
+        if (children_[i]->CanMatchBloomFilters(filters)) return true;
+      }
+      return false;
+    case EQ:
+    case IN:
+      break;
+    default:
+      return true;
+  }
+
+  const BloomFilter* filter = column_ < filters.size() ? filters[column_] : NULL;
+  if (filter == NULL) return true;
+  // The literals are PLAIN encoded, which is what the filter hashes. Filters are not
+  // written for the other types.
+  for (int i = 0; i < values_.size(); ++i) {
+    Type::type type = values_[i].type();
+    if (type != Type::INT32 && type != Type::INT64 && type != Type::BYTE_ARRAY) {
+      return true;
+    }
+    const string& encoded = values_[i].encoded();
+    uint64_t hash = BloomFilter::Hash(
+        reinterpret_cast<const uint8_t*>(encoded.data()), encoded.size());
+    if (filter->Find(hash)) return true;
+  }
+  return false;
+}
+
+void Predicate::GetBloomFilterColumns(vector<int>* columns) const {
+  if (op_ == EQ || op_ == IN) {
+    columns->push_back(column_);
+    return;
+  }
+  for (int i = 0; i < children_.size(); ++i) {
+    children_[i]->GetBloomFilterColumns(columns);
+  }
+}
+
+bool Predicate::CanMatchPage(int column, const ColumnIndex& column_index,
+    int page) const {
+  switch (op_) {
+    case AND:
+      for (int i = 0; i < children_.size(); ++i) {
+        if (!children_[i]->CanMatchPage(column, column_index, page)) return false;
+      }
+      return true;
+    case OR:
+      for (int i = 0; i < children_.size(); ++i) {
+        if (children_[i]->CanMatchPage(column, column_index, page)) return true;
+      }
+      return false;
+    default:
+      break;
+  }
+  if (column_ != column) return true;
+
+  // Only IS_NULL can match a page without any non-null value.
+  if (column_index.null_pages[page]) return op_ == IS_NULL;
+  Statistics stats;
+  if (column_index.__isset.null_counts) {
+    stats.__set_null_count(column_index.null_counts[page]);
+  }
+  // The page index was added to the format after the ordering of byte arrays was
+  // fixed, its min and max are ordered like min_value and max_value.
+  stats.__set_min_value(column_index.min_values[page]);
+  stats.__set_max_value(column_index.max_values[page]);
+  return CanMatchStatistics(stats, false);
+}
+
+}
@@ -0,0 +1,237 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parquet/prefetcher.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+
+using namespace boost;
+using namespace parquet;
+using namespace std;
+
+namespace parquet_cpp {
+
+// Accounts for the buffered bytes. Buffers can outlive the prefetcher, so this is
+// shared between them.
+class ColumnChunkPrefetcher::MemoryBudget {
+ public:
+  explicit MemoryBudget(int64_t limit)
+    : limit_(limit), used_(0), num_waiters_(0), cancelled_(false) {}
+
+  // Waits until 'num_bytes' fit in the budget, or until nothing else is used if
+  // 'num_bytes' exceeds it. The limit is ignored while a reader waits for a range:
+  // the buffers that use the budget may belong to chunks that are only requested
+  // after that one. Returns false if Cancel() was called.
+  bool Acquire(int64_t num_bytes) {
+    mutex::scoped_lock l(lock_);
+    while (!cancelled_ && num_waiters_ == 0 && used_ > 0 && used_ + num_bytes > limit_) {
+      released_cv_.wait(l);
+    }
+    if (cancelled_) return false;
+    used_ += num_bytes;
+    return true;
+  }
+
+  void AddWaiter() {
+    {
+      mutex::scoped_lock l(lock_);
+      ++num_waiters_;
+    }
+    released_cv_.notify_all();
+  }
+
+  void RemoveWaiter() {
+    mutex::scoped_lock l(lock_);
+    --num_waiters_;
+  }
+
+  void Release(int64_t num_bytes) {
+    {
+      mutex::scoped_lock l(lock_);
+      used_ -= num_bytes;
+    }
+    released_cv_.notify_all();
+  }
+
+  void Cancel() {
+    {
+      mutex::scoped_lock l(lock_);
+      cancelled_ = true;
+    }
+    released_cv_.notify_all();
+  }
+
+ private:
+  const int64_t limit_;
+  mutex lock_;
+  condition_variable released_cv_;
+  int64_t used_;
+  int num_waiters_;
+  bool cancelled_;
+};
+
+// The bytes of a range. The memory is returned to the budget when the buffer is
+// destroyed.
+class ColumnChunkPrefetcher::Buffer {
+ public:
+  Buffer(shared_ptr<MemoryBudget> budget, int64_t size)
+    : budget_(budget), data_(size) {}
+  ~Buffer() { budget_->Release(data_.size()); }
+
+  uint8_t* data() { return data_.empty() ? NULL : &data_[0]; }
+
+ private:
+  shared_ptr<MemoryBudget> budget_;
+  std::vector<uint8_t> data_;
+};
+
+// Orders chunks by file offset.
+struct ChunkOffsetLess {
+  explicit ChunkOffsetLess(const vector<pair<int64_t, int64_t> >* ranges)
+    : ranges_(ranges) {}
+  bool operator()(int x, int y) const {
+    return (*ranges_)[x].first < (*ranges_)[y].first;
+  }
+  const vector<pair<int64_t, int64_t> >* ranges_;
+};
+
+ColumnChunkPrefetcher::ColumnChunkPrefetcher(ParquetFileReader* reader,
+    const vector<pair<int, int> >& chunks, const Options& options)
+  : reader_(reader),
+    options_(options),
+    budget_(new MemoryBudget(options.memory_limit)) {
+  // Byte range of each chunk, and the chunks sorted by offset.
+  vector<pair<int64_t, int64_t> > chunk_ranges(chunks.size());
+  vector<int> sorted;
+  for (int i = 0; i < chunks.size(); ++i) {
+    const ColumnChunk& chunk = reader->column_chunk(chunks[i].first, chunks[i].second);
+    ParquetFileReader::GetColumnChunkRange(chunk.meta_data,
+        &chunk_ranges[i].first, &chunk_ranges[i].second);
+    if (chunks_.find(chunks[i]) == chunks_.end()) {
+      sorted.push_back(i);
+      chunks_[chunks[i]].range = -1;
+    }
+  }
+  sort(sorted.begin(), sorted.end(), ChunkOffsetLess(&chunk_ranges));
+
+  // Merge neighboring chunks. Each range is read when its first chunk in the
+  // original order is needed.
+  vector<pair<int, int> > range_order;
+  vector<Range> ranges;
+  for (int i = 0; i < sorted.size(); ++i) {
+    int64_t offset = chunk_ranges[sorted[i]].first;
+    int64_t length = chunk_ranges[sorted[i]].second;
+    bool merge = false;
+    if (!ranges.empty()) {
+      const Range& last = ranges.back();
+      int64_t last_end = last.offset + last.length;
+      merge = offset - last_end <= options.max_hole_size &&
+          ::max(last_end, offset + length) - last.offset <= options.max_read_size;
+    }
+    if (!merge) {
+      Range range;
+      range.offset = offset;
+      range.length = length;
+      range.num_pending_chunks = 0;
+      range.done = false;
+      ranges.push_back(range);
+      range_order.push_back(make_pair(sorted[i], ranges.size() - 1));
+    }
+    Range& range = ranges.back();
+    range.length = ::max(range.offset + range.length, offset + length) - range.offset;
+    ++range.num_pending_chunks;
+    range_order.back().first = ::min(range_order.back().first, sorted[i]);
+
+    Chunk& chunk = chunks_[chunks[sorted[i]]];
+    chunk.range = ranges.size() - 1;
+    chunk.offset = offset - range.offset;
+    chunk.length = length;
+    chunk.requested = false;
+  }
+
+  // Put the ranges in read order and renumber the chunks accordingly.
+  sort(range_order.begin(), range_order.end());
+  vector<int> new_index(ranges.size());
+  for (int i = 0; i < range_order.size(); ++i) {
+    ranges_.push_back(ranges[range_order[i].second]);
+    new_index[range_order[i].second] = i;
+  }
+  for (map<pair<int, int>, Chunk>::iterator it = chunks_.begin(); it != chunks_.end();
+      ++it) {
+    it->second.range = new_index[it->second.range];
+  }
+
+  read_thread_ = thread(bind(&ColumnChunkPrefetcher::ReadLoop, this));
+}
+
+ColumnChunkPrefetcher::~ColumnChunkPrefetcher() {
+  budget_->Cancel();
+  read_thread_.join();
+}
+
+void ColumnChunkPrefetcher::ReadLoop() {
+  RandomAccessFile* file = reader_->file();
+  for (int i = 0; i < ranges_.size(); ++i) {
+    // The offset and length are not modified after the constructor, so they can be
+    // read without the lock.
+    int64_t offset = ranges_[i].offset;
+    int64_t length = ranges_[i].length;
+    if (!budget_->Acquire(length)) return;
+    shared_ptr<Buffer> buffer(new Buffer(budget_, length));
+
+    string error;
+    try {
+      if (file->ReadAt(offset, length, buffer->data()) != length) {
+        error = "Unexpected end of file while prefetching a column chunk.";
+      }
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+
+    mutex::scoped_lock l(lock_);
+    if (!error.empty()) {
+      error_ = error;
+      range_read_cv_.notify_all();
+      return;
+    }
+    ranges_[i].buffer = buffer;
+    ranges_[i].done = true;
+    range_read_cv_.notify_all();
+  }
+}
+
+shared_ptr<InputStream> ColumnChunkPrefetcher::GetStream(int row_group, int column) {
+  mutex::scoped_lock l(lock_);
+  map<pair<int, int>, Chunk>::iterator it = chunks_.find(make_pair(row_group, column));
+  if (it == chunks_.end()) {
+    throw ParquetException("Column chunk was not prefetched.");
+  }
+  Chunk& chunk = it->second;
+  if (chunk.requested) throw ParquetException("Column chunk was already requested.");
+  Range* range = &ranges_[chunk.range];
+  if (!range->done) {
+    budget_->AddWaiter();
+    while (!range->done && error_.empty()) range_read_cv_.wait(l);
+    budget_->RemoveWaiter();
+    if (!range->done) throw ParquetException(error_);
+  }
+  chunk.requested = true;
+  shared_ptr<InputStream> stream(new SharedBufferInputStream(range->buffer,
+      range->buffer->data() + chunk.offset, chunk.length));
+  if (--range->num_pending_chunks == 0) range->buffer.reset();
+  return stream;
+}
+
+}
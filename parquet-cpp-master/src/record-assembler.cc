@@ -0,0 +1,100 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parquet/record-assembler.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+namespace parquet_cpp {
+
+RecordAssembler::RecordAssembler(const SchemaNode* column)
+  : column_(column), num_records_(0) {
+  if (!column->is_leaf()) {
+    throw ParquetException("RecordAssembler requires a leaf node.");
+  }
+  for (const SchemaNode* node = column; !node->is_root(); node = node->parent()) {
+    Layer layer;
+    layer.node = node;
+    layers_.push_back(layer);
+  }
+  reverse(layers_.begin(), layers_.end());
+  Clear();
+}
+
+void RecordAssembler::Clear() {
+  for (int i = 0; i < layers_.size(); ++i) {
+    layers_[i].offsets.clear();
+    layers_[i].valid.clear();
+    if (layers_[i].node->is_repeated()) layers_[i].offsets.push_back(0);
+  }
+  num_records_ = 0;
+}
+
+void RecordAssembler::Append(const int16_t* def_levels, const int16_t* rep_levels,
+    int num_levels) {
+  const int max_def_level = column_->max_definition_level();
+  const int max_rep_level = column_->max_repetition_level();
+  if (def_levels == NULL && max_def_level > 0) {
+    throw ParquetException("Column has definition levels.");
+  }
+  if (rep_levels == NULL && max_rep_level > 0) {
+    throw ParquetException("Column has repetition levels.");
+  }
+
+  for (int i = 0; i < num_levels; ++i) {
+    int def_level = def_levels == NULL ? 0 : def_levels[i];
+    int rep_level = rep_levels == NULL ? 0 : rep_levels[i];
+    if (def_level < 0 || def_level > max_def_level ||
+        rep_level < 0 || rep_level > max_rep_level) {
+      stringstream ss;
+      ss << "Invalid levels for column " << column_->path() << ": definition level "
+         << def_level << ", repetition level " << rep_level;
+      throw ParquetException(ss.str());
+    }
+    if (rep_level == 0) {
+      ++num_records_;
+    } else if (num_records_ == 0) {
+      throw ParquetException("The first level does not start a record.");
+    }
+
+    // Walk down the path. 'new_slot' is true if this level starts a new slot in
+    // the current layer, which starts a new list, or null/non-null entry, in the
+    // layer below.
+    bool new_slot = rep_level == 0;
+    for (int j = 0; j < layers_.size(); ++j) {
+      Layer* layer = &layers_[j];
+      const SchemaNode* node = layer->node;
+      if (node->is_repeated()) {
+        if (new_slot) layer->offsets.push_back(layer->offsets.back());
+        // A repetition level up to this node's continues a list at this node or
+        // starts a new one above it; either way there is a new element here unless
+        // the list is empty.
+        new_slot = rep_level <= node->max_repetition_level() &&
+            def_level >= node->max_definition_level();
+        if (new_slot) ++layer->offsets.back();
+      }
+      if (!new_slot) continue;
+      if (node->is_optional()) {
+        layer->valid.push_back(def_level >= node->max_definition_level());
+      } else if (node == column_) {
+        layer->valid.push_back(def_level == max_def_level);
+      }
+    }
+  }
+}
+
+}
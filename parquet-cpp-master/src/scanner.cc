@@ -0,0 +1,252 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parquet/scanner.h"
+
+#include <string.h>
+#include <algorithm>
+#include <boost/bind.hpp>
+
+using namespace boost;
+using namespace parquet;
+using namespace std;
+
+namespace parquet_cpp {
+
+ParquetScanner::ParquetScanner(ParquetFileReader* reader, const vector<int>& columns,
+    const Options& options)
+  : reader_(reader),
+    columns_(columns),
+    options_(options),
+    next_task_(0),
+    next_row_group_(0),
+    cancelled_(false) {
+  if (columns.empty()) throw ParquetException("The scanner needs at least one column.");
+  for (int i = 0; i < columns.size(); ++i) {
+    if (columns[i] < 0 || columns[i] >= reader->num_columns()) {
+      throw ParquetException("Column index out of range.");
+    }
+  }
+  if (options.predicate != NULL) {
+    row_groups_ = reader->SelectRowGroups(*options.predicate);
+  } else {
+    for (int i = 0; i < reader->num_row_groups(); ++i) row_groups_.push_back(i);
+  }
+
+  if (options.read_ahead) {
+    // The chunks are prefetched in the order the workers take them.
+    vector<pair<int, int> > chunks;
+    for (int i = 0; i < row_groups_.size(); ++i) {
+      for (int j = 0; j < columns_.size(); ++j) {
+        chunks.push_back(make_pair(row_groups_[i], columns_[j]));
+      }
+    }
+    prefetcher_.reset(new ColumnChunkPrefetcher(reader, chunks,
+        options.read_ahead_options));
+  }
+
+  int num_threads = ::max(1, options.num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.create_thread(bind(&ParquetScanner::WorkerLoop, this));
+  }
+}
+
+ParquetScanner::~ParquetScanner() {
+  {
+    mutex::scoped_lock l(lock_);
+    cancelled_ = true;
+  }
+  row_group_taken_cv_.notify_all();
+  workers_.join_all();
+}
+
+shared_ptr<RowGroupData> ParquetScanner::Next() {
+  mutex::scoped_lock l(lock_);
+  if (next_row_group_ >= row_groups_.size()) return shared_ptr<RowGroupData>();
+  map<int, pair<shared_ptr<RowGroupData>, int> >::iterator it;
+  while (true) {
+    if (!error_.empty()) throw ParquetException(error_);
+    it = in_flight_.find(next_row_group_);
+    if (it != in_flight_.end() && it->second.second == 0) break;
+    row_group_done_cv_.wait(l);
+  }
+  shared_ptr<RowGroupData> result = it->second.first;
+  in_flight_.erase(it);
+  ++next_row_group_;
+  row_group_taken_cv_.notify_all();
+  return result;
+}
+
+void ParquetScanner::WorkerLoop() {
+  const int num_columns = columns_.size();
+  // At least the row group the consumer waits for must be decoded.
+  const int max_in_flight = ::max(1, options_.max_row_groups_in_flight);
+  const int64_t num_tasks = static_cast<int64_t>(row_groups_.size()) * num_columns;
+  while (true) {
+    int row_group_idx;
+    int column_idx;
+    ColumnChunkData* data;
+    {
+      mutex::scoped_lock l(lock_);
+      // Wait until the consumer is close enough to the next column chunk.
+      while (!cancelled_ && next_task_ < num_tasks &&
+          next_task_ / num_columns >=
+          next_row_group_ + max_in_flight) {
+        row_group_taken_cv_.wait(l);
+      }
+      if (cancelled_ || next_task_ >= num_tasks) return;
+      row_group_idx = next_task_ / num_columns;
+      column_idx = next_task_ % num_columns;
+      ++next_task_;
+
+      pair<shared_ptr<RowGroupData>, int>& entry = in_flight_[row_group_idx];
+      if (entry.first == NULL) {
+        entry.first.reset(new RowGroupData());
+        entry.first->row_group = row_groups_[row_group_idx];
+        entry.first->num_rows = reader_->row_group(entry.first->row_group).num_rows;
+        entry.first->columns.resize(num_columns);
+        entry.second = num_columns;
+      }
+      data = &entry.first->columns[column_idx];
+    }
+
+    // The column chunk is decoded without holding the lock. The RowGroupData is
+    // not accessed by the consumer until all its chunks are done.
+    string error;
+    try {
+      DecodeColumnChunk(row_groups_[row_group_idx], columns_[column_idx], data);
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+
+    mutex::scoped_lock l(lock_);
+    if (!error.empty()) {
+      if (error_.empty()) error_ = error;
+      cancelled_ = true;
+      row_group_done_cv_.notify_all();
+      row_group_taken_cv_.notify_all();
+      return;
+    }
+    if (--in_flight_[row_group_idx].second == 0) row_group_done_cv_.notify_all();
+  }
+}
+
+void ParquetScanner::DecodeColumnChunk(int row_group, int column,
+    ColumnChunkData* data) {
+  shared_ptr<ColumnReader> reader;
+  if (prefetcher_ != NULL) {
+    reader = reader_->GetColumnReader(row_group, column,
+        prefetcher_->GetStream(row_group, column));
+  } else {
+    reader = reader_->GetColumnReader(row_group, column);
+  }
+  const ColumnMetaData& metadata = reader_->column_chunk(row_group, column).meta_data;
+  data->column = column;
+  data->type = metadata.type;
+  switch (data->type) {
+    case Type::BOOLEAN:
+      DecodeValues<bool>(reader.get(), metadata.num_values, data);
+      break;
+    case Type::INT32:
+      DecodeValues<int32_t>(reader.get(), metadata.num_values, data);
+      break;
+    case Type::INT64:
+      DecodeValues<int64_t>(reader.get(), metadata.num_values, data);
+      break;
+    case Type::FLOAT:
+      DecodeValues<float>(reader.get(), metadata.num_values, data);
+      break;
+    case Type::DOUBLE:
+      DecodeValues<double>(reader.get(), metadata.num_values, data);
+      break;
+    case Type::BYTE_ARRAY:
+      DecodeValues<ByteArray>(reader.get(), metadata.num_values, data);
+      break;
+    default:
+      ParquetException::NYI("Unsupported type");
+  }
+}
+
+// ByteArray values point into the page they were decoded from, which is only
+// valid until the next page is read, so their bytes are copied to 'data'. The
+// buffer can grow, so the pointers are only set once all the pages are read; in
+// the meantime 'offsets' holds the offset of each value in the buffer.
+static void CopyByteArrays(const ByteArray* values, int num_values,
+    vector<uint8_t>* data, vector<int64_t>* offsets) {
+  for (int i = 0; i < num_values; ++i) {
+    offsets->push_back(data->size());
+    data->insert(data->end(), values[i].ptr, values[i].ptr + values[i].len);
+  }
+}
+
+static void SetByteArrayPointers(const vector<int64_t>& offsets,
+    const vector<uint8_t>& data, ByteArray* values) {
+  const uint8_t* base = data.empty() ? NULL : &data[0];
+  for (int64_t i = 0; i < offsets.size(); ++i) values[i].ptr = base + offsets[i];
+}
+
+// The other types are copied by value.
+template <typename T>
+static void CopyByteArrays(const T* values, int num_values,
+    vector<uint8_t>* data, vector<int64_t>* offsets) {
+}
+
+template <typename T>
+static void SetByteArrayPointers(const vector<int64_t>& offsets,
+    const vector<uint8_t>& data, T* values) {
+}
+
+template <typename T>
+void ParquetScanner::DecodeValues(ColumnReader* reader, int64_t num_levels_hint,
+    ColumnChunkData* data) {
+  const int batch_size = ::max(1, options_.batch_size);
+  const bool has_def_levels = reader->max_definition_level() > 0;
+  const bool has_rep_levels = reader->max_repetition_level() > 0;
+  data->num_levels = 0;
+  data->num_values = 0;
+  vector<int64_t> byte_array_offsets;
+
+  // The metadata has the number of levels of the chunk, which bounds the number of
+  // values. It is only trusted as a hint, the buffers grow if it is too small.
+  int64_t capacity = 0;
+  while (true) {
+    if (data->num_levels + batch_size > capacity) {
+      capacity = ::max(::max(capacity * 2, num_levels_hint),
+          data->num_levels + batch_size);
+      if (has_def_levels) data->def_levels.resize(capacity);
+      if (has_rep_levels) data->rep_levels.resize(capacity);
+      data->values.resize(capacity * sizeof(T));
+    }
+    T* values = reinterpret_cast<T*>(&data->values[0]) + data->num_values;
+    int64_t values_read;
+    int levels_read = reader->ReadBatch(batch_size,
+        has_def_levels ? &data->def_levels[data->num_levels] : NULL,
+        has_rep_levels ? &data->rep_levels[data->num_levels] : NULL,
+        values, &values_read);
+    if (levels_read == 0) break;
+    CopyByteArrays(values, values_read, &data->byte_array_data, &byte_array_offsets);
+    data->num_levels += levels_read;
+    data->num_values += values_read;
+  }
+
+  if (has_def_levels) data->def_levels.resize(data->num_levels);
+  if (has_rep_levels) data->rep_levels.resize(data->num_levels);
+  data->values.resize(data->num_values * sizeof(T));
+  if (data->num_values > 0) {
+    SetByteArrayPointers(byte_array_offsets, data->byte_array_data,
+        reinterpret_cast<T*>(&data->values[0]));
+  }
+}
+
+}
@@ -0,0 +1,82 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parquet/schema.h"
+
+using namespace parquet;
+using namespace std;
+
+namespace parquet_cpp {
+
+string SchemaNode::path() const {
+  if (is_root()) return "";
+  if (parent_->is_root()) return name();
+  return parent_->path() + "." + name();
+}
+
+Schema::Schema(const vector<SchemaElement>& elements)
+  : elements_(elements) {
+  if (elements.empty()) throw ParquetException("Invalid parquet file. Empty schema.");
+  nodes_.resize(elements.size(), SchemaNode());
+  int idx = 0;
+  BuildTree(NULL, &idx);
+  if (idx != elements.size()) {
+    throw ParquetException("Invalid parquet file. Schema has more than one root.");
+  }
+}
+
+void Schema::BuildTree(SchemaNode* parent, int* idx) {
+  if (*idx >= elements_.size()) {
+    throw ParquetException("Invalid parquet file. Schema is truncated.");
+  }
+  SchemaNode* node = &nodes_[*idx];
+  const SchemaElement& element = elements_[*idx];
+  node->element_ = &element;
+  node->parent_ = parent;
+  if (parent != NULL) {
+    node->max_definition_level_ = parent->max_definition_level_;
+    node->max_repetition_level_ = parent->max_repetition_level_;
+    if (node->is_optional()) {
+      ++node->max_definition_level_;
+    } else if (node->is_repeated()) {
+      ++node->max_definition_level_;
+      ++node->max_repetition_level_;
+    }
+  }
+  ++*idx;
+
+  if (parent != NULL && !element.__isset.num_children) {
+    node->column_index_ = columns_.size();
+    columns_.push_back(node);
+    return;
+  }
+  int num_children = element.__isset.num_children ? element.num_children : 0;
+  if (num_children < 0) {
+    throw ParquetException("Invalid parquet file. Negative number of children.");
+  }
+  for (int i = 0; i < num_children; ++i) {
+    node->children_.push_back(&nodes_[*idx]);
+    BuildTree(node, idx);
+  }
+}
+
+bool Schema::is_flat() const {
+  for (int i = 0; i < columns_.size(); ++i) {
+    if (columns_[i]->max_repetition_level() > 0) return false;
+    if (!columns_[i]->parent()->is_root()) return false;
+  }
+  return true;
+}
+
+}
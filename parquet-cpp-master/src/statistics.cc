@@ -0,0 +1,197 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parquet/statistics.h"
+
+#include <string.h>
+
+using namespace parquet;
+using namespace std;
+
+namespace parquet_cpp {
+
+// Compares byte arrays as unsigned bytes, a prefix sorts first.
+static int CompareBytes(const uint8_t* x, int x_len, const uint8_t* y, int y_len) {
+  int cmp = memcmp(x, y, ::min(x_len, y_len));
+  if (cmp != 0) return cmp;
+  return x_len - y_len;
+}
+
+static string EncodeValue(const void* value, int len) {
+  return string(reinterpret_cast<const char*>(value), len);
+}
+
+ColumnStatistics::ColumnStatistics(const Type::type& type) : type_(type) {
+  Reset();
+}
+
+void ColumnStatistics::Reset() {
+  has_min_max_ = false;
+  null_count_ = 0;
+  min_bytes_.clear();
+  max_bytes_.clear();
+}
+
+template <typename T>
+void ColumnStatistics::UpdateInternal(const T* values, int num_values,
+    T* min, T* max) {
+  int i = 0;
+  if (!has_min_max_) {
+    // Skip NaNs, which are never equal to themselves.
+    while (i < num_values && values[i] != values[i]) ++i;
+    if (i == num_values) return;
+    *min = *max = values[i++];
+    has_min_max_ = true;
+  }
+  T cur_min = *min;
+  T cur_max = *max;
+  for (; i < num_values; ++i) {
+    if (values[i] < cur_min) cur_min = values[i];
+    if (values[i] > cur_max) cur_max = values[i];
+  }
+  *min = cur_min;
+  *max = cur_max;
+}
+
+void ColumnStatistics::Update(const bool* values, int num_values) {
+  UpdateInternal(values, num_values, &min_.bool_val, &max_.bool_val);
+}
+
+void ColumnStatistics::Update(const int32_t* values, int num_values) {
+  UpdateInternal(values, num_values, &min_.int32_val, &max_.int32_val);
+}
+
+void ColumnStatistics::Update(const int64_t* values, int num_values) {
+  UpdateInternal(values, num_values, &min_.int64_val, &max_.int64_val);
+}
+
+void ColumnStatistics::Update(const float* values, int num_values) {
+  UpdateInternal(values, num_values, &min_.float_val, &max_.float_val);
+}
+
+void ColumnStatistics::Update(const double* values, int num_values) {
+  UpdateInternal(values, num_values, &min_.double_val, &max_.double_val);
+}
+
+void ColumnStatistics::Update(const ByteArray* values, int num_values) {
+  if (num_values == 0) return;
+  // Find the min and max of the batch first so the strings are only assigned once.
+  const ByteArray* min = &values[0];
+  const ByteArray* max = &values[0];
+  for (int i = 1; i < num_values; ++i) {
+    if (CompareBytes(values[i].ptr, values[i].len, min->ptr, min->len) < 0) {
+      min = &values[i];
+    }
+    if (CompareBytes(values[i].ptr, values[i].len, max->ptr, max->len) > 0) {
+      max = &values[i];
+    }
+  }
+  const uint8_t* min_bytes = reinterpret_cast<const uint8_t*>(min_bytes_.data());
+  const uint8_t* max_bytes = reinterpret_cast<const uint8_t*>(max_bytes_.data());
+  if (!has_min_max_ ||
+      CompareBytes(min->ptr, min->len, min_bytes, min_bytes_.size()) < 0) {
+    min_bytes_.assign(reinterpret_cast<const char*>(min->ptr), min->len);
+  }
+  if (!has_min_max_ ||
+      CompareBytes(max->ptr, max->len, max_bytes, max_bytes_.size()) > 0) {
+    max_bytes_.assign(reinterpret_cast<const char*>(max->ptr), max->len);
+  }
+  has_min_max_ = true;
+}
+
+void ColumnStatistics::Merge(const ColumnStatistics& other) {
+  if (other.type_ != type_) {
+    throw ParquetException("Cannot merge statistics of different types.");
+  }
+  null_count_ += other.null_count_;
+  if (!other.has_min_max_) return;
+  switch (type_) {
+    case Type::BOOLEAN:
+      Update(&other.min_.bool_val, 1);
+      Update(&other.max_.bool_val, 1);
+      break;
+    case Type::INT32:
+      Update(&other.min_.int32_val, 1);
+      Update(&other.max_.int32_val, 1);
+      break;
+    case Type::INT64:
+      Update(&other.min_.int64_val, 1);
+      Update(&other.max_.int64_val, 1);
+      break;
+    case Type::FLOAT:
+      Update(&other.min_.float_val, 1);
+      Update(&other.max_.float_val, 1);
+      break;
+    case Type::DOUBLE:
+      Update(&other.min_.double_val, 1);
+      Update(&other.max_.double_val, 1);
+      break;
+    case Type::BYTE_ARRAY: {
+      ByteArray values[2];
+      values[0].ptr = reinterpret_cast<const uint8_t*>(other.min_bytes_.data());
+      values[0].len = other.min_bytes_.size();
+      values[1].ptr = reinterpret_cast<const uint8_t*>(other.max_bytes_.data());
+      values[1].len = other.max_bytes_.size();
+      Update(values, 2);
+      break;
+    }
+    default:
+      ParquetException::NYI("Unsupported statistics type");
+  }
+}
+
+Statistics ColumnStatistics::ToThrift() const {
+  Statistics stats;
+  stats.__set_null_count(null_count_);
+  if (!has_min_max_) return stats;
+  switch (type_) {
+    case Type::BOOLEAN: {
+      uint8_t min = min_.bool_val;
+      uint8_t max = max_.bool_val;
+      stats.__set_min(EncodeValue(&min, 1));
+      stats.__set_max(EncodeValue(&max, 1));
+      break;
+    }
+    case Type::INT32:
+      stats.__set_min(EncodeValue(&min_.int32_val, sizeof(int32_t)));
+      stats.__set_max(EncodeValue(&max_.int32_val, sizeof(int32_t)));
+      break;
+    case Type::INT64:
+      stats.__set_min(EncodeValue(&min_.int64_val, sizeof(int64_t)));
+      stats.__set_max(EncodeValue(&max_.int64_val, sizeof(int64_t)));
+      break;
+    case Type::FLOAT:
+      stats.__set_min(EncodeValue(&min_.float_val, sizeof(float)));
+      stats.__set_max(EncodeValue(&max_.float_val, sizeof(float)));
+      break;
+    case Type::DOUBLE:
+      stats.__set_min(EncodeValue(&min_.double_val, sizeof(double)));
+      stats.__set_max(EncodeValue(&max_.double_val, sizeof(double)));
+      break;
+    case Type::BYTE_ARRAY:
+      stats.__set_min(min_bytes_);
+      stats.__set_max(max_bytes_);
+      break;
+    default:
+      break;
+  }
+  // The deprecated min and max are kept for older readers.
+  if (stats.__isset.min) {
+    stats.__set_min_value(stats.min);
+    stats.__set_max_value(stats.max);
+  }
+  return stats;
+}
+
+}
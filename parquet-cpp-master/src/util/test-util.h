@@ -0,0 +1,41 @@
+// Copyright 2012 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PARQUET_UTIL_TEST_UTIL_H
+#define PARQUET_UTIL_TEST_UTIL_H
+
+#include <iostream>
+#include <stdlib.h>
+
+// Checks for the test executables. A failed check prints the condition and exits
+// with a non-zero status, which is how ctest detects the failure.
+#define PARQUET_CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": Check failed: " #cond \
+          << std::endl; \
+      exit(1); \
+    } \
+  } while (false)
+
+#define PARQUET_CHECK_EQ(a, b) \
+  do { \
+    if (!((a) == (b))) { \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": Check failed: " #a " == " #b \
+          << " (" << (a) << " vs. " << (b) << ")" << std::endl; \
+      exit(1); \
+    } \
+  } while (false)
+
+#endif